@@ -0,0 +1,168 @@
+/**
+ * @name            hotel-booking
+ * @file            Admission.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Oct 26 09:12:40 CEST 2026
+ * @brief           admission control of an event loop
+ *
+ *
+ * Every event loop measures how long the sessions it found ready wait
+ * before being served (queue delay, smoothed) and how many of them are
+ * still waiting (in flight). Multiplied by the smoothed service time, the
+ * latter tells the delay of the last session of the batch before it's
+ * reached, so a burst is noticed as soon as it's picked up.
+ *
+ * When the expected delay goes over ADMISSION_LOGIN_DELAY the loop turns
+ * down new logins and registrations (crypt() is the most expensive thing
+ * the server does); over ADMISSION_SHED_DELAY it turns down the commands of
+ * logged-in sessions too. Turned down means answered right away with
+ * "BUSY <ms>", the time the client should wait before trying again.
+ * Cheap commands (help, resume, logout, quit) are always served.
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "config.h"
+#include "messages.h"   // BUSY_MSG
+
+
+typedef enum admission_class {
+    ADMISSION_LOGIN,                // new logins and registrations
+    ADMISSION_SESSION,              // reserve, release and view of logged-in sessions
+} admission_class_t;
+
+
+typedef struct admission {
+    uint64_t    batch_start;        // us, when the loop picked up the current batch
+    uint64_t    serving_since;      // us, when the session being served was picked
+    uint32_t    in_flight;          // sessions of the batch not served yet
+    uint64_t    delay;              // us, smoothed queue delay
+    uint64_t    service;            // us, smoothed time to serve a session
+
+    // metrics
+    uint64_t    max_delay;          // us, worst queue delay seen
+    uint64_t    admitted;
+    uint64_t    shed_logins;
+    uint64_t    shed_commands;
+} Admission;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+void    admissionBatch(Admission* a, uint32_t ready);
+void    admissionServe(Admission* a);
+void    admissionDone(Admission* a);
+int     admissionShed(Admission* a, admission_class_t class, char* busy, size_t size);
+void    admissionStats(const Admission* a, FILE* out, const char* prefix);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline uint64_t
+admissionNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+/**
+ * The loop picked up `ready` sessions.
+ */
+void
+admissionBatch(Admission* a, uint32_t ready)
+{
+    a->batch_start = admissionNow();
+    __atomic_store_n(&a->in_flight, ready, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * The loop is about to serve the next session of the batch.
+ */
+void
+admissionServe(Admission* a)
+{
+    uint64_t now   = admissionNow();
+    uint64_t delay = now - a->batch_start;
+
+    a->serving_since = now;
+
+    // moving averages, 1/8 weight to the new sample
+    __atomic_store_n(&a->delay, a->delay - (a->delay >> 3) + (delay >> 3), __ATOMIC_RELAXED);
+    if (delay > a->max_delay){
+        __atomic_store_n(&a->max_delay, delay, __ATOMIC_RELAXED);
+    }
+    if (a->in_flight > 0){
+        __atomic_store_n(&a->in_flight, a->in_flight - 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * The session picked by admissionServe() has been served.
+ */
+void
+admissionDone(Admission* a)
+{
+    uint64_t service = admissionNow() - a->serving_since;
+
+    a->service = a->service - (a->service >> 3) + (service >> 3);
+}
+
+
+/**
+ * Whether to turn down a command of `class`. If so, the reply is written to `busy`.
+ * return 1 if the command has to be turned down, 0 if it can be served
+ */
+int
+admissionShed(Admission* a, admission_class_t class, char* busy, size_t size)
+{
+    uint64_t expected = a->in_flight * a->service;
+    uint64_t delay    = a->delay > expected ? a->delay : expected;
+    uint64_t limit    = (class == ADMISSION_LOGIN ? ADMISSION_LOGIN_DELAY : ADMISSION_SHED_DELAY) * 1000;
+
+    if (delay <= limit){
+        __atomic_store_n(&a->admitted, a->admitted + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    // come back when the queue has had the time to drain
+    uint64_t retry = 2 * delay / 1000;
+
+    if (retry < ADMISSION_RETRY_MIN) retry = ADMISSION_RETRY_MIN;
+    if (retry > ADMISSION_RETRY_MAX) retry = ADMISSION_RETRY_MAX;
+
+    snprintf(busy, size, BUSY_MSG " %llu", (unsigned long long) retry);
+
+    if (class == ADMISSION_LOGIN){
+        __atomic_store_n(&a->shed_logins, a->shed_logins + 1, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_store_n(&a->shed_commands, a->shed_commands + 1, __ATOMIC_RELAXED);
+    }
+    return 1;
+}
+
+
+void
+admissionStats(const Admission* a, FILE* out, const char* prefix)
+{
+    fprintf(out, "%s.in_flight %u\n",        prefix, __atomic_load_n(&a->in_flight, __ATOMIC_RELAXED));
+    fprintf(out, "%s.queue_delay_us %llu\n", prefix, (unsigned long long) __atomic_load_n(&a->delay, __ATOMIC_RELAXED));
+    fprintf(out, "%s.max_delay_us %llu\n",   prefix, (unsigned long long) __atomic_load_n(&a->max_delay, __ATOMIC_RELAXED));
+    fprintf(out, "%s.admitted %llu\n",       prefix, (unsigned long long) __atomic_load_n(&a->admitted, __ATOMIC_RELAXED));
+    fprintf(out, "%s.shed_logins %llu\n",    prefix, (unsigned long long) __atomic_load_n(&a->shed_logins, __ATOMIC_RELAXED));
+    fprintf(out, "%s.shed_commands %llu\n",  prefix, (unsigned long long) __atomic_load_n(&a->shed_commands, __ATOMIC_RELAXED));
+}
+
+
+#endif
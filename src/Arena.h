@@ -0,0 +1,137 @@
+/**
+ * @name            hotel-booking
+ * @file            Arena.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Wed Oct 21 10:12:37 CEST 2026
+ * @brief           bump allocator for session and request scoped buffers
+ *
+ *
+ * A worker thread owns one arena, allocated once when the server starts.
+ * Whatever a command needs while it's being served is allocated from it
+ * and the arena is reset every time the thread resumes a session (what
+ * must outlive a command lives in the Session). Resetting is O(1) and
+ * nothing is ever freed one by one, so nothing can leak. arenaMark() and
+ * arenaRewind() give back part of it early.
+ *
+ * Counters are written by the owner thread only and read by the metrics
+ * thread, hence the relaxed atomics.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define ARENA_ALIGNMENT     16      // enough for any type we store
+
+
+typedef struct arena {
+    char*       base;
+    size_t      size;
+    size_t      used;
+
+    // metrics
+    size_t      high_water;         // max bytes in use at once
+    uint64_t    allocations;        // arenaAlloc() calls served
+    uint64_t    failures;           // arenaAlloc() calls that didn't fit
+    uint64_t    resets;             // arenaRewind() calls
+    uint64_t    heap_allocations;   // malloc() calls made by the arena: 1 in the steady state
+} Arena;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     initializeArena(Arena* a, size_t size);
+void*   arenaAlloc(Arena* a, size_t n);
+size_t  arenaMark(const Arena* a);
+void    arenaRewind(Arena* a, size_t mark);
+void    arenaReset(Arena* a);
+void    arenaStats(const Arena* a, FILE* out, const char* prefix);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+initializeArena(Arena* a, size_t size)
+{
+    a->base             = (char*) malloc(size);
+    a->size             = a->base != NULL ? size : 0;
+    a->used             = 0;
+    a->high_water       = 0;
+    a->allocations      = 0;
+    a->failures         = 0;
+    a->resets           = 0;
+    a->heap_allocations = 1;
+
+    return a->base != NULL ? 0 : -1;
+}
+
+
+/**
+ * return `n` bytes aligned to ARENA_ALIGNMENT, NULL if the arena is full
+ */
+void*
+arenaAlloc(Arena* a, size_t n)
+{
+    size_t start = (a->used + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+
+    if (start > a->size || n > a->size - start){
+        __atomic_add_fetch(&a->failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    a->used = start + n;
+    if (a->used > a->high_water){
+        __atomic_store_n(&a->high_water, a->used, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&a->allocations, 1, __ATOMIC_RELAXED);
+
+    return a->base + start;
+}
+
+
+/**
+ * return the current position, to be passed to arenaRewind()
+ */
+size_t
+arenaMark(const Arena* a)
+{
+    return a->used;
+}
+
+
+/**
+ * Release everything allocated after `mark`.
+ */
+void
+arenaRewind(Arena* a, size_t mark)
+{
+    a->used = mark;
+    __atomic_add_fetch(&a->resets, 1, __ATOMIC_RELAXED);
+}
+
+
+void
+arenaReset(Arena* a)
+{
+    arenaRewind(a, 0);
+}
+
+
+void
+arenaStats(const Arena* a, FILE* out, const char* prefix)
+{
+    fprintf(out, "%s.size %zu\n",             prefix, a->size);
+    fprintf(out, "%s.high_water %zu\n",       prefix, __atomic_load_n(&a->high_water, __ATOMIC_RELAXED));
+    fprintf(out, "%s.allocations %llu\n",     prefix, (unsigned long long) __atomic_load_n(&a->allocations, __ATOMIC_RELAXED));
+    fprintf(out, "%s.failures %llu\n",        prefix, (unsigned long long) __atomic_load_n(&a->failures, __ATOMIC_RELAXED));
+    fprintf(out, "%s.resets %llu\n",          prefix, (unsigned long long) __atomic_load_n(&a->resets, __ATOMIC_RELAXED));
+    fprintf(out, "%s.heap_allocations %llu\n",prefix, (unsigned long long) a->heap_allocations);
+}
+
+
+#endif
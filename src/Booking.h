@@ -11,12 +11,16 @@
 #ifndef BOOKING_H
 #define BOOKING_H
 
+#include "Calendar.h"
+
 typedef struct booking {
-    char    date[6];    // date is at most 6 since the date the user
-                        // is supposed to insert is - at most- 5 chars long
-                        // 24/10 (Oct 24).
-    char    room[4];    
+    char    date[DATE_STRING_LENGTH];   // date is at most 11 since the date the user
+                                        // is supposed to insert is - at most- 10 chars long
+                                        // 24/10/2020 (Oct 24, 2020).
+    day_t   day;                        // same date, as a day index (see Calendar.h)
+    char    room[ROOM_STRING_LENGTH];       // room number, 1..HOTEL_MAX_ROOMS-1
     char    code[RESERVATION_CODE_LENGTH];    // alphanumeric and autogenerated
+    uint32_t hotel;                     // hotel the booking is for (server side, picked with `hotel`)
 } Booking;
 
 
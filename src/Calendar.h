@@ -0,0 +1,247 @@
+/**
+ * @name            hotel-booking
+ * @file            Calendar.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Oct 19 09:12:40 CEST 2026
+ * @brief           day-indexed calendar with a sliding multi-year horizon
+ *
+ *
+ * Every date is turned into a `day_t` (days since 1970-01-01) so it can be
+ * compared and hashed as a plain integer.
+ * The booking horizon covers `CALENDAR_HORIZON_YEARS` consecutive years starting
+ * at `first_year`. Per-day data lives in a ring of fixed-size year slots
+ * (`CALENDAR_DAYS_PER_YEAR` entries each) indexed by `year % CALENDAR_HORIZON_YEARS`,
+ * so rolling the horizon forward only clears the slot of the year that
+ * leaves it: nothing is moved and the memory footprint never grows.
+ */
+
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "config.h"
+
+
+#define CALENDAR_DAYS_PER_YEAR  366                                         // slot size, leap years included
+#define CALENDAR_SLOTS          (CALENDAR_HORIZON_YEARS * CALENDAR_DAYS_PER_YEAR)
+#define DATE_STRING_LENGTH      11                                          // dd/mm/yyyy + '\0'
+
+
+typedef int32_t day_t;  // days since 1970-01-01
+
+
+typedef struct calendar {
+    int     first_year;     // oldest year still inside the horizon
+    int     years;          // horizon length (CALENDAR_HORIZON_YEARS)
+} Calendar;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     isLeapYear(int y);
+int     daysInMonth(int y, int m);
+int     dateIsValid(int y, int m, int d);
+day_t   daysFromCivil(int y, int m, int d);
+void    civilFromDays(day_t z, int* y, int* m, int* d);
+int     currentYear(void);
+int     parseDate(const char* s, int default_year, int* y, int* m, int* d);
+void    formatDate(day_t day, char* str);
+void    formatDateYYYYMMDD(day_t day, char* str);
+
+void    initializeCalendar(Calendar* c, int first_year);
+int     calendarContains(const Calendar* c, day_t day);
+int     calendarSlot(const Calendar* c, day_t day);
+int     calendarYearSlot(const Calendar* c, int year);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+isLeapYear(int y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+
+int
+daysInMonth(int y, int m)
+{
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    if (m == 2 && isLeapYear(y)){
+        return 29;
+    }
+    return days[m - 1];
+}
+
+
+/**
+ * return 1 if the date actually exists, 0 otherwise
+ */
+int
+dateIsValid(int y, int m, int d)
+{
+    if (y < 1970 || y > 9999 || m < 1 || m > 12 || d < 1){
+        return 0;
+    }
+    return d <= daysInMonth(y, m);
+}
+
+
+/**
+ * Days since 1970-01-01 of the proleptic gregorian date y-m-d.
+ * (http://howardhinnant.github.io/date_algorithms.html#days_from_civil)
+ */
+day_t
+daysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    const int      era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned) (y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + (day_t) doe - 719468;
+}
+
+
+/**
+ * Inverse of daysFromCivil().
+ */
+void
+civilFromDays(day_t z, int* y, int* m, int* d)
+{
+    z += 719468;
+    const int      era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = (unsigned) (z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp  = (5 * doy + 2) / 153;
+
+    *d = (int) (doy - (153 * mp + 2) / 5 + 1);
+    *m = (int) (mp < 10 ? mp + 3 : mp - 9);
+    *y = (int) yoe + era * 400 + (*m <= 2);
+}
+
+
+int
+currentYear(void)
+{
+    time_t now = time(NULL);
+    struct tm tm_now;
+
+    localtime_r(&now, &tm_now);
+    return tm_now.tm_year + 1900;
+}
+
+
+/**
+ * Parse a `dd/mm` or `dd/mm/yyyy` date, and nothing else: two digits for
+ * the day and the month, four for the year. When the year is omitted
+ * `default_year` is used.
+ * return 0 if the date is well formed and exists, -1 otherwise
+ */
+int
+parseDate(const char* s, int default_year, int* y, int* m, int* d)
+{
+    int len;
+    int end = 0;
+
+    // the shape first: %d would take a sign, a blank or a single digit too
+    for (len = 0; s[len] != '\0' && len < DATE_STRING_LENGTH; len++){
+        int slash = len == 2 || len == 5;
+
+        if (slash ? s[len] != '/' : s[len] < '0' || s[len] > '9'){
+            return -1;
+        }
+    }
+
+    if (len == 5 && sscanf(s, "%2d/%2d%n", d, m, &end) == 2 && end == len){
+        *y = default_year;
+    }
+    else if (len != DATE_STRING_LENGTH - 1 || sscanf(s, "%2d/%2d/%4d%n", d, m, y, &end) != 3 || end != len){
+        return -1;
+    }
+
+    return dateIsValid(*y, *m, *d) ? 0 : -1;
+}
+
+
+/**
+ * str must be at least DATE_STRING_LENGTH bytes long: dd/mm/yyyy
+ */
+void
+formatDate(day_t day, char* str)
+{
+    int y, m, d;
+
+    civilFromDays(day, &y, &m, &d);
+    snprintf(str, DATE_STRING_LENGTH, "%02d/%02d/%04d", d, m, y);
+}
+
+
+/**
+ * str must be at least 9 bytes long: yyyymmdd, the sortable form stored in the database.
+ */
+void
+formatDateYYYYMMDD(day_t day, char* str)
+{
+    int y, m, d;
+
+    civilFromDays(day, &y, &m, &d);
+    snprintf(str, 9, "%04d%02d%02d", y, m, d);
+}
+
+
+void
+initializeCalendar(Calendar* c, int first_year)
+{
+    c->first_year = first_year;
+    c->years      = CALENDAR_HORIZON_YEARS;
+}
+
+
+/**
+ * return 1 if `day` falls inside the booking horizon, 0 otherwise
+ */
+int
+calendarContains(const Calendar* c, day_t day)
+{
+    return day >= daysFromCivil(c->first_year, 1, 1) &&
+           day <  daysFromCivil(c->first_year + c->years, 1, 1);
+}
+
+
+/**
+ * Index of the first entry of the year slot holding `year`.
+ */
+int
+calendarYearSlot(const Calendar* c, int year)
+{
+    return (year % c->years) * CALENDAR_DAYS_PER_YEAR;
+}
+
+
+/**
+ * Index in [0, CALENDAR_SLOTS) of the per-day entry for `day`,
+ * -1 if the day is outside the horizon.
+ */
+int
+calendarSlot(const Calendar* c, day_t day)
+{
+    int y, m, d;
+
+    if (!calendarContains(c, day)){
+        return -1;
+    }
+
+    civilFromDays(day, &y, &m, &d);
+    return calendarYearSlot(c, y) + (int) (day - daysFromCivil(y, 1, 1));
+}
+
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * @name            hotel-booking
+ * @file            CodeIndex.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Tue Oct 20 15:40:55 CEST 2026
+ * @brief           index of the live reservation codes
+ *
+ *
+ * Open addressing hash table (linear probing, backward shift deletion)
+ * mapping every live reservation code to the booking it belongs to.
+ * It guarantees new codes are unique with an O(1) membership check and lets
+ * `release` find a booking (and its row id in the database) by its code.
+ *
+ * Codes generated before this index existed may be duplicated: the table
+ * tolerates that (same code, different owner), lookups match the owner too.
+ */
+
+#ifndef CODE_INDEX_H
+#define CODE_INDEX_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "utils.h"      // hashString()
+#include "Calendar.h"
+#include "Random.h"
+
+
+#define CODE_INDEX_INITIAL_CAPACITY     1024    // power of 2
+#define CODE_CHARSET                    "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+
+
+typedef struct code_entry {
+    char        code[RESERVATION_CODE_LENGTH];      // "" marks an empty slot
+    char        username[USERNAME_MAX_LENGTH];
+    day_t       day;
+    int         room;
+    uint32_t    hotel;
+    int64_t     id;                                 // row id in the Bookings table, 0 until stored
+} CodeEntry;
+
+
+typedef struct code_index {
+    pthread_mutex_t     lock;
+    CodeEntry*          slots;
+    uint32_t            capacity;                   // power of 2
+    uint32_t            count;
+    uint64_t            collisions;                 // generated codes that were already live
+} CodeIndex;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     initializeCodeIndex(CodeIndex* idx);
+int     codeIndexInsert(CodeIndex* idx, const CodeEntry* entry);
+int     codeIndexGenerate(CodeIndex* idx, CodeEntry* entry);
+int     codeIndexLookup(CodeIndex* idx, const CodeEntry* key, CodeEntry* found);
+int     codeIndexSetId(CodeIndex* idx, const CodeEntry* key, int64_t id);
+int     codeIndexRemove(CodeIndex* idx, const char* code, const char* username, day_t day, int room);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+initializeCodeIndex(CodeIndex* idx)
+{
+    memset(idx, 0, sizeof(CodeIndex));
+    pthread_mutex_init(&idx->lock, 0);
+
+    idx->capacity = CODE_INDEX_INITIAL_CAPACITY;
+    idx->slots    = (CodeEntry*) calloc(idx->capacity, sizeof(CodeEntry));
+
+    return idx->slots != NULL ? 0 : -1;
+}
+
+
+static inline int
+codeEntryMatches(const CodeEntry* e, const char* code, const char* username, day_t day, int room)
+{
+    return strcmp(e->code, code) == 0 && strcmp(e->username, username) == 0 && e->day == day && e->room == room;
+}
+
+
+/**
+ * Slot holding `code` (any owner), or the empty slot ending its probe sequence. Lock held.
+ */
+static uint32_t
+codeIndexProbe(const CodeIndex* idx, const char* code)
+{
+    uint32_t mask = idx->capacity - 1;
+    uint32_t i    = hashString(code) & mask;
+
+    while (idx->slots[i].code[0] != '\0' && strcmp(idx->slots[i].code, code) != 0){
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+
+/**
+ * Add an entry without checking for duplicates. Lock held.
+ */
+static int
+codeIndexPut(CodeIndex* idx, const CodeEntry* entry)
+{
+    // keep load factor <= 1/2
+    if (2 * (idx->count + 1) > idx->capacity){
+        CodeEntry* old      = idx->slots;
+        uint32_t   old_size = idx->capacity;
+        CodeEntry* grown    = (CodeEntry*) calloc(2 * old_size, sizeof(CodeEntry));
+
+        if (grown == NULL){
+            return -1;
+        }
+        idx->slots    = grown;
+        idx->capacity = 2 * old_size;
+        idx->count    = 0;
+
+        for (uint32_t i = 0; i < old_size; i++){
+            if (old[i].code[0] != '\0'){
+                codeIndexPut(idx, &old[i]);
+            }
+        }
+        free(old);
+    }
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t i    = hashString(entry->code) & mask;
+
+    while (idx->slots[i].code[0] != '\0'){
+        i = (i + 1) & mask;
+    }
+    idx->slots[i] = *entry;
+    idx->count++;
+    return 0;
+}
+
+
+/**
+ * Index an existing booking (used when warming up from the database).
+ * return 0 if OK, -1 if out of memory
+ */
+int
+codeIndexInsert(CodeIndex* idx, const CodeEntry* entry)
+{
+    int rv;
+
+    MUTEX_LOCK(&idx->lock);
+        rv = codeIndexPut(idx, entry);
+    MUTEX_UNLOCK(&idx->lock);
+
+    return rv;
+}
+
+
+/**
+ * Generate a code not used by any live booking, store it in `entry->code`
+ * and index `entry`. The code is reserved until codeIndexRemove().
+ * return 0 if OK, -1 if out of memory
+ */
+int
+codeIndexGenerate(CodeIndex* idx, CodeEntry* entry)
+{
+    int rv;
+
+    /* critical section */
+    MUTEX_LOCK(&idx->lock);
+
+        while (1){
+            for (int n = 0; n < RESERVATION_CODE_LENGTH - 1; n++){
+                entry->code[n] = CODE_CHARSET[randomBelow(sizeof(CODE_CHARSET) - 1)];
+            }
+            entry->code[RESERVATION_CODE_LENGTH - 1] = '\0';
+
+            if (idx->slots[codeIndexProbe(idx, entry->code)].code[0] == '\0'){
+                break;  // not live
+            }
+            idx->collisions++;
+        }
+
+        rv = codeIndexPut(idx, entry);
+
+    MUTEX_UNLOCK(&idx->lock);
+    /* end critical section */
+
+    return rv;
+}
+
+
+/**
+ * Slot of the entry matching code and owner, or -1. Lock held.
+ */
+static int64_t
+codeIndexSlot(const CodeIndex* idx, const char* code, const char* username, day_t day, int room)
+{
+    uint32_t mask = idx->capacity - 1;
+    uint32_t i    = hashString(code) & mask;
+
+    for (; idx->slots[i].code[0] != '\0'; i = (i + 1) & mask){
+        if (codeEntryMatches(&idx->slots[i], code, username, day, room)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Look up the booking (key->code, key->username, key->day, key->room) and copy it into `found`.
+ * return 0 if `code` is the live code of that booking, -1 otherwise
+ */
+int
+codeIndexLookup(CodeIndex* idx, const CodeEntry* key, CodeEntry* found)
+{
+    int64_t slot;
+
+    MUTEX_LOCK(&idx->lock);
+        slot = codeIndexSlot(idx, key->code, key->username, key->day, key->room);
+        if (slot >= 0){
+            *found = idx->slots[slot];
+        }
+    MUTEX_UNLOCK(&idx->lock);
+
+    return slot >= 0 ? 0 : -1;
+}
+
+
+/**
+ * Record the database row id of a booking once it's stored.
+ * return 0 if OK, -1 if there's no such booking
+ */
+int
+codeIndexSetId(CodeIndex* idx, const CodeEntry* key, int64_t id)
+{
+    int64_t slot;
+
+    MUTEX_LOCK(&idx->lock);
+        slot = codeIndexSlot(idx, key->code, key->username, key->day, key->room);
+        if (slot >= 0){
+            idx->slots[slot].id = id;
+        }
+    MUTEX_UNLOCK(&idx->lock);
+
+    return slot >= 0 ? 0 : -1;
+}
+
+
+/**
+ * Drop the booking from the index, making its code available again.
+ * return 0 if removed, -1 if there's no such booking
+ */
+int
+codeIndexRemove(CodeIndex* idx, const char* code, const char* username, day_t day, int room)
+{
+    int64_t  slot;
+    uint32_t mask;
+    uint32_t hole, i, home;
+
+    /* critical section */
+    MUTEX_LOCK(&idx->lock);
+
+        slot = codeIndexSlot(idx, code, username, day, room);
+        if (slot < 0){
+            MUTEX_UNLOCK(&idx->lock);
+            return -1;
+        }
+
+        // backward shift deletion: no tombstones, probe sequences stay short
+        mask = idx->capacity - 1;
+        hole = (uint32_t) slot;
+        i    = (hole + 1) & mask;
+
+        while (idx->slots[i].code[0] != '\0'){
+            home = hashString(idx->slots[i].code) & mask;
+
+            // move the entry into the hole if the hole lies between its home and its slot
+            if (((i - home) & mask) >= ((i - hole) & mask)){
+                idx->slots[hole] = idx->slots[i];
+                hole = i;
+            }
+            i = (i + 1) & mask;
+        }
+        memset(&idx->slots[hole], 0, sizeof(CodeEntry));
+        idx->count--;
+
+    MUTEX_UNLOCK(&idx->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * @name            hotel-booking
+ * @file            EventLoop.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sat Oct 24 10:21:36 CEST 2026
+ * @brief           readiness notification for the session event loops
+ *
+ *
+ * Each worker thread runs an event loop over the sessions it owns: it
+ * waits for their sockets to become readable (or writable, when a reply
+ * didn't fit in the socket buffer) and resumes their FSM (see `Session.h`).
+ *
+ * The poller is epoll on Linux and kqueue on macOS, behind the same few
+ * calls. Notifications are level-triggered: a session that still has data
+ * to read is reported again on the next wait.
+ *
+ * On Linux the loops run on io_uring instead when the kernel allows it
+ * (IO_URING): rather than waiting for readiness and then reading, the loop
+ * keeps a receive posted for every session, straight into its input
+ * buffer, and gets the bytes with the completion; replies go out as a send
+ * linked to the next receive. One io_uring_enter() per batch submits all of
+ * them and waits for the next completions. The loop also accepts its own
+ * connections, with a multishot accept on the listening socket.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+    #include <sys/event.h>
+#else
+    #include <sys/epoll.h>
+#endif
+
+#include "Uring.h"
+#include "Admission.h"
+
+
+#define POLLER_IN           1       // wait for the socket to be readable
+#define POLLER_OUT          2       // wait for the socket to be writable
+
+
+typedef struct poller_event {
+    void*       data;               // as passed to pollerAdd()
+    int         readable;
+    int         writable;
+    int         hangup;             // peer closed or socket error
+} PollerEvent;
+
+
+typedef struct event_loop {
+    int         poller;             // epoll/kqueue backend
+    int         uring;              // 1 if the loop runs on `ring` instead
+    Uring       ring;
+    Admission   admission;          // queue delay of the loop, decides what to turn down
+
+    // metrics
+    uint32_t    sessions;           // live sessions owned by the loop
+    uint64_t    accepted;
+    uint64_t    closed;
+    uint64_t    steps;              // times a session was resumed
+    uint64_t    backlogged;         // replies that didn't fit in the socket buffer
+    uint64_t    protocol_errors;    // sessions dropped for oversized or malformed frames
+    uint64_t    syscalls;           // waits, receives and sends (io_uring_enter() only, with io_uring)
+} EventLoop;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     pollerCreate(void);
+int     pollerAdd(int poller, int fd, int events, void* data);
+int     pollerModify(int poller, int fd, int events, void* data);
+int     pollerWait(int poller, PollerEvent* events, int max, int timeout_ms);
+void    eventLoopStats(const EventLoop* loop, FILE* out, const char* prefix);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+#ifdef __APPLE__
+
+
+int
+pollerCreate(void)
+{
+    return kqueue();
+}
+
+
+static int
+pollerSet(int poller, int fd, int events, void* data, int add)
+{
+    struct kevent change[2];
+
+    EV_SET(&change[0], fd, EVFILT_READ,  (add ? EV_ADD : 0) | ((events & POLLER_IN)  ? EV_ENABLE : EV_DISABLE), 0, 0, data);
+    EV_SET(&change[1], fd, EVFILT_WRITE, (add ? EV_ADD : 0) | ((events & POLLER_OUT) ? EV_ENABLE : EV_DISABLE), 0, 0, data);
+
+    return kevent(poller, change, 2, NULL, 0, NULL) == 0 ? 0 : -1;
+}
+
+
+int
+pollerAdd(int poller, int fd, int events, void* data)
+{
+    return pollerSet(poller, fd, events, data, 1);
+}
+
+
+int
+pollerModify(int poller, int fd, int events, void* data)
+{
+    return pollerSet(poller, fd, events, data, 0);
+}
+
+
+/**
+ * Wait for up to `max` events (-1 `timeout_ms` waits forever).
+ * return the number of events, -1 on error
+ */
+int
+pollerWait(int poller, PollerEvent* events, int max, int timeout_ms)
+{
+    struct kevent   ready[64];
+    struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    int             n;
+
+    n = kevent(poller, NULL, 0, ready, max < 64 ? max : 64, timeout_ms < 0 ? NULL : &timeout);
+    for (int i = 0; i < n; i++){
+        events[i].data     = ready[i].udata;
+        events[i].readable = ready[i].filter == EVFILT_READ;
+        events[i].writable = ready[i].filter == EVFILT_WRITE;
+        events[i].hangup   = (ready[i].flags & EV_ERROR) != 0;     // EOF shows up as a read of 0 bytes
+    }
+    return n;
+}
+
+
+#else
+
+
+int
+pollerCreate(void)
+{
+    return epoll_create1(EPOLL_CLOEXEC);
+}
+
+
+static inline uint32_t
+pollerEpollEvents(int events)
+{
+    return ((events & POLLER_IN) ? EPOLLIN : 0) | ((events & POLLER_OUT) ? EPOLLOUT : 0) | EPOLLRDHUP;
+}
+
+
+int
+pollerAdd(int poller, int fd, int events, void* data)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = pollerEpollEvents(events);
+    ev.data.ptr = data;
+
+    return epoll_ctl(poller, EPOLL_CTL_ADD, fd, &ev);
+}
+
+
+int
+pollerModify(int poller, int fd, int events, void* data)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = pollerEpollEvents(events);
+    ev.data.ptr = data;
+
+    return epoll_ctl(poller, EPOLL_CTL_MOD, fd, &ev);
+}
+
+
+/**
+ * Wait for up to `max` events (-1 `timeout_ms` waits forever).
+ * return the number of events, -1 on error
+ */
+int
+pollerWait(int poller, PollerEvent* events, int max, int timeout_ms)
+{
+    struct epoll_event  ready[64];
+    int                 n;
+
+    n = epoll_wait(poller, ready, max < 64 ? max : 64, timeout_ms);
+    for (int i = 0; i < n; i++){
+        events[i].data     = ready[i].data.ptr;
+        events[i].readable = (ready[i].events & (EPOLLIN | EPOLLRDHUP)) != 0;
+        events[i].writable = (ready[i].events & EPOLLOUT) != 0;
+        events[i].hangup   = (ready[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+    }
+    return n;
+}
+
+
+#endif
+
+
+void
+eventLoopStats(const EventLoop* loop, FILE* out, const char* prefix)
+{
+    fprintf(out, "%s.backend %s\n",             prefix, loop->uring ? "io_uring" : "poller");
+    fprintf(out, "%s.sessions %u\n",            prefix, __atomic_load_n(&loop->sessions, __ATOMIC_RELAXED));
+    fprintf(out, "%s.accepted %llu\n",          prefix, (unsigned long long) __atomic_load_n(&loop->accepted, __ATOMIC_RELAXED));
+    fprintf(out, "%s.closed %llu\n",            prefix, (unsigned long long) __atomic_load_n(&loop->closed, __ATOMIC_RELAXED));
+    fprintf(out, "%s.steps %llu\n",             prefix, (unsigned long long) __atomic_load_n(&loop->steps, __ATOMIC_RELAXED));
+    fprintf(out, "%s.backlogged %llu\n",        prefix, (unsigned long long) __atomic_load_n(&loop->backlogged, __ATOMIC_RELAXED));
+    fprintf(out, "%s.protocol_errors %llu\n",   prefix, (unsigned long long) __atomic_load_n(&loop->protocol_errors, __ATOMIC_RELAXED));
+    fprintf(out, "%s.syscalls %llu\n",          prefix, (unsigned long long) __atomic_load_n(&loop->syscalls, __ATOMIC_RELAXED));
+}
+
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @name            hotel-booking
+ * @file            HashRing.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Thu Oct 29 10:12:44 CET 2026
+ * @brief           consistent hashing of hotel IDs over server processes (shards)
+ *
+ *
+ * Each shard is hashed onto a 32-bit ring at ROUTER_VNODES points, from its
+ * address ("ip:port#k"); a hotel belongs to the shard owning the first point
+ * at or after the hash of its ID, wrapping around. Points only depend on
+ * the addresses, so every router given the same shards (in any order)
+ * agrees, and adding a shard only moves the hotels that land on its points:
+ * about 1/N of them.
+ */
+
+#ifndef HASH_RING_H
+#define HASH_RING_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "Address.h"
+#include "utils.h"      // hashString()
+
+
+typedef struct hash_ring_point {
+    uint32_t    hash;
+    int32_t     shard;
+} HashRingPoint;
+
+
+typedef struct hash_ring {
+    Address         shards[ROUTER_MAX_SHARDS];
+    int             count;
+    HashRingPoint   points[ROUTER_MAX_SHARDS * ROUTER_VNODES];      // sorted by hash
+    int             size;
+} HashRing;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     hashRingAdd(HashRing* ring, const Address* shard);
+int     hashRingLookup(const HashRing* ring, uint32_t hotel);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+/**
+ * FNV-1a leaves similar keys close to each other: spread them over the whole ring.
+ */
+static inline uint32_t
+hashRingMix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+
+static int
+hashRingCompare(const void* a, const void* b)
+{
+    uint32_t x = ((const HashRingPoint*) a)->hash;
+    uint32_t y = ((const HashRingPoint*) b)->hash;
+
+    return x < y ? -1 : x > y;
+}
+
+
+/**
+ * return the index of the new shard, -1 if there are ROUTER_MAX_SHARDS already
+ */
+int
+hashRingAdd(HashRing* ring, const Address* shard)
+{
+    char name[40];
+
+    if (ring->count == ROUTER_MAX_SHARDS){
+        return -1;
+    }
+
+    for (int k = 0; k < ROUTER_VNODES; k++){
+        snprintf(name, sizeof(name), "%s:%d#%d", shard->ip, shard->port, k);
+
+        ring->points[ring->size].hash  = hashRingMix(hashString(name));
+        ring->points[ring->size].shard = ring->count;
+        ring->size++;
+    }
+    ring->shards[ring->count] = *shard;
+
+    qsort(ring->points, ring->size, sizeof(HashRingPoint), hashRingCompare);
+    return ring->count++;
+}
+
+
+/**
+ * return the index of the shard owning `hotel`, -1 if the ring is empty
+ */
+int
+hashRingLookup(const HashRing* ring, uint32_t hotel)
+{
+    uint32_t h  = hashRingMix(hotel * 0x9e3779b1u);
+    int      lo = 0, hi = ring->size;
+
+    if (ring->size == 0){
+        return -1;
+    }
+
+    // first point at or after `h`
+    while (lo < hi){
+        int mid = lo + (hi - lo) / 2;
+
+        if (ring->points[mid].hash < h){
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return ring->points[lo == ring->size ? 0 : lo].shard;
+}
+
+
+#endif
@@ -11,17 +11,30 @@
 #ifndef HOTEL_H
 #define HOTEL_H
 
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Calendar.h"
+#include "Inventory.h"
 
 
 typedef struct hotel {
-    int     available_rooms;
-    int     booked_rooms[12][31];   // rooms available for each day of the year
+    uint32_t    id;                                             // hotel ID (see HOTEL_ID_DEFAULT)
+    Inventory   inventory;                                      // room catalog
+    Calendar    calendar;                                       // booking horizon
+    uint64_t    occupied[CALENDAR_SLOTS][ROOM_MASK_WORDS];      // booked rooms for each day of the horizon
+    uint16_t    booked_rooms[CALENDAR_SLOTS][ROOM_TYPES];       // number of booked rooms of each type for each day
 } Hotel;
 
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
-void    initializeHotel(Hotel* h);
-int     bookRoom(Hotel* h, int day, int month);
+void    initializeHotel(Hotel* h, int first_year);
+int     bookRoom(Hotel* h, day_t day, room_type_t type);
+int     markRoomBooked(Hotel* h, day_t day, int room);
+int     releaseRoom(Hotel* h, day_t day, int room);
+int     roomsBooked(Hotel* h, day_t day);
+int     rollHotelHorizon(Hotel* h, int first_year, const char* archive_folder);
 
 
 
@@ -30,27 +43,136 @@ int     bookRoom(Hotel* h, int day, int month);
 
 
 // methods definitions
-void initializeHotel(Hotel* h){
-    for (int i = 0; i < 12; i++) {
-        for (int j = 0; j < 31; j++) {
-            h->booked_rooms[i][j] = 0;
-        }
-    }
+void initializeHotel(Hotel* h, int first_year){
+    initializeInventory(&h->inventory);
+    initializeCalendar(&h->calendar, first_year);
+    memset(h->occupied, 0, sizeof(h->occupied));
+    memset(h->booked_rooms, 0, sizeof(h->booked_rooms));
     return;
 }
 
 
 /**
- * return 0 is booking is successful, otherwise -1
+ * Book the best fitting free room of type `type` on `day`.
+ * return the room number if booking is successful, otherwise -1
  */
-int bookRoom(Hotel* h, int day, int month){
-    if (h->booked_rooms[day][month] < h->available_rooms){
-        h->booked_rooms[day][month]++;
-        return 0;   // success
-    }
-    else {
+int bookRoom(Hotel* h, day_t day, room_type_t type){
+    int slot = calendarSlot(&h->calendar, day);
+    int room;
+
+    if (slot < 0){
         return -1;  // failure
     }
+
+    // per-type counters tell a sold out type without scanning its mask.
+    if (type != ROOM_ANY && h->booked_rooms[slot][type] >= h->inventory.rooms_per_type[type]){
+        return -1;
+    }
+
+    room = findFreeRoom(&h->inventory, h->occupied[slot], type);
+    if (room > 0){
+        markRoomBooked(h, day, room);
+    }
+    return room;
+}
+
+
+/**
+ * Flag `room` as booked on `day` (used when loading existing bookings).
+ * return 0 if the room was free, otherwise -1
+ */
+int markRoomBooked(Hotel* h, day_t day, int room){
+    int slot = calendarSlot(&h->calendar, day);
+
+    if (slot < 0 || room <= 0 || room >= HOTEL_MAX_ROOMS || (h->occupied[slot][room / 64] >> (room % 64)) & 1){
+        return -1;
+    }
+
+    h->occupied[slot][room / 64] |= 1ULL << (room % 64);
+    if (roomExists(&h->inventory, room)){
+        h->booked_rooms[slot][h->inventory.room_type[room]]++;
+    }
+    return 0;
+}
+
+
+/**
+ * return 0 if a booked room has been given back, otherwise -1
+ */
+int releaseRoom(Hotel* h, day_t day, int room){
+    int slot = calendarSlot(&h->calendar, day);
+
+    if (slot < 0 || room <= 0 || room >= HOTEL_MAX_ROOMS || !((h->occupied[slot][room / 64] >> (room % 64)) & 1)){
+        return -1;
+    }
+
+    h->occupied[slot][room / 64] &= ~(1ULL << (room % 64));
+    if (roomExists(&h->inventory, room)){
+        h->booked_rooms[slot][h->inventory.room_type[room]]--;
+    }
+    return 0;
+}
+
+
+/**
+ * return number of rooms booked on `day`, -1 if day is outside the horizon
+ */
+int roomsBooked(Hotel* h, day_t day){
+    int slot = calendarSlot(&h->calendar, day);
+    int n = 0;
+
+    if (slot < 0){
+        return -1;
+    }
+    for (int w = 0; w < ROOM_MASK_WORDS; w++){
+        n += __builtin_popcountll(h->occupied[slot][w]);
+    }
+    return n;
+}
+
+
+/**
+ * Slide the horizon so that it starts at `first_year`.
+ * The occupancy of every year leaving the horizon is written to
+ * `<archive_folder>/<year>.bin` and its slot is recycled for the new years.
+ * Every archive is written before any slot is recycled: on an I/O error the
+ * horizon is left as it was, and the next roll writes the same archives again.
+ * return number of years archived, -1 on I/O error
+ */
+int rollHotelHorizon(Hotel* h, int first_year, const char* archive_folder){
+    char path[64];
+    int  archived = 0;
+    int  failed;
+
+    // years that are entirely in the past of the new horizon are archived,
+    // years skipped altogether (server down for a long time) are just empty.
+    for (int year = h->calendar.first_year; year < first_year && year < h->calendar.first_year + h->calendar.years; year++){
+        int slot = calendarYearSlot(&h->calendar, year);
+
+        snprintf(path, sizeof(path), "%s/%d.bin", archive_folder, year);
+
+        FILE* archive = fopen(path, "wb");
+        if (archive == NULL){
+            return -1;
+        }
+        failed = fwrite(h->occupied[slot], sizeof(h->occupied[0]), CALENDAR_DAYS_PER_YEAR, archive) != CALENDAR_DAYS_PER_YEAR;
+        if (fclose(archive) != 0 || failed){
+            return -1;
+        }
+        archived++;
+    }
+
+    for (int year = h->calendar.first_year; year < first_year; year++){
+        int slot = calendarYearSlot(&h->calendar, year);
+
+        memset(h->occupied[slot],     0, CALENDAR_DAYS_PER_YEAR * sizeof(h->occupied[0]));
+        memset(h->booked_rooms[slot], 0, CALENDAR_DAYS_PER_YEAR * sizeof(h->booked_rooms[0]));
+    }
+
+    if (first_year > h->calendar.first_year){
+        h->calendar.first_year = first_year;
+    }
+    return archived;
 }
 
 
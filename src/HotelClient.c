@@ -0,0 +1,1004 @@
+/**
+ * @name            hotel-booking
+ * @file            HotelClient.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Tue Oct 27 10:02:31 CET 2026
+ * @brief           client library (see `HotelClient.h`)
+ *
+ * *compilation     `make hotelclient`: libhotelclient.a
+ *
+ *
+ * Every connection keeps its commands in a queue, in the order they were
+ * (or will be) sent: the server serves them in that order, so each reply
+ * belongs to the command at the head. `unsent` points at the first command
+ * whose frames haven't been written yet; everything before it is in flight.
+ *
+ * Login, register and moving the connection to another user change who the
+ * following commands run as, and may fail: while one of them is in flight
+ * (`barrier`) nothing else is written on that connection.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// networking
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <arpa/inet.h>
+
+
+/* user-defined headers */
+
+#include "config.h"
+#include "messages.h"
+#include "HotelClient.h"
+
+
+#define HOTEL_CLIENT_PIPELINE   64          // commands queued on the connection of a user before another one is taken
+#define HOTEL_CLIENT_USERS      4096        // buckets of the users table
+#define HOTEL_CLIENT_INPUT      SESSION_OUTPUT_SIZE     // the longest reply the server frames
+#define HOTEL_TOKEN_SIZE        64          // > length of the tokens sent by the server
+#define HOTEL_ARG_SIZE          PASSWORD_MAX_LENGTH
+
+#define RELEASE_OK_PREFIX       "\033[92mOK."   // server reply to a successful `release`
+
+#ifdef MSG_NOSIGNAL
+    #define HOTEL_SEND_FLAGS    MSG_NOSIGNAL
+#else
+    #define HOTEL_SEND_FLAGS    0
+#endif
+
+
+typedef enum request_type {
+    REQUEST_REGISTER,
+    REQUEST_LOGIN,
+    REQUEST_RESERVE,
+    REQUEST_VIEW,
+    REQUEST_RELEASE
+} request_type_t;
+
+typedef enum request_phase {
+    PHASE_QUEUED,           // not sent yet
+    PHASE_SWITCH,           // `resume` sent to move the connection to the user, waiting for "Y"
+    PHASE_SENT,             // command sent, waiting for its (first) reply
+    PHASE_PROMPT,           // login/register sent, waiting for "OK" / the username prompt
+    PHASE_USERNAME,         // username sent, waiting for "Y"
+    PHASE_PASSWORD,         // password sent
+    PHASE_MESSAGE,          // register: waiting for the second message
+    PHASE_TOKEN,            // waiting for the session token
+    PHASE_ROOM,             // reserve: waiting for the room
+    PHASE_CODE              // reserve: waiting for the code
+} request_phase_t;
+
+typedef enum connection_state {
+    CONNECTION_DOWN,
+    CONNECTION_CONNECTING,
+    CONNECTION_UP
+} connection_state_t;
+
+
+typedef struct hotel_user {
+    char                    username[USERNAME_MAX_LENGTH];
+    char                    token[HOTEL_TOKEN_SIZE];        // "" until logged in
+    struct hotel_user*      next;
+} HotelUser;
+
+
+typedef struct hotel_request {
+    request_type_t          type;
+    request_phase_t         phase;
+    HotelUser*              user;
+    char                    args[3][HOTEL_ARG_SIZE];        // password | date, type | date, room, code
+    int                     failed;                         // register: "password NOT OK."
+
+    hotel_callback_t        callback;
+    void*                   arg;
+    HotelReply              reply;
+    char*                   text;                           // reply.text
+
+    struct hotel_request*   next;
+} HotelRequest;
+
+
+typedef struct hotel_connection {
+    int                     fd;
+    connection_state_t      state;
+    HotelUser*              user;           // logged in as, once what was sent is served (NULL: logged out)
+    HotelUser*              tail_user;      // logged in as, once the whole queue is served (if all goes well)
+    int                     barrier;        // a login, register or switch is in flight
+
+    HotelRequest*           head;           // in flight first, then the ones not sent yet
+    HotelRequest*           tail;
+    HotelRequest*           last_sent;      // NULL if nothing is in flight
+    HotelRequest*           unsent;
+    int                     queued;
+
+    char*                   out;            // frames not taken by the socket yet
+    uint32_t                out_used;
+    uint32_t                out_size;
+    uint32_t                out_sent;
+
+    char                    in[HOTEL_CLIENT_INPUT];
+    uint32_t                in_used;
+} HotelConnection;
+
+
+struct hotel_client {
+    struct sockaddr_in      server;
+    HotelConnection*        connections;
+    int                     count;
+
+    HotelUser*              users[HOTEL_CLIENT_USERS];
+
+    HotelRequest*           done_head;      // callbacks to call
+    HotelRequest*           done_tail;
+    int                     pending;
+};
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+static void     connectionOpen(HotelClient* c, HotelConnection* conn);
+static void     connectionReset(HotelClient* c, HotelConnection* conn);
+static int      connectionPump(HotelClient* c, HotelConnection* conn);
+static int      connectionFlush(HotelConnection* conn);
+static int      connectionReceive(HotelClient* c, HotelConnection* conn);
+static int      connectionReply(HotelClient* c, HotelConnection* conn, const char* msg);
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static uint32_t
+hashUsername(const char* username)
+{
+    uint32_t h = 2166136261u;   // FNV-1a
+
+    while (*username){
+        h = (h ^ (uint8_t) *username++) * 16777619u;
+    }
+    return h;
+}
+
+
+/**
+ * return the user `username`, added if new, NULL if out of memory
+ */
+static HotelUser*
+userGet(HotelClient* c, const char* username)
+{
+    uint32_t   b = hashUsername(username) % HOTEL_CLIENT_USERS;
+    HotelUser* u;
+
+    for (u = c->users[b]; u != NULL; u = u->next){
+        if (strcmp(u->username, username) == 0){
+            return u;
+        }
+    }
+
+    u = (HotelUser*) calloc(1, sizeof(HotelUser));
+    if (u != NULL){
+        strcpy(u->username, username);
+        u->next     = c->users[b];
+        c->users[b] = u;
+    }
+    return u;
+}
+
+
+/**
+ * Hand `r` (already out of its connection queue) to the callbacks to call.
+ */
+static void
+requestDone(HotelClient* c, HotelRequest* r, hotel_status_t status)
+{
+    r->reply.status = status;
+    r->reply.text   = r->text != NULL ? r->text : "";
+    r->next         = NULL;
+
+    if (c->done_tail != NULL){
+        c->done_tail->next = r;
+    }
+    else {
+        c->done_head = r;
+    }
+    c->done_tail = r;
+}
+
+
+static int
+callbacksRun(HotelClient* c)
+{
+    int n = 0;
+
+    // a callback may queue commands, failing ones land here too
+    while (c->done_head != NULL){
+        HotelRequest* r = c->done_head;
+
+        c->done_head = r->next;
+        if (c->done_head == NULL){
+            c->done_tail = NULL;
+        }
+        c->pending--;
+
+        r->callback(r->arg, &r->reply);
+        free(r->text);
+        free(r);
+        n++;
+    }
+    return n;
+}
+
+
+static char*
+textCopy(const char* msg)
+{
+    size_t n    = strlen(msg) + 1;
+    char*  text = (char*) malloc(n);
+
+    if (text != NULL){
+        memcpy(text, msg, n);
+    }
+    return text;
+}
+
+
+/**
+ * return the reply as a busy reply's retry time, -1 if it isn't one
+ */
+static int
+busyRetry(const char* msg)
+{
+    int retry;
+
+    return sscanf(msg, BUSY_MSG " %d", &retry) == 1 ? retry : -1;
+}
+
+
+static int
+frameAppend(HotelConnection* conn, const char* msg)
+{
+    uint32_t len  = (uint32_t) strlen(msg);
+    uint32_t need = conn->out_used + sizeof(uint32_t) + len;
+    uint32_t dim  = htonl(len);
+
+    if (need > conn->out_size){
+        uint32_t size  = conn->out_size ? conn->out_size : 256;
+        char*    grown;
+
+        while (size < need){
+            size *= 2;
+        }
+        grown = (char*) realloc(conn->out, size);
+        if (grown == NULL){
+            return -1;
+        }
+        conn->out      = grown;
+        conn->out_size = size;
+    }
+
+    memcpy(conn->out + conn->out_used, &dim, sizeof(dim));
+    memcpy(conn->out + conn->out_used + sizeof(dim), msg, len);
+    conn->out_used = need;
+    return 0;
+}
+
+
+/**
+ * Take `r`, the first request not sent, out of the queue of `conn`.
+ */
+static void
+unlinkUnsent(HotelConnection* conn, HotelRequest* r)
+{
+    if (conn->last_sent != NULL){
+        conn->last_sent->next = r->next;
+    }
+    else {
+        conn->head = r->next;
+    }
+    if (conn->tail == r){
+        conn->tail = conn->last_sent;
+    }
+    conn->unsent = r->next;
+    conn->queued--;
+}
+
+
+/**
+ * Take the request at the head (the one the reply was for) out of the queue of `conn`.
+ */
+static HotelRequest*
+unlinkHead(HotelConnection* conn)
+{
+    HotelRequest* r = conn->head;
+
+    conn->head = r->next;
+    if (conn->tail == r){
+        conn->tail = NULL;
+    }
+    if (conn->last_sent == r){
+        conn->last_sent = NULL;
+    }
+    conn->queued--;
+    return r;
+}
+
+
+static void
+finishHead(HotelClient* c, HotelConnection* conn, hotel_status_t status)
+{
+    requestDone(c, unlinkHead(conn), status);
+}
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+HotelClient*
+hotelClientCreate(const char* ip, int port, int connections)
+{
+    HotelClient* c;
+
+    if (connections <= 0 || port <= 0 || port > 65535){
+        return NULL;
+    }
+
+    c = (HotelClient*) calloc(1, sizeof(HotelClient));
+    if (c == NULL){
+        return NULL;
+    }
+
+    c->server.sin_family = AF_INET;
+    c->server.sin_port   = htons(port);
+    c->connections       = (HotelConnection*) calloc(connections, sizeof(HotelConnection));
+    c->count             = connections;
+
+    if (c->connections == NULL || inet_pton(AF_INET, ip, &c->server.sin_addr) != 1){
+        free(c->connections);
+        free(c);
+        return NULL;
+    }
+
+    for (int i = 0; i < connections; i++){
+        c->connections[i].fd = -1;
+        connectionOpen(c, &c->connections[i]);
+    }
+    return c;
+}
+
+
+void
+hotelClientDestroy(HotelClient* c)
+{
+    int count = c->count;
+
+    c->count = 0;       // nothing can be queued anymore
+    for (int i = 0; i < count; i++){
+        HotelConnection* conn = &c->connections[i];
+
+        while (conn->head != NULL){
+            finishHead(c, conn, HOTEL_ERROR);
+        }
+        if (conn->fd >= 0){
+            close(conn->fd);
+        }
+        free(conn->out);
+    }
+    callbacksRun(c);
+
+    for (int b = 0; b < HOTEL_CLIENT_USERS; b++){
+        while (c->users[b] != NULL){
+            HotelUser* u = c->users[b];
+
+            c->users[b] = u->next;
+            free(u);
+        }
+    }
+    free(c->connections);
+    free(c);
+}
+
+
+/**
+ * return a new request of `username`, to be filled and queued with requestQueue(), NULL if out of memory
+ */
+static HotelRequest*
+requestCreate(HotelClient* c, request_type_t type, const char* username, hotel_callback_t callback, void* arg)
+{
+    HotelRequest* r    = (HotelRequest*) calloc(1, sizeof(HotelRequest));
+    HotelUser*    user = userGet(c, username);
+
+    if (r == NULL || user == NULL || c->count == 0){
+        free(r);
+        return NULL;
+    }
+    r->type     = type;
+    r->phase    = PHASE_QUEUED;
+    r->user     = user;
+    r->callback = callback;
+    r->arg      = arg;
+    return r;
+}
+
+
+/**
+ * Queue `r` on the best connection: one already (going to be) logged in
+ * as its user, otherwise the least loaded. It may be sent right away.
+ * return 0
+ */
+static int
+requestQueue(HotelClient* c, HotelRequest* r)
+{
+    HotelUser*       user = r->user;
+    HotelConnection* best = NULL;
+
+    for (int i = 0; i < c->count; i++){
+        HotelConnection* conn = &c->connections[i];
+
+        if (r->type != REQUEST_LOGIN && r->type != REQUEST_REGISTER && conn->tail_user == user && conn->queued < HOTEL_CLIENT_PIPELINE){
+            best = conn;
+            break;
+        }
+        if (best == NULL || conn->queued < best->queued){
+            best = conn;
+        }
+    }
+
+    if (best->tail != NULL){
+        best->tail->next = r;
+    }
+    else {
+        best->head = r;
+    }
+    best->tail = r;
+    if (best->unsent == NULL){
+        best->unsent = r;
+    }
+    best->queued++;
+    best->tail_user = user;
+    c->pending++;
+
+    if (best->state == CONNECTION_DOWN){
+        connectionOpen(c, best);
+    }
+    else if (connectionPump(c, best) != 0){
+        connectionReset(c, best);
+    }
+    return 0;
+}
+
+
+static int
+validUsername(const char* username)
+{
+    size_t n = username != NULL ? strlen(username) : 0;
+
+    return n >= USERNAME_MIN_LENGTH && n < USERNAME_MAX_LENGTH;
+}
+
+
+static int
+credentialsQueue(HotelClient* c, request_type_t type, const char* username, const char* password, hotel_callback_t callback, void* arg)
+{
+    HotelRequest* r;
+
+    if (!validUsername(username) || password == NULL || strlen(password) < PASSWORD_MIN_LENGTH || strlen(password) >= PASSWORD_MAX_LENGTH || callback == NULL){
+        return -1;
+    }
+    if ((r = requestCreate(c, type, username, callback, arg)) == NULL){
+        return -1;
+    }
+    strcpy(r->args[0], password);
+    return requestQueue(c, r);
+}
+
+
+int
+hotelClientRegister(HotelClient* c, const char* username, const char* password, hotel_callback_t callback, void* arg)
+{
+    return credentialsQueue(c, REQUEST_REGISTER, username, password, callback, arg);
+}
+
+
+int
+hotelClientLogin(HotelClient* c, const char* username, const char* password, hotel_callback_t callback, void* arg)
+{
+    return credentialsQueue(c, REQUEST_LOGIN, username, password, callback, arg);
+}
+
+
+int
+hotelClientReserve(HotelClient* c, const char* username, const char* date, const char* type, hotel_callback_t callback, void* arg)
+{
+    HotelRequest* r;
+
+    if (!validUsername(username) || date == NULL || strlen(date) >= HOTEL_ARG_SIZE || (type != NULL && strlen(type) >= HOTEL_ARG_SIZE) || callback == NULL){
+        return -1;
+    }
+    if ((r = requestCreate(c, REQUEST_RESERVE, username, callback, arg)) == NULL){
+        return -1;
+    }
+    strcpy(r->args[0], date);
+    strcpy(r->args[1], type != NULL ? type : "any");
+    return requestQueue(c, r);
+}
+
+
+int
+hotelClientView(HotelClient* c, const char* username, hotel_callback_t callback, void* arg)
+{
+    HotelRequest* r;
+
+    if (!validUsername(username) || callback == NULL){
+        return -1;
+    }
+    if ((r = requestCreate(c, REQUEST_VIEW, username, callback, arg)) == NULL){
+        return -1;
+    }
+    return requestQueue(c, r);
+}
+
+
+int
+hotelClientRelease(HotelClient* c, const char* username, const char* date, int room, const char* code, hotel_callback_t callback, void* arg)
+{
+    HotelRequest* r;
+
+    if (!validUsername(username) || date == NULL || strlen(date) >= HOTEL_ARG_SIZE || code == NULL || strlen(code) >= HOTEL_ARG_SIZE || room <= 0 || callback == NULL){
+        return -1;
+    }
+    if ((r = requestCreate(c, REQUEST_RELEASE, username, callback, arg)) == NULL){
+        return -1;
+    }
+    strcpy(r->args[0], date);
+    snprintf(r->args[1], HOTEL_ARG_SIZE, "%d", room);
+    strcpy(r->args[2], code);
+    return requestQueue(c, r);
+}
+
+
+int
+hotelClientPollfds(HotelClient* c, struct pollfd* fds, int max)
+{
+    if (max < c->count){
+        return -1;
+    }
+
+    for (int i = 0; i < c->count; i++){
+        HotelConnection* conn = &c->connections[i];
+
+        fds[i].fd      = conn->state != CONNECTION_DOWN ? conn->fd : -1;
+        fds[i].events  = POLLIN;
+        fds[i].revents = 0;
+        if (conn->state == CONNECTION_CONNECTING || conn->out_sent < conn->out_used){
+            fds[i].events |= POLLOUT;
+        }
+    }
+    return c->count;
+}
+
+
+int
+hotelClientProcess(HotelClient* c, const struct pollfd* fds, int n)
+{
+    for (int i = 0; i < n && i < c->count; i++){
+        HotelConnection* conn = &c->connections[i];
+        short            ev   = fds[i].revents;
+
+        if (ev == 0 || conn->state == CONNECTION_DOWN || fds[i].fd != conn->fd){
+            continue;
+        }
+
+        if (conn->state == CONNECTION_CONNECTING){
+            int       err = 0;
+            socklen_t len = sizeof(err);
+
+            if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0){
+                connectionReset(c, conn);
+                continue;
+            }
+            conn->state = CONNECTION_UP;
+            if (connectionPump(c, conn) != 0){
+                connectionReset(c, conn);
+            }
+            continue;
+        }
+
+        if ((ev & POLLOUT) && connectionFlush(conn) != 0){
+            connectionReset(c, conn);
+            continue;
+        }
+        if ((ev & (POLLIN | POLLHUP | POLLERR)) && connectionReceive(c, conn) != 0){
+            connectionReset(c, conn);
+        }
+    }
+
+    return callbacksRun(c);
+}
+
+
+int
+hotelClientPoll(HotelClient* c, int timeout_ms)
+{
+    struct pollfd  stack[16];
+    struct pollfd* fds = c->count <= 16 ? stack : (struct pollfd*) malloc(c->count * sizeof(struct pollfd));
+    int            rv;
+
+    if (fds == NULL){
+        return -1;
+    }
+
+    hotelClientPollfds(c, fds, c->count);
+
+    // callbacks already due don't wait
+    rv = poll(fds, c->count, c->done_head != NULL ? 0 : timeout_ms);
+    if (rv < 0 && errno != EINTR){
+        if (fds != stack) free(fds);
+        return -1;
+    }
+    if (rv < 0){
+        for (int i = 0; i < c->count; i++){
+            fds[i].revents = 0;
+        }
+    }
+
+    rv = hotelClientProcess(c, fds, c->count);
+
+    if (fds != stack){
+        free(fds);
+    }
+    return rv;
+}
+
+
+int
+hotelClientPending(const HotelClient* c)
+{
+    return c->pending;
+}
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+/**
+ * Connect (non-blocking). If it can't, the queued requests fail.
+ */
+static void
+connectionOpen(HotelClient* c, HotelConnection* conn)
+{
+    int one = 1;
+
+    conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (conn->fd < 0){
+        connectionReset(c, conn);
+        return;
+    }
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL, 0) | O_NONBLOCK);
+
+    if (connect(conn->fd, (struct sockaddr*) &c->server, sizeof(c->server)) == 0){
+        conn->state = CONNECTION_UP;
+        if (connectionPump(c, conn) != 0){
+            connectionReset(c, conn);
+        }
+    }
+    else if (errno == EINPROGRESS){
+        conn->state = CONNECTION_CONNECTING;
+    }
+    else {
+        connectionReset(c, conn);
+    }
+}
+
+
+/**
+ * The connection is lost (or out of step with the server): what's in flight fails.
+ * The rest is sent on a new connection, or fails too if there's none.
+ */
+static void
+connectionReset(HotelClient* c, HotelConnection* conn)
+{
+    int was_up = conn->state == CONNECTION_UP;
+
+    while (conn->head != NULL && conn->head != conn->unsent){
+        finishHead(c, conn, HOTEL_ERROR);
+    }
+
+    if (conn->fd >= 0){
+        close(conn->fd);
+    }
+    conn->fd        = -1;
+    conn->state     = CONNECTION_DOWN;
+    conn->user      = NULL;
+    conn->barrier   = 0;
+    conn->last_sent = NULL;
+    conn->out_used  = 0;
+    conn->out_sent  = 0;
+    conn->in_used   = 0;
+
+    if (conn->head == NULL){
+        conn->tail_user = NULL;
+        return;
+    }
+    if (was_up){
+        connectionOpen(c, conn);    // once: if that fails too, the server is gone
+        return;
+    }
+    while (conn->head != NULL){
+        finishHead(c, conn, HOTEL_ERROR);
+    }
+    conn->unsent    = NULL;
+    conn->tail_user = NULL;
+}
+
+
+/**
+ * Write the frames of the requests that can be sent, as far as the barrier.
+ * return 0 if OK, -1 if the connection has to be reset
+ */
+static int
+connectionPump(HotelClient* c, HotelConnection* conn)
+{
+    HotelRequest* r;
+    int           rv = 0;
+
+    if (conn->state != CONNECTION_UP){
+        return 0;
+    }
+
+    while ((r = conn->unsent) != NULL && !conn->barrier && rv == 0){
+        if (r->type == REQUEST_LOGIN || r->type == REQUEST_REGISTER){
+            rv = frameAppend(conn, r->type == REQUEST_LOGIN ? LOGIN_MSG : REGISTER_MSG);
+            r->phase      = PHASE_PROMPT;
+            conn->barrier = 1;
+            conn->user    = NULL;
+        }
+        else if (conn->user != r->user){
+            if (r->user->token[0] == '\0'){
+                unlinkUnsent(conn, r);
+                requestDone(c, r, HOTEL_EXPIRED);
+                continue;
+            }
+            // move the connection to the user
+            rv = frameAppend(conn, RESUME_MSG) | frameAppend(conn, r->user->token);
+            r->phase      = PHASE_SWITCH;
+            conn->barrier = 1;
+            conn->user    = NULL;
+        }
+        else {
+            switch (r->type){
+                // "0": the hotel of the session, HOTEL_ID_DEFAULT
+                case REQUEST_RESERVE:
+                    rv = frameAppend(conn, RESERVE_MSG) | frameAppend(conn, r->args[0]) | frameAppend(conn, r->args[1]) | frameAppend(conn, "0");
+                    break;
+                case REQUEST_VIEW:
+                    rv = frameAppend(conn, VIEW_MSG) | frameAppend(conn, "0");
+                    break;
+                default:
+                    rv = frameAppend(conn, RELEASE_MSG) | frameAppend(conn, r->args[0]) | frameAppend(conn, r->args[1]) | frameAppend(conn, r->args[2]) | frameAppend(conn, "0");
+                    break;
+            }
+            r->phase = PHASE_SENT;
+        }
+
+        conn->last_sent = r;
+        conn->unsent    = r->next;
+    }
+
+    return rv == 0 ? connectionFlush(conn) : -1;
+}
+
+
+/**
+ * return 0 if OK (possibly something left for POLLOUT), -1 if the connection is lost
+ */
+static int
+connectionFlush(HotelConnection* conn)
+{
+    while (conn->out_sent < conn->out_used){
+        ssize_t n = send(conn->fd, conn->out + conn->out_sent, conn->out_used - conn->out_sent, HOTEL_SEND_FLAGS);
+
+        if (n < 0){
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        conn->out_sent += (uint32_t) n;
+    }
+    conn->out_used = 0;
+    conn->out_sent = 0;
+    return 0;
+}
+
+
+/**
+ * Read what the socket has and handle the replies complete.
+ * return 0 if OK, -1 if the connection is lost or out of step
+ */
+static int
+connectionReceive(HotelClient* c, HotelConnection* conn)
+{
+    while (1){
+        ssize_t n = recv(conn->fd, conn->in + conn->in_used, HOTEL_CLIENT_INPUT - conn->in_used, 0);
+
+        if (n == 0){
+            return -1;
+        }
+        if (n < 0){
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        conn->in_used += (uint32_t) n;
+
+        uint32_t at = 0;
+
+        while (conn->in_used - at >= sizeof(uint32_t)){
+            uint32_t dim;
+            char     msg[HOTEL_CLIENT_INPUT];
+
+            memcpy(&dim, conn->in + at, sizeof(dim));
+            dim = ntohl(dim);
+
+            if (dim > HOTEL_CLIENT_INPUT - sizeof(dim)){
+                return -1;
+            }
+            if (conn->in_used - at - sizeof(dim) < dim){
+                break;
+            }
+            memcpy(msg, conn->in + at + sizeof(dim), dim);
+            msg[dim] = '\0';
+            at += sizeof(dim) + dim;
+
+            if (connectionReply(c, conn, msg) != 0){
+                return -1;
+            }
+        }
+
+        conn->in_used -= at;
+        memmove(conn->in, conn->in + at, conn->in_used);
+    }
+}
+
+
+/**
+ * One reply of the server: it's for the request at the head.
+ * return 0 if OK, -1 if the connection has to be reset
+ */
+static int
+connectionReply(HotelClient* c, HotelConnection* conn, const char* msg)
+{
+    HotelRequest* r     = conn->head;
+    int           retry = busyRetry(msg);
+
+    if (r == NULL || r->phase == PHASE_QUEUED){
+        return -1;      // nothing was asked
+    }
+
+    if (retry >= 0 && (r->phase == PHASE_SWITCH || r->phase == PHASE_SENT || r->phase == PHASE_PROMPT || r->phase == PHASE_USERNAME)){
+        r->reply.retry_ms = retry;
+        if (r->phase != PHASE_SENT){
+            // the server logged the session out
+            conn->user    = NULL;
+            conn->barrier = 0;
+        }
+        finishHead(c, conn, HOTEL_BUSY);
+        return connectionPump(c, conn);
+    }
+
+    switch (r->phase){
+        case PHASE_SWITCH:
+            conn->barrier = 0;
+            if (strcmp(msg, "Y") != 0){
+                r->user->token[0] = '\0';   // forgotten by the server
+                finishHead(c, conn, HOTEL_EXPIRED);
+                break;
+            }
+            conn->user = r->user;
+
+            // the request goes on as if it had been on this connection all along
+            r->phase        = PHASE_QUEUED;
+            conn->unsent    = r;
+            conn->last_sent = NULL;
+            break;
+
+        case PHASE_PROMPT:
+            if (strcmp(msg, READONLY_MSG) == 0){
+                // register on a replica: the server logged the session out
+                r->text       = textCopy(msg);
+                conn->user    = NULL;
+                conn->barrier = 0;
+                finishHead(c, conn, HOTEL_REFUSED);
+                break;
+            }
+            if (r->type == REQUEST_LOGIN && strcmp(msg, "OK") != 0){
+                return -1;
+            }
+            r->phase = PHASE_USERNAME;
+            if (frameAppend(conn, r->user->username) != 0){
+                return -1;
+            }
+            break;
+
+        case PHASE_USERNAME:
+            if (strcmp(msg, "Y") != 0){
+                r->text = textCopy(msg);
+                conn->barrier = 0;
+                finishHead(c, conn, HOTEL_REFUSED);
+
+                // register is still waiting for another username: only a new connection gets out of it
+                return r->type == REQUEST_REGISTER ? -1 : 0;
+            }
+            r->phase = PHASE_PASSWORD;
+            if (frameAppend(conn, r->args[0]) != 0){
+                return -1;
+            }
+            break;
+
+        case PHASE_PASSWORD:
+            if (r->type == REQUEST_LOGIN){
+                if (strcmp(msg, "Y") != 0){
+                    conn->barrier = 0;
+                    finishHead(c, conn, HOTEL_REFUSED);
+                    break;
+                }
+                r->phase = PHASE_TOKEN;
+                break;
+            }
+            r->failed = strcmp(msg, "password OK.") != 0;
+            r->phase  = PHASE_MESSAGE;
+            break;
+
+        case PHASE_MESSAGE:
+            r->text = textCopy(msg);
+            if (r->failed){
+                finishHead(c, conn, HOTEL_REFUSED);
+                return -1;      // the server closes the connection
+            }
+            r->phase = PHASE_TOKEN;
+            break;
+
+        case PHASE_TOKEN:
+            snprintf(r->user->token, HOTEL_TOKEN_SIZE, "%s", msg);
+            conn->user    = r->user;
+            conn->barrier = 0;
+            finishHead(c, conn, HOTEL_OK);
+            break;
+
+        case PHASE_SENT:
+            if (r->type == REQUEST_RESERVE){
+                if (strcmp(msg, "RESOK") == 0){
+                    r->phase = PHASE_ROOM;
+                    break;
+                }
+                r->text = textCopy(msg);
+                finishHead(c, conn, HOTEL_REFUSED);
+                break;
+            }
+            r->text = textCopy(msg);
+            if (r->type == REQUEST_RELEASE && strncmp(msg, RELEASE_OK_PREFIX, strlen(RELEASE_OK_PREFIX)) != 0){
+                finishHead(c, conn, HOTEL_REFUSED);
+                break;
+            }
+            finishHead(c, conn, HOTEL_OK);
+            break;
+
+        case PHASE_ROOM:
+            r->reply.room = atoi(msg);
+            r->phase      = PHASE_CODE;
+            break;
+
+        case PHASE_CODE:
+            snprintf(r->reply.code, sizeof(r->reply.code), "%s", msg);
+            finishHead(c, conn, HOTEL_OK);
+            break;
+
+        default:
+            return -1;
+    }
+
+    return connectionPump(c, conn);
+}
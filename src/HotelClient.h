@@ -0,0 +1,134 @@
+/**
+ * @name            hotel-booking
+ * @file            HotelClient.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Tue Oct 27 10:02:31 CET 2026
+ * @brief           client library: asynchronous commands over a pool of connections
+ *
+ *
+ * For programs serving many users at once (a booking front-end): register,
+ * login, reserve, view and release return right away and the result is
+ * handed to a callback once the server replies. The commands of any number
+ * of users share a few connections to the server:
+ *
+ *  - a connection is logged in as one user at a time. Commands of that user
+ *    are pipelined on it, several in flight, no round trip waited for;
+ *  - a command of another user first moves the connection over to it with
+ *    the session token its login got (`resume`, no password, no crypt()).
+ *    Nothing else is sent on the connection until the server confirmed;
+ *  - a user has to be logged in (or registered) through the library before
+ *    its commands are accepted: HOTEL_EXPIRED otherwise, or once the server
+ *    forgot the token. Logging in again is all it takes.
+ *
+ * A HotelClient is driven by one thread: either hotelClientPoll() in a loop,
+ * or hotelClientPollfds() + hotelClientProcess() from an event loop the
+ * program already has. Callbacks are only called from there, never from the
+ * call that queued the command, and may queue new commands.
+ *
+ * Link with the `hotelclient` static library.
+ */
+
+#ifndef HOTEL_CLIENT_H
+#define HOTEL_CLIENT_H
+
+#include <poll.h>
+
+
+typedef enum hotel_status {
+    HOTEL_OK,
+    HOTEL_REFUSED,      // wrong password, unknown or taken username, no such reservation, or
+                        // no reservation made (`text`: "NOAVAL", "QUOTA", "BADDATE" or "BADTYPE"),
+                        // or a register, reserve or release sent to a replica (`text`: "READONLY")
+    HOTEL_BUSY,         // turned down by the server: try again in `retry_ms`
+    HOTEL_EXPIRED,      // the user isn't logged in (never was, or the server forgot it): login again
+    HOTEL_ERROR         // connection lost before the reply, or out of memory
+} hotel_status_t;
+
+
+typedef struct hotel_reply {
+    hotel_status_t  status;
+    int             retry_ms;       // HOTEL_BUSY
+    const char*     text;           // reply of the server (`view`: the reservations), valid during the callback only
+    int             room;           // `reserve`
+    char            code[8];        // `reserve`
+} HotelReply;
+
+
+typedef void (*hotel_callback_t)(void* arg, const HotelReply* reply);
+
+typedef struct hotel_client HotelClient;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+/** @brief  Opens a pool of `connections` connections to the server (non-blocking).
+ *  @param  ip          server address, dotted quad
+ *  @param  port
+ *  @param  connections connections shared by all the users
+ *  @return the client, NULL if the arguments are invalid or out of memory
+ */
+HotelClient*    hotelClientCreate(const char* ip, int port, int connections);
+
+/** @brief  Closes the connections. Callbacks still pending are called with HOTEL_ERROR.
+ *          Not from a callback.
+ *  @return Void
+ */
+void            hotelClientDestroy(HotelClient* c);
+
+/** @brief  Registers `username` and logs it in.
+ *  @return 0 if queued, -1 if the arguments are invalid or out of memory
+ */
+int             hotelClientRegister(HotelClient* c, const char* username, const char* password, hotel_callback_t callback, void* arg);
+
+/** @brief  Logs `username` in. Its commands can be queued right after this, they wait for the login.
+ *  @return 0 if queued, -1 if the arguments are invalid or out of memory
+ */
+int             hotelClientLogin(HotelClient* c, const char* username, const char* password, hotel_callback_t callback, void* arg);
+
+/** @brief  Reserves a room for `username`.
+ *  @param  date    dd/mm/yyyy
+ *  @param  type    "single", "double", "suite", or NULL for any
+ *  @return 0 if queued, -1 if the arguments are invalid or out of memory
+ */
+int             hotelClientReserve(HotelClient* c, const char* username, const char* date, const char* type, hotel_callback_t callback, void* arg);
+
+/** @brief  Lists the reservations of `username` (`text` of the reply).
+ *  @return 0 if queued, -1 if the arguments are invalid or out of memory
+ */
+int             hotelClientView(HotelClient* c, const char* username, hotel_callback_t callback, void* arg);
+
+/** @brief  Cancels a reservation of `username`.
+ *  @param  date    dd/mm/yyyy
+ *  @param  room
+ *  @param  code    reservation code
+ *  @return 0 if queued, -1 if the arguments are invalid or out of memory
+ */
+int             hotelClientRelease(HotelClient* c, const char* username, const char* date, int room, const char* code, hotel_callback_t callback, void* arg);
+
+/** @brief  Fills `fds` with what the connections wait for, to poll() them with other descriptors.
+ *  @param  fds     at least as many as the connections of the pool
+ *  @param  max     size of `fds`
+ *  @return number of entries filled (one per connection, fd -1 if it's closed), -1 if `max` is too small
+ */
+int             hotelClientPollfds(HotelClient* c, struct pollfd* fds, int max);
+
+/** @brief  Does the I/O poll() found ready and calls the callbacks of the commands done.
+ *  @param  fds     as filled by hotelClientPollfds(), with `revents` set
+ *  @param  n       entries
+ *  @return number of callbacks called
+ */
+int             hotelClientProcess(HotelClient* c, const struct pollfd* fds, int n);
+
+/** @brief  hotelClientPollfds(), poll() and hotelClientProcess().
+ *  @param  timeout_ms  as poll()
+ *  @return number of callbacks called, -1 if poll() failed
+ */
+int             hotelClientPoll(HotelClient* c, int timeout_ms);
+
+/** @brief  Commands whose callback hasn't been called yet.
+ *  @return count
+ */
+int             hotelClientPending(const HotelClient* c);
+
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @name            hotel-booking
+ * @file            HotelRegistry.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Fri Oct 30 09:48:21 CET 2026
+ * @brief           hotels hosted by one server process
+ *
+ *
+ * Every hotel is a tenant with its own occupancy, its own reservation
+ * code index and its own lock: sessions booking in different hotels never
+ * wait for each other (lock striping, one stripe per hotel). The worker
+ * threads, the users and the storage are shared.
+ *
+ * Tenants are made on their first booking and never removed (picking a
+ * hotel with `htl` only checks there's room for it, so sessions that never
+ * book can't fill the registry):
+ * `tenants[0..count)` is published with release semantics, so lookups
+ * take no lock. Adding one takes `lock`.
+ */
+
+#ifndef HOTEL_REGISTRY_H
+#define HOTEL_REGISTRY_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "Calendar.h"
+#include "Hotel.h"
+#include "CodeIndex.h"
+
+
+typedef struct hotel_tenant {
+    pthread_mutex_t     lock;               // occupancy of this hotel; booking, code, quota and cached list change together under it
+    Hotel               hotel;
+    CodeIndex           codes;              // live reservation codes of this hotel -> booking
+
+    // metrics
+    uint64_t            reservations;
+    uint64_t            releases;
+    uint64_t            sold_out;           // `reserve` turned down: no room of the type asked for
+    uint64_t            views;
+} HotelTenant;
+
+
+typedef struct hotel_registry {
+    pthread_mutex_t     lock;               // taken to add a hotel only
+    HotelTenant*        tenants[HOTELS_MAX];
+    uint32_t            count;
+    Inventory           inventory;          // room catalog of every hotel
+} HotelRegistry;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+void            initializeHotelRegistry(HotelRegistry* r);
+HotelTenant*    hotelRegistryFind(HotelRegistry* r, uint32_t id);
+HotelTenant*    hotelRegistryAdd(HotelRegistry* r, uint32_t id);
+int             hotelRegistryAdmits(HotelRegistry* r, uint32_t id);
+uint32_t        hotelRegistryCodes(HotelRegistry* r);
+void            hotelRegistryStats(HotelRegistry* r, FILE* out);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+/**
+ * The room catalog is filled in afterwards, before the first hotel is added.
+ */
+void
+initializeHotelRegistry(HotelRegistry* r)
+{
+    memset(r, 0, sizeof(HotelRegistry));
+    pthread_mutex_init(&r->lock, 0);
+    initializeInventory(&r->inventory);
+}
+
+
+/**
+ * return the tenant of hotel `id`, NULL if it isn't hosted
+ */
+HotelTenant*
+hotelRegistryFind(HotelRegistry* r, uint32_t id)
+{
+    uint32_t count = __atomic_load_n(&r->count, __ATOMIC_ACQUIRE);
+
+    for (uint32_t i = 0; i < count; i++){
+        if (r->tenants[i]->hotel.id == id){
+            return r->tenants[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Host hotel `id` if it isn't yet.
+ * return its tenant, NULL if `id` is 0, out of memory or HOTELS_MAX hotels already
+ */
+HotelTenant*
+hotelRegistryAdd(HotelRegistry* r, uint32_t id)
+{
+    HotelTenant* t = hotelRegistryFind(r, id);
+
+    if (t != NULL || id == 0){
+        return t;
+    }
+
+    /* critical section */
+    MUTEX_LOCK(&r->lock);
+
+        // added by another thread meanwhile
+        t = hotelRegistryFind(r, id);
+
+        if (t == NULL && r->count < HOTELS_MAX){
+            t = (HotelTenant*) calloc(1, sizeof(HotelTenant));
+
+            if (t != NULL && initializeCodeIndex(&t->codes) != 0){
+                free(t);
+                t = NULL;
+            }
+            if (t != NULL){
+                pthread_mutex_init(&t->lock, 0);
+
+                // booking horizon starts with the current year
+                initializeHotel(&t->hotel, currentYear());
+                t->hotel.id        = id;
+                t->hotel.inventory = r->inventory;
+
+                r->tenants[r->count] = t;
+                __atomic_store_n(&r->count, r->count + 1, __ATOMIC_RELEASE);
+            }
+        }
+
+    MUTEX_UNLOCK(&r->lock);
+    /* end critical section */
+
+    return t;
+}
+
+
+/**
+ * Whether hotel `id` can be booked in, without hosting it yet.
+ * return 0 if it's hosted or there's room for it, -1 otherwise
+ */
+int
+hotelRegistryAdmits(HotelRegistry* r, uint32_t id)
+{
+    if (id == 0){
+        return -1;
+    }
+    return hotelRegistryFind(r, id) != NULL || __atomic_load_n(&r->count, __ATOMIC_ACQUIRE) < HOTELS_MAX ? 0 : -1;
+}
+
+
+/**
+ * return the live reservation codes of every hotel
+ */
+uint32_t
+hotelRegistryCodes(HotelRegistry* r)
+{
+    uint32_t count = __atomic_load_n(&r->count, __ATOMIC_ACQUIRE);
+    uint32_t codes = 0;
+
+    for (uint32_t i = 0; i < count; i++){
+        MUTEX_LOCK(&r->tenants[i]->codes.lock);
+            codes += r->tenants[i]->codes.count;
+        MUTEX_UNLOCK(&r->tenants[i]->codes.lock);
+    }
+    return codes;
+}
+
+
+void
+hotelRegistryStats(HotelRegistry* r, FILE* out)
+{
+    uint32_t  count = __atomic_load_n(&r->count, __ATOMIC_ACQUIRE);
+    time_t    now   = time(NULL);
+    struct tm tm;
+    day_t     today;
+
+    localtime_r(&now, &tm);
+    today = daysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+
+    fprintf(out, "hotels %u\n",     count);
+    fprintf(out, "max_hotels %d\n", HOTELS_MAX);
+
+    for (uint32_t i = 0; i < count; i++){
+        HotelTenant* t = r->tenants[i];
+        uint32_t     id = t->hotel.id;
+        uint32_t     live;
+        int          booked;
+
+        MUTEX_LOCK(&t->codes.lock);
+            live = t->codes.count;
+        MUTEX_UNLOCK(&t->codes.lock);
+
+        MUTEX_LOCK(&t->lock);
+            booked = roomsBooked(&t->hotel, today);
+        MUTEX_UNLOCK(&t->lock);
+
+        fprintf(out, "hotel%u.bookings %u\n",           id, live);
+        fprintf(out, "hotel%u.rooms_booked_today %d\n", id, booked > 0 ? booked : 0);
+        fprintf(out, "hotel%u.rooms %d\n",              id, t->hotel.inventory.rooms);
+        fprintf(out, "hotel%u.reservations %llu\n",     id, (unsigned long long) __atomic_load_n(&t->reservations, __ATOMIC_RELAXED));
+        fprintf(out, "hotel%u.releases %llu\n",         id, (unsigned long long) __atomic_load_n(&t->releases, __ATOMIC_RELAXED));
+        fprintf(out, "hotel%u.sold_out %llu\n",         id, (unsigned long long) __atomic_load_n(&t->sold_out, __ATOMIC_RELAXED));
+        fprintf(out, "hotel%u.views %llu\n",            id, (unsigned long long) __atomic_load_n(&t->views, __ATOMIC_RELAXED));
+    }
+}
+
+
+#endif
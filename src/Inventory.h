@@ -0,0 +1,208 @@
+/**
+ * @name            hotel-booking
+ * @file            Inventory.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Oct 19 11:02:17 CEST 2026
+ * @brief           room catalog: room types and per-type room masks
+ *
+ *
+ * Rooms are numbered 1..HOTEL_MAX_ROOMS-1 and each of them belongs to a
+ * category (single, double, suite). For every category the catalog keeps a
+ * bitmask of its rooms, so that finding a free room of a given type on a
+ * given day is a word-wise `type_mask & ~occupied` followed by a bit scan.
+ *
+ * Catalog file format (one entry per line, `#` starts a comment):
+ *
+ *      101         single
+ *      102-110     double
+ *      201-204     suite
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+
+#define ROOM_MASK_WORDS     ((HOTEL_MAX_ROOMS + 63) / 64)
+
+
+typedef enum {
+    ROOM_SINGLE,
+    ROOM_DOUBLE,
+    ROOM_SUITE,
+
+    ROOM_TYPES,             // number of room types
+
+    ROOM_ANY = ROOM_TYPES   // no preference: best fit among all the types
+} room_type_t;
+
+
+typedef struct inventory {
+    int         rooms;                                      // number of rooms in the catalog
+    int         rooms_per_type[ROOM_TYPES];
+    uint8_t     room_type[HOTEL_MAX_ROOMS];                 // type of each room (valid if set in `rooms_mask`)
+    uint64_t    rooms_mask[ROOM_MASK_WORDS];                // every room in the catalog
+    uint64_t    type_mask[ROOM_TYPES][ROOM_MASK_WORDS];     // rooms of each type
+} Inventory;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+const char* roomTypeName(room_type_t type);
+int         parseRoomType(const char* s);
+void        initializeInventory(Inventory* inv);
+int         addRoom(Inventory* inv, int room, room_type_t type);
+int         loadRoomCatalog(Inventory* inv, const char* path);
+int         roomExists(const Inventory* inv, int room);
+int         findFreeRoom(const Inventory* inv, const uint64_t* occupied, room_type_t type);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+const char*
+roomTypeName(room_type_t type)
+{
+    switch (type)
+    {
+        case ROOM_SINGLE:   return "single";
+        case ROOM_DOUBLE:   return "double";
+        case ROOM_SUITE:    return "suite";
+        default:            return "any";
+    }
+}
+
+
+/**
+ * return the room_type_t named by `s`, ROOM_ANY for "any" (or an empty string), -1 if unknown
+ */
+int
+parseRoomType(const char* s)
+{
+    if (s[0] == '\0' || strcmp(s, "any") == 0){
+        return ROOM_ANY;
+    }
+    for (int t = 0; t < ROOM_TYPES; t++){
+        if (strcmp(s, roomTypeName(t)) == 0){
+            return t;
+        }
+    }
+    return -1;
+}
+
+
+void
+initializeInventory(Inventory* inv)
+{
+    memset(inv, 0, sizeof(Inventory));
+}
+
+
+/**
+ * return 0 if the room has been added, -1 if it's out of range or already in the catalog
+ */
+int
+addRoom(Inventory* inv, int room, room_type_t type)
+{
+    if (room <= 0 || room >= HOTEL_MAX_ROOMS || type >= ROOM_TYPES || roomExists(inv, room)){
+        return -1;
+    }
+
+    inv->rooms_mask[room / 64]      |= 1ULL << (room % 64);
+    inv->type_mask[type][room / 64] |= 1ULL << (room % 64);
+    inv->room_type[room] = (uint8_t) type;
+    inv->rooms_per_type[type]++;
+    inv->rooms++;
+    return 0;
+}
+
+
+/**
+ * Read the room catalog from `path`.
+ * return number of rooms loaded, -1 if the file can't be opened
+ */
+int
+loadRoomCatalog(Inventory* inv, const char* path)
+{
+    char line[128];
+    char type_name[16];
+    int  first, last, type;
+
+    FILE* catalog = fopen(path, "r");
+    if (catalog == NULL){
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), catalog)){
+        char* comment = strchr(line, '#');
+        if (comment != NULL){
+            *comment = '\0';
+        }
+
+        if (sscanf(line, "%d-%d %15s", &first, &last, type_name) != 3){
+            if (sscanf(line, "%d %15s", &first, type_name) != 2){
+                continue;   // blank or malformed line
+            }
+            last = first;
+        }
+
+        type = parseRoomType(type_name);
+        if (type < 0 || type == ROOM_ANY){
+            fprintf(stderr, "%s: unknown room type `%s`\n", path, type_name);
+            continue;
+        }
+
+        for (int room = first; room <= last; room++){
+            if (addRoom(inv, room, type) != 0){
+                fprintf(stderr, "%s: room %d skipped (out of range or duplicated)\n", path, room);
+            }
+        }
+    }
+
+    fclose(catalog);
+    return inv->rooms;
+}
+
+
+int
+roomExists(const Inventory* inv, int room)
+{
+    return room > 0 && room < HOTEL_MAX_ROOMS && (inv->rooms_mask[room / 64] >> (room % 64)) & 1;
+}
+
+
+/**
+ * Lowest-numbered room of type `type` not set in `occupied`.
+ * With ROOM_ANY the types are tried from the smallest (single) up,
+ * so that bigger rooms are kept for the guests that asked for them.
+ * return room number, -1 if none is free
+ */
+int
+findFreeRoom(const Inventory* inv, const uint64_t* occupied, room_type_t type)
+{
+    if (type == ROOM_ANY){
+        for (int t = 0; t < ROOM_TYPES; t++){
+            int room = findFreeRoom(inv, occupied, t);
+            if (room > 0){
+                return room;
+            }
+        }
+        return -1;
+    }
+
+    for (int w = 0; w < ROOM_MASK_WORDS; w++){
+        uint64_t free_rooms = inv->type_mask[type][w] & ~occupied[w];
+        if (free_rooms){
+            return w * 64 + __builtin_ctzll(free_rooms);
+        }
+    }
+    return -1;
+}
+
+
+#endif
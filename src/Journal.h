@@ -0,0 +1,655 @@
+/**
+ * @name            hotel-booking
+ * @file            Journal.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Wed Oct 21 17:02:44 CEST 2026
+ * @brief           memory-mapped append-only booking journal (storage engine)
+ *
+ *
+ * The journal file is a header followed by fixed-width records:
+ *
+ *      JOURNAL_BOOKING     a new booking (id, user, day, room, code)
+ *      JOURNAL_TOMBSTONE   booking `id` has been released
+ *
+ * Each record carries a checksum, so a record torn by a crash is detected
+ * at replay and dropped together with whatever follows it. The file is
+ * mapped in memory and grows JOURNAL_GROW_RECORDS at a time; writes are
+ * appends, synced to disk every JOURNAL_SYNC_EVERY records.
+ * When dead records (released bookings and their tombstones) outnumber the
+ * live ones, the live bookings are copied to a new file that atomically
+ * replaces the old one; the header generation is bumped so that cursors
+ * into the old file (see Storage.tail) are recognized as stale.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "Storage.h"
+
+
+#define JOURNAL_MAGIC           "HBJRNL01"
+#define JOURNAL_RECORD_SIZE     64
+#define JOURNAL_GROW_RECORDS    16384   // 1 MiB
+#define JOURNAL_COMPACT_MIN     1024    // records in the file before compaction is considered
+
+#define JOURNAL_BOOKING         1
+#define JOURNAL_TOMBSTONE       2
+
+
+typedef struct journal_record {
+    uint32_t    checksum;                               // of the bytes that follow
+    uint8_t     type;                                   // 0 marks the end of the journal
+    uint8_t     reserved[3];
+    int64_t     id;
+    int32_t     day;
+    int32_t     room;
+    char        username[USERNAME_MAX_LENGTH];
+    char        code[RESERVATION_CODE_LENGTH];
+    char        padding[JOURNAL_RECORD_SIZE - 28 - USERNAME_MAX_LENGTH - RESERVATION_CODE_LENGTH];
+    uint32_t    hotel;                                  // 0 in records written before hotels had an ID
+} JournalRecord;
+
+
+typedef struct journal_header {
+    char        magic[8];
+    uint32_t    record_size;
+    uint32_t    reserved;
+    int64_t     generation;                             // compactions so far
+    char        padding[JOURNAL_RECORD_SIZE - 24];
+} JournalHeader;
+
+
+typedef struct journal {
+    pthread_mutex_t     lock;
+    char                path[64];
+    int                 fd;
+    char*               map;
+    size_t              mapped;         // bytes, same as the file size
+    uint64_t            records;        // records written (after the header)
+    int64_t             next_id;
+    int64_t*            live;           // live[id]: record of booking `id`, -1 if released
+    int64_t             live_capacity;
+    uint64_t            live_count;
+
+    // metrics
+    uint64_t            synced;         // records known to be on disk
+    uint64_t            appends;
+    uint64_t            syncs;
+    uint64_t            compactions;
+    uint64_t            torn;           // torn records found at replay
+} Journal;
+
+
+static Journal journal_g;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     journalOpen(const char* path);
+int     journalScan(int thread_index, const char* username, storage_visit_t visit, void* payload);
+int     journalInsert(int thread_index, StoredBooking* booking);
+int     journalRemove(int thread_index, int64_t id);
+int     journalSnapshot(int thread_index, storage_visit_t visit, void* payload, StorageCursor* cursor);
+int     journalTail(int thread_index, const StorageCursor* since,
+                    storage_visit_t inserted, storage_visit_t removed, void* payload);
+void    journalCheckpoint(int thread_index, const StorageCursor* cursor);
+void    journalStats(FILE* out);
+
+
+static const Storage journal_storage = {
+    .name       = "journal",
+    .open       = journalOpen,
+    .scan       = journalScan,
+    .insert     = journalInsert,
+    .remove     = journalRemove,
+    .snapshot   = journalSnapshot,
+    .tail       = journalTail,
+    .checkpoint = journalCheckpoint,
+    .stats      = journalStats,
+};
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static uint32_t
+journalChecksum(const JournalRecord* r)
+{
+    const unsigned char* p = (const unsigned char*) r + sizeof(r->checksum);
+    uint32_t h = 2166136261u;   // FNV-1a
+
+    for (size_t i = sizeof(r->checksum); i < sizeof(JournalRecord); i++, p++){
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
+}
+
+
+static inline JournalRecord*
+journalRecord(const Journal* j, uint64_t i)
+{
+    return (JournalRecord*) (j->map + sizeof(JournalHeader) + i * sizeof(JournalRecord));
+}
+
+
+static inline JournalHeader*
+journalHeader(const Journal* j)
+{
+    return (JournalHeader*) j->map;
+}
+
+
+static inline uint64_t
+journalCapacity(const Journal* j)
+{
+    return (j->mapped - sizeof(JournalHeader)) / sizeof(JournalRecord);
+}
+
+
+/**
+ * Map `fd` (resized to `size` bytes first) in place of the current mapping.
+ */
+static int
+journalMap(Journal* j, int fd, size_t size)
+{
+    if (ftruncate(fd, size) != 0){
+        return -1;
+    }
+
+    char* map = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED){
+        return -1;
+    }
+
+    if (j->map != NULL){
+        munmap(j->map, j->mapped);
+    }
+    j->map    = map;
+    j->mapped = size;
+    return 0;
+}
+
+
+static int
+journalTrack(Journal* j, int64_t id, int64_t record)
+{
+    if (id >= j->live_capacity){
+        int64_t  capacity = j->live_capacity ? j->live_capacity : 1024;
+        int64_t* grown;
+
+        while (capacity <= id){
+            capacity *= 2;
+        }
+        grown = (int64_t*) realloc(j->live, capacity * sizeof(int64_t));
+        if (grown == NULL){
+            return -1;
+        }
+        memset(grown + j->live_capacity, 0xff, (capacity - j->live_capacity) * sizeof(int64_t));   // -1
+        j->live          = grown;
+        j->live_capacity = capacity;
+    }
+    j->live[id] = record;
+    return 0;
+}
+
+
+/**
+ * Apply the sync policy after an append: only the pages holding
+ * the records appended since the last sync are written. Lock held.
+ */
+static void
+journalSync(Journal* j)
+{
+    if (JOURNAL_SYNC_EVERY > 0 && j->records - j->synced >= JOURNAL_SYNC_EVERY){
+        size_t page  = (size_t) sysconf(_SC_PAGESIZE);
+        size_t start = (sizeof(JournalHeader) + j->synced * sizeof(JournalRecord)) & ~(page - 1);
+        size_t end   = sizeof(JournalHeader) + j->records * sizeof(JournalRecord);
+
+        msync(j->map + start, end - start, MS_SYNC);
+        j->synced = j->records;
+        j->syncs++;
+    }
+}
+
+
+/**
+ * Append `r` (checksum filled in here). Lock held.
+ * return index of the record, -1 on error
+ */
+static int64_t
+journalAppend(Journal* j, JournalRecord* r)
+{
+    if (j->records == journalCapacity(j)){
+        if (journalMap(j, j->fd, j->mapped + JOURNAL_GROW_RECORDS * sizeof(JournalRecord)) != 0){
+            return -1;
+        }
+    }
+
+    r->checksum = journalChecksum(r);
+    memcpy(journalRecord(j, j->records), r, sizeof(JournalRecord));
+    j->records++;
+    j->appends++;
+
+    journalSync(j);
+
+    return (int64_t) j->records - 1;
+}
+
+
+/**
+ * Rebuild `live` from the records. Lock held.
+ */
+static int
+journalReplay(Journal* j)
+{
+    uint64_t capacity = journalCapacity(j);
+    uint64_t i;
+
+    j->next_id    = 1;
+    j->live_count = 0;
+
+    for (i = 0; i < capacity; i++){
+        JournalRecord* r = journalRecord(j, i);
+
+        if (r->type == 0){
+            break;
+        }
+        if (r->checksum != journalChecksum(r) || r->id <= 0 ||
+            (r->type != JOURNAL_BOOKING && r->type != JOURNAL_TOMBSTONE)){
+            // torn write: drop it and anything after it
+            j->torn++;
+            memset(r, 0, (capacity - i) * sizeof(JournalRecord));
+            break;
+        }
+
+        if (r->type == JOURNAL_BOOKING){
+            if (journalTrack(j, r->id, i) != 0){
+                return -1;
+            }
+            j->live_count++;
+            if (r->id >= j->next_id){
+                j->next_id = r->id + 1;
+            }
+        }
+        else if (r->id < j->live_capacity && j->live[r->id] >= 0){
+            j->live[r->id] = -1;
+            j->live_count--;
+        }
+    }
+
+    j->records = i;
+    j->synced  = i;
+    return 0;
+}
+
+
+/**
+ * fsync the directory holding `path`, so that a rename() in it survives a crash.
+ * return 0 if OK, -1 otherwise
+ */
+static int
+journalSyncDirectory(const char* path)
+{
+    char        dir[sizeof(((Journal*) 0)->path)];
+    const char* slash = strrchr(path, '/');
+    int         fd, rv;
+
+    if (slash == NULL){
+        strcpy(dir, ".");
+    }
+    else {
+        snprintf(dir, sizeof(dir), "%.*s", slash == path ? 1 : (int) (slash - path), path);
+    }
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0){
+        return -1;
+    }
+    rv = fsync(fd);
+    close(fd);
+    return rv;
+}
+
+
+/**
+ * Copy the live bookings to a new file and swap it in. Lock held.
+ * return 0 once the new file is durably in place, -1 otherwise
+ */
+static int
+journalCompact(Journal* j)
+{
+    char     tmp_path[sizeof(j->path) + 8];
+    uint64_t n = 0;
+    size_t   size = sizeof(JournalHeader) +
+                    (j->live_count / JOURNAL_GROW_RECORDS + 1) * JOURNAL_GROW_RECORDS * sizeof(JournalRecord);
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.compact", j->path);
+
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){
+        return -1;
+    }
+    if (ftruncate(fd, size) != 0){
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    char* map = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED){
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    memcpy(map, j->map, sizeof(JournalHeader));
+    ((JournalHeader*) map)->generation++;
+    for (uint64_t i = 0; i < j->records; i++){
+        JournalRecord* r = journalRecord(j, i);
+
+        if (r->type == JOURNAL_BOOKING && j->live[r->id] == (int64_t) i){
+            memcpy(map + sizeof(JournalHeader) + n * sizeof(JournalRecord), r, sizeof(JournalRecord));
+            n++;
+        }
+    }
+    msync(map, size, MS_SYNC);
+
+    if (fsync(fd) != 0 || rename(tmp_path, j->path) != 0){
+        munmap(map, size);
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    munmap(j->map, j->mapped);
+    close(j->fd);
+    j->fd     = fd;
+    j->map    = map;
+    j->mapped = size;
+    j->compactions++;
+
+    // record indexes changed
+    memset(j->live, 0xff, j->live_capacity * sizeof(int64_t));
+    for (uint64_t i = 0; i < n; i++){
+        j->live[journalRecord(j, i)->id] = i;
+    }
+    j->records = n;
+    j->synced  = n;
+
+    // the rename itself is only durable once the directory is: until then a crash may bring back the old file
+    if (journalSyncDirectory(j->path) != 0){
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Hand record `r` over to `visit` as a StoredBooking.
+ */
+static int
+journalVisit(const JournalRecord* r, storage_visit_t visit, void* payload)
+{
+    StoredBooking b;
+
+    memset(&b, '\0', sizeof(b));
+    b.id    = r->id;
+    b.hotel = r->hotel != 0 ? r->hotel : HOTEL_ID_DEFAULT;
+    b.day   = r->day;
+    b.room  = r->room;
+    memcpy(b.username, r->username, sizeof(b.username) - 1);
+    memcpy(b.code,     r->code,     sizeof(b.code) - 1);
+
+    return visit(&b, payload);
+}
+
+
+/**
+ * Visit the live bookings (of `username`, every user if NULL). Lock held.
+ */
+static void
+journalVisitLive(const Journal* j, const char* username, storage_visit_t visit, void* payload)
+{
+    for (uint64_t i = 0; i < j->records; i++){
+        JournalRecord* r = journalRecord(j, i);
+
+        if (r->type != JOURNAL_BOOKING || j->live[r->id] != (int64_t) i){
+            continue;
+        }
+        if (username != NULL && strncmp(r->username, username, sizeof(r->username)) != 0){
+            continue;
+        }
+        if (journalVisit(r, visit, payload) != 0){
+            break;
+        }
+    }
+}
+
+
+int
+journalOpen(const char* path)
+{
+    Journal*    j = &journal_g;
+    struct stat st;
+
+    memset(j, 0, sizeof(Journal));
+    pthread_mutex_init(&j->lock, 0);
+    strncpy(j->path, path, sizeof(j->path) - 1);
+
+    j->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (j->fd < 0 || fstat(j->fd, &st) != 0){
+        return -1;
+    }
+
+    if (st.st_size == 0){
+        // new journal
+        if (journalMap(j, j->fd, sizeof(JournalHeader) + JOURNAL_GROW_RECORDS * sizeof(JournalRecord)) != 0){
+            return -1;
+        }
+        JournalHeader* h = (JournalHeader*) j->map;
+        memcpy(h->magic, JOURNAL_MAGIC, sizeof(h->magic));
+        h->record_size = sizeof(JournalRecord);
+        msync(j->map, j->mapped, MS_SYNC);
+    }
+    else {
+        size_t records = ((size_t) st.st_size - sizeof(JournalHeader)) / sizeof(JournalRecord);
+
+        if ((size_t) st.st_size < sizeof(JournalHeader) ||
+            journalMap(j, j->fd, sizeof(JournalHeader) + records * sizeof(JournalRecord)) != 0){
+            return -1;
+        }
+        JournalHeader* h = (JournalHeader*) j->map;
+        if (memcmp(h->magic, JOURNAL_MAGIC, sizeof(h->magic)) != 0 || h->record_size != sizeof(JournalRecord)){
+            fprintf(stderr, "%s is not a booking journal\n", path);
+            return -1;
+        }
+    }
+
+    return journalReplay(j);
+}
+
+
+int
+journalScan(int thread_index, const char* username, storage_visit_t visit, void* payload)
+{
+    Journal* j = &journal_g;
+
+    /* critical section */
+    MUTEX_LOCK(&j->lock);
+
+        journalVisitLive(j, username, visit, payload);
+
+    MUTEX_UNLOCK(&j->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+int
+journalInsert(int thread_index, StoredBooking* booking)
+{
+    Journal*      j = &journal_g;
+    JournalRecord r;
+    int64_t       i;
+
+    memset(&r, '\0', sizeof(r));
+    r.type  = JOURNAL_BOOKING;
+    r.hotel = booking->hotel;
+    r.day   = booking->day;
+    r.room  = booking->room;
+    strncpy(r.username, booking->username, sizeof(r.username));
+    strncpy(r.code,     booking->code,     sizeof(r.code));
+
+    /* critical section */
+    MUTEX_LOCK(&j->lock);
+
+        r.id = j->next_id;
+
+        if (journalTrack(j, r.id, -1) != 0 || (i = journalAppend(j, &r)) < 0){
+            MUTEX_UNLOCK(&j->lock);
+            return -1;
+        }
+        j->live[r.id] = i;
+        j->live_count++;
+        j->next_id++;
+
+    MUTEX_UNLOCK(&j->lock);
+    /* end critical section */
+
+    booking->id = r.id;
+    return 0;
+}
+
+
+int
+journalRemove(int thread_index, int64_t id)
+{
+    Journal*      j = &journal_g;
+    JournalRecord r;
+
+    /* critical section */
+    MUTEX_LOCK(&j->lock);
+
+        if (id <= 0 || id >= j->live_capacity || j->live[id] < 0){
+            MUTEX_UNLOCK(&j->lock);
+            return 1;   // no such booking
+        }
+
+        // the tombstone repeats the booking, so a tail replay knows what to un-index
+        r = *journalRecord(j, j->live[id]);
+        r.type = JOURNAL_TOMBSTONE;
+
+        if (journalAppend(j, &r) < 0){
+            MUTEX_UNLOCK(&j->lock);
+            return -1;
+        }
+        j->live[id] = -1;
+        j->live_count--;
+
+        if (j->records >= JOURNAL_COMPACT_MIN && j->records - j->live_count > j->live_count){
+            if (journalCompact(j) != 0){
+                perror("journal compaction");   // either file holds the live bookings: the old one or, once renamed, the new one
+            }
+        }
+
+    MUTEX_UNLOCK(&j->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+/**
+ * The visitor only copies the bookings, so the lock isn't held for long.
+ */
+int
+journalSnapshot(int thread_index, storage_visit_t visit, void* payload, StorageCursor* cursor)
+{
+    Journal* j = &journal_g;
+
+    /* critical section */
+    MUTEX_LOCK(&j->lock);
+
+        cursor->generation = journalHeader(j)->generation;
+        cursor->position   = (int64_t) j->records;
+        cursor->max_id     = j->next_id - 1;
+
+        journalVisitLive(j, NULL, visit, payload);
+
+    MUTEX_UNLOCK(&j->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+int
+journalTail(int thread_index, const StorageCursor* since,
+            storage_visit_t inserted, storage_visit_t removed, void* payload)
+{
+    Journal* j = &journal_g;
+
+    /* critical section */
+    MUTEX_LOCK(&j->lock);
+
+        if (since->generation != journalHeader(j)->generation || since->position > (int64_t) j->records){
+            MUTEX_UNLOCK(&j->lock);
+            return 1;   // compacted since
+        }
+
+        for (uint64_t i = since->position; i < j->records; i++){
+            JournalRecord* r = journalRecord(j, i);
+
+            journalVisit(r, r->type == JOURNAL_BOOKING ? inserted : removed, payload);
+        }
+
+    MUTEX_UNLOCK(&j->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+void
+journalCheckpoint(int thread_index, const StorageCursor* cursor)
+{
+    // nothing to do: compaction drops history on its own
+}
+
+
+void
+journalStats(FILE* out)
+{
+    Journal* j = &journal_g;
+
+    MUTEX_LOCK(&j->lock);
+
+        fprintf(out, "engine journal\n");
+        fprintf(out, "generation %lld\n",       (long long) journalHeader(j)->generation);
+        fprintf(out, "file_bytes %zu\n",        j->mapped);
+        fprintf(out, "records %llu\n",          (unsigned long long) j->records);
+        fprintf(out, "live %llu\n",             (unsigned long long) j->live_count);
+        fprintf(out, "dead %llu\n",             (unsigned long long) (j->records - j->live_count));
+        fprintf(out, "appends %llu\n",          (unsigned long long) j->appends);
+        fprintf(out, "syncs %llu\n",            (unsigned long long) j->syncs);
+        fprintf(out, "compactions %llu\n",      (unsigned long long) j->compactions);
+        fprintf(out, "torn_records %llu\n",     (unsigned long long) j->torn);
+
+    MUTEX_UNLOCK(&j->lock);
+}
+
+
+#endif
@@ -0,0 +1,388 @@
+/**
+ * @name            hotel-booking
+ * @file            LockProfile.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sun Nov  1 16:20:09 CET 2026
+ * @brief           contention profile of the server's mutexes and semaphores
+ *
+ *
+ * The server takes its mutexes with MUTEX_LOCK() / MUTEX_UNLOCK() (and
+ * waits on semaphores with SEM_WAIT()). Built with LOCK_PROFILING, every
+ * place a lock is taken is a site of its own, counting:
+ *
+ *      acquisitions    times the lock was taken there
+ *      contended       of which it was held by another thread
+ *      wait_us         time spent waiting for it, and the longest wait
+ *      hold_us         time it was held from there, and the longest hold
+ *
+ * The `[locks]` metrics section lists the sites by total wait, the one to
+ * attack first on top; every LOCK_PROFILE_INTERVAL seconds the console gets
+ * the sites that waited the most since the previous summary.
+ *
+ * An uncontended lock costs a trylock and two clock readings; the wait is
+ * only timed when the trylock fails. Without LOCK_PROFILING the macros are
+ * the plain pthread / xp_sem calls.
+ */
+
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "xp_sem.h"
+
+
+#if LOCK_PROFILING
+    // one site per place in the code, made on the first use
+    #define LOCK_SITE(lock)                             \
+        static LockSite lock_site_ = { #lock, __FILE__, __LINE__ }
+
+    #define MUTEX_LOCK(mutex)                           \
+        do { LOCK_SITE(mutex); lockProfileAcquire(mutex, &lock_site_); } while (0)
+    #define MUTEX_UNLOCK(mutex)                         \
+        lockProfileRelease(mutex)
+    #define MUTEX_COND_TIMEDWAIT(cond, mutex, until)    \
+        lockProfileCondWait(cond, mutex, until)
+    #define SEM_WAIT(sem)                               \
+        do { LOCK_SITE(sem); lockProfileSemWait(sem, &lock_site_); } while (0)
+#else
+    #define MUTEX_LOCK(mutex)                           pthread_mutex_lock(mutex)
+    #define MUTEX_UNLOCK(mutex)                         pthread_mutex_unlock(mutex)
+    #define MUTEX_COND_TIMEDWAIT(cond, mutex, until)    pthread_cond_timedwait(cond, mutex, until)
+    #define SEM_WAIT(sem)                               xp_sem_wait(sem)
+#endif
+
+
+typedef struct lock_site {
+    const char*         lock;               // as written at the site, e.g. "&t->lock"
+    const char*         file;
+    int                 line;
+
+    uint64_t            acquisitions;
+    uint64_t            contended;
+    uint64_t            wait_us;
+    uint64_t            hold_us;
+    uint64_t            max_wait_us;
+    uint64_t            max_hold_us;
+
+    uint64_t            summarized_wait_us; // at the previous console summary (its thread only)
+    uint64_t            summarized_contended;
+
+    int                 registered;
+    struct lock_site*   next;               // sites registered so far
+} LockSite;
+
+
+typedef struct lock_held {
+    void*               lock;
+    LockSite*           site;
+    uint64_t            since;              // us
+} LockHeld;
+
+
+static LockSite*            lock_sites_g;       // pushed on first use, never removed
+static __thread LockHeld    lock_held_tls[LOCK_PROFILE_DEPTH];
+static __thread int         lock_held_count_tls;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+void        lockProfileAcquire(pthread_mutex_t* mutex, LockSite* site);
+void        lockProfileRelease(pthread_mutex_t* mutex);
+int         lockProfileCondWait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* until);
+void        lockProfileSemWait(xp_sem_t* sem, LockSite* site);
+void        lockProfileStats(FILE* out);
+void*       lockProfileThread(void* NotUsed);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline uint64_t
+lockProfileNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+static inline void
+lockProfileMax(uint64_t* max, uint64_t value)
+{
+    uint64_t seen = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    while (value > seen && !__atomic_compare_exchange_n(max, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+    }
+}
+
+
+static void
+lockProfileRegister(LockSite* site)
+{
+    LockSite* head;
+
+    if (__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE) || __atomic_exchange_n(&site->registered, 1, __ATOMIC_ACQ_REL)){
+        return;
+    }
+
+    head = __atomic_load_n(&lock_sites_g, __ATOMIC_RELAXED);
+    do {
+        site->next = head;
+    } while (!__atomic_compare_exchange_n(&lock_sites_g, &head, site, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * Count a wait of `waited` us at `site`, contended if it waited at all.
+ */
+static void
+lockProfileWaited(LockSite* site, int contended, uint64_t waited)
+{
+    lockProfileRegister(site);
+
+    __atomic_add_fetch(&site->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended){
+        __atomic_add_fetch(&site->contended, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&site->wait_us, waited, __ATOMIC_RELAXED);
+        lockProfileMax(&site->max_wait_us, waited);
+    }
+}
+
+
+/**
+ * From now on the calling thread holds `lock`, taken at `site`.
+ */
+static void
+lockProfileHeld(void* lock, LockSite* site)
+{
+    if (lock_held_count_tls < LOCK_PROFILE_DEPTH){
+        lock_held_tls[lock_held_count_tls++] = (LockHeld){ .lock = lock, .site = site, .since = lockProfileNow() };
+    }
+}
+
+
+/**
+ * The calling thread lets go of `lock`: its hold is counted at the site it was taken at.
+ * return that site, NULL if unknown (more than LOCK_PROFILE_DEPTH locks held)
+ */
+static LockSite*
+lockProfileUnheld(void* lock)
+{
+    // usually the last one taken
+    for (int i = lock_held_count_tls - 1; i >= 0; i--){
+        if (lock_held_tls[i].lock == lock){
+            LockSite* site = lock_held_tls[i].site;
+            uint64_t  held = lockProfileNow() - lock_held_tls[i].since;
+
+            __atomic_add_fetch(&site->hold_us, held, __ATOMIC_RELAXED);
+            lockProfileMax(&site->max_hold_us, held);
+
+            lock_held_tls[i] = lock_held_tls[--lock_held_count_tls];
+            return site;
+        }
+    }
+    return NULL;
+}
+
+
+void
+lockProfileAcquire(pthread_mutex_t* mutex, LockSite* site)
+{
+    if (pthread_mutex_trylock(mutex) == 0){
+        lockProfileWaited(site, 0, 0);
+    }
+    else {
+        uint64_t start = lockProfileNow();
+
+        pthread_mutex_lock(mutex);
+        lockProfileWaited(site, 1, lockProfileNow() - start);
+    }
+    lockProfileHeld(mutex, site);
+}
+
+
+void
+lockProfileRelease(pthread_mutex_t* mutex)
+{
+    lockProfileUnheld(mutex);
+    pthread_mutex_unlock(mutex);
+}
+
+
+/**
+ * Waiting on `cond` lets go of `mutex`: not counted as held meanwhile.
+ */
+int
+lockProfileCondWait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* until)
+{
+    LockSite* site = lockProfileUnheld(mutex);
+    int       rv   = pthread_cond_timedwait(cond, mutex, until);
+
+    if (site != NULL){
+        lockProfileHeld(mutex, site);
+    }
+    return rv;
+}
+
+
+/**
+ * A semaphore isn't held by anyone: only the waits are counted.
+ */
+void
+lockProfileSemWait(xp_sem_t* sem, LockSite* site)
+{
+    if (xp_sem_trywait(sem) == 0){
+        lockProfileWaited(site, 0, 0);
+    }
+    else {
+        uint64_t start = lockProfileNow();
+
+        xp_sem_wait(sem);
+        lockProfileWaited(site, 1, lockProfileNow() - start);
+    }
+}
+
+
+static int
+compareSites(const void* a, const void* b)
+{
+    uint64_t x = __atomic_load_n(&(*(LockSite* const*) a)->wait_us, __ATOMIC_RELAXED);
+    uint64_t y = __atomic_load_n(&(*(LockSite* const*) b)->wait_us, __ATOMIC_RELAXED);
+
+    return x > y ? -1 : x < y;
+}
+
+
+/**
+ * return the registered sites, sorted by total wait (to free), NULL if none
+ */
+static LockSite**
+lockProfileSites(int* count)
+{
+    LockSite*  head = __atomic_load_n(&lock_sites_g, __ATOMIC_ACQUIRE);
+    LockSite** sites;
+    int        n = 0;
+
+    for (LockSite* s = head; s != NULL; s = s->next){
+        n++;
+    }
+    sites = n > 0 ? (LockSite**) malloc(n * sizeof(LockSite*)) : NULL;
+    if (sites == NULL){
+        *count = 0;
+        return NULL;
+    }
+
+    n = 0;
+    for (LockSite* s = head; s != NULL; s = s->next){
+        sites[n++] = s;
+    }
+    qsort(sites, n, sizeof(LockSite*), compareSites);
+
+    *count = n;
+    return sites;
+}
+
+
+/**
+ * `locks` metrics section: every site, the one that waited the most first.
+ */
+void
+lockProfileStats(FILE* out)
+{
+    int        count;
+    LockSite** sites = lockProfileSites(&count);
+
+    fprintf(out, "sites %d\n", count);
+
+    for (int i = 0; i < count; i++){
+        LockSite*   s    = sites[i];
+        const char* file = strrchr(s->file, '/') != NULL ? strrchr(s->file, '/') + 1 : s->file;
+
+        fprintf(out, "%s:%d.lock %s\n",             file, s->line, s->lock);
+        fprintf(out, "%s:%d.acquisitions %llu\n",   file, s->line, (unsigned long long) __atomic_load_n(&s->acquisitions, __ATOMIC_RELAXED));
+        fprintf(out, "%s:%d.contended %llu\n",      file, s->line, (unsigned long long) __atomic_load_n(&s->contended, __ATOMIC_RELAXED));
+        fprintf(out, "%s:%d.wait_us %llu\n",        file, s->line, (unsigned long long) __atomic_load_n(&s->wait_us, __ATOMIC_RELAXED));
+        fprintf(out, "%s:%d.max_wait_us %llu\n",    file, s->line, (unsigned long long) __atomic_load_n(&s->max_wait_us, __ATOMIC_RELAXED));
+        fprintf(out, "%s:%d.hold_us %llu\n",        file, s->line, (unsigned long long) __atomic_load_n(&s->hold_us, __ATOMIC_RELAXED));
+        fprintf(out, "%s:%d.max_hold_us %llu\n",    file, s->line, (unsigned long long) __atomic_load_n(&s->max_hold_us, __ATOMIC_RELAXED));
+    }
+    free(sites);
+}
+
+
+typedef struct lock_delta {
+    LockSite*   site;
+    uint64_t    wait_us;
+    uint64_t    contended;
+} LockDelta;
+
+
+static int
+compareDeltas(const void* a, const void* b)
+{
+    uint64_t x = ((const LockDelta*) a)->wait_us;
+    uint64_t y = ((const LockDelta*) b)->wait_us;
+
+    return x > y ? -1 : x < y;
+}
+
+
+/**
+ * Console summary thread body: every LOCK_PROFILE_INTERVAL seconds, the
+ * LOCK_PROFILE_TOP sites that waited the most meanwhile.
+ */
+void*
+lockProfileThread(void* NotUsed)
+{
+    while (1)
+    {
+        int        count;
+        LockSite** sites;
+        LockDelta* deltas;
+
+        sleep(LOCK_PROFILE_INTERVAL);
+
+        sites  = lockProfileSites(&count);
+        deltas = count > 0 ? (LockDelta*) malloc(count * sizeof(LockDelta)) : NULL;
+        if (deltas == NULL){
+            free(sites);
+            continue;
+        }
+
+        for (int i = 0; i < count; i++){
+            LockSite* s         = sites[i];
+            uint64_t  wait      = __atomic_load_n(&s->wait_us, __ATOMIC_RELAXED);
+            uint64_t  contended = __atomic_load_n(&s->contended, __ATOMIC_RELAXED);
+
+            deltas[i] = (LockDelta){ .site = s, .wait_us = wait - s->summarized_wait_us, .contended = contended - s->summarized_contended };
+            s->summarized_wait_us   = wait;
+            s->summarized_contended = contended;
+        }
+        qsort(deltas, count, sizeof(LockDelta), compareDeltas);
+
+        for (int i = 0; i < count && i < LOCK_PROFILE_TOP && deltas[i].contended > 0; i++){
+            LockSite*   s    = deltas[i].site;
+            const char* file = strrchr(s->file, '/') != NULL ? strrchr(s->file, '/') + 1 : s->file;
+
+            printf(ANSI_COLOR_YELLOW "LOCKS: %s:%d %s waited %llu us, contended %llu times in the last %d s" ANSI_COLOR_RESET "\n",
+                    file, s->line, s->lock, (unsigned long long) deltas[i].wait_us,
+                    (unsigned long long) deltas[i].contended, LOCK_PROFILE_INTERVAL);
+        }
+        free(deltas);
+        free(sites);
+    }
+
+    return NULL;
+}
+
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * @name            hotel-booking
+ * @file            Metrics.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Oct 19 14:58:03 CEST 2026
+ * @brief           server metrics report
+ *
+ *
+ * Subsystems register a section writer with metricsRegister(); a monitor
+ * thread rewrites DATA_FOLDER/METRICS_FILE_NAME every METRICS_INTERVAL
+ * seconds, and right away when the server receives SIGUSR1:
+ *
+ *      kill -USR1 <server pid> && cat .data/metrics.txt
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+
+
+#define METRICS_MAX_SECTIONS    16
+
+
+typedef void (*metrics_section_t)(FILE* out);
+
+
+typedef struct metrics {
+    int                     sections;
+    const char*             names[METRICS_MAX_SECTIONS];
+    metrics_section_t       writers[METRICS_MAX_SECTIONS];
+    char                    path[64];
+} Metrics;
+
+
+static Metrics                  metrics_g;
+static volatile sig_atomic_t    metrics_requested_g;    // set by SIGUSR1
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     metricsRegister(const char* name, metrics_section_t writer);
+int     metricsWriteReport(void);
+void    metricsSignalHandler(int signo);
+void*   metricsThread(void* path);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+/**
+ * Register the writer of a report section. Call before starting metricsThread().
+ * return 0 if OK, -1 if there's no room for more sections
+ */
+int
+metricsRegister(const char* name, metrics_section_t writer)
+{
+    if (metrics_g.sections == METRICS_MAX_SECTIONS){
+        return -1;
+    }
+    metrics_g.names[metrics_g.sections]   = name;
+    metrics_g.writers[metrics_g.sections] = writer;
+    metrics_g.sections++;
+    return 0;
+}
+
+
+/**
+ * Write the report to a temporary file and rename it over the previous one,
+ * so readers never see a half-written report.
+ * return 0 if OK, -1 otherwise
+ */
+int
+metricsWriteReport(void)
+{
+    char   tmp_path[sizeof(metrics_g.path) + 4];
+    time_t now = time(NULL);
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", metrics_g.path);
+
+    FILE* out = fopen(tmp_path, "w");
+    if (out == NULL){
+        return -1;
+    }
+
+    fprintf(out, "# hotel-booking metrics, %s", ctime(&now));
+    for (int i = 0; i < metrics_g.sections; i++){
+        fprintf(out, "\n[%s]\n", metrics_g.names[i]);
+        metrics_g.writers[i](out);
+    }
+    fclose(out);
+
+    return rename(tmp_path, metrics_g.path);
+}
+
+
+void
+metricsSignalHandler(int signo)
+{
+    metrics_requested_g = 1;
+}
+
+
+/**
+ * Monitor thread body. `path` is the report file.
+ */
+void*
+metricsThread(void* path)
+{
+    int elapsed = 0;
+
+    strncpy(metrics_g.path, (const char*) path, sizeof(metrics_g.path) - 1);
+    signal(SIGUSR1, metricsSignalHandler);
+
+    while (1)
+    {
+        sleep(1);
+
+        if (metrics_requested_g || ++elapsed >= METRICS_INTERVAL){
+            metrics_requested_g = 0;
+            elapsed = 0;
+
+            if (metricsWriteReport() != 0){
+                perror("metrics report");
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @name            hotel-booking
+ * @file            Random.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Tue Oct 20 15:04:29 CEST 2026
+ * @brief           per-thread pseudo random number generator
+ *
+ *
+ * xoshiro256** (https://prng.di.unimi.it/), one state per thread so no
+ * locking is needed. Each state is seeded once from /dev/urandom (falling
+ * back to time, pid and thread address if that's not readable) expanded
+ * with splitmix64.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static __thread uint64_t    random_state_tls[4];
+static __thread int         random_seeded_tls;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+uint64_t    randomNext(void);
+uint32_t    randomBelow(uint32_t n);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline uint64_t
+splitmix64(uint64_t* x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+static inline uint64_t
+rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+
+static void
+randomSeed(void)
+{
+    uint64_t seed = 0;
+
+    FILE* urandom = fopen("/dev/urandom", "rb");
+    if (urandom == NULL || fread(&seed, sizeof(seed), 1, urandom) != 1){
+        seed = (uint64_t) time(NULL) ^ ((uint64_t) getpid() << 32) ^ (uint64_t) (uintptr_t) &seed;
+    }
+    if (urandom != NULL){
+        fclose(urandom);
+    }
+
+    for (int i = 0; i < 4; i++){
+        random_state_tls[i] = splitmix64(&seed);
+    }
+    random_seeded_tls = 1;
+}
+
+
+/**
+ * return 64 random bits
+ */
+uint64_t
+randomNext(void)
+{
+    uint64_t* s = random_state_tls;
+
+    if (!random_seeded_tls){
+        randomSeed();
+    }
+
+    const uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    const uint64_t t      = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3]  = rotl64(s[3], 45);
+
+    return result;
+}
+
+
+/**
+ * return a random number in [0, n) (multiply-shift, no modulo)
+ */
+uint32_t
+randomBelow(uint32_t n)
+{
+    return (uint32_t) (((randomNext() >> 32) * (uint64_t) n) >> 32);
+}
+
+
+#endif
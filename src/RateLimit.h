@@ -0,0 +1,241 @@
+/**
+ * @name            hotel-booking
+ * @file            RateLimit.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Oct 26 15:27:05 CEST 2026
+ * @brief           per-user and per-IP rate limits (token buckets)
+ *
+ *
+ * Each (command class, username) and (command class, client IP) pair has a
+ * token bucket: it holds up to `burst` tokens, refilled at `per_second`,
+ * and every command takes one. An empty bucket means the command is turned
+ * down with "BUSY <ms>", the time until the next token. The checks come
+ * first thing, before any lookup, storage access or crypt().
+ *
+ * Buckets live in a fixed table of 64-bit words, updated with a single
+ * compare-and-swap: no locks, and threads only ever contend on the same
+ * bucket. A word packs the key fingerprint (16 bits), the tokens (16 bits,
+ * in 1/16ths) and the time of the last refill (32 bits, ms). A key finding
+ * its slot taken by another one starts over with a full bucket, so the
+ * table only needs to be large enough for the clients active at the same
+ * time. Hashes are salted at startup, so colliding keys can't be picked.
+ *
+ * IP buckets are RATE_LIMIT_IP_FACTOR times larger than user ones: several
+ * users may come from the same address.
+ */
+
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "messages.h"   // BUSY_MSG
+#include "Random.h"
+#include "utils.h"      // hashString()
+
+
+#define RATE_TOKEN_UNIT     16      // a token, in bucket units
+
+
+typedef enum rate_class {
+    RATE_LOGIN,             // login, register and resume attempts
+    RATE_BOOKING,           // reserve and release
+    RATE_VIEW,              // view
+    RATE_CLASSES
+} rate_class_t;
+
+
+typedef struct rate_limiter {
+    uint64_t*   buckets;            // fingerprint << 48 | tokens << 32 | refilled at (ms)
+    uint32_t    mask;
+    uint32_t    salt;
+    uint64_t    epoch;              // ms, origin of the bucket times
+
+    // metrics
+    uint64_t    allowed[RATE_CLASSES];
+    uint64_t    limited[RATE_CLASSES];
+} RateLimiter;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     initializeRateLimiter(RateLimiter* r, uint32_t slots);
+int     rateLimitUser(RateLimiter* r, rate_class_t class, const char* username, char* busy, size_t size);
+int     rateLimitAddress(RateLimiter* r, rate_class_t class, uint32_t ip, char* busy, size_t size);
+int     rateLimitAddressCheck(RateLimiter* r, rate_class_t class, uint32_t ip, char* busy, size_t size);
+void    rateLimiterStats(RateLimiter* r, FILE* out);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static const struct {
+    const char* name;
+    uint32_t    per_second;
+    uint32_t    burst;
+} rate_classes[RATE_CLASSES] = {
+    [RATE_LOGIN]   = { "login",   RATE_LOGIN_PER_SECOND,   RATE_LOGIN_BURST },
+    [RATE_BOOKING] = { "booking", RATE_BOOKING_PER_SECOND, RATE_BOOKING_BURST },
+    [RATE_VIEW]    = { "view",    RATE_VIEW_PER_SECOND,    RATE_VIEW_BURST },
+};
+
+
+static inline uint64_t
+rateNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+
+/**
+ * `slots` is rounded up to a power of 2.
+ * return 0 if OK, -1 if out of memory
+ */
+int
+initializeRateLimiter(RateLimiter* r, uint32_t slots)
+{
+    uint32_t n = 1;
+
+    while (n < slots){
+        n <<= 1;
+    }
+
+    memset(r, 0, sizeof(RateLimiter));
+    r->buckets = (uint64_t*) calloc(n, sizeof(uint64_t));
+    r->mask    = n - 1;
+    r->salt    = (uint32_t) randomNext();
+    r->epoch   = rateNow();
+
+    return r->buckets != NULL ? 0 : -1;
+}
+
+
+/**
+ * Take a token from the bucket of `hash`, holding up to `scale` times the burst of `class`.
+ * `take` 0 only looks whether there's one.
+ * return 0 if taken, otherwise the ms until there's one
+ */
+static uint32_t
+rateLimitTake(RateLimiter* r, rate_class_t class, uint32_t hash, uint32_t scale, int take)
+{
+    #if !RATE_LIMIT
+        (void) r; (void) class; (void) hash; (void) scale; (void) take;
+        return 0;
+    #endif
+
+    uint64_t* bucket      = &r->buckets[hash & r->mask];
+    uint64_t  fingerprint = (hash >> 16) | 1;       // never 0: a 0 word is an empty slot
+    uint64_t  rate        = (uint64_t) rate_classes[class].per_second * scale;
+    uint64_t  burst       = (uint64_t) rate_classes[class].burst * scale * RATE_TOKEN_UNIT;
+    uint32_t  now         = (uint32_t) (rateNow() - r->epoch);
+    uint64_t  old         = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    uint64_t  tokens, word;
+
+    if (burst > 0xffff){
+        burst = 0xffff;
+    }
+
+    do {
+        if ((old >> 48) != fingerprint){
+            tokens = burst;         // new key (or the slot was taken by another one): full bucket
+        }
+        else {
+            uint32_t elapsed = now - (uint32_t) old;
+
+            tokens = ((old >> 32) & 0xffff) + (uint64_t) elapsed * rate * RATE_TOKEN_UNIT / 1000;
+            if (tokens > burst){
+                tokens = burst;
+            }
+        }
+
+        if (tokens < RATE_TOKEN_UNIT){
+            __atomic_add_fetch(&r->limited[class], 1, __ATOMIC_RELAXED);
+            return rate > 0 ? (uint32_t) ((RATE_TOKEN_UNIT - tokens) * 1000 / (rate * RATE_TOKEN_UNIT)) + 1 : 1000;
+        }
+        if (!take){
+            return 0;
+        }
+
+        word = fingerprint << 48 | (tokens - RATE_TOKEN_UNIT) << 32 | now;
+
+    } while (!__atomic_compare_exchange_n(bucket, &old, word, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    __atomic_add_fetch(&r->allowed[class], 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+static inline int
+rateLimitReply(uint32_t wait, char* busy, size_t size)
+{
+    if (wait == 0){
+        return 0;
+    }
+    snprintf(busy, size, BUSY_MSG " %u", wait);
+    return 1;
+}
+
+
+/**
+ * Take a token of `class` for `username`. If there's none, the reply is written to `busy`.
+ * return 1 if the command has to be turned down, 0 if it can be served
+ */
+int
+rateLimitUser(RateLimiter* r, rate_class_t class, const char* username, char* busy, size_t size)
+{
+    uint32_t hash = (hashString(username) ^ r->salt) * 0x9e3779b1u + (uint32_t) class;
+
+    return rateLimitReply(rateLimitTake(r, class, hash, 1, 1), busy, size);
+}
+
+
+static inline uint32_t
+rateAddressHash(RateLimiter* r, rate_class_t class, uint32_t ip)
+{
+    uint32_t hash = ((ip ^ r->salt) * 0x85ebca6bu) ^ ((uint32_t) class * 0xc2b2ae35u);
+
+    return hash ^ (hash >> 16);
+}
+
+
+/**
+ * Take a token of `class` for the client address `ip` (network order). As rateLimitUser().
+ */
+int
+rateLimitAddress(RateLimiter* r, rate_class_t class, uint32_t ip, char* busy, size_t size)
+{
+    return rateLimitReply(rateLimitTake(r, class, rateAddressHash(r, class, ip), RATE_LIMIT_IP_FACTOR, 1), busy, size);
+}
+
+
+/**
+ * As rateLimitAddress(), without taking the token: for commands charged only
+ * if they fail (rateLimitAddress() afterwards).
+ */
+int
+rateLimitAddressCheck(RateLimiter* r, rate_class_t class, uint32_t ip, char* busy, size_t size)
+{
+    return rateLimitReply(rateLimitTake(r, class, rateAddressHash(r, class, ip), RATE_LIMIT_IP_FACTOR, 0), busy, size);
+}
+
+
+void
+rateLimiterStats(RateLimiter* r, FILE* out)
+{
+    fprintf(out, "slots %u\n", r->mask + 1);
+    for (int c = 0; c < RATE_CLASSES; c++){
+        fprintf(out, "%s.allowed %llu\n", rate_classes[c].name, (unsigned long long) __atomic_load_n(&r->allowed[c], __ATOMIC_RELAXED));
+        fprintf(out, "%s.limited %llu\n", rate_classes[c].name, (unsigned long long) __atomic_load_n(&r->limited[c], __ATOMIC_RELAXED));
+    }
+}
+
+
+#endif
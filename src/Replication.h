@@ -0,0 +1,757 @@
+/**
+ * @name            hotel-booking
+ * @file            Replication.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Wed Oct 28 09:41:17 CET 2026
+ * @brief           log shipping from a primary server to read-only followers
+ *
+ *
+ * The primary publishes every booking stored or removed to an in-memory
+ * log (a ring of REPLICATION_LOG_SIZE messages, numbered from 1) right
+ * after the storage took it, and serves it on a TCP port of its own. A
+ * thread per follower ships it:
+ *
+ *  - the follower says hello with the log it followed (`epoch`, the primary
+ *    process) and the next message it needs. If the ring still has it, the
+ *    log is shipped from there;
+ *  - otherwise (new follower, primary restarted, follower too far behind)
+ *    it's RESET: the follower drops its bookings, gets every live booking
+ *    of a storage snapshot, then SYNCED with the position the snapshot was
+ *    taken from. Changes made while the snapshot is read are shipped again
+ *    from the log: followers apply them idempotently;
+ *  - users are shipped from the user table, by record (it only grows);
+ *  - each batch ends with a HEARTBEAT carrying the log position it was
+ *    read up to, sent anyway every REPLICATION_HEARTBEAT_MS when idle.
+ *
+ * A follower applies what it gets to its own storage and indexes through
+ * the callbacks of its Replica. Staleness is the time since a heartbeat
+ * found it caught up: over REPLICATION_MAX_STALENESS the server turns reads
+ * down. Lost connections are retried every REPLICATION_RETRY_MS.
+ *
+ * Messages are fixed-size structs as laid out in memory: primary and
+ * followers have to run the same build (checked by the hello).
+ */
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "Address.h"
+#include "Random.h"
+#include "Storage.h"
+#include "UserTable.h"
+
+
+#define REPLICATION_MAGIC       "HBREPL01"
+#define REPLICATION_BATCH       64          // messages shipped with one send()
+
+
+typedef enum replication_type {
+    REPLICATION_USER = 1,       // user registered (`username`, `password` as stored)
+    REPLICATION_INSERT,         // booking stored; `seq` 0 if it comes from a snapshot
+    REPLICATION_REMOVE,         // booking removed
+    REPLICATION_RESET,          // drop every booking, a snapshot follows
+    REPLICATION_SYNCED,         // snapshot done: the log follows from `seq`, of `epoch`
+    REPLICATION_HEARTBEAT       // the log was shipped up to `seq` (excluded)
+} replication_type_t;
+
+
+typedef struct replication_message {
+    uint32_t    type;
+    int32_t     room;
+    uint64_t    seq;
+    uint64_t    epoch;
+    uint32_t    hotel;
+    day_t       day;
+    char        username[USERNAME_MAX_LENGTH];
+    char        password[PASSWORD_MAX_LENGTH];
+    char        code[RESERVATION_CODE_LENGTH];
+} ReplicationMessage;
+
+
+typedef struct replication_hello {
+    char        magic[8];
+    uint32_t    message_size;               // sizeof(ReplicationMessage): same build
+    uint32_t    users;                      // user records the follower has
+    uint64_t    epoch;                      // of the log it followed, 0 if none
+    uint64_t    next;                       // first message it's missing
+} ReplicationHello;
+
+
+struct replication_log;
+
+typedef struct replication_follower {
+    struct replication_log* log;
+    int                     fd;             // -1: free slot
+    char                    ip[INET_ADDRSTRLEN];
+    uint64_t                next;           // first message not shipped yet
+    uint64_t                shipped;        // messages
+    uint64_t                resets;
+} ReplicationFollower;
+
+
+/* primary side */
+typedef struct replication_log {
+    pthread_mutex_t         lock;
+    pthread_cond_t          appended;
+    pthread_mutex_t         sync_lock;      // one snapshot at a time
+    ReplicationMessage*     ring;           // NULL: not replicating
+    uint64_t                seq;            // next message number
+    uint64_t                epoch;
+
+    const Storage*          storage;
+    UserTable*              users;
+    int                     thread_index;   // storage connection of the shippers
+    int                     listener;
+
+    ReplicationFollower     followers[REPLICATION_MAX_FOLLOWERS];
+} ReplicationLog;
+
+
+/* follower side */
+typedef struct replica {
+    Address                 primary;
+
+    // applying what the primary ships, called by the replica thread only
+    int                     (*user)(const char* username, const char* password);
+    storage_visit_t         insert;
+    storage_visit_t         remove;
+    int                     (*reset)(void);
+    uint32_t                (*users)(void);
+
+    int                     connected;
+    uint64_t                epoch;          // 0 until a snapshot is complete
+    uint64_t                next;
+    uint64_t                head;           // primary position, as of the last heartbeat
+    uint64_t                fresh_at;       // ms, last time a heartbeat found it caught up (0: never)
+
+    // metrics
+    uint64_t                applied;
+    uint64_t                resets;
+    uint64_t                connections;
+} Replica;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int         initializeReplicationLog(ReplicationLog* log, const Storage* storage, UserTable* users, int thread_index);
+void        replicationPublish(ReplicationLog* log, replication_type_t type, const StoredBooking* booking);
+void*       replicationListenThread(void* log);
+void        replicationLogStats(ReplicationLog* log, FILE* out);
+
+void*       replicaThread(void* replica);
+uint64_t    replicaStaleness(const Replica* r);
+void        replicaStats(const Replica* r, FILE* out);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline uint64_t
+replicationNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+
+/**
+ * return 0 if all of `buf` was sent, -1 if the peer is gone
+ */
+static int
+replicationSend(int fd, const void* buf, size_t size)
+{
+    const char* p = (const char*) buf;
+
+    while (size > 0){
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            return -1;
+        }
+        p    += n;
+        size -= (size_t) n;
+    }
+    return 0;
+}
+
+
+/**
+ * return 0 if `buf` was filled, -1 if the peer is gone
+ */
+static int
+replicationReceive(int fd, void* buf, size_t size)
+{
+    char* p = (char*) buf;
+
+    while (size > 0){
+        ssize_t n = recv(fd, p, size, 0);
+
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            return -1;
+        }
+        p    += n;
+        size -= (size_t) n;
+    }
+    return 0;
+}
+
+
+static void
+replicationBooking(ReplicationMessage* m, replication_type_t type, const StoredBooking* b)
+{
+    memset(m, '\0', sizeof(ReplicationMessage));
+    m->type  = type;
+    m->hotel = b->hotel;
+    m->day   = b->day;
+    m->room  = b->room;
+    memcpy(m->username, b->username, sizeof(m->username));
+    memcpy(m->code,     b->code,     sizeof(m->code));
+}
+
+
+/**
+ * The shippers read the storage through connection `thread_index`.
+ * return 0 if OK, -1 if out of memory
+ */
+int
+initializeReplicationLog(ReplicationLog* log, const Storage* storage, UserTable* users, int thread_index)
+{
+    memset(log, 0, sizeof(ReplicationLog));
+    pthread_mutex_init(&log->lock, 0);
+    pthread_cond_init(&log->appended, 0);
+    pthread_mutex_init(&log->sync_lock, 0);
+
+    log->ring         = (ReplicationMessage*) calloc(REPLICATION_LOG_SIZE, sizeof(ReplicationMessage));
+    log->seq          = 1;
+    log->epoch        = randomNext() | 1;       // never 0: a follower's "none"
+    log->storage      = storage;
+    log->users        = users;
+    log->thread_index = thread_index;
+    log->listener     = -1;
+
+    for (int i = 0; i < REPLICATION_MAX_FOLLOWERS; i++){
+        log->followers[i].fd = -1;
+    }
+    return log->ring != NULL ? 0 : -1;
+}
+
+
+/**
+ * Append a change of the storage to the log. Called once the storage took
+ * it, before anything depending on it can happen (the booking released, the
+ * room given to someone else): the log is in the order of the storage.
+ * A no-op if the log isn't initialized.
+ */
+void
+replicationPublish(ReplicationLog* log, replication_type_t type, const StoredBooking* booking)
+{
+    if (log->ring == NULL){
+        return;
+    }
+
+    /* critical section */
+    MUTEX_LOCK(&log->lock);
+
+        ReplicationMessage* m = &log->ring[log->seq % REPLICATION_LOG_SIZE];
+
+        replicationBooking(m, type, booking);
+        m->seq   = log->seq++;
+        m->epoch = log->epoch;
+
+        pthread_cond_broadcast(&log->appended);
+
+    MUTEX_UNLOCK(&log->lock);
+    /* end critical section */
+}
+
+
+typedef struct replication_snapshot {
+    StoredBooking*  bookings;
+    uint64_t        count;
+    uint64_t        capacity;
+    int             failed;
+} ReplicationSnapshot;
+
+
+static int
+replicationCollect(const StoredBooking* b, void* payload)
+{
+    ReplicationSnapshot* s = (ReplicationSnapshot*) payload;
+
+    if (s->count == s->capacity){
+        uint64_t       capacity = s->capacity ? 2 * s->capacity : 4096;
+        StoredBooking* grown    = (StoredBooking*) realloc(s->bookings, capacity * sizeof(StoredBooking));
+
+        if (grown == NULL){
+            s->failed = 1;
+            return 1;
+        }
+        s->bookings = grown;
+        s->capacity = capacity;
+    }
+    s->bookings[s->count++] = *b;
+    return 0;
+}
+
+
+/**
+ * RESET, every live booking, SYNCED. The log position is taken before the
+ * snapshot: what changes meanwhile is in both, followers don't mind.
+ * return the log position the follower goes on from, 0 if it's gone
+ */
+static uint64_t
+replicationShipSnapshot(ReplicationFollower* f)
+{
+    ReplicationLog*     log = f->log;
+    ReplicationSnapshot snapshot;
+    ReplicationMessage  batch[REPLICATION_BATCH];
+    StorageCursor       cursor;
+    uint64_t            from;
+    int                 n = 0, rv;
+
+    MUTEX_LOCK(&log->lock);
+        from = log->seq;
+    MUTEX_UNLOCK(&log->lock);
+
+    memset(&batch[0], '\0', sizeof(ReplicationMessage));
+    batch[0].type  = REPLICATION_RESET;
+    batch[0].epoch = log->epoch;
+    if (replicationSend(f->fd, &batch[0], sizeof(ReplicationMessage)) != 0){
+        return 0;
+    }
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    MUTEX_LOCK(&log->sync_lock);
+        rv = log->storage->snapshot(log->thread_index, replicationCollect, &snapshot, &cursor);
+    MUTEX_UNLOCK(&log->sync_lock);
+
+    if (rv != 0 || snapshot.failed){
+        free(snapshot.bookings);
+        return 0;   // the follower reconnects and tries again
+    }
+
+    for (uint64_t i = 0; i <= snapshot.count; i++){
+        if (i < snapshot.count){
+            replicationBooking(&batch[n], REPLICATION_INSERT, &snapshot.bookings[i]);
+            batch[n].epoch = log->epoch;
+            n++;
+        }
+        if (n == REPLICATION_BATCH || (i == snapshot.count && n > 0)){
+            if (replicationSend(f->fd, batch, n * sizeof(ReplicationMessage)) != 0){
+                free(snapshot.bookings);
+                return 0;
+            }
+            f->shipped += n;
+            n = 0;
+        }
+    }
+    free(snapshot.bookings);
+
+    memset(&batch[0], '\0', sizeof(ReplicationMessage));
+    batch[0].type  = REPLICATION_SYNCED;
+    batch[0].seq   = from;
+    batch[0].epoch = log->epoch;
+
+    f->resets++;
+    return replicationSend(f->fd, &batch[0], sizeof(ReplicationMessage)) == 0 ? from : 0;
+}
+
+
+/**
+ * Ship the users registered since record `*users`.
+ * return 0 if OK, -1 if the follower is gone
+ */
+static int
+replicationShipUsers(ReplicationFollower* f, uint32_t* users)
+{
+    ReplicationLog*    log   = f->log;
+    uint32_t           count = __atomic_load_n(&log->users->header->count, __ATOMIC_ACQUIRE);
+    ReplicationMessage batch[REPLICATION_BATCH];
+    int                n = 0;
+
+    while (*users < count){
+        const UserRecord* u = &log->users->records[(*users)++];
+
+        memset(&batch[n], '\0', sizeof(ReplicationMessage));
+        batch[n].type  = REPLICATION_USER;
+        batch[n].epoch = log->epoch;
+        memcpy(batch[n].username, u->username, sizeof(batch[n].username));
+        memcpy(batch[n].password, u->password, sizeof(batch[n].password));
+
+        if (++n == REPLICATION_BATCH || *users == count){
+            if (replicationSend(f->fd, batch, n * sizeof(ReplicationMessage)) != 0){
+                return -1;
+            }
+            f->shipped += n;
+            n = 0;
+        }
+    }
+    return 0;
+}
+
+
+static void*
+replicationShipThread(void* opaque)
+{
+    ReplicationFollower* f   = (ReplicationFollower*) opaque;
+    ReplicationLog*      log = f->log;
+    ReplicationHello     hello;
+    ReplicationMessage   batch[REPLICATION_BATCH + 1];
+    uint64_t             next = 0;
+    uint32_t             users;
+    int                  resume = 0;
+
+    if (replicationReceive(f->fd, &hello, sizeof(hello)) == 0 &&
+        memcmp(hello.magic, REPLICATION_MAGIC, sizeof(hello.magic)) == 0 &&
+        hello.message_size == sizeof(ReplicationMessage))
+    {
+        MUTEX_LOCK(&log->lock);
+            resume = hello.epoch == log->epoch && hello.next <= log->seq && log->seq - hello.next < REPLICATION_LOG_SIZE;
+        MUTEX_UNLOCK(&log->lock);
+
+        next  = resume ? hello.next : replicationShipSnapshot(f);
+        users = hello.users;
+    }
+    else {
+        printf("REPLICATION: %s is not a follower of this build\n", f->ip);
+    }
+
+    while (next > 0){
+        int n = 0;
+
+        if (replicationShipUsers(f, &users) != 0){
+            break;
+        }
+
+        /* critical section */
+        MUTEX_LOCK(&log->lock);
+
+            if (next == log->seq){
+                struct timespec until;
+
+                clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_nsec += (long) REPLICATION_HEARTBEAT_MS * 1000000;
+                until.tv_sec  += until.tv_nsec / 1000000000;
+                until.tv_nsec %= 1000000000;
+                MUTEX_COND_TIMEDWAIT(&log->appended, &log->lock, &until);
+            }
+            if (log->seq - next >= REPLICATION_LOG_SIZE){
+                MUTEX_UNLOCK(&log->lock);
+                printf("REPLICATION: %s fell behind the log\n", f->ip);
+                break;      // it reconnects and starts over from a snapshot
+            }
+            while (next < log->seq && n < REPLICATION_BATCH){
+                batch[n++] = log->ring[next++ % REPLICATION_LOG_SIZE];
+            }
+
+        MUTEX_UNLOCK(&log->lock);
+        /* end critical section */
+
+        memset(&batch[n], '\0', sizeof(ReplicationMessage));
+        batch[n].type  = REPLICATION_HEARTBEAT;
+        batch[n].seq   = next;
+        batch[n].epoch = log->epoch;
+
+        if (replicationSend(f->fd, batch, (n + 1) * sizeof(ReplicationMessage)) != 0){
+            break;
+        }
+        f->shipped += n;
+        __atomic_store_n(&f->next, next, __ATOMIC_RELAXED);
+    }
+
+    printf("REPLICATION: follower %s gone\n", f->ip);
+    close(f->fd);
+    __atomic_store_n(&f->fd, -1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+
+/**
+ * Accepts followers on `log->listener` (set up by the caller), up to REPLICATION_MAX_FOLLOWERS.
+ */
+void*
+replicationListenThread(void* opaque)
+{
+    ReplicationLog* log = (ReplicationLog*) opaque;
+
+    while (1)
+    {
+        struct sockaddr_in addr;
+        socklen_t          addrlen = sizeof(addr);
+        ReplicationFollower* f     = NULL;
+        pthread_t          thread;
+        int                one     = 1;
+        int                fd      = accept(log->listener, (struct sockaddr*) &addr, &addrlen);
+
+        if (fd < 0){
+            perror("accept(replication)");
+            usleep(10 * 1000);
+            continue;
+        }
+
+        for (int i = 0; i < REPLICATION_MAX_FOLLOWERS && f == NULL; i++){
+            if (__atomic_load_n(&log->followers[i].fd, __ATOMIC_ACQUIRE) < 0){
+                f = &log->followers[i];
+            }
+        }
+        if (f == NULL){
+            printf("REPLICATION: too many followers, one turned away\n");
+            close(fd);
+            continue;
+        }
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        memset(f, 0, sizeof(ReplicationFollower));
+        f->log = log;
+        f->fd  = fd;
+        inet_ntop(AF_INET, &addr.sin_addr, f->ip, sizeof(f->ip));
+
+        if (pthread_create(&thread, NULL, replicationShipThread, f) != 0){
+            perror("pthread_create(replication)");
+            close(fd);
+            f->fd = -1;
+            continue;
+        }
+        pthread_detach(thread);
+        printf("REPLICATION: follower %s connected\n", f->ip);
+    }
+
+    return NULL;
+}
+
+
+void
+replicationLogStats(ReplicationLog* log, FILE* out)
+{
+    uint64_t seq;
+
+    MUTEX_LOCK(&log->lock);
+        seq = log->seq;
+    MUTEX_UNLOCK(&log->lock);
+
+    fprintf(out, "role primary\n");
+    fprintf(out, "log_position %llu\n", (unsigned long long) seq);
+    for (int i = 0; i < REPLICATION_MAX_FOLLOWERS; i++){
+        ReplicationFollower* f = &log->followers[i];
+
+        if (__atomic_load_n(&f->fd, __ATOMIC_ACQUIRE) < 0){
+            continue;
+        }
+        fprintf(out, "follower%d %s behind %llu shipped %llu resets %llu\n", i, f->ip,
+                (unsigned long long) (seq - __atomic_load_n(&f->next, __ATOMIC_RELAXED)),
+                (unsigned long long) f->shipped, (unsigned long long) f->resets);
+    }
+}
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static int
+replicaConnect(const Replica* r)
+{
+    struct sockaddr_in addr;
+    int                one = 1;
+    int                fd  = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0){
+        return -1;
+    }
+    memset(&addr, '\0', sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(r->primary.port);
+    addr.sin_addr.s_addr = inet_addr(r->primary.ip);
+
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0){
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+
+/**
+ * return 0 if OK, -1 if the message makes no sense (or the callback failed)
+ */
+static int
+replicaApply(Replica* r, const ReplicationMessage* m)
+{
+    StoredBooking b;
+
+    switch (m->type){
+        case REPLICATION_USER:
+            return r->user(m->username, m->password) < 0 ? -1 : 0;
+
+        case REPLICATION_INSERT:
+        case REPLICATION_REMOVE:
+            memset(&b, '\0', sizeof(b));
+            memcpy(b.username, m->username, sizeof(b.username) - 1);
+            memcpy(b.code,     m->code,     sizeof(b.code) - 1);
+            b.hotel = m->hotel;
+            b.day   = m->day;
+            b.room  = m->room;
+
+            if ((m->type == REPLICATION_INSERT ? r->insert : r->remove)(&b, NULL) != 0){
+                return -1;
+            }
+            if (m->seq > 0){
+                r->next = m->seq + 1;
+            }
+            __atomic_add_fetch(&r->applied, 1, __ATOMIC_RELAXED);
+            return 0;
+
+        case REPLICATION_RESET:
+            __atomic_store_n(&r->epoch, 0, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&r->resets, 1, __ATOMIC_RELAXED);
+            return r->reset();
+
+        case REPLICATION_SYNCED:
+            r->next = m->seq;
+            __atomic_store_n(&r->epoch, m->epoch, __ATOMIC_RELAXED);
+            return 0;
+
+        case REPLICATION_HEARTBEAT:
+            __atomic_store_n(&r->head, m->seq, __ATOMIC_RELAXED);
+            if (r->epoch == m->epoch && r->next == m->seq){
+                __atomic_store_n(&r->fresh_at, replicationNow(), __ATOMIC_RELAXED);
+            }
+            return 0;
+    }
+    return -1;
+}
+
+
+/**
+ * Follows `r->primary` for as long as the process lives.
+ */
+void*
+replicaThread(void* opaque)
+{
+    Replica* r = (Replica*) opaque;
+
+    while (1)
+    {
+        ReplicationHello   hello;
+        ReplicationMessage batch[REPLICATION_BATCH];
+        size_t             have = 0;
+        int                fd   = replicaConnect(r);
+
+        if (fd < 0){
+            usleep(REPLICATION_RETRY_MS * 1000);
+            continue;
+        }
+
+        memset(&hello, '\0', sizeof(hello));
+        memcpy(hello.magic, REPLICATION_MAGIC, sizeof(hello.magic));
+        hello.message_size = sizeof(ReplicationMessage);
+        hello.users        = r->users();
+        hello.epoch        = r->epoch;
+        hello.next         = r->next;
+
+        if (replicationSend(fd, &hello, sizeof(hello)) == 0){
+            __atomic_store_n(&r->connected, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&r->connections, 1, __ATOMIC_RELAXED);
+            printf("REPLICA: following %s:%d\n", r->primary.ip, r->primary.port);
+        }
+        else {
+            have = (size_t) -1;
+        }
+
+        while (have != (size_t) -1){
+            ssize_t n = recv(fd, (char*) batch + have, sizeof(batch) - have, 0);
+
+            if (n < 0 && errno == EINTR){
+                continue;
+            }
+            if (n <= 0){
+                break;
+            }
+            have += (size_t) n;
+
+            size_t whole = have / sizeof(ReplicationMessage);
+
+            for (size_t i = 0; i < whole; i++){
+                if (replicaApply(r, &batch[i]) != 0){
+                    printf("REPLICA: message %u not applied, starting over\n", batch[i].type);
+                    r->epoch = 0;
+                    have     = (size_t) -1;
+                    break;
+                }
+            }
+            if (have != (size_t) -1){
+                have -= whole * sizeof(ReplicationMessage);
+                memmove(batch, (char*) batch + whole * sizeof(ReplicationMessage), have);
+            }
+        }
+
+        close(fd);
+        if (__atomic_exchange_n(&r->connected, 0, __ATOMIC_RELAXED)){
+            printf("REPLICA: lost %s:%d\n", r->primary.ip, r->primary.port);
+        }
+        usleep(REPLICATION_RETRY_MS * 1000);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * return ms since the follower was last known to be up to date with the primary, UINT64_MAX if never
+ */
+uint64_t
+replicaStaleness(const Replica* r)
+{
+    uint64_t fresh_at = __atomic_load_n(&r->fresh_at, __ATOMIC_RELAXED);
+
+    return fresh_at > 0 ? replicationNow() - fresh_at : UINT64_MAX;
+}
+
+
+void
+replicaStats(const Replica* r, FILE* out)
+{
+    uint64_t staleness = replicaStaleness(r);
+
+    fprintf(out, "role follower\n");
+    fprintf(out, "primary %s:%d\n", r->primary.ip, r->primary.port);
+    fprintf(out, "connected %d\n", __atomic_load_n(&r->connected, __ATOMIC_RELAXED));
+    fprintf(out, "position %llu\n", (unsigned long long) __atomic_load_n(&r->next, __ATOMIC_RELAXED));
+    fprintf(out, "primary_position %llu\n", (unsigned long long) __atomic_load_n(&r->head, __ATOMIC_RELAXED));
+    if (staleness == UINT64_MAX){
+        fprintf(out, "staleness_ms never_synced\n");
+    }
+    else {
+        fprintf(out, "staleness_ms %llu\n", (unsigned long long) staleness);
+    }
+    fprintf(out, "applied %llu\n", (unsigned long long) __atomic_load_n(&r->applied, __ATOMIC_RELAXED));
+    fprintf(out, "resets %llu\n", (unsigned long long) __atomic_load_n(&r->resets, __ATOMIC_RELAXED));
+    fprintf(out, "connections %llu\n", (unsigned long long) __atomic_load_n(&r->connections, __ATOMIC_RELAXED));
+}
+
+
+#endif
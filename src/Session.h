@@ -0,0 +1,323 @@
+/**
+ * @name            hotel-booking
+ * @file            Session.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sat Oct 24 11:05:52 CEST 2026
+ * @brief           client session: FSM state and framed, non-blocking socket I/O
+ *
+ *
+ * A session holds everything the server FSM keeps between two commands,
+ * so it can be suspended whenever the frames a state needs haven't arrived
+ * yet and resumed by the event loop when they do: no thread is tied up
+ * waiting for a client.
+ *
+ * Incoming bytes are buffered in the session (SESSION_INPUT_SIZE, enough for
+ * the longest frame a client sends). Replies are framed into a per-thread
+ * buffer and sent with one call when the FSM suspends; only what the socket
+ * doesn't take right away is copied into the session (`pending`), and the
+ * session doesn't read more commands until that's gone.
+ *
+ * With io_uring (see `EventLoop.h`) the loop does the socket I/O itself:
+ * the kernel receives straight into `in`, and every step's replies are
+ * moved into `pending` (sessionQueue()) to stay put while the send runs.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <arpa/inet.h>      // htonl(), ntohl()
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "utils.h"          // server_fsm_state_t
+#include "Booking.h"
+#include "User.h"
+#include "SessionTokens.h"
+
+
+#ifdef MSG_NOSIGNAL
+    #define SESSION_SEND_FLAGS      MSG_NOSIGNAL
+#else
+    #define SESSION_SEND_FLAGS      0           // SIGPIPE is ignored by the server
+#endif
+
+
+typedef struct session {
+    int                 fd;
+    server_fsm_state_t  state;
+    int                 interest;                       // POLLER_IN, or POLLER_OUT while `pending`
+    uint32_t            ip;                             // client address (network order), rate limited
+
+    User                user;
+    char                token[SESSION_TOKEN_LENGTH];    // "" until logged in
+    Booking             booking;                        // `reserve` and `release` arguments
+    uint32_t            hotel;                          // picked with `hotel`, commands naming no hotel act on it, 0 if the pick wasn't a hotel ID
+    int                 routed;                         // 1 once the first command is read: a router picked the shard by it, the hotel can't change
+    int                 room_type;                      // room type requested with `reserve`
+
+    uint32_t            in_used;
+    char                in[SESSION_INPUT_SIZE];         // frames received, not consumed yet
+
+    uint32_t            id;                             // sessions are numbered from 1 (traffic trace, spans)
+    uint32_t            traced;                         // bytes of `in` already recorded
+    uint32_t            frames_out;                     // reply frames written so far
+
+    char*               pending;                        // reply bytes the socket didn't take, NULL almost always
+    uint32_t            pending_size;
+    uint32_t            pending_sent;
+
+    // io_uring only
+    uint8_t             recv_posted;                    // a receive into `in` is in flight
+    uint8_t             send_posted;                    // a send of `pending` is in flight
+    uint8_t             quit;                           // close once `pending` is sent
+    uint8_t             closing;                        // freed when nothing is in flight anymore
+} Session;
+
+
+static uint32_t             session_ids_g;                          // IDs handed out so far
+
+static __thread char        session_out_tls[SESSION_OUTPUT_SIZE];   // replies of the session being served
+static __thread uint32_t    session_out_used_tls;
+static __thread uint64_t    session_syscalls_tls;                   // recv() and send() calls of the thread
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+Session*    sessionCreate(int fd);
+void        sessionDestroy(Session* s);
+int         sessionReceive(Session* s);
+int         sessionFrames(const Session* s);
+void        sessionRead(Session* s, char* msg, size_t size);
+void        sessionWrite(Session* s, const char* msg);
+int         sessionQueue(Session* s);
+int         sessionFlush(Session* s);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+/**
+ * return a new session reading from `fd` (non-blocking, unless served by io_uring), NULL if out of memory
+ */
+Session*
+sessionCreate(int fd)
+{
+    Session* s = (Session*) calloc(1, sizeof(Session));
+
+    if (s != NULL){
+        s->fd    = fd;
+        s->id    = __atomic_add_fetch(&session_ids_g, 1, __ATOMIC_RELAXED);
+        s->state = INIT;
+        s->hotel = HOTEL_ID_DEFAULT;    // until the client picks one
+    }
+    return s;
+}
+
+
+void
+sessionDestroy(Session* s)
+{
+    close(s->fd);
+    free(s->pending);
+    free(s);
+}
+
+
+/**
+ * Read what the socket has into the input buffer.
+ * return 0 if OK (possibly nothing new), -1 if the client is gone
+ */
+int
+sessionReceive(Session* s)
+{
+    ssize_t n;
+
+    if (s->in_used == SESSION_INPUT_SIZE){
+        return 0;   // full of complete frames, consume them first
+    }
+
+    n = recv(s->fd, s->in + s->in_used, SESSION_INPUT_SIZE - s->in_used, 0);
+    session_syscalls_tls++;
+    if (n == 0){
+        return -1;
+    }
+    if (n < 0){
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    }
+
+    s->in_used += (uint32_t) n;
+    return 0;
+}
+
+
+/**
+ * return the number of complete frames buffered, -1 if a frame can't fit the buffer
+ */
+int
+sessionFrames(const Session* s)
+{
+    uint32_t at     = 0;
+    int      frames = 0;
+
+    while (s->in_used - at >= sizeof(int32_t)){
+        int32_t dim;
+
+        memcpy(&dim, s->in + at, sizeof(dim));
+        dim = ntohl(dim);
+
+        if (dim < 0 || dim > SESSION_INPUT_SIZE - (int32_t) sizeof(dim)){
+            return -1;
+        }
+        if (s->in_used - at - sizeof(dim) < (uint32_t) dim){
+            break;
+        }
+        at += sizeof(dim) + dim;
+        frames++;
+    }
+    return frames;
+}
+
+
+/**
+ * Consume the first frame, copying it NUL-terminated into `msg` (truncated to `size`).
+ * There must be one (sessionFrames() > 0).
+ */
+void
+sessionRead(Session* s, char* msg, size_t size)
+{
+    int32_t dim;
+
+    memcpy(&dim, s->in, sizeof(dim));
+    dim = ntohl(dim);
+
+    size_t n = (size_t) dim < size - 1 ? (size_t) dim : size - 1;
+    memcpy(msg, s->in + sizeof(dim), n);
+    msg[n] = '\0';
+
+    s->in_used -= sizeof(dim) + dim;
+    s->traced   = s->traced > sizeof(dim) + dim ? s->traced - (sizeof(dim) + dim) : 0;
+    memmove(s->in, s->in + sizeof(dim) + dim, s->in_used);
+}
+
+
+/**
+ * Frame a reply into the thread's buffer, sent by sessionFlush().
+ */
+void
+sessionWrite(Session* s, const char* msg)
+{
+    uint32_t len = (uint32_t) strlen(msg);
+    int32_t  dim;
+
+    if (len > SESSION_OUTPUT_SIZE - sizeof(dim)){
+        len = SESSION_OUTPUT_SIZE - sizeof(dim);
+    }
+    if (session_out_used_tls + sizeof(dim) + len > SESSION_OUTPUT_SIZE){
+        sessionQueue(s);
+    }
+
+    dim = htonl((int32_t) len);
+    memcpy(session_out_tls + session_out_used_tls, &dim, sizeof(dim));
+    memcpy(session_out_tls + session_out_used_tls + sizeof(dim), msg, len);
+    session_out_used_tls += sizeof(dim) + len;
+    s->frames_out++;
+}
+
+
+/**
+ * Move the replies framed so far behind the session's `pending` ones.
+ * Never while a send of `pending` is in flight: it may move.
+ * return 0 if OK, -1 if out of memory (the replies are lost)
+ */
+int
+sessionQueue(Session* s)
+{
+    if (session_out_used_tls == 0){
+        return 0;
+    }
+
+    char* grown = (char*) realloc(s->pending, s->pending_size + session_out_used_tls);
+
+    if (grown == NULL){
+        session_out_used_tls = 0;
+        return -1;
+    }
+    memcpy(grown + s->pending_size, session_out_tls, session_out_used_tls);
+    s->pending       = grown;
+    s->pending_size += session_out_used_tls;
+    session_out_used_tls = 0;
+    return 0;
+}
+
+
+/**
+ * Send the queued replies, then what was left pending before.
+ * return 0 if everything was sent, 1 if some is still pending, -1 if the client is gone
+ */
+int
+sessionFlush(Session* s)
+{
+    // replies of this step go after the older pending ones
+    if (s->pending != NULL && sessionQueue(s) != 0){
+        return -1;
+    }
+
+    if (s->pending != NULL){
+        while (s->pending_sent < s->pending_size){
+            ssize_t n = send(s->fd, s->pending + s->pending_sent, s->pending_size - s->pending_sent, SESSION_SEND_FLAGS);
+
+            session_syscalls_tls++;
+
+            if (n < 0){
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 1 : -1;
+            }
+            s->pending_sent += (uint32_t) n;
+        }
+        free(s->pending);
+        s->pending      = NULL;
+        s->pending_size = 0;
+        s->pending_sent = 0;
+        return 0;
+    }
+
+    uint32_t sent = 0;
+
+    while (sent < session_out_used_tls){
+        ssize_t n = send(s->fd, session_out_tls + sent, session_out_used_tls - sent, SESSION_SEND_FLAGS);
+
+        session_syscalls_tls++;
+
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+            session_out_used_tls = 0;
+            return -1;
+        }
+        if (n < 0){
+            // the socket is full: keep the rest in the session
+            s->pending = (char*) malloc(session_out_used_tls - sent);
+            if (s->pending == NULL){
+                session_out_used_tls = 0;
+                return -1;
+            }
+            s->pending_size = session_out_used_tls - sent;
+            s->pending_sent = 0;
+            memcpy(s->pending, session_out_tls + sent, s->pending_size);
+            session_out_used_tls = 0;
+            return 1;
+        }
+        sent += (uint32_t) n;
+    }
+
+    session_out_used_tls = 0;
+    return 0;
+}
+
+
+#endif
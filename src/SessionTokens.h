@@ -0,0 +1,236 @@
+/**
+ * @name            hotel-booking
+ * @file            SessionTokens.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Fri Oct 23 15:02:44 CEST 2026
+ * @brief           session resumption tokens
+ *
+ *
+ * A client that logged in gets a token; presenting it later (`resume`)
+ * restores the logged-in session in one round trip, without the password
+ * and without crypt().
+ *
+ * A token is "<slot><secret>": the slot of the table it lives in (8 hex
+ * digits) followed by 128 random bits (32 hex digits). Lookups are O(1),
+ * no hashing. Slots are handed out round robin, so when the table is full
+ * the oldest token is the one replaced. Each slot is protected by one of
+ * SESSION_TOKEN_STRIPES locks. Tokens expire SESSION_TOKEN_TTL seconds after
+ * they were issued or last used, and are revoked by `logout`.
+ */
+
+#ifndef SESSION_TOKENS_H
+#define SESSION_TOKENS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>     // getentropy()
+
+#include "config.h"
+#include "LockProfile.h"
+#include "Random.h"
+
+
+#define SESSION_TOKEN_STRIPES       16      // power of 2
+#define SESSION_SECRET_LENGTH       32      // hex digits
+#define SESSION_TOKEN_LENGTH        (8 + SESSION_SECRET_LENGTH + 1)
+
+
+typedef struct session_token {
+    char        secret[SESSION_SECRET_LENGTH];  // not NUL-terminated, all '\0' when the slot is free
+    char        username[USERNAME_MAX_LENGTH];
+    time_t      expires;
+} SessionToken;
+
+
+typedef struct session_tokens {
+    pthread_mutex_t     locks[SESSION_TOKEN_STRIPES];
+    SessionToken*       slots;
+    uint32_t            capacity;
+    uint32_t            next;               // next slot handed out
+
+    // metrics
+    uint64_t            issued;
+    uint64_t            resumed;
+    uint64_t            rejected;           // unknown, expired or revoked tokens
+    uint64_t            revoked;
+} SessionTokens;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     initializeSessionTokens(SessionTokens* t, uint32_t capacity);
+void    sessionTokenIssue(SessionTokens* t, const char* username, char* token);
+int     sessionTokenResume(SessionTokens* t, const char* token, char* username);
+void    sessionTokenRevoke(SessionTokens* t, const char* token);
+void    sessionTokensStats(SessionTokens* t, FILE* out);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+initializeSessionTokens(SessionTokens* t, uint32_t capacity)
+{
+    memset(t, 0, sizeof(SessionTokens));
+
+    for (int i = 0; i < SESSION_TOKEN_STRIPES; i++){
+        pthread_mutex_init(&t->locks[i], 0);
+    }
+
+    t->capacity = capacity;
+    t->slots    = (SessionToken*) calloc(capacity, sizeof(SessionToken));
+
+    return t->slots != NULL ? 0 : -1;
+}
+
+
+/**
+ * Slot named by `token`, or -1 if `token` is malformed.
+ */
+static int64_t
+sessionTokenSlot(const SessionTokens* t, const char* token)
+{
+    uint32_t slot = 0;
+
+    if (strlen(token) != SESSION_TOKEN_LENGTH - 1){
+        return -1;
+    }
+    for (int i = 0; i < 8; i++){
+        char c = token[i];
+
+        if      (c >= '0' && c <= '9') slot = (slot << 4) | (uint32_t) (c - '0');
+        else if (c >= 'a' && c <= 'f') slot = (slot << 4) | (uint32_t) (c - 'a' + 10);
+        else return -1;
+    }
+    return slot < t->capacity ? (int64_t) slot : -1;
+}
+
+
+/**
+ * Compare secrets in constant time.
+ */
+static int
+sessionSecretEquals(const char* a, const char* b)
+{
+    unsigned char diff = 0;
+
+    for (int i = 0; i < SESSION_SECRET_LENGTH; i++){
+        diff |= (unsigned char) (a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+
+/**
+ * Issue a token for `username` and write it to `token` (SESSION_TOKEN_LENGTH bytes).
+ */
+void
+sessionTokenIssue(SessionTokens* t, const char* username, char* token)
+{
+    static const char hex[] = "0123456789abcdef";
+    unsigned char     bits[SESSION_SECRET_LENGTH / 2];
+    uint32_t          slot  = __atomic_fetch_add(&t->next, 1, __ATOMIC_RELAXED) % t->capacity;
+    SessionToken*     entry = &t->slots[slot];
+
+    if (getentropy(bits, sizeof(bits)) != 0){
+        for (size_t i = 0; i < sizeof(bits); i++){
+            bits[i] = (unsigned char) randomNext();
+        }
+    }
+
+    snprintf(token, SESSION_TOKEN_LENGTH, "%08x", slot);
+    for (size_t i = 0; i < sizeof(bits); i++){
+        token[8 + 2*i]     = hex[bits[i] >> 4];
+        token[8 + 2*i + 1] = hex[bits[i] & 0xf];
+    }
+    token[SESSION_TOKEN_LENGTH - 1] = '\0';
+
+    /* critical section */
+    MUTEX_LOCK(&t->locks[slot & (SESSION_TOKEN_STRIPES - 1)]);
+        memcpy(entry->secret, token + 8, SESSION_SECRET_LENGTH);
+        memset(entry->username, '\0', sizeof(entry->username));
+        strncpy(entry->username, username, sizeof(entry->username) - 1);
+        entry->expires = time(NULL) + SESSION_TOKEN_TTL;
+    MUTEX_UNLOCK(&t->locks[slot & (SESSION_TOKEN_STRIPES - 1)]);
+    /* end critical section */
+
+    __atomic_add_fetch(&t->issued, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Check `token` and copy the user it belongs to into `username` (USERNAME_MAX_LENGTH bytes).
+ * The token stays valid for another SESSION_TOKEN_TTL seconds.
+ * return 0 if OK, -1 if the token is unknown, expired or revoked
+ */
+int
+sessionTokenResume(SessionTokens* t, const char* token, char* username)
+{
+    int64_t slot = sessionTokenSlot(t, token);
+    int     rv   = -1;
+
+    if (slot >= 0){
+        SessionToken* entry = &t->slots[slot];
+        time_t        now   = time(NULL);
+
+        /* critical section */
+        MUTEX_LOCK(&t->locks[slot & (SESSION_TOKEN_STRIPES - 1)]);
+            if (entry->username[0] != '\0' && sessionSecretEquals(entry->secret, token + 8)){
+                if (entry->expires > now){
+                    memcpy(username, entry->username, USERNAME_MAX_LENGTH);
+                    entry->expires = now + SESSION_TOKEN_TTL;
+                    rv = 0;
+                }
+                else {
+                    memset(entry, 0, sizeof(SessionToken));
+                }
+            }
+        MUTEX_UNLOCK(&t->locks[slot & (SESSION_TOKEN_STRIPES - 1)]);
+        /* end critical section */
+    }
+
+    __atomic_add_fetch(rv == 0 ? &t->resumed : &t->rejected, 1, __ATOMIC_RELAXED);
+    return rv;
+}
+
+
+/**
+ * Invalidate `token` (no-op if it's not valid).
+ */
+void
+sessionTokenRevoke(SessionTokens* t, const char* token)
+{
+    int64_t slot = sessionTokenSlot(t, token);
+
+    if (slot < 0){
+        return;
+    }
+
+    SessionToken* entry = &t->slots[slot];
+
+    MUTEX_LOCK(&t->locks[slot & (SESSION_TOKEN_STRIPES - 1)]);
+        if (entry->username[0] != '\0' && sessionSecretEquals(entry->secret, token + 8)){
+            memset(entry, 0, sizeof(SessionToken));
+            __atomic_add_fetch(&t->revoked, 1, __ATOMIC_RELAXED);
+        }
+    MUTEX_UNLOCK(&t->locks[slot & (SESSION_TOKEN_STRIPES - 1)]);
+}
+
+
+void
+sessionTokensStats(SessionTokens* t, FILE* out)
+{
+    fprintf(out, "capacity %u\n",   t->capacity);
+    fprintf(out, "issued %llu\n",   (unsigned long long) __atomic_load_n(&t->issued, __ATOMIC_RELAXED));
+    fprintf(out, "resumed %llu\n",  (unsigned long long) __atomic_load_n(&t->resumed, __ATOMIC_RELAXED));
+    fprintf(out, "rejected %llu\n", (unsigned long long) __atomic_load_n(&t->rejected, __ATOMIC_RELAXED));
+    fprintf(out, "revoked %llu\n",  (unsigned long long) __atomic_load_n(&t->revoked, __ATOMIC_RELAXED));
+}
+
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * @name            hotel-booking
+ * @file            Snapshot.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Thu Oct 22 11:48:16 CEST 2026
+ * @brief           binary snapshot of the live bookings
+ *
+ *
+ * The in-memory indexes (occupancy, reservation codes, quota) are all
+ * derived from the set of live bookings. A snapshot stores that set as
+ * fixed-width records, together with the storage cursor it corresponds to,
+ * so at startup the server maps the snapshot, indexes it and only asks the
+ * storage for what changed after the cursor (Storage.tail).
+ *
+ * Snapshots are taken in the background (snapshotTake()): the storage
+ * provides a consistent copy without holding up request threads, the file
+ * is written aside and renamed over the previous one.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "Storage.h"
+
+
+#define SNAPSHOT_MAGIC      "HBSNAP01"
+
+
+typedef struct snapshot_record {
+    int64_t     id;
+    uint32_t    hotel;
+    int32_t     day;
+    int32_t     room;
+    char        username[USERNAME_MAX_LENGTH];
+    char        code[RESERVATION_CODE_LENGTH];
+} SnapshotRecord;
+
+
+typedef struct snapshot_header {
+    char            magic[8];
+    uint32_t        record_size;
+    uint32_t        engine;         // STORAGE_ENGINE that wrote it
+    uint64_t        count;
+    uint32_t        checksum;       // of the records
+    uint32_t        reserved;
+    StorageCursor   cursor;
+} SnapshotHeader;
+
+
+typedef struct snapshot {
+    void*                   map;
+    size_t                  size;
+    const SnapshotHeader*   header;
+    const SnapshotRecord*   records;
+} Snapshot;
+
+
+typedef struct snapshot_builder {
+    SnapshotRecord*     records;
+    uint64_t            count;
+    uint64_t            capacity;
+    int                 failed;         // out of memory
+} SnapshotBuilder;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     snapshotTake(const Storage* storage, int thread_index, const char* path, StorageCursor* cursor);
+int     snapshotOpen(const char* path, Snapshot* snapshot);
+void    snapshotBooking(const Snapshot* snapshot, uint64_t i, StoredBooking* booking);
+void    snapshotClose(Snapshot* snapshot);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static uint32_t
+snapshotChecksum(const void* data, size_t size)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    uint32_t h = 2166136261u;   // FNV-1a
+
+    for (size_t i = 0; i < size; i++){
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+
+static int
+snapshotCollect(const StoredBooking* b, void* payload)
+{
+    SnapshotBuilder* builder = (SnapshotBuilder*) payload;
+    SnapshotRecord*  r;
+
+    if (builder->count == builder->capacity){
+        uint64_t        capacity = builder->capacity ? 2 * builder->capacity : 4096;
+        SnapshotRecord* grown    = (SnapshotRecord*) realloc(builder->records, capacity * sizeof(SnapshotRecord));
+
+        if (grown == NULL){
+            builder->failed = 1;
+            return 1;   // stops the scan
+        }
+        builder->records  = grown;
+        builder->capacity = capacity;
+    }
+
+    r = &builder->records[builder->count++];
+    memset(r, '\0', sizeof(SnapshotRecord));
+    r->id    = b->id;
+    r->hotel = b->hotel;
+    r->day   = b->day;
+    r->room  = b->room;
+    memcpy(r->username, b->username, sizeof(r->username));
+    memcpy(r->code,     b->code,     sizeof(r->code));
+
+    return 0;
+}
+
+
+/**
+ * Write a snapshot of the live bookings of `storage` to `path`.
+ * return 0 if OK (`cursor` is the position it was taken at), -1 otherwise
+ */
+int
+snapshotTake(const Storage* storage, int thread_index, const char* path, StorageCursor* cursor)
+{
+    SnapshotBuilder builder = { NULL, 0, 0, 0 };
+    SnapshotHeader  header;
+    char            tmp_path[64];
+    int             rv = -1;
+
+    memset(&header, '\0', sizeof(header));
+
+    if (storage->snapshot(thread_index, snapshotCollect, &builder, &header.cursor) != 0 || builder.failed){
+        free(builder.records);
+        return -1;
+    }
+
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(SnapshotRecord);
+    header.engine      = STORAGE_ENGINE;
+    header.count       = builder.count;
+    header.checksum    = snapshotChecksum(builder.records, builder.count * sizeof(SnapshotRecord));
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* out = fopen(tmp_path, "wb");
+    if (out != NULL){
+        if (fwrite(&header, sizeof(header), 1, out) == 1 &&
+            fwrite(builder.records, sizeof(SnapshotRecord), builder.count, out) == builder.count &&
+            fflush(out) == 0 && fsync(fileno(out)) == 0){
+            rv = 0;
+        }
+        fclose(out);
+    }
+    if (rv == 0){
+        rv = rename(tmp_path, path);
+    }
+    if (rv != 0){
+        unlink(tmp_path);
+    }
+
+    free(builder.records);
+
+    *cursor = header.cursor;
+    return rv;
+}
+
+
+/**
+ * Map the snapshot at `path` and check it's whole.
+ * return 0 if OK, -1 if there's no usable snapshot
+ */
+int
+snapshotOpen(const char* path, Snapshot* snapshot)
+{
+    struct stat st;
+
+    memset(snapshot, 0, sizeof(Snapshot));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SnapshotHeader)){
+        close(fd);
+        return -1;
+    }
+
+    snapshot->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (snapshot->map == MAP_FAILED){
+        snapshot->map = NULL;
+        return -1;
+    }
+    snapshot->size    = st.st_size;
+    snapshot->header  = (const SnapshotHeader*) snapshot->map;
+    snapshot->records = (const SnapshotRecord*) ((const char*) snapshot->map + sizeof(SnapshotHeader));
+
+    const SnapshotHeader* h = snapshot->header;
+
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+        h->record_size != sizeof(SnapshotRecord) ||
+        h->engine != STORAGE_ENGINE ||
+        snapshot->size != sizeof(SnapshotHeader) + h->count * sizeof(SnapshotRecord) ||
+        h->checksum != snapshotChecksum(snapshot->records, h->count * sizeof(SnapshotRecord))){
+        snapshotClose(snapshot);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Copy the `i`-th booking of the snapshot into `booking`.
+ */
+void
+snapshotBooking(const Snapshot* snapshot, uint64_t i, StoredBooking* booking)
+{
+    const SnapshotRecord* r = &snapshot->records[i];
+
+    memset(booking, '\0', sizeof(StoredBooking));
+    booking->id    = r->id;
+    booking->hotel = r->hotel;
+    booking->day   = r->day;
+    booking->room  = r->room;
+    memcpy(booking->username, r->username, sizeof(booking->username) - 1);
+    memcpy(booking->code,     r->code,     sizeof(booking->code) - 1);
+}
+
+
+void
+snapshotClose(Snapshot* snapshot)
+{
+    if (snapshot->map != NULL){
+        munmap(snapshot->map, snapshot->size);
+    }
+    memset(snapshot, 0, sizeof(Snapshot));
+}
+
+
+#endif
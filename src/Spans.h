@@ -0,0 +1,276 @@
+/**
+ * @name            hotel-booking
+ * @file            Spans.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sun Nov  1 10:41:12 CET 2026
+ * @brief           timed spans of the request path, dumped as a Chrome trace
+ *
+ *
+ * Built with SPAN_TRACING, the server times every FSM state a session goes
+ * through, every storage call, crypt() and every socket operation, each as
+ * a span: what, when, how long, for which session. Every thread records its
+ * spans into a buffer of its own (no lock, no syscall but clock_gettime()),
+ * keeping the last SPAN_BUFFER_EVENTS. On SIGUSR2 the spans thread writes
+ * the buffers of all the threads to DATA_FOLDER/SPANS_FILE_NAME in the
+ * Chrome trace event format:
+ *
+ *      kill -USR2 <server pid>     then open .data/spans.json in
+ *                                  chrome://tracing or https://ui.perfetto.dev
+ *
+ * Spans nest as they're timed: a worker's `step` holds the states the
+ * session went through, a state holds the storage calls it made. Without
+ * SPAN_TRACING the SPAN_* macros are empty: nothing is timed or stored.
+ */
+
+#ifndef SPANS_H
+#define SPANS_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+
+
+#if SPAN_TRACING
+    #define SPAN_THREAD(name, index)            spanThread(name, index)
+    #define SPAN_BEGIN(span)                    uint64_t span = spanNow()
+    #define SPAN_END(span, cat, name, session)  spanRecord(cat, name, span, session)
+#else
+    #define SPAN_THREAD(name, index)
+    #define SPAN_BEGIN(span)
+    #define SPAN_END(span, cat, name, session)
+#endif
+
+
+typedef struct span_event {
+    const char*     cat;                // "fsm", "storage", "socket"... string literals only
+    const char*     name;
+    uint64_t        start;              // us, monotonic
+    uint32_t        duration;           // us
+    uint32_t        session;            // 0 if not about a session
+} SpanEvent;
+
+
+typedef struct span_buffer {
+    char            name[24];           // thread name in the trace
+    uint64_t        recorded;           // spans so far, the last SPAN_BUFFER_EVENTS are in `events`
+    SpanEvent       events[SPAN_BUFFER_EVENTS];
+} SpanBuffer;
+
+
+typedef struct spans {
+    pthread_mutex_t lock;               // taken to add a thread only
+    SpanBuffer*     buffers[SPAN_MAX_THREADS];
+    int             count;
+    char            path[64];
+} Spans;
+
+
+static Spans                    spans_g = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static __thread SpanBuffer*     span_buffer_tls;
+static volatile sig_atomic_t    spans_requested_g;  // set by SIGUSR2
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+void        spanThread(const char* name, int index);
+void        spanRecord(const char* cat, const char* name, uint64_t start, uint32_t session);
+int         spansDump(void);
+void        spansSignalHandler(int signo);
+void*       spansThread(void* path);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline uint64_t
+spanNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+/**
+ * Give the calling thread its buffer, named `name` `index` (index < 0: just `name`).
+ * Threads that don't call it get one, "thread <n>", with their first span.
+ */
+void
+spanThread(const char* name, int index)
+{
+    SpanBuffer* b = span_buffer_tls;
+
+    if (b == NULL){
+        b = (SpanBuffer*) calloc(1, sizeof(SpanBuffer));
+        if (b == NULL){
+            return;
+        }
+
+        pthread_mutex_lock(&spans_g.lock);
+            if (spans_g.count == SPAN_MAX_THREADS){
+                free(b);
+                b = NULL;
+            }
+            else {
+                spans_g.buffers[spans_g.count] = b;
+                snprintf(b->name, sizeof(b->name), "thread %d", spans_g.count);
+                __atomic_store_n(&spans_g.count, spans_g.count + 1, __ATOMIC_RELEASE);
+            }
+        pthread_mutex_unlock(&spans_g.lock);
+
+        if (b == NULL){
+            return;
+        }
+        span_buffer_tls = b;
+    }
+
+    if (name != NULL){
+        if (index >= 0){
+            snprintf(b->name, sizeof(b->name), "%s %d", name, index);
+        }
+        else {
+            snprintf(b->name, sizeof(b->name), "%s", name);
+        }
+    }
+}
+
+
+/**
+ * Record a span that started at `start` and ends now. The oldest is overwritten when the buffer is full.
+ */
+void
+spanRecord(const char* cat, const char* name, uint64_t start, uint32_t session)
+{
+    SpanBuffer* b = span_buffer_tls;
+
+    if (b == NULL){
+        spanThread(NULL, -1);
+        if ((b = span_buffer_tls) == NULL){
+            return;
+        }
+    }
+
+    SpanEvent* e = &b->events[b->recorded % SPAN_BUFFER_EVENTS];
+
+    e->cat      = cat;
+    e->name     = name;
+    e->start    = start;
+    e->duration = (uint32_t) (spanNow() - start);
+    e->session  = session;
+
+    // the dumping thread reads up to `recorded`
+    __atomic_store_n(&b->recorded, b->recorded + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Write the spans of every thread to a temporary file and rename it over the previous dump.
+ * The threads go on recording meanwhile: spans they overwrite while being copied are left out.
+ * return 0 if OK, -1 otherwise
+ */
+int
+spansDump(void)
+{
+    char       tmp_path[sizeof(spans_g.path) + 4];
+    int        count = __atomic_load_n(&spans_g.count, __ATOMIC_ACQUIRE);
+    int        first = 1;
+    SpanEvent* copy  = (SpanEvent*) malloc(SPAN_BUFFER_EVENTS * sizeof(SpanEvent));
+
+    if (copy == NULL){
+        return -1;
+    }
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", spans_g.path);
+
+    FILE* out = fopen(tmp_path, "w");
+    if (out == NULL){
+        free(copy);
+        return -1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (int t = 0; t < count; t++){
+        SpanBuffer* b     = spans_g.buffers[t];
+        uint64_t    end   = __atomic_load_n(&b->recorded, __ATOMIC_ACQUIRE);
+        uint64_t    from  = end > SPAN_BUFFER_EVENTS ? end - SPAN_BUFFER_EVENTS : 0;
+        uint64_t    begin = from;
+        uint64_t    now;
+
+        for (uint64_t i = from; i < end; i++){
+            copy[i - from] = b->events[i % SPAN_BUFFER_EVENTS];
+        }
+
+        // the oldest ones may have been overwritten while copying
+        now = __atomic_load_n(&b->recorded, __ATOMIC_ACQUIRE);
+        if (now > SPAN_BUFFER_EVENTS && now - SPAN_BUFFER_EVENTS > begin){
+            begin = now - SPAN_BUFFER_EVENTS < end ? now - SPAN_BUFFER_EVENTS : end;
+        }
+
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", t, b->name);
+        first = 0;
+
+        for (uint64_t i = begin; i < end; i++){
+            const SpanEvent* e = &copy[i - from];
+
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%u,\"args\":{\"session\":%u}}",
+                    e->name, e->cat, t, (unsigned long long) e->start, e->duration, e->session);
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    free(copy);
+
+    return rename(tmp_path, spans_g.path);
+}
+
+
+void
+spansSignalHandler(int signo)
+{
+    spans_requested_g = 1;
+}
+
+
+/**
+ * Spans thread body. `path` is the dump file.
+ */
+void*
+spansThread(void* path)
+{
+    strncpy(spans_g.path, (const char*) path, sizeof(spans_g.path) - 1);
+    signal(SIGUSR2, spansSignalHandler);
+
+    while (1)
+    {
+        sleep(1);
+
+        if (spans_requested_g){
+            spans_requested_g = 0;
+
+            if (spansDump() != 0){
+                perror("spans dump");
+            }
+            #if DEBUG
+                else {
+                    printf("SPANS: dumped to %s\n", spans_g.path);
+                }
+            #endif
+        }
+    }
+
+    return NULL;
+}
+
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @name            hotel-booking
+ * @file            Storage.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Wed Oct 21 16:25:08 CEST 2026
+ * @brief           storage engine interface
+ *
+ *
+ * The server stores bookings through a Storage, picked at compile time
+ * with STORAGE_ENGINE (see `config.h`):
+ *      STORAGE_SQLITE      SQLite database (`server.c`)
+ *      STORAGE_JOURNAL     memory-mapped append-only journal (`Journal.h`)
+ *
+ * Every booking has a numeric id, assigned by the engine when it's stored
+ * and used to remove it, and belongs to a hotel: bookings stored before
+ * hotels had an ID belong to HOTEL_ID_DEFAULT. The in-memory indexes (occupancy, codes, quota)
+ * are warmed up at startup from a snapshot (see `Snapshot.h`) plus the
+ * changes made after it, or by scanning every live booking.
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "Calendar.h"
+
+
+#define STORAGE_SQLITE      0
+#define STORAGE_JOURNAL     1
+
+
+typedef struct stored_booking {
+    int64_t     id;
+    uint32_t    hotel;          // hotel ID, part of the booking key with user, day and room
+    char        username[USERNAME_MAX_LENGTH];
+    day_t       day;
+    int         room;
+    char        code[RESERVATION_CODE_LENGTH];
+} StoredBooking;
+
+
+/**
+ * Called once per booking by Storage.scan; returning !0 stops the scan.
+ */
+typedef int (*storage_visit_t)(const StoredBooking* booking, void* payload);
+
+
+/**
+ * A point in the history of the storage, meaningful to the engine that returned it.
+ */
+typedef struct storage_cursor {
+    int64_t     generation;     // changes when the engine rewrites its history (journal compaction)
+    int64_t     position;       // changes recorded up to here
+    int64_t     max_id;         // highest booking id up to here
+} StorageCursor;
+
+
+typedef struct storage {
+    const char*     name;
+
+    /** open (creating it if needed) the storage at `path`. return 0 if OK */
+    int             (*open)(const char* path);
+
+    /** visit the live bookings of `username` (every user if NULL) in id order. return 0 if OK */
+    int             (*scan)(int thread_index, const char* username, storage_visit_t visit, void* payload);
+
+    /** store `booking`, setting its id. return 0 if OK */
+    int             (*insert)(int thread_index, StoredBooking* booking);
+
+    /** remove booking `id`. return 0 if removed, 1 if there's no such booking, -1 on error */
+    int             (*remove)(int thread_index, int64_t id);
+
+    /** visit every live booking and set `cursor` to the point the visit reflects,
+     *  without holding up writers for long. return 0 if OK */
+    int             (*snapshot)(int thread_index, storage_visit_t visit, void* payload, StorageCursor* cursor);
+
+    /** visit, in order, the bookings stored (`inserted`) and removed (`removed`) after `since`.
+     *  return 0 if OK, 1 (before visiting anything) if `since` is no longer valid, -1 on error */
+    int             (*tail)(int thread_index, const StorageCursor* since,
+                            storage_visit_t inserted, storage_visit_t removed, void* payload);
+
+    /** a snapshot at `cursor` is safely on disk: history before it may be dropped */
+    void            (*checkpoint)(int thread_index, const StorageCursor* cursor);
+
+    /** `storage` section of the metrics report */
+    void            (*stats)(FILE* out);
+} Storage;
+
+
+#endif
@@ -0,0 +1,230 @@
+/**
+ * @name            hotel-booking
+ * @file            TrafficTrace.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sat Oct 31 10:22:37 CET 2026
+ * @brief           recording of the client traffic of a server, replayed by `replay.c`
+ *
+ *
+ * With `--record <file>` the server appends to a binary trace every frame a
+ * client sends, as it arrives, with the microsecond it arrived at and the
+ * session it came from. Sessions opening and closing are recorded too, so
+ * the trace holds the interleaving of all the sessions.
+ *
+ * Reservation codes and session tokens are random: the server running the
+ * replay hands out different ones. The trace records which reply frame of
+ * the session carried each (TRACE_ISSUED), so the replay can swap the
+ * recorded values the clients sent back (`release`, `resume`) for the ones
+ * its server handed out.
+ *
+ * File: TRAFFIC_TRACE_MAGIC, the wall clock time the recording started (8
+ * bytes), then the records: a TrafficRecord followed by `length` bytes of
+ * payload. Host byte order, read on the machine that wrote it.
+ *
+ * One lock for all the threads: a record is a buffered fwrite(), flushed
+ * once TRAFFIC_TRACE_FLUSH_MS have passed or a session closes, so a server
+ * stopped with no client connected leaves a complete trace.
+ */
+
+#ifndef TRAFFIC_TRACE_H
+#define TRAFFIC_TRACE_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "LockProfile.h"
+
+
+#define TRAFFIC_TRACE_MAGIC     "HOTELTR1"
+
+
+typedef enum {
+    TRACE_OPEN = 1,         // session accepted, no payload
+    TRACE_FRAME,            // frame received, payload: the frame (without its length)
+    TRACE_ISSUED,           // code or token handed out, payload: index of the reply frame carrying it (uint32_t), then the value
+    TRACE_CLOSE             // session closed, no payload
+} trace_kind_t;
+
+
+typedef struct traffic_record {
+    uint64_t        time;           // us since the recording started
+    uint32_t        session;
+    uint16_t        kind;           // trace_kind_t
+    uint16_t        length;         // bytes of payload
+} TrafficRecord;
+
+
+typedef struct traffic_trace {
+    pthread_mutex_t lock;
+    FILE*           file;           // NULL: not recording
+    uint64_t        start;          // monotonic us the recording started at
+    uint64_t        flushed;        // monotonic us of the last fflush()
+
+    // metrics
+    uint64_t        records;
+    uint64_t        bytes;
+    uint64_t        errors;         // records lost (disk full...)
+} TrafficTrace;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int         trafficTraceOpen(TrafficTrace* t, const char* path);
+void        trafficTraceRecord(TrafficTrace* t, uint32_t session, trace_kind_t kind, const void* data, uint32_t length);
+void        trafficTraceIssued(TrafficTrace* t, uint32_t session, uint32_t frame, const char* value);
+void        trafficTraceStats(TrafficTrace* t, FILE* out);
+int         trafficTraceRead(FILE* in, TrafficRecord* r, char* data, uint32_t size);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline uint64_t
+trafficTraceNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+/**
+ * Start recording to `path` (truncated), before the threads serving sessions start.
+ * return 0 if OK, -1 otherwise
+ */
+int
+trafficTraceOpen(TrafficTrace* t, const char* path)
+{
+    uint64_t wall = (uint64_t) time(NULL);
+
+    memset(t, 0, sizeof(TrafficTrace));
+    pthread_mutex_init(&t->lock, 0);
+
+    // every frame verbatim, passwords and session tokens too: only the server's user can read it
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+    t->file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (t->file == NULL){
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if (fwrite(TRAFFIC_TRACE_MAGIC, 1, 8, t->file) != 8 || fwrite(&wall, sizeof(wall), 1, t->file) != 1){
+        fclose(t->file);
+        t->file = NULL;
+        return -1;
+    }
+    t->start   = trafficTraceNow();
+    t->flushed = t->start;
+    return 0;
+}
+
+
+/**
+ * Append a record, unless not recording. Payloads longer than 64 KiB are cut.
+ */
+void
+trafficTraceRecord(TrafficTrace* t, uint32_t session, trace_kind_t kind, const void* data, uint32_t length)
+{
+    TrafficRecord r;
+
+    if (t->file == NULL){
+        return;
+    }
+
+    r.session = session;
+    r.kind    = (uint16_t) kind;
+    r.length  = (uint16_t) (length < UINT16_MAX ? length : UINT16_MAX);
+
+    /* critical section */
+    MUTEX_LOCK(&t->lock);
+
+        // taken under the lock: records are in time order
+        uint64_t now = trafficTraceNow();
+
+        r.time = now - t->start;
+
+        if (fwrite(&r, sizeof(r), 1, t->file) == 1 && fwrite(data, 1, r.length, t->file) == r.length){
+            t->records++;
+            t->bytes += sizeof(r) + r.length;
+        }
+        else {
+            t->errors++;
+        }
+
+        if (kind == TRACE_CLOSE || now - t->flushed >= TRAFFIC_TRACE_FLUSH_MS * 1000){
+            fflush(t->file);
+            t->flushed = now;
+        }
+
+    MUTEX_UNLOCK(&t->lock);
+    /* end critical section */
+}
+
+
+/**
+ * Record that `value` is handed out as reply frame `frame` of the session (0 is its first).
+ */
+void
+trafficTraceIssued(TrafficTrace* t, uint32_t session, uint32_t frame, const char* value)
+{
+    char     data[sizeof(uint32_t) + SESSION_INPUT_SIZE];
+    uint32_t length = (uint32_t) strlen(value);
+
+    if (t->file == NULL){
+        return;
+    }
+    if (length > SESSION_INPUT_SIZE){
+        length = SESSION_INPUT_SIZE;
+    }
+
+    memcpy(data, &frame, sizeof(frame));
+    memcpy(data + sizeof(frame), value, length);
+    trafficTraceRecord(t, session, TRACE_ISSUED, data, sizeof(frame) + length);
+}
+
+
+void
+trafficTraceStats(TrafficTrace* t, FILE* out)
+{
+    MUTEX_LOCK(&t->lock);
+        fprintf(out, "records %llu\n", (unsigned long long) t->records);
+        fprintf(out, "bytes %llu\n",   (unsigned long long) t->bytes);
+        fprintf(out, "errors %llu\n",  (unsigned long long) t->errors);
+    MUTEX_UNLOCK(&t->lock);
+}
+
+
+/**
+ * Read the next record of a trace (past its header), its payload NUL-terminated
+ * into `data` (cut to `size` - 1).
+ * return 0 if OK, 1 at the end of the trace, -1 if it's corrupted
+ */
+int
+trafficTraceRead(FILE* in, TrafficRecord* r, char* data, uint32_t size)
+{
+    uint32_t kept;
+
+    if (fread(r, sizeof(TrafficRecord), 1, in) != 1){
+        return feof(in) ? 1 : -1;
+    }
+    if (r->kind < TRACE_OPEN || r->kind > TRACE_CLOSE){
+        return -1;
+    }
+
+    kept = r->length < size - 1 ? r->length : size - 1;
+    if (fread(data, 1, kept, in) != kept || fseek(in, r->length - kept, SEEK_CUR) != 0){
+        return -1;
+    }
+    data[kept] = '\0';
+    return 0;
+}
+
+
+#endif
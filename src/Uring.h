@@ -0,0 +1,354 @@
+/**
+ * @name            hotel-booking
+ * @file            Uring.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sun Oct 25 10:14:09 CEST 2026
+ * @brief           minimal io_uring, straight on the system calls
+ *
+ *
+ * Just what the session event loops need (see `EventLoop.h`): set up a
+ * ring, fill submission entries (accept, recv, send), submit them and
+ * wait for completions with a single io_uring_enter(), walk the
+ * completions. No liburing needed, only the kernel headers.
+ *
+ * Only on Linux (and only if the kernel lets us create a ring): anywhere
+ * else uringInit() fails and the caller falls back to epoll/kqueue.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+    #include <errno.h>
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>     // MSG_NOSIGNAL
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+
+#ifdef __linux__
+
+
+typedef struct uring {
+    int                     fd;
+
+    // submission queue
+    unsigned*               sq_head;
+    unsigned*               sq_tail;
+    unsigned*               sq_mask;
+    unsigned*               sq_array;
+    struct io_uring_sqe*    sqes;
+    unsigned                sq_local_tail;      // entries filled, published by uringEnter()
+
+    // completion queue
+    unsigned*               cq_head;
+    unsigned*               cq_tail;
+    unsigned*               cq_mask;
+    struct io_uring_cqe*    cqes;
+
+    void*                   ring_map;
+    size_t                  ring_map_size;
+    size_t                  sqes_size;
+
+    uint64_t                enters;             // io_uring_enter() calls
+} Uring;
+
+
+#else
+
+typedef struct uring {
+    int                     fd;
+} Uring;
+
+#endif
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int     uringInit(Uring* ring, unsigned entries);
+void    uringExit(Uring* ring);
+int     uringEnter(Uring* ring, unsigned wait);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+#ifdef __linux__
+
+
+/**
+ * Create a ring with `entries` submission entries.
+ * return 0 if OK, -1 if io_uring isn't available
+ */
+int
+uringInit(Uring* ring, unsigned entries)
+{
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(Uring));
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP;
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0){
+        return -1;
+    }
+
+    // one mapping for both rings (every kernel with the opcodes we use has it)
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)){
+        close(ring->fd);
+        return -1;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    ring->ring_map_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_map      = mmap(NULL, ring->ring_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->sqes_size     = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes          = (struct io_uring_sqe*) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (ring->ring_map == MAP_FAILED || ring->sqes == MAP_FAILED){
+        if (ring->ring_map != MAP_FAILED) munmap(ring->ring_map, ring->ring_map_size);
+        if (ring->sqes != MAP_FAILED)     munmap(ring->sqes, ring->sqes_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char* m = (char*) ring->ring_map;
+
+    ring->sq_head  = (unsigned*) (m + p.sq_off.head);
+    ring->sq_tail  = (unsigned*) (m + p.sq_off.tail);
+    ring->sq_mask  = (unsigned*) (m + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (m + p.sq_off.array);
+    ring->cq_head  = (unsigned*) (m + p.cq_off.head);
+    ring->cq_tail  = (unsigned*) (m + p.cq_off.tail);
+    ring->cq_mask  = (unsigned*) (m + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*) (m + p.cq_off.cqes);
+
+    ring->sq_local_tail = *ring->sq_tail;
+
+    return 0;
+}
+
+
+void
+uringExit(Uring* ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->ring_map, ring->ring_map_size);
+    close(ring->fd);
+}
+
+
+/**
+ * Submit what was filled so far and wait for at least `wait` completions.
+ * return 0 if OK, -1 on error
+ */
+int
+uringEnter(Uring* ring, unsigned wait)
+{
+    unsigned submit = ring->sq_local_tail - *ring->sq_tail;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    while (1){
+        ring->enters++;
+
+        long rv = syscall(__NR_io_uring_enter, ring->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+        if (rv >= 0){
+            return 0;
+        }
+        if (errno != EINTR){
+            return -1;
+        }
+        submit = 0;     // consumed before the signal, if at all: the kernel keeps track of them
+    }
+}
+
+
+/**
+ * Make room for `count` submission entries, submitting the queued ones first if the queue can't take them.
+ * return 0 if OK, -1 if there's still no room: errno is the one of io_uring_enter(),
+ *        or EBUSY if the kernel took none of the queued entries
+ */
+static inline int
+uringReserve(Uring* ring, unsigned count)
+{
+    unsigned entries = *ring->sq_mask + 1;
+
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) + count <= entries){
+        return 0;
+    }
+    if (uringEnter(ring, 0) != 0){
+        return -1;
+    }
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) + count > entries){
+        errno = EBUSY;
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * return an empty submission entry, submitting the queued ones first if the queue is full,
+ *        NULL if there's none (errno set by uringReserve())
+ */
+static inline struct io_uring_sqe*
+uringSqe(Uring* ring)
+{
+    if (uringReserve(ring, 1) != 0){
+        return NULL;
+    }
+
+    unsigned             i   = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[i] = i;
+    ring->sq_local_tail++;
+
+    return sqe;
+}
+
+
+/**
+ * return the oldest completion not seen yet, NULL if there's none
+ */
+static inline struct io_uring_cqe*
+uringPeek(Uring* ring)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)){
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+
+/**
+ * return the number of completions not seen yet
+ */
+static inline unsigned
+uringReady(Uring* ring)
+{
+    return __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head;
+}
+
+
+/**
+ * Mark the completion returned by uringPeek() as consumed.
+ */
+static inline void
+uringSeen(Uring* ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * The entry makers below return 0 if queued, -1 if the submission queue has
+ * no room (see uringSqe()).
+ */
+
+
+/**
+ * `multishot`: one completion per connection (IORING_CQE_F_MORE set) until
+ * an error, rather than one connection only. Needs Linux 5.19.
+ */
+static inline int
+uringAccept(Uring* ring, int fd, uint64_t user_data, int multishot)
+{
+    struct io_uring_sqe* sqe = uringSqe(ring);
+
+    if (sqe == NULL){
+        return -1;
+    }
+    sqe->opcode    = IORING_OP_ACCEPT;
+    sqe->fd        = fd;
+    sqe->ioprio    = multishot ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+
+static inline int
+uringRecv(Uring* ring, int fd, void* buf, unsigned len, uint64_t user_data)
+{
+    struct io_uring_sqe* sqe = uringSqe(ring);
+
+    if (sqe == NULL){
+        return -1;
+    }
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t) (uintptr_t) buf;
+    sqe->len       = len;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+
+/**
+ * `link`: the next entry starts only once this one is done. The caller
+ * makes room for both first (uringReserve()): a link to nothing fails.
+ */
+static inline int
+uringSend(Uring* ring, int fd, const void* buf, unsigned len, uint64_t user_data, int link)
+{
+    struct io_uring_sqe* sqe = uringSqe(ring);
+
+    if (sqe == NULL){
+        return -1;
+    }
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t) (uintptr_t) buf;
+    sqe->len       = len;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;    // the kernel retries short sends, which would break the link
+    sqe->flags     = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+
+#else
+
+
+int
+uringInit(Uring* ring, unsigned entries)
+{
+    (void) entries;
+    ring->fd = -1;
+    return -1;
+}
+
+
+void
+uringExit(Uring* ring)
+{
+    (void) ring;
+}
+
+
+int
+uringEnter(Uring* ring, unsigned wait)
+{
+    (void) ring;
+    (void) wait;
+    return -1;
+}
+
+
+#endif
+
+
+#endif
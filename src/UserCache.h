@@ -0,0 +1,404 @@
+/**
+ * @name            hotel-booking
+ * @file            UserCache.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Tue Oct 20 09:37:12 CEST 2026
+ * @brief           per-user reservation cache serving `view`
+ *
+ *
+ * Keeps, for the most recently active users, the list of their bookings
+ * already sorted the way `view` shows them (see SORT_VIEW_BY_DATE), so
+ * the view response is rendered straight into the output frame.
+ * Reserve and release update the cached list of the user in place.
+ * At most USER_CACHE_MAX_USERS users are cached: the least recently used
+ * one is evicted to make room for a new one.
+ *
+ * An entry is created empty (`valid == 0`) on a miss; the caller then loads
+ * the bookings from the database and hands them over with userCacheFill(),
+ * together with the generation the miss returned. Every update bumps the
+ * generation of the entry: a fill whose load started before an update is
+ * discarded, so a stale list is never published, however many loads of the
+ * same user overlap.
+ */
+
+#ifndef USER_CACHE_H
+#define USER_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "utils.h"      // hashString()
+#include "Calendar.h"
+
+
+#define USER_CACHE_BUCKETS      1024    // power of 2
+
+
+typedef struct cached_booking {
+    day_t       day;
+    int         room;
+    uint32_t    hotel;
+    char        code[RESERVATION_CODE_LENGTH];
+} CachedBooking;
+
+
+typedef struct user_cache_entry {
+    char                        username[USERNAME_MAX_LENGTH];
+    int                         valid;          // bookings loaded
+    uint64_t                    generation;     // bumped by every update, and new for every entry
+    int                         count;
+    int                         capacity;
+    CachedBooking*              bookings;       // sorted as shown by `view`
+    struct user_cache_entry*    hash_next;
+    struct user_cache_entry*    lru_prev;
+    struct user_cache_entry*    lru_next;
+} UserCacheEntry;
+
+
+typedef struct user_cache {
+    pthread_mutex_t     lock;
+    UserCacheEntry*     buckets[USER_CACHE_BUCKETS];
+    UserCacheEntry      lru;                    // sentinel: lru.lru_next is the most recently used
+    int                 users;
+    int                 max_users;
+    uint64_t            generation;             // last one handed to an entry
+
+    // metrics
+    uint64_t            hits;
+    uint64_t            misses;
+    uint64_t            evictions;
+    size_t              bytes;
+} UserCache;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+void    initializeUserCache(UserCache* c, int max_users);
+int     renderCachedBookings(const CachedBooking* bookings, int n, uint32_t hotel, char* out, size_t size);
+int     userCacheRender(UserCache* c, const char* username, uint32_t hotel, char* out, size_t size, uint64_t* generation);
+int     userCacheFill(UserCache* c, const char* username, uint64_t generation, const CachedBooking* bookings, int n);
+void    userCacheAdd(UserCache* c, const char* username, const CachedBooking* booking);
+void    userCacheRemove(UserCache* c, const char* username, uint32_t hotel, day_t day, int room);
+void    userCacheStats(UserCache* c, FILE* out);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+void
+initializeUserCache(UserCache* c, int max_users)
+{
+    memset(c, 0, sizeof(UserCache));
+    pthread_mutex_init(&c->lock, 0);
+    c->lru.lru_next = c->lru.lru_prev = &c->lru;
+    c->max_users = max_users;
+}
+
+
+/**
+ * Render the bookings in `hotel` among `bookings` into `out`, one per line
+ * (`dd/mm/yyyy room code`, no trailing new line).
+ * return number of bookings rendered
+ */
+int
+renderCachedBookings(const CachedBooking* bookings, int n, uint32_t hotel, char* out, size_t size)
+{
+    char   date[DATE_STRING_LENGTH];
+    size_t len = 0;
+    int    rendered = 0;
+
+    out[0] = '\0';
+    for (int i = 0; i < n && len < size; i++){
+        if (bookings[i].hotel != hotel){
+            continue;
+        }
+        formatDate(bookings[i].day, date);
+        len += snprintf(out + len, size - len, "%s%s %d     %s",
+                        rendered++ ? "\n" : "", date, bookings[i].room, bookings[i].code);
+    }
+    return rendered;
+}
+
+
+static inline int
+compareCachedBookings(const CachedBooking* a, const CachedBooking* b)
+{
+    #if SORT_VIEW_BY_DATE
+        if (a->day != b->day){
+            return a->day < b->day ? -1 : 1;
+        }
+        return a->room - b->room;
+    #else
+        return 0;   // order of reservation: new bookings go last
+    #endif
+}
+
+
+static inline void
+lruUnlink(UserCacheEntry* e)
+{
+    e->lru_prev->lru_next = e->lru_next;
+    e->lru_next->lru_prev = e->lru_prev;
+}
+
+
+static inline void
+lruPushFront(UserCache* c, UserCacheEntry* e)
+{
+    e->lru_next = c->lru.lru_next;
+    e->lru_prev = &c->lru;
+    c->lru.lru_next->lru_prev = e;
+    c->lru.lru_next = e;
+}
+
+
+/**
+ * Lookup, lock held.
+ */
+static UserCacheEntry*
+userCacheFind(UserCache* c, const char* username)
+{
+    uint32_t bucket = hashString(username) & (USER_CACHE_BUCKETS - 1);
+
+    for (UserCacheEntry* e = c->buckets[bucket]; e != NULL; e = e->hash_next){
+        if (strcmp(e->username, username) == 0){
+            return e;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Drop the least recently used entry, lock held.
+ */
+static void
+userCacheEvict(UserCache* c)
+{
+    UserCacheEntry*  victim = c->lru.lru_prev;
+    UserCacheEntry** link   = &c->buckets[hashString(victim->username) & (USER_CACHE_BUCKETS - 1)];
+
+    if (victim == &c->lru){
+        return;
+    }
+
+    while (*link != victim){
+        link = &(*link)->hash_next;
+    }
+    *link = victim->hash_next;
+    lruUnlink(victim);
+
+    c->bytes -= sizeof(UserCacheEntry) + victim->capacity * sizeof(CachedBooking);
+    c->users--;
+    c->evictions++;
+
+    free(victim->bookings);
+    free(victim);
+}
+
+
+/**
+ * Render the bookings of `username` in `hotel` into `out` (see renderCachedBookings()).
+ * The entry holds the bookings in every hotel. On a miss `generation` is the
+ * one to hand over to userCacheFill() with the bookings loaded.
+ * return number of bookings rendered if the user is cached, -1 on a miss
+ */
+int
+userCacheRender(UserCache* c, const char* username, uint32_t hotel, char* out, size_t size, uint64_t* generation)
+{
+    UserCacheEntry* e;
+    int             n;
+
+    /* critical section */
+    MUTEX_LOCK(&c->lock);
+
+        e = userCacheFind(c, username);
+
+        if (e == NULL || !e->valid){
+            c->misses++;
+
+            if (e == NULL){
+                // placeholder, filled in by userCacheFill()
+                if (c->users >= c->max_users){
+                    userCacheEvict(c);
+                }
+
+                e = (UserCacheEntry*) calloc(1, sizeof(UserCacheEntry));
+                if (e != NULL){
+                    uint32_t bucket = hashString(username) & (USER_CACHE_BUCKETS - 1);
+
+                    strncpy(e->username, username, sizeof(e->username) - 1);
+                    e->generation = ++c->generation;    // fills of an evicted entry don't match it
+                    e->hash_next = c->buckets[bucket];
+                    c->buckets[bucket] = e;
+                    lruPushFront(c, e);
+                    c->users++;
+                    c->bytes += sizeof(UserCacheEntry);
+                }
+            }
+            *generation = e != NULL ? e->generation : 0;
+
+            MUTEX_UNLOCK(&c->lock);
+            return -1;
+        }
+
+        c->hits++;
+        lruUnlink(e);
+        lruPushFront(c, e);
+
+        n = renderCachedBookings(e->bookings, e->count, hotel, out, size);
+
+    MUTEX_UNLOCK(&c->lock);
+    /* end critical section */
+
+    return n;
+}
+
+
+/**
+ * Publish the bookings loaded from the database after a miss.
+ * `generation` is the one userCacheRender() returned on that miss,
+ * `bookings` must be sorted as `view` shows them.
+ * return 0 if published, -1 if discarded (already filled, entry evicted or updated since the miss)
+ */
+int
+userCacheFill(UserCache* c, const char* username, uint64_t generation, const CachedBooking* bookings, int n)
+{
+    UserCacheEntry* e;
+    CachedBooking*  copy = NULL;
+    int             capacity = n > MAX_BOOKINGS_PER_USER ? n : MAX_BOOKINGS_PER_USER;
+    int             rv = -1;
+
+    copy = (CachedBooking*) malloc(capacity * sizeof(CachedBooking));
+    if (copy == NULL){
+        return -1;
+    }
+    memcpy(copy, bookings, n * sizeof(CachedBooking));
+
+    /* critical section */
+    MUTEX_LOCK(&c->lock);
+
+        e = userCacheFind(c, username);
+
+        if (e != NULL && !e->valid && e->generation == generation){
+            e->bookings = copy;
+            e->count    = n;
+            e->capacity = capacity;
+            e->valid    = 1;
+            c->bytes   += capacity * sizeof(CachedBooking);
+            copy = NULL;
+            rv = 0;
+        }
+
+    MUTEX_UNLOCK(&c->lock);
+    /* end critical section */
+
+    free(copy);
+    return rv;
+}
+
+
+/**
+ * Keep the cached list (if any) coherent with a new reservation.
+ */
+void
+userCacheAdd(UserCache* c, const char* username, const CachedBooking* booking)
+{
+    UserCacheEntry* e;
+    int             i;
+
+    /* critical section */
+    MUTEX_LOCK(&c->lock);
+
+        e = userCacheFind(c, username);
+
+        if (e != NULL){
+            e->generation = ++c->generation;    // loads started before this one are stale
+        }
+        if (e != NULL && e->valid){
+            // already there if the database load raced with this reservation
+            for (i = 0; i < e->count; i++){
+                if (e->bookings[i].day == booking->day && e->bookings[i].room == booking->room && e->bookings[i].hotel == booking->hotel){
+                    MUTEX_UNLOCK(&c->lock);
+                    return;
+                }
+            }
+
+            if (e->count == e->capacity){
+                CachedBooking* grown = (CachedBooking*) realloc(e->bookings, 2 * e->capacity * sizeof(CachedBooking));
+                if (grown == NULL){
+                    e->valid = 0;   // reload on next view
+                    MUTEX_UNLOCK(&c->lock);
+                    return;
+                }
+                c->bytes += e->capacity * sizeof(CachedBooking);
+                e->bookings = grown;
+                e->capacity *= 2;
+            }
+
+            // insertion sort step
+            for (i = e->count; i > 0 && compareCachedBookings(&e->bookings[i - 1], booking) > 0; i--){
+                e->bookings[i] = e->bookings[i - 1];
+            }
+            e->bookings[i] = *booking;
+            e->count++;
+        }
+
+    MUTEX_UNLOCK(&c->lock);
+    /* end critical section */
+}
+
+
+/**
+ * Keep the cached list (if any) coherent with a released reservation.
+ */
+void
+userCacheRemove(UserCache* c, const char* username, uint32_t hotel, day_t day, int room)
+{
+    UserCacheEntry* e;
+
+    /* critical section */
+    MUTEX_LOCK(&c->lock);
+
+        e = userCacheFind(c, username);
+
+        if (e != NULL){
+            e->generation = ++c->generation;    // loads started before this one are stale
+        }
+        if (e != NULL && e->valid){
+            for (int i = 0; i < e->count; i++){
+                if (e->bookings[i].day == day && e->bookings[i].room == room && e->bookings[i].hotel == hotel){
+                    memmove(&e->bookings[i], &e->bookings[i + 1], (e->count - i - 1) * sizeof(CachedBooking));
+                    e->count--;
+                    break;
+                }
+            }
+        }
+
+    MUTEX_UNLOCK(&c->lock);
+    /* end critical section */
+}
+
+
+void
+userCacheStats(UserCache* c, FILE* out)
+{
+    MUTEX_LOCK(&c->lock);
+
+        fprintf(out, "users %d\n",      c->users);
+        fprintf(out, "max_users %d\n",  c->max_users);
+        fprintf(out, "hits %llu\n",     (unsigned long long) c->hits);
+        fprintf(out, "misses %llu\n",   (unsigned long long) c->misses);
+        fprintf(out, "evictions %llu\n",(unsigned long long) c->evictions);
+        fprintf(out, "bytes %zu\n",     c->bytes);
+
+    MUTEX_UNLOCK(&c->lock);
+}
+
+
+#endif
@@ -0,0 +1,225 @@
+/**
+ * @name            hotel-booking
+ * @file            UserQuota.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Oct 19 14:20:51 CEST 2026
+ * @brief           concurrent per-user booking counters (MAX_BOOKINGS_PER_USER)
+ *
+ *
+ * Hash table of usernames -> number of active bookings.
+ * Buckets are guarded by a small set of striped mutexes, taken only to insert
+ * a user seen for the first time. Entries are never removed, so once a
+ * thread holds an entry it updates the counter with atomic compare-and-swap
+ * and no lock at all: checking the quota costs no database round trip.
+ */
+
+#ifndef USER_QUOTA_H
+#define USER_QUOTA_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "utils.h"      // hashString()
+
+
+#define USER_QUOTA_BUCKETS      1024    // power of 2
+#define USER_QUOTA_STRIPES      16      // power of 2, <= USER_QUOTA_BUCKETS
+
+
+typedef struct user_quota_entry {
+    char                        username[USERNAME_MAX_LENGTH];
+    int                         bookings;       // accessed with __atomic builtins only
+    struct user_quota_entry*    next;
+} UserQuotaEntry;
+
+
+typedef struct user_quota {
+    int                 max_bookings;
+    int                 users;
+    UserQuotaEntry*     buckets[USER_QUOTA_BUCKETS];
+    pthread_mutex_t     stripes[USER_QUOTA_STRIPES];
+} UserQuota;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+void                initializeUserQuota(UserQuota* q, int max_bookings);
+UserQuotaEntry*     userQuotaEntry(UserQuota* q, const char* username);
+int                 userQuotaAcquire(UserQuota* q, const char* username);
+void                userQuotaRelease(UserQuota* q, const char* username);
+void                userQuotaSet(UserQuota* q, const char* username, int bookings);
+int                 userQuotaBookings(UserQuota* q, const char* username);
+int                 userQuotaTop(UserQuota* q, UserQuotaEntry* top, int n);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+void
+initializeUserQuota(UserQuota* q, int max_bookings)
+{
+    memset(q, 0, sizeof(UserQuota));
+    q->max_bookings = max_bookings;
+
+    for (int i = 0; i < USER_QUOTA_STRIPES; i++){
+        pthread_mutex_init(&q->stripes[i], 0);
+    }
+}
+
+
+/**
+ * Find the entry of `username`, creating it (with 0 bookings) if missing.
+ * Lookups of existing users never take a lock.
+ */
+UserQuotaEntry*
+userQuotaEntry(UserQuota* q, const char* username)
+{
+    uint32_t         bucket = hashString(username) & (USER_QUOTA_BUCKETS - 1);
+    UserQuotaEntry*  e;
+
+    for (e = __atomic_load_n(&q->buckets[bucket], __ATOMIC_ACQUIRE); e != NULL; e = e->next){
+        if (strcmp(e->username, username) == 0){
+            return e;
+        }
+    }
+
+    pthread_mutex_t* stripe = &q->stripes[bucket & (USER_QUOTA_STRIPES - 1)];
+
+    /* critical section */
+    MUTEX_LOCK(stripe);
+
+        // somebody may have inserted it while we were waiting for the lock
+        for (e = q->buckets[bucket]; e != NULL; e = e->next){
+            if (strcmp(e->username, username) == 0){
+                MUTEX_UNLOCK(stripe);
+                return e;
+            }
+        }
+
+        e = (UserQuotaEntry*) calloc(1, sizeof(UserQuotaEntry));
+        if (e == NULL){
+            MUTEX_UNLOCK(stripe);
+            return NULL;
+        }
+        strncpy(e->username, username, sizeof(e->username) - 1);
+        e->next = q->buckets[bucket];
+        __atomic_store_n(&q->buckets[bucket], e, __ATOMIC_RELEASE);    // publish to lock-free readers
+        __atomic_add_fetch(&q->users, 1, __ATOMIC_RELAXED);
+
+    MUTEX_UNLOCK(stripe);
+    /* end critical section */
+
+    return e;
+}
+
+
+/**
+ * Take one booking out of the quota of `username`.
+ * return 0 if the user is below MAX_BOOKINGS_PER_USER, -1 otherwise (quota untouched)
+ */
+int
+userQuotaAcquire(UserQuota* q, const char* username)
+{
+    UserQuotaEntry* e = userQuotaEntry(q, username);
+    int             n;
+
+    if (e == NULL){
+        return -1;
+    }
+
+    n = __atomic_load_n(&e->bookings, __ATOMIC_RELAXED);
+    do {
+        if (n >= q->max_bookings){
+            return -1;
+        }
+    } while (!__atomic_compare_exchange_n(&e->bookings, &n, n + 1, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    return 0;
+}
+
+
+/**
+ * Give one booking back to the quota of `username`.
+ */
+void
+userQuotaRelease(UserQuota* q, const char* username)
+{
+    UserQuotaEntry* e = userQuotaEntry(q, username);
+    int             n;
+
+    if (e == NULL){
+        return;
+    }
+
+    n = __atomic_load_n(&e->bookings, __ATOMIC_RELAXED);
+    do {
+        if (n <= 0){
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&e->bookings, &n, n - 1, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * Used when warming up the table from the database.
+ */
+void
+userQuotaSet(UserQuota* q, const char* username, int bookings)
+{
+    UserQuotaEntry* e = userQuotaEntry(q, username);
+
+    if (e != NULL){
+        __atomic_store_n(&e->bookings, bookings, __ATOMIC_RELEASE);
+    }
+}
+
+
+int
+userQuotaBookings(UserQuota* q, const char* username)
+{
+    UserQuotaEntry* e = userQuotaEntry(q, username);
+
+    return e != NULL ? __atomic_load_n(&e->bookings, __ATOMIC_ACQUIRE) : 0;
+}
+
+
+/**
+ * Copy into `top` the `n` users with the most active bookings, heaviest first.
+ * return number of entries copied (<= n)
+ */
+int
+userQuotaTop(UserQuota* q, UserQuotaEntry* top, int n)
+{
+    int found = 0;
+
+    for (int b = 0; b < USER_QUOTA_BUCKETS; b++){
+        for (UserQuotaEntry* e = __atomic_load_n(&q->buckets[b], __ATOMIC_ACQUIRE); e != NULL; e = e->next){
+            int bookings = __atomic_load_n(&e->bookings, __ATOMIC_RELAXED);
+            int i;
+
+            if (bookings == 0 || (found == n && bookings <= top[n - 1].bookings)){
+                continue;
+            }
+
+            // insertion into the (small) sorted array
+            i = found < n ? found++ : n - 1;
+            while (i > 0 && top[i - 1].bookings < bookings){
+                top[i] = top[i - 1];
+                i--;
+            }
+            memcpy(top[i].username, e->username, sizeof(top[i].username));
+            top[i].bookings = bookings;
+            top[i].next     = NULL;
+        }
+    }
+
+    return found;
+}
+
+
+#endif
@@ -0,0 +1,346 @@
+/**
+ * @name            hotel-booking
+ * @file            UserTable.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Fri Oct 23 09:37:02 CEST 2026
+ * @brief           binary table of the registered users
+ *
+ *
+ * Fixed-size records preceded by a header and an embedded hash index
+ * (bucket heads, records chained through `next`):
+ *
+ *      | header | heads[buckets] | records[capacity] |
+ *
+ * The file is created at its full size (sparse, so only the records in use
+ * take disk space) and mapped once, so the mapping never moves: workers
+ * look users up through a read-only mapping without taking any lock.
+ *
+ * Registrations are serialized by the table lock. A record is written past
+ * the last one, then published by storing its bucket head (release), which
+ * is what makes it visible to lookups, and committed by storing the header
+ * `count` once the record is on disk. At open the index is rebuilt from the
+ * committed records, so a registration cut short by a crash is simply lost.
+ *
+ * userTableImport() converts the legacy text file (`username password` lines).
+ */
+
+#ifndef USER_TABLE_H
+#define USER_TABLE_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "LockProfile.h"
+#include "utils.h"      // hashString()
+
+
+#define USER_TABLE_MAGIC        "HBUSER01"
+#define USER_TABLE_VERSION      1
+
+
+typedef struct user_record {
+    char        username[USERNAME_MAX_LENGTH];
+    char        password[PASSWORD_MAX_LENGTH];  // as stored by the server (encrypted if ENCRYPT_PASSWORD)
+    uint32_t    next;                           // next record of the same bucket + 1, 0 ends the chain
+    uint32_t    reserved;
+} UserRecord;
+
+
+typedef struct user_table_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    record_size;
+    uint32_t    buckets;                        // power of 2
+    uint32_t    capacity;                       // records
+    uint32_t    count;                          // committed records
+    uint32_t    reserved[9];
+} UserTableHeader;      // 64 bytes
+
+
+typedef struct user_table {
+    pthread_mutex_t         lock;               // registrations
+    int                     fd;
+    size_t                  size;
+
+    const char*             map;                // read-only, used by lookups
+    char*                   wmap;               // same pages, used by registrations
+
+    const UserTableHeader*  header;
+    const uint32_t*         heads;
+    const UserRecord*       records;
+
+    // metrics
+    uint64_t                lookups;
+    uint64_t                registrations;
+    uint64_t                full;               // registrations refused, table full
+} UserTable;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+int                 userTableOpen(UserTable* t, const char* path, uint32_t capacity);
+const UserRecord*   userTableFind(UserTable* t, const char* username);
+int                 userTableAdd(UserTable* t, const char* username, const char* password);
+int                 userTableImport(UserTable* t, const char* path);
+void                userTableStats(UserTable* t, FILE* out);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static inline size_t
+userTableSize(uint32_t buckets, uint32_t capacity)
+{
+    return sizeof(UserTableHeader) + (size_t) buckets * sizeof(uint32_t) + (size_t) capacity * sizeof(UserRecord);
+}
+
+
+static inline uint32_t
+userTableBucket(const UserTable* t, const char* username)
+{
+    return hashString(username) & (t->header->buckets - 1);
+}
+
+
+/**
+ * Write the header of a new, empty table.
+ */
+static int
+userTableCreate(int fd, uint32_t capacity)
+{
+    UserTableHeader header;
+    uint32_t        buckets = 1;
+
+    while (buckets < capacity){
+        buckets <<= 1;
+    }
+
+    memset(&header, '\0', sizeof(header));
+    memcpy(header.magic, USER_TABLE_MAGIC, sizeof(header.magic));
+    header.version     = USER_TABLE_VERSION;
+    header.record_size = sizeof(UserRecord);
+    header.buckets     = buckets;
+    header.capacity    = capacity;
+    header.count       = 0;
+
+    if (ftruncate(fd, userTableSize(buckets, capacity)) != 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+        fsync(fd) != 0){
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Rebuild the bucket heads from the committed records. Nobody else uses the table yet.
+ */
+static void
+userTableReindex(UserTable* t)
+{
+    uint32_t*   heads   = (uint32_t*) (t->wmap + sizeof(UserTableHeader));
+    UserRecord* records = (UserRecord*) (t->wmap + ((const char*) t->records - t->map));
+
+    memset(heads, 0, (size_t) t->header->buckets * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < t->header->count; i++){
+        uint32_t b = userTableBucket(t, records[i].username);
+
+        records[i].next = heads[b];
+        heads[b]        = i + 1;
+    }
+}
+
+
+/**
+ * Open (creating it with room for `capacity` users if needed) the table at `path`.
+ * return 0 if OK, -1 otherwise
+ */
+int
+userTableOpen(UserTable* t, const char* path, uint32_t capacity)
+{
+    struct stat st;
+
+    memset(t, 0, sizeof(UserTable));
+    pthread_mutex_init(&t->lock, 0);
+
+    t->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (t->fd < 0){
+        return -1;
+    }
+    if (fstat(t->fd, &st) != 0){
+        close(t->fd);
+        return -1;
+    }
+    if (st.st_size == 0 && userTableCreate(t->fd, capacity) != 0){
+        close(t->fd);
+        return -1;
+    }
+
+    UserTableHeader header;
+
+    if (pread(t->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+        memcmp(header.magic, USER_TABLE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != USER_TABLE_VERSION ||
+        header.record_size != sizeof(UserRecord) ||
+        header.buckets == 0 || (header.buckets & (header.buckets - 1)) != 0 ||
+        header.count > header.capacity){
+        close(t->fd);
+        return -1;
+    }
+
+    // geometry comes from the file: `capacity` only applies to new tables
+    t->size = userTableSize(header.buckets, header.capacity);
+    if (fstat(t->fd, &st) != 0 || (size_t) st.st_size != t->size){
+        close(t->fd);
+        return -1;
+    }
+
+    t->map  = (const char*) mmap(NULL, t->size, PROT_READ, MAP_SHARED, t->fd, 0);
+    t->wmap = (char*) mmap(NULL, t->size, PROT_READ | PROT_WRITE, MAP_SHARED, t->fd, 0);
+    if (t->map == MAP_FAILED || t->wmap == MAP_FAILED){
+        if (t->map  != MAP_FAILED) munmap((void*) t->map, t->size);
+        if (t->wmap != MAP_FAILED) munmap(t->wmap, t->size);
+        close(t->fd);
+        return -1;
+    }
+
+    t->header  = (const UserTableHeader*) t->map;
+    t->heads   = (const uint32_t*) (t->map + sizeof(UserTableHeader));
+    t->records = (const UserRecord*) (t->map + sizeof(UserTableHeader) + (size_t) header.buckets * sizeof(uint32_t));
+
+    userTableReindex(t);
+
+    return 0;
+}
+
+
+/**
+ * return the record of `username`, NULL if not registered. Lock-free.
+ */
+const UserRecord*
+userTableFind(UserTable* t, const char* username)
+{
+    uint32_t i = __atomic_load_n(&t->heads[userTableBucket(t, username)], __ATOMIC_ACQUIRE);
+
+    __atomic_add_fetch(&t->lookups, 1, __ATOMIC_RELAXED);
+
+    while (i != 0){
+        const UserRecord* r = &t->records[i - 1];
+
+        if (strncmp(r->username, username, USERNAME_MAX_LENGTH) == 0){
+            return r;
+        }
+        i = r->next;
+    }
+    return NULL;
+}
+
+
+/**
+ * Register `username` with its (already encrypted) `password`.
+ * return 0 if OK, 1 if `username` is already registered, -1 if the table is full or on error
+ */
+int
+userTableAdd(UserTable* t, const char* username, const char* password)
+{
+    UserTableHeader* header = (UserTableHeader*) t->wmap;
+    uint32_t*        heads  = (uint32_t*) (t->wmap + sizeof(UserTableHeader));
+    UserRecord*      r;
+    uint32_t         i, b;
+    long             page   = sysconf(_SC_PAGESIZE);
+
+    /* critical section */
+    MUTEX_LOCK(&t->lock);
+
+        if (userTableFind(t, username) != NULL){
+            MUTEX_UNLOCK(&t->lock);
+            return 1;
+        }
+
+        i = header->count;
+        if (i == header->capacity){
+            __atomic_add_fetch(&t->full, 1, __ATOMIC_RELAXED);
+            MUTEX_UNLOCK(&t->lock);
+            return -1;
+        }
+
+        b = userTableBucket(t, username);
+        r = (UserRecord*) (t->wmap + ((const char*) &t->records[i] - t->map));
+
+        memset(r, '\0', sizeof(UserRecord));
+        strncpy(r->username, username, sizeof(r->username) - 1);
+        strncpy(r->password, password, sizeof(r->password) - 1);
+        r->next = heads[b];
+
+        // publish: lookups see the record from here on
+        __atomic_store_n(&heads[b], i + 1, __ATOMIC_RELEASE);
+
+        // commit: the record (and its bucket head) on disk first, then the count
+        uintptr_t from = ((uintptr_t) r) & ~((uintptr_t) page - 1);
+        msync((void*) from, (uintptr_t) (r + 1) - from, MS_SYNC);
+        from = ((uintptr_t) &heads[b]) & ~((uintptr_t) page - 1);
+        msync((void*) from, page, MS_SYNC);
+
+        __atomic_store_n(&header->count, i + 1, __ATOMIC_RELEASE);
+        msync(t->wmap, page, MS_SYNC);
+
+        __atomic_add_fetch(&t->registrations, 1, __ATOMIC_RELAXED);
+
+    MUTEX_UNLOCK(&t->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+/**
+ * Add the users of the legacy text file at `path` (`username password` lines).
+ * return the number of users added, -1 if the file can't be read
+ */
+int
+userTableImport(UserTable* t, const char* path)
+{
+    char username[USERNAME_MAX_LENGTH];
+    char password[PASSWORD_MAX_LENGTH];
+    char line[USERNAME_MAX_LENGTH + PASSWORD_MAX_LENGTH + 2];
+    int  added = 0;
+
+    FILE* in = fopen(path, "r");
+    if (in == NULL){
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), in)){
+        if (sscanf(line, "%15s %31s", username, password) != 2){
+            continue;
+        }
+        if (userTableAdd(t, username, password) == 0){
+            added++;
+        }
+    }
+
+    fclose(in);
+    return added;
+}
+
+
+void
+userTableStats(UserTable* t, FILE* out)
+{
+    fprintf(out, "users %u\n",          __atomic_load_n(&t->header->count, __ATOMIC_ACQUIRE));
+    fprintf(out, "capacity %u\n",       t->header->capacity);
+    fprintf(out, "lookups %llu\n",      (unsigned long long) __atomic_load_n(&t->lookups, __ATOMIC_RELAXED));
+    fprintf(out, "registrations %llu\n",(unsigned long long) __atomic_load_n(&t->registrations, __ATOMIC_RELAXED));
+    fprintf(out, "full %llu\n",         (unsigned long long) __atomic_load_n(&t->full, __ATOMIC_RELAXED));
+}
+
+
+#endif
@@ -0,0 +1,651 @@
+/**
+ * @name            hotel-booking
+ * @file            bench.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sun Oct 25 16:48:20 CEST 2026
+ * @brief           load generator: reservations per second and their latency
+ *
+ * *compilation     `make bench` or `gcc bench.c -o bench -lpthread`
+ *
+ *
+ * usage            ./bench <ip> <port> [threads] [sessions per thread] [seconds] [--hot] [--csv]
+ *
+ * Every session logs in (registering the first time) as its own bench user,
+ * then keeps reserving a room for a date of next year and releasing it right
+ * away. Each thread keeps a command in flight on every one of its sessions
+ * at once (poll() over their sockets): the sessions are the concurrent
+ * requests the server sees, not just open connections.
+ *
+ * Reported: reserve + release pairs per second and the latency percentiles
+ * of a single round trip. Run it against a server built with the default
+ * IO_URING and one built with -DIO_URING=0 to compare the event loop
+ * backends (the `[loops]` metrics of the server tell the syscalls and
+ * context switches each one took).
+ *
+ * Dates are spread over the whole year, or with `--hot` all on the same
+ * day: every reservation then goes through the occupancy of one date,
+ * the worst case for assignRoom(). `--csv` prints the results as one
+ * line (CSV_HEADER), see `scale.sh` for the sweep over server builds.
+ */
+
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// POSIX threading
+#include <pthread.h>
+
+// networking
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <arpa/inet.h>
+
+
+/* user-defined headers */
+
+#include "config.h"
+#include "messages.h"
+
+
+#define BENCH_MAX_THREADS       64
+#define BENCH_MAX_SESSIONS      1024    // per thread
+#define BENCH_MAX_SAMPLES       (1 << 20)   // latencies kept per thread
+#define BENCH_PASSWORD          "bench-pass"
+#define BENCH_HOT_DAY           15      // the date of `--hot`: 15 June of next year
+#define BENCH_HOT_MONTH         6
+
+#define BENCH_BUFFER_SIZE       (SESSION_OUTPUT_SIZE + 4)  // the longest reply frame
+
+#define CSV_HEADER              "sessions,dates,pairs_per_s,p50_us,p99_us,max_us,refused,busy,errors"
+
+
+typedef enum {
+    BENCH_RESERVE,                  // reserve sent, waiting for the reply
+    BENCH_RESERVED,                 // RESOK in, waiting for the room and the code
+    BENCH_RELEASE,                  // release sent, waiting for the reply
+    BENCH_BUSY_RESERVE,             // turned down: reserve again at `resume_at`
+    BENCH_BUSY_RELEASE              // turned down: release again at `resume_at`
+} bench_state_t;
+
+
+typedef struct bench_session {
+    int             fd;
+    bench_state_t   state;
+    int             frames;         // of the reply to the reserve
+    uint64_t        sent_at;        // us, the command in flight was sent
+    uint64_t        resume_at;      // us, when turned down
+    char            date[16];
+    char            room[16];
+    char            code[RESERVATION_CODE_LENGTH + 1];
+
+    char            in[BENCH_BUFFER_SIZE];
+    uint32_t        in_used;
+} BenchSession;
+
+
+typedef struct bench_thread {
+    pthread_t       thread;
+    int             index;
+    int             sessions;
+    int*            fds;
+    unsigned int    seed;
+
+    // results
+    uint64_t        pairs;          // reserve + release completed
+    uint64_t        refused;        // reservations refused (no room left that day)
+    uint64_t        busy;           // commands turned down by the server admission control
+    uint64_t        errors;
+    uint32_t*       samples;        // round trip latencies, us
+    uint32_t        samples_used;
+} BenchThread;
+
+
+static struct sockaddr_in   server_g;
+static volatile int         stop_g;
+static int                  year_g;                 // reservations go to next year
+static int                  hot_g;                  // all of them on the same day (`--hot`)
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+/** @brief  Sends `count` frames with a single send().
+ *  @return 0 if OK, -1 otherwise
+ */
+int         benchWrite(int fd, const char** msgs, int count);
+
+/** @brief  Reads one frame, NUL-terminated into `msg` (truncated to `size`).
+ *  @return 0 if OK, -1 if the server is gone
+ */
+int         benchRead(int fd, char* msg, size_t size);
+
+/** @brief  If `reply` turns the command down ("BUSY <ms>"), waits as long as asked.
+ *  @return 1 if the command was turned down, 0 otherwise
+ */
+int         benchBusy(const char* reply);
+
+/** @brief  Connects and logs in as `username`, registering it if unknown.
+ *  @return socket, -1 on failure
+ */
+int         benchLogin(const char* username);
+
+/** @brief  Sends the next command of `s`: a reserve, or the release of what it reserved.
+ *  @return 0 if OK, -1 if the server is gone
+ */
+int         benchSend(BenchThread* b, BenchSession* s);
+
+/** @brief  Handles a reply frame of `s`, sending the next command once the reply is whole.
+ *  @return 0 if OK, -1 if the session is broken
+ */
+int         benchReply(BenchThread* b, BenchSession* s, const char* reply);
+
+/** @brief  Thread body: a reserve or a release in flight on each of its sessions until `stop_g`.
+ *  @param  opaque BenchThread
+ *  @return NULL
+ */
+void*       benchThread(void* opaque);
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+static uint64_t
+nowMicroseconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+static int
+compareSamples(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+
+int
+main(int argc, char** argv)
+{
+    int threads  = 2;
+    int sessions = 8;
+    int seconds  = 10;
+    int csv      = 0;
+
+    if (argc < 3){
+        printf("Usage: %s <ip> <port> [threads] [sessions per thread] [seconds] [--hot] [--csv]\n", argv[0]);
+        exit(-1);
+    }
+    for (int i = 3, positional = 0; i < argc; i++){
+        if      (strcmp(argv[i], "--hot") == 0)     hot_g    = 1;
+        else if (strcmp(argv[i], "--csv") == 0)     csv      = 1;
+        else if (positional == 0 && ++positional)   threads  = atoi(argv[i]);
+        else if (positional == 1 && ++positional)   sessions = atoi(argv[i]);
+        else if (positional == 2 && ++positional)   seconds  = atoi(argv[i]);
+        else {
+            printf("\x1b[31mbad argument %s\x1b[0m\n", argv[i]);
+            exit(-1);
+        }
+    }
+
+    if (threads <= 0 || threads > BENCH_MAX_THREADS || sessions <= 0 || sessions > BENCH_MAX_SESSIONS || seconds <= 0){
+        printf("\x1b[31mthreads have to be 1..%d, sessions 1..%d, seconds >= 1\x1b[0m\n", BENCH_MAX_THREADS, BENCH_MAX_SESSIONS);
+        exit(-1);
+    }
+
+    memset(&server_g, '\0', sizeof(server_g));
+    server_g.sin_family = AF_INET;
+    server_g.sin_port   = htons(atoi(argv[2]));
+    if (inet_pton(AF_INET, argv[1], &server_g.sin_addr) != 1){
+        printf("\x1b[31mInvalid IP address.\x1b[0m\n");
+        exit(-1);
+    }
+
+    time_t     now = time(NULL);
+    struct tm* tm  = localtime(&now);
+    year_g = tm->tm_year + 1900 + 1;
+
+
+    BenchThread* bench = (BenchThread*) calloc(threads, sizeof(BenchThread));
+
+    // everybody logged in before the clock starts
+    for (int t = 0; t < threads; t++){
+        bench[t].index    = t;
+        bench[t].sessions = sessions;
+        bench[t].fds      = (int*) calloc(sessions, sizeof(int));
+        bench[t].samples  = (uint32_t*) malloc(BENCH_MAX_SAMPLES * sizeof(uint32_t));
+
+        for (int i = 0; i < sessions; i++){
+            char username[USERNAME_MAX_LENGTH];
+
+            snprintf(username, sizeof(username), "bench%02d%04d", t % 100, i % 10000);
+            bench[t].fds[i] = benchLogin(username);
+            if (bench[t].fds[i] < 0){
+                printf("\x1b[31mCould not log in as %s.\x1b[0m\n", username);
+                exit(-1);
+            }
+        }
+    }
+    if (!csv){
+        printf("%d sessions logged in, running for %d s...\n", threads * sessions, seconds);
+    }
+
+
+    uint64_t start = nowMicroseconds();
+
+    for (int t = 0; t < threads; t++){
+        if (pthread_create(&bench[t].thread, NULL, benchThread, &bench[t]) != 0){
+            perror("pthread_create()");
+            exit(-1);
+        }
+    }
+
+    sleep(seconds);
+    stop_g = 1;
+
+    for (int t = 0; t < threads; t++){
+        pthread_join(bench[t].thread, NULL);
+    }
+
+    double elapsed = (double) (nowMicroseconds() - start) / 1e6;
+
+
+    // merging the results
+    uint64_t  pairs = 0, refused = 0, busy = 0, errors = 0, count = 0;
+    uint32_t* all;
+
+    for (int t = 0; t < threads; t++){
+        pairs   += bench[t].pairs;
+        refused += bench[t].refused;
+        busy    += bench[t].busy;
+        errors  += bench[t].errors;
+        count   += bench[t].samples_used;
+    }
+
+    all   = (uint32_t*) malloc((count + 1) * sizeof(uint32_t));
+    count = 0;
+    for (int t = 0; t < threads; t++){
+        memcpy(all + count, bench[t].samples, bench[t].samples_used * sizeof(uint32_t));
+        count += bench[t].samples_used;
+    }
+    qsort(all, count, sizeof(uint32_t), compareSamples);
+
+    if (csv){
+        printf("%d,%s,%.0f,%u,%u,%u,%llu,%llu,%llu\n", threads * sessions, hot_g ? "hot" : "uniform", pairs / elapsed,
+                count > 0 ? all[count / 2] : 0, count > 0 ? all[count * 99 / 100] : 0, count > 0 ? all[count - 1] : 0,
+                (unsigned long long) refused, (unsigned long long) busy, (unsigned long long) errors);
+        return errors == 0 ? 0 : 1;
+    }
+
+    printf("sessions       %d (%d threads)\n", threads * sessions, threads);
+    printf("pairs          %llu (reserve + release)\n", (unsigned long long) pairs);
+    printf("pairs/s        %.0f\n", pairs / elapsed);
+    printf("refused        %llu\n", (unsigned long long) refused);
+    printf("busy           %llu\n", (unsigned long long) busy);
+    printf("errors         %llu\n", (unsigned long long) errors);
+    if (count > 0){
+        printf("latency p50    %u us\n", all[count / 2]);
+        printf("latency p99    %u us\n", all[count * 99 / 100]);
+        printf("latency max    %u us\n", all[count - 1]);
+    }
+
+    return errors == 0 ? 0 : 1;
+}
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+benchWrite(int fd, const char** msgs, int count)
+{
+    char   buf[SESSION_INPUT_SIZE * 4];
+    size_t used = 0;
+
+    for (int i = 0; i < count; i++){
+        uint32_t len = (uint32_t) strlen(msgs[i]);
+        uint32_t dim = htonl(len);
+
+        if (used + sizeof(dim) + len > sizeof(buf)){
+            return -1;
+        }
+        memcpy(buf + used, &dim, sizeof(dim));
+        memcpy(buf + used + sizeof(dim), msgs[i], len);
+        used += sizeof(dim) + len;
+    }
+
+    return send(fd, buf, used, 0) == (ssize_t) used ? 0 : -1;
+}
+
+
+int
+benchRead(int fd, char* msg, size_t size)
+{
+    int32_t dim;
+    char    skip[256];
+
+    if (recv(fd, &dim, sizeof(dim), MSG_WAITALL) != sizeof(dim)){
+        return -1;
+    }
+    dim = ntohl(dim);
+    if (dim < 0){
+        return -1;
+    }
+
+    size_t n = (size_t) dim < size - 1 ? (size_t) dim : size - 1;
+
+    if (n > 0 && recv(fd, msg, n, MSG_WAITALL) != (ssize_t) n){
+        return -1;
+    }
+    msg[n] = '\0';
+
+    // what didn't fit
+    for (size_t left = (size_t) dim - n; left > 0; ){
+        ssize_t r = recv(fd, skip, left < sizeof(skip) ? left : sizeof(skip), 0);
+
+        if (r <= 0){
+            return -1;
+        }
+        left -= (size_t) r;
+    }
+    return 0;
+}
+
+
+int
+benchBusy(const char* reply)
+{
+    int retry;
+
+    if (sscanf(reply, BUSY_MSG " %d", &retry) != 1){
+        return 0;
+    }
+    usleep(retry * 1000);
+    return 1;
+}
+
+
+int
+benchLogin(const char* username)
+{
+    char        reply[BUFSIZE];
+    int         one = 1;
+    const char* login[]    = { LOGIN_MSG, username };
+    const char* password[] = { BENCH_PASSWORD };
+    const char* reg[]      = { REGISTER_MSG, username, BENCH_PASSWORD };
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0){
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (struct sockaddr*) &server_g, sizeof(server_g)) != 0){
+        close(fd);
+        return -1;
+    }
+
+    // login: "OK", then "Y" if the username exists. The username is ignored when the login is turned down.
+    do {
+        if (benchWrite(fd, login, 2) != 0 || benchRead(fd, reply, sizeof(reply)) != 0){
+            close(fd);
+            return -1;
+        }
+    } while (benchBusy(reply));
+
+    if (benchRead(fd, reply, sizeof(reply)) != 0){
+        close(fd);
+        return -1;
+    }
+
+    if (strcmp(reply, "Y") == 0){
+        if (benchWrite(fd, password, 1) != 0 || benchRead(fd, reply, sizeof(reply)) != 0 || strcmp(reply, "Y") != 0){
+            close(fd);
+            return -1;
+        }
+    }
+    else {
+        // register: prompt, "Y" for the username, then two messages for the password
+        do {
+            if (benchWrite(fd, reg, 3) != 0 || benchRead(fd, reply, sizeof(reply)) != 0){
+                close(fd);
+                return -1;
+            }
+        } while (benchBusy(reply));
+
+        if (benchRead(fd, reply, sizeof(reply)) != 0 || strcmp(reply, "Y") != 0 ||
+            benchRead(fd, reply, sizeof(reply)) != 0 || strcmp(reply, "password OK.") != 0 ||
+            benchRead(fd, reply, sizeof(reply)) != 0){
+            close(fd);
+            return -1;
+        }
+    }
+
+    // session token
+    if (benchRead(fd, reply, sizeof(reply)) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int
+benchSend(BenchThread* b, BenchSession* s)
+{
+    if (s->state == BENCH_RESERVE || s->state == BENCH_BUSY_RESERVE){
+        if (hot_g){
+            snprintf(s->date, sizeof(s->date), "%02d/%02d/%04d", BENCH_HOT_DAY, BENCH_HOT_MONTH, year_g);
+        }
+        else {
+            snprintf(s->date, sizeof(s->date), "%02d/%02d/%04d", 1 + rand_r(&b->seed) % 28, 1 + rand_r(&b->seed) % 12, year_g);
+        }
+
+        const char* reserve[] = { RESERVE_MSG, s->date, "any", "0" };     // "0": the session's hotel
+
+        s->state   = BENCH_RESERVE;
+        s->frames  = 0;
+        s->sent_at = nowMicroseconds();
+        return benchWrite(s->fd, reserve, 4);
+    }
+
+    const char* release[] = { RELEASE_MSG, s->date, s->room, s->code, "0" };
+
+    s->state   = BENCH_RELEASE;
+    s->sent_at = nowMicroseconds();
+    return benchWrite(s->fd, release, 5);
+}
+
+
+/**
+ * Wait the time asked by a "BUSY <ms>" reply before sending `s` its command again.
+ * return 1 if the reply turns the command down, 0 otherwise
+ */
+static int
+benchTurnedDown(BenchThread* b, BenchSession* s, const char* reply, bench_state_t retry)
+{
+    int ms;
+
+    if (sscanf(reply, BUSY_MSG " %d", &ms) != 1){
+        return 0;
+    }
+    b->busy++;
+    s->state     = retry;
+    s->resume_at = nowMicroseconds() + (uint64_t) (ms > 0 ? ms : 0) * 1000;
+    return 1;
+}
+
+
+static void
+benchSample(BenchThread* b, BenchSession* s)
+{
+    if (b->samples_used < BENCH_MAX_SAMPLES){
+        b->samples[b->samples_used++] = (uint32_t) (nowMicroseconds() - s->sent_at);
+    }
+}
+
+
+int
+benchReply(BenchThread* b, BenchSession* s, const char* reply)
+{
+    switch (s->state){
+        case BENCH_RESERVE:
+            if (benchTurnedDown(b, s, reply, BENCH_BUSY_RESERVE)){
+                return 0;
+            }
+            if (strcmp(reply, "RESOK") != 0){
+                b->refused++;
+                return benchSend(b, s);
+            }
+            s->state = BENCH_RESERVED;
+            return 0;
+
+        case BENCH_RESERVED:
+            // the room, then the code
+            if (s->frames++ == 0){
+                snprintf(s->room, sizeof(s->room), "%s", reply);
+                return 0;
+            }
+            snprintf(s->code, sizeof(s->code), "%s", reply);
+            benchSample(b, s);
+            return benchSend(b, s);
+
+        case BENCH_RELEASE:
+            // the room has to be given back, however busy the server is
+            if (benchTurnedDown(b, s, reply, BENCH_BUSY_RELEASE)){
+                return 0;
+            }
+            if (strstr(reply, "OK.") == NULL){
+                b->errors++;
+            }
+            b->pairs++;
+            benchSample(b, s);
+            s->state = BENCH_RESERVE;
+            return benchSend(b, s);
+
+        default:
+            return -1;      // nothing was in flight
+    }
+}
+
+
+/**
+ * Read what `s` has and handle the whole frames.
+ * return 0 if OK, -1 if the server is gone
+ */
+static int
+benchReceive(BenchThread* b, BenchSession* s)
+{
+    ssize_t  n = recv(s->fd, s->in + s->in_used, sizeof(s->in) - s->in_used, MSG_DONTWAIT);
+    uint32_t used = 0;
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+        return -1;
+    }
+    if (n < 0){
+        return 0;
+    }
+    s->in_used += (uint32_t) n;
+
+    while (s->in_used - used >= sizeof(uint32_t)){
+        char     reply[BUFSIZE];
+        uint32_t dim;
+
+        memcpy(&dim, s->in + used, sizeof(dim));
+        dim = ntohl(dim);
+        if (dim > sizeof(s->in) - sizeof(dim)){
+            return -1;
+        }
+        if (s->in_used - used - sizeof(dim) < dim){
+            break;
+        }
+
+        snprintf(reply, sizeof(reply), "%.*s", (int) dim, s->in + used + sizeof(dim));
+        used += sizeof(dim) + dim;
+
+        if (benchReply(b, s, reply) != 0){
+            return -1;
+        }
+    }
+
+    s->in_used -= used;
+    memmove(s->in, s->in + used, s->in_used);
+    return 0;
+}
+
+
+void*
+benchThread(void* opaque)
+{
+    BenchThread*   b        = (BenchThread*) opaque;
+    BenchSession*  sessions = (BenchSession*) calloc(b->sessions, sizeof(BenchSession));
+    struct pollfd* fds      = (struct pollfd*) calloc(b->sessions, sizeof(struct pollfd));
+
+    if (sessions == NULL || fds == NULL){
+        b->errors++;
+        return NULL;
+    }
+
+    b->seed = (unsigned int) (time(NULL) ^ (b->index * 7919));
+
+    // every session gets its first command in flight at once
+    for (int i = 0; i < b->sessions; i++){
+        sessions[i].fd    = b->fds[i];
+        sessions[i].state = BENCH_RESERVE;
+        fds[i].fd         = b->fds[i];
+        fds[i].events     = POLLIN;
+
+        if (benchSend(b, &sessions[i]) != 0){
+            b->errors++;
+            return NULL;
+        }
+    }
+
+    while (!stop_g){
+        uint64_t now     = nowMicroseconds();
+        int      timeout = 100;
+
+        // the sessions turned down go again once they've waited
+        for (int i = 0; i < b->sessions; i++){
+            BenchSession* s = &sessions[i];
+
+            if (s->state != BENCH_BUSY_RESERVE && s->state != BENCH_BUSY_RELEASE){
+                continue;
+            }
+            if (s->resume_at <= now){
+                if (benchSend(b, s) != 0){
+                    b->errors++;
+                    return NULL;
+                }
+            }
+            else if ((int) ((s->resume_at - now) / 1000) + 1 < timeout){
+                timeout = (int) ((s->resume_at - now) / 1000) + 1;
+            }
+        }
+
+        if (poll(fds, b->sessions, timeout) < 0){
+            continue;   // EINTR
+        }
+
+        for (int i = 0; i < b->sessions; i++){
+            if (fds[i].revents != 0 && benchReceive(b, &sessions[i]) != 0){
+                b->errors++;
+                return NULL;
+            }
+        }
+    }
+
+    free(fds);
+    free(sessions);
+    return NULL;
+}
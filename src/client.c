@@ -14,11 +14,27 @@
  *      help                
  *      register            
  *      login               
+ *      resume              
  *      view                
  *      quit                
  *      logout
- *      reserve    [date]
+ *      reserve    [date] [type]
  *      release    [date] [room] [code]
+ *
+ *      [date] is either dd/mm (current year) or dd/mm/yyyy
+ *      [type] is optional: single, double or suite
+ *
+ *
+ *      batch mode: `client <ip> <port> <script>` ("-" reads the script from stdin)
+ *      ---------------------+
+ *      register   <username> <password>
+ *      login      <username> <password>
+ *      reserve    <username> [date] [type]
+ *      release    <username> [date] [room] [code]
+ *      view       <username>
+ *
+ *      one command per line, blank lines and lines starting with # are skipped.
+ *      A user's commands have to come after its login (or register).
  */
 
 
@@ -26,6 +42,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>         // getpass()
+#include <fcntl.h>          // open()
 
 // networking
 #include <sys/socket.h>
@@ -34,8 +51,9 @@
 #include <arpa/inet.h>
 
 // miscellaneous
-#include <regex.h>
+#include <ctype.h>          // isdigit(), isalnum()
 #include <signal.h>         // signal()
+#include <time.h>           // clock_gettime()
 
 
 
@@ -48,29 +66,213 @@
 #include "messages.h"
 
 #include "Address.h"
+#include "Calendar.h"
 #include "Booking.h"
 #include "Hotel.h"
 #include "User.h"
+#include "HotelClient.h"
+
+
+#define SESSION_TOKEN_BUFSIZE   64      // > length of the tokens sent by the server
+
+#define BATCH_CONNECTIONS       4       // connections of the batch mode, shared by all the users of the script
+#define BATCH_WINDOW            512     // batch commands in flight at most
+#define BATCH_LOGIN_WAIT        10      // ms a command waits before being retried while its user's login is retried
+
+
+#define ROOM_TYPE_LENGTH        8       // "single", "double", "suite" + '\0'
+
+
+typedef enum batch_op {
+    BATCH_NONE = -1,        // not available in batch mode
+    BATCH_REGISTER,
+    BATCH_LOGIN,
+    BATCH_RESERVE,
+    BATCH_RELEASE,
+    BATCH_VIEW
+} batch_op_t;
+
+
+/* commands, looked up by the first word typed: what they lead to depends on whether the user is logged in */
+typedef struct client_command {
+    const char*         name;
+    client_fsm_state_t  unlogged;       // INVALID_UNLOGGED if only for logged in users
+    client_fsm_state_t  logged;         // INVALID_LOGGED_IN if only before logging in
+    batch_op_t          batch;
+} ClientCommand;
+
+
+static const ClientCommand client_commands[] = {
+    { "help",       SEND_HELP,          SEND_HELP_LOGGED,   BATCH_NONE },
+    { "login",      SEND_LOGIN,         INVALID_LOGGED_IN,  BATCH_LOGIN },
+    { "register",   SEND_REGISTER,      INVALID_LOGGED_IN,  BATCH_REGISTER },
+    { "resume",     SEND_RESUME,        INVALID_LOGGED_IN,  BATCH_NONE },
+    { "hotel",      SEND_HOTEL,         INVALID_LOGGED_IN,  BATCH_NONE },       // hotel <id>, before logging in
+    { "quit",       SEND_QUIT,          SEND_QUIT,          BATCH_NONE },
+    { "view",       INVALID_UNLOGGED,   SEND_VIEW,          BATCH_VIEW },
+    { "logout",     INVALID_UNLOGGED,   SEND_LOGOUT,        BATCH_NONE },
+    { "reserve",    INVALID_UNLOGGED,   SEND_RESERVE,       BATCH_RESERVE },     // arguments checked before sending
+    { "release",    INVALID_UNLOGGED,   SEND_RELEASE,       BATCH_RELEASE },
+};
+
+
+/* day-month pairs that can exist, in any year: bit `d` of `month_days[m]` is set if d/m can be a date.
+ * 29/02 is in, the year is checked afterwards by `normalizeDate()`.
+ */
+#define DAYS_1_TO(n)        ((uint32_t) ((1ull << ((n) + 1)) - 2))
+
+static const uint32_t month_days[13] = {
+    0,
+    DAYS_1_TO(31), DAYS_1_TO(29), DAYS_1_TO(31), DAYS_1_TO(30), DAYS_1_TO(31), DAYS_1_TO(30),
+    DAYS_1_TO(31), DAYS_1_TO(31), DAYS_1_TO(30), DAYS_1_TO(31), DAYS_1_TO(30), DAYS_1_TO(31)
+};
+
+
+typedef struct batch_command {
+    batch_op_t          op;
+    int                 line;                               // in the script
+    int                 login;                              // index of the user's login (or register) before it, -1 for none
+    int                 done;                               // its outcome is known, no more retries
+    uint64_t            retry_at;                           // ms, turned down by the server: sent again then
+
+    char                username[USERNAME_MAX_LENGTH];
+    char                password[PASSWORD_MAX_LENGTH];
+    char                date[DATE_STRING_LENGTH];
+    char                room_type[ROOM_TYPE_LENGTH];        // "" for any
+    int                 room;
+    char                code[RESERVATION_CODE_LENGTH];
+
+    struct batch*       batch;
+} BatchCommand;
+
+
+typedef struct batch {
+    HotelClient*        client;
+    BatchCommand*       commands;
+    int                 count;
+    int                 next;                               // first command not sent yet
+    int                 in_flight;
+
+    int*                retries;                            // commands waiting to be sent again
+    int                 retrying;
+
+    int                 ok;
+    int                 refused;
+    int                 failed;
+} Batch;
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+/** @brief  looks up the command named by the first word of `input`.
+ *  @param  input   as typed, lower case
+ *  @return the command, NULL if there's no such command
+ */
+const ClientCommand*    findCommand(const char* input);
+
+
+/** @brief  checks that `date` is written `dd/mm` or `dd/mm/yyyy`.
+ *  @return 1 if it is, 0 otherwise
+ */
+int         isDateFormat(const char* date);
+
+
+/** @brief  checks the day and month of a date in the format of isDateFormat()
+ *          against the month_days table (29/02 accepted for any year).
+ *  @return 1 if the day exists in that month, 0 otherwise
+ */
+int         isDayOfMonth(const char* date);
+
+
+/** @brief  checks a room number: 1-999, no leading zeros.
+ *  @return 1 if valid, 0 otherwise
+ */
+int         isRoomNumber(const char* room);
+
+
+/** @brief  checks an optional room type: "", "single", "double" or "suite".
+ *  @return 1 if valid, 0 otherwise
+ */
+int         isRoomType(const char* type);
+
+
+/** @brief  checks a reservation code: RESERVATION_CODE_LENGTH-1 letters or digits.
+ *  @return 1 if valid, 0 otherwise
+ */
+int         isReservationCode(const char* code);
+
+
+/** @brief  turns a valid `dd/mm` or `dd/mm/yyyy` date into `dd/mm/yyyy`,
+ *          filling in the current year when it is omitted.
+ *  @param  date  date typed by the user, rewritten in place (DATE_STRING_LENGTH bytes)
+ *  @return 0 if the date exists, -1 otherwise
+ */
+int         normalizeDate(char* date);
+
+
+
+
+/** @brief  remembers the session token of `username` in SESSION_FILE_NAME,
+ *          so a later `resume` (even from another client run) skips the login.
+ *  @param  username
+ *  @param  token   token sent by the server after logging in
+ *  @return Void
+ */
+void        saveSession(const char* username, const char* token);
 
 
-// regex patterns
-#define REGEX_HELP          "help"
-#define REGEX_LOGIN         "login"
-#define REGEX_REGISTER      "register"
-#define REGEX_VIEW          "view"
-#define REGEX_QUIT          "quit"
-#define REGEX_LOGOUT        "logout"
-#define REGEX_RESERVE       "reserve"
-#define REGEX_RELEASE       "release"
+/** @brief  reads back what saveSession() stored.
+ *  @param  username    USERNAME_MAX_LENGTH bytes
+ *  @param  token       SESSION_TOKEN_BUFSIZE bytes
+ *  @return 0 if there's a saved session, -1 otherwise
+ */
+int         loadSession(char* username, char* token);
+
+
+/** @brief  forgets the saved session (logout, expired token).
+ *  @return Void
+ */
+void        forgetSession();
+
+
+/** @brief  tells the user if `reply` is the server turning the command down
+ *          ("BUSY <ms>", or "READONLY" from a replica for commands changing something).
+ *  @param  reply   first reply to a command
+ *  @return 1 if the command was turned down, 0 otherwise
+ */
+int         serverBusy(const char* reply);
 
-#define REGEX_ROOM          "^[1-9]{1,3}$"          // room can be in range 1-999 
-#define REGEX_CODE          "^([a-zA-Z0-9]{5})$"    // 5 chars, alphanumeric
 
-// removed ^ from date regex pattern so leading whitespaces are discarded.
-#define REGEX_DATE_FORMAT   "[0-9]{2}/[0-9]{2}$"
-#define REGEX_DATE_VALID    "(((0[1-9]|[12][0-9]|3[01])/(0[13578]|1[02]))|((0[1-9]|[12][0-9]|30)/(0[13456789]|1[012]))|((0[1-9]|1[0-9]|2[0-8])/02)|(29/02))$"
-                            /* inspired by [this answer](https://stackoverflow.com/a/21583100/6164816), I've then removed the year part and replaced "-" with "/".
-                             */
+/** @brief  batch mode: runs the commands of a script, pipelined over a few connections
+ *          shared by all its users (client library, see `HotelClient.h`).
+ *          One line per command is printed as its reply comes.
+ *  @param  address server
+ *  @param  path    script, "-" for stdin
+ *  @return exit status: 0 if every command succeeded, 1 if some didn't, 2 if the script is invalid (nothing is sent)
+ */
+int         runBatch(Address* address, const char* path);
+
+
+/** @brief  parses a script line into `cmd`.
+ *  @param  line    without the new line
+ *  @param  cmd     filled in
+ *  @return 1 if it's a command, 0 if the line is blank or a comment, -1 if it's invalid (error printed)
+ */
+int         parseBatchLine(char* line, BatchCommand* cmd);
+
+
+/** @brief  hands a batch command to the client library, or fails it.
+ *  @return Void
+ */
+void        sendBatchCommand(Batch* b, BatchCommand* cmd);
+
+
+/** @brief  client library callback of the batch commands: prints the outcome,
+ *          or sets the command aside to be sent again.
+ *  @return Void
+ */
+void        batchCommandDone(void* arg, const HotelReply* reply);
 
 
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
@@ -80,6 +282,20 @@ int
 main(int argc, char** argv) 
 {
 
+    #if !GDB_MODE
+        if (argc < 3 || argc > 4){
+            printf("\x1b[31mWrong number of parameters!\x1b[0m\n");
+            printf("Usage: %s <ip> <port> [script]   (batch mode with a script, \"-\" for stdin)\n", argv[0]);
+            exit(-1);
+        }
+    #endif
+
+    if (argc > 3){
+        Address address = readArguments(argc, argv);
+
+        return runBatch(&address, argv[3]);
+    }
+
     // clear terminal
     system("clear");
 
@@ -115,13 +331,15 @@ main(int argc, char** argv)
 
 
     char command[BUFSIZE];
-    char cmd[BUFSIZE];  // local command, used when parsing the reserve and release instructions
     char response[BUFSIZE];
+    char room_type[ROOM_TYPE_LENGTH];  // optional room type of the reserve instruction
 
 
     
     char username[USERNAME_MAX_LENGTH];
     char password[PASSWORD_MAX_LENGTH];
+    char token[SESSION_TOKEN_BUFSIZE];
+    char hotel[12];                         // ID of the hotel picked with `hotel`
 
 
 
@@ -137,6 +355,7 @@ main(int argc, char** argv)
     
     // FSM initialization
     client_fsm_state_t state = CL_INIT;    
+    const ClientCommand* found;
 
 
     // show available commands even before starting off.
@@ -163,22 +382,8 @@ main(int argc, char** argv)
 
 
 
-                if      (regexMatch(command, REGEX_HELP)){
-                    state = SEND_HELP;
-                }
-                else if (regexMatch(command, REGEX_LOGIN)){ 
-                    state = SEND_LOGIN;
-                }
-                else if (regexMatch(command, REGEX_REGISTER)) {
-                    state = SEND_REGISTER;
-                }
-                else if (regexMatch(command, REGEX_QUIT)){
-                    state = SEND_QUIT;
-                }
-                else{
-                    state = INVALID_UNLOGGED;
-                }
-                
+                found = findCommand(command);
+                state = found != NULL ? found->unlogged : INVALID_UNLOGGED;
                 break;
 
 
@@ -238,7 +443,7 @@ main(int argc, char** argv)
             case READ_REGISTER_RESP:
                 memset(command, '\0', sizeof(command));
                 readSocket(sockfd, command);
-                state = SEND_USERNAME;
+                state = serverBusy(command) ? CL_INIT : SEND_USERNAME;
                 break;
 
             case SEND_USERNAME:
@@ -299,14 +504,25 @@ main(int argc, char** argv)
                 break;
             
             case READ_PASSWORD_RESP:
-                memset(command, '\0', sizeof(command));
-                readSocket(sockfd, command);  // OK: Account was successfully setup.
-                printf("%s\n", command);
+                memset(response, '\0', sizeof(response));
+                readSocket(sockfd, response);  // OK: Account was successfully setup.
+                printf("%s\n", response);
 
                 memset(command, '\0', sizeof(command));
                 readSocket(sockfd, command);  // Successfully registerd, you are now logged in
                 printf("%s\n", command);
 
+                if (strcmp(response, "password OK.") != 0){
+                    // registration failed, the server closes the connection
+                    memset(command, '\0', sizeof(command));
+                    strcpy(command, "abort");
+                    break;
+                }
+
+                memset(token, '\0', sizeof(token));
+                readSocket(sockfd, token);
+                saveSession(user->username, token);
+
                 state = CL_LOGIN;
                 break;
 
@@ -318,7 +534,7 @@ main(int argc, char** argv)
             case READ_LOGIN_RESP:
                 memset(command, '\0', sizeof(command));
                 readSocket(sockfd, command);    // "OK"
-                state = SEND_LOGIN_USERNAME;
+                state = serverBusy(command) ? CL_INIT : SEND_LOGIN_USERNAME;
                 break;
 
             case SEND_LOGIN_USERNAME:
@@ -338,6 +554,11 @@ main(int argc, char** argv)
             case READ_LOGIN_USERNAME_RESP:
                 memset(command, '\0', sizeof(command));
                 readSocket(sockfd, command);
+
+                if (serverBusy(command)){
+                    state = CL_INIT;
+                    break;
+                }
                 if (strcmp(command, "Y") == 0){
                     printf("OK.\n");
                     state = SEND_LOGIN_PASSWORD;
@@ -372,6 +593,11 @@ main(int argc, char** argv)
                 readSocket(sockfd, command);
                 if (strcmp(command, "Y") == 0){
                     printf(ACCESS_GRANTED_MSG);
+
+                    memset(token, '\0', sizeof(token));
+                    readSocket(sockfd, token);
+                    saveSession(user->username, token);
+
                     state = CL_LOGIN;
                 }
                 else {
@@ -380,13 +606,71 @@ main(int argc, char** argv)
                 }
                 break;
 
+            case SEND_RESUME:
+                if (loadSession(username, token) != 0){
+                    printf(SESSION_EXPIRED_MSG);
+                    state = CL_INIT;
+                    break;
+                }
+
+                writeSocket(sockfd, RESUME_MSG);
+                writeSocket(sockfd, token);
+
+                state = READ_RESUME_RESP;
+                break;
+
+            case READ_RESUME_RESP:
+                memset(command, '\0', sizeof(command));
+                readSocket(sockfd, command);
+
+                if (serverBusy(command)){
+                    state = CL_INIT;
+                    break;
+                }
+                if (strcmp(command, "Y") == 0){
+                    strcpy(user->username, username);
+                    printf(ACCESS_GRANTED_MSG);
+                    state = CL_LOGIN;
+                }
+                else {
+                    forgetSession();
+                    printf(SESSION_EXPIRED_MSG);
+                    state = CL_INIT;
+                }
+                break;
+
+            case SEND_HOTEL:
+                memset(hotel, '\0', sizeof(hotel));
+                if (sscanf(command, "%*s %11s", hotel) != 1 || hotel[strspn(hotel, "0123456789")] != '\0' || atol(hotel) <= 0){
+                    printf("%s\n", "Usage: hotel <id>");
+                    state = CL_INIT;
+                    break;
+                }
+                writeSocket(sockfd, HOTEL_MSG);
+                writeSocket(sockfd, hotel);
+                state = READ_HOTEL_RESP;
+                break;
+
+            case READ_HOTEL_RESP:
+                memset(response, '\0', BUFSIZE);
+                readSocket(sockfd, response);
+
+                if (strcmp(response, "OK") == 0){
+                    printf("Hotel %s.\n", hotel);
+                }
+                else if (!serverBusy(response)){
+                    printf(UNKNOWN_HOTEL_MSG);
+                }
+                state = CL_INIT;
+                break;
+
             case CL_LOGIN:
                 
                 printf(ANSI_COLOR_YELLOW ANSI_BOLD "(%s)" ANSI_COLOR_RESET "> ", user->username);
 
                 // read input
                 memset(command, '\0', BUFSIZE);
-                fgets(command, 30, stdin);
+                fgets(command, 48, stdin);
 
             
                 // drop the new line and replace w/ the string termination
@@ -398,67 +682,41 @@ main(int argc, char** argv)
                 /////////////////////////////////////////////////
 
 
-                if      (regexMatch(command, REGEX_HELP)){
-                    state = SEND_HELP_LOGGED;
-                }
-                else if (regexMatch(command, REGEX_VIEW)) {
-                    state = SEND_VIEW;  
-                }
-                else if (regexMatch(command, REGEX_QUIT)){
-                    state = SEND_QUIT;
-                }
-                else if (regexMatch(command, REGEX_LOGOUT)){
-                    state = SEND_LOGOUT;
-                }
-                else {
+                found = findCommand(command);
+                state = found != NULL ? found->logged : INVALID_LOGGED_IN;
+
+                if (state == SEND_RESERVE || state == SEND_RELEASE){
                     // splitting input in its parts.
 
-                    memset(cmd,           '\0', sizeof cmd);
                     memset(booking->date, '\0', sizeof booking->date);
                     memset(booking->room, '\0', sizeof booking->room);
                     memset(booking->code, '\0', sizeof booking->code);
+                    memset(room_type,     '\0', sizeof room_type);
 
-                    sscanf(command, "%s %s %s %s", 
-                        cmd, booking->date, booking->room, booking->code
+                    sscanf(command, "%*s %10s %3s %5s", 
+                        booking->date, booking->room, booking->code
                     ); 
+                }
 
+                if (state == SEND_RESERVE){
+                    // second argument is the room type, not a room number
+                    sscanf(command, "%*s %*s %7s", room_type);
 
-                    if (regexMatch(cmd, REGEX_RESERVE)){
-                        if (regexMatch(booking->date, REGEX_DATE_FORMAT)){
-                            if (regexMatch(booking->date, REGEX_DATE_VALID)){
-                                state = SEND_RESERVE;        
-                            } else {
-                                printf(INVALID_DATE_MSG);
-                                state = CL_LOGIN;
-                            }
-                            
-                        }
-                        else{
-                            state = INVALID_DATE;
-                        }
+                    if (!isDateFormat(booking->date) || !isRoomType(room_type)){
+                        state = INVALID_DATE;
+                    }
+                    else if (!isDayOfMonth(booking->date) || normalizeDate(booking->date) != 0){
+                        printf(INVALID_DATE_MSG);
+                        state = CL_LOGIN;
                     }
-                    else if (regexMatch(cmd, REGEX_RELEASE)){
-
-                        if (regexMatch(booking->date, REGEX_DATE_FORMAT) && 
-                            regexMatch(booking->room, REGEX_ROOM) &&
-                            regexMatch(booking->code, REGEX_CODE))
-                        {
-                            if (regexMatch(booking->date, REGEX_DATE_VALID)){
-                                state = SEND_RELEASE;
-                            }
-                            else {
-                                printf(INVALID_DATE_MSG);
-                                state = CL_LOGIN;
-                            }
-                            
-                        }
-                        else {
-                            state = INVALID_RELEASE;
-                        }
-                    
+                }
+                else if (state == SEND_RELEASE){
+                    if (!isDateFormat(booking->date) || !isRoomNumber(booking->room) || !isReservationCode(booking->code)){
+                        state = INVALID_RELEASE;
                     }
-                    else {
-                        state = INVALID_LOGGED_IN;
+                    else if (!isDayOfMonth(booking->date) || normalizeDate(booking->date) != 0){
+                        printf(INVALID_DATE_MSG);
+                        state = CL_LOGIN;
                     }
                 }
                 break;
@@ -481,6 +739,7 @@ main(int argc, char** argv)
 
             case SEND_LOGOUT:
                 writeSocket(sockfd, LOGOUT_MSG);
+                forgetSession();
                 state = CL_INIT;
 
                 // to be used later when i'm logged in and display the username
@@ -491,6 +750,8 @@ main(int argc, char** argv)
             case SEND_RESERVE:
                 writeSocket(sockfd, RESERVE_MSG);
                 writeSocket(sockfd, booking->date);
+                writeSocket(sockfd, strlen(room_type) ? room_type : "any");
+                writeSocket(sockfd, "0");    // the hotel picked with `hotel`
                 state = READ_RESERVE_RESP;
                 break;
             
@@ -499,11 +760,23 @@ main(int argc, char** argv)
                 readSocket(sockfd, command);
 
 
-                if (strcmp(command, "BADDATE") == 0){
-                    printf("%s\n", "Wrong date format");
+                if (serverBusy(command)){
+                    // nothing reserved
+                }
+                else if (strcmp(command, "BADDATE") == 0){
+                    printf(OUT_OF_HORIZON_MSG, CALENDAR_HORIZON_YEARS);
+                }
+                else if (strcmp(command, "QUOTA") == 0){
+                    printf(QUOTA_REACHED_MSG, MAX_BOOKINGS_PER_USER);
+                }
+                else if (strcmp(command, "BADTYPE") == 0){
+                    printf("%s\n", "Unknown room type");
+                }
+                else if (strcmp(command, NO_HOTEL_MSG) == 0){
+                    printf(UNKNOWN_HOTEL_MSG);
                 }
                 else if (strcmp(command, "NOAVAL") == 0){
-                    printf("\x1b[31mNo room available on %s/2020\x1b[0m\n", booking->date);
+                    printf("\x1b[31mNo %s room available on %s\x1b[0m\n", strlen(room_type) ? room_type : "free", booking->date);
                 }
                 else if (strcmp(command, "RESOK") == 0){
                     memset(booking->room, '\0', sizeof(booking->room));
@@ -523,13 +796,16 @@ main(int argc, char** argv)
 
             case SEND_VIEW:
                 writeSocket(sockfd, VIEW_MSG);
+                writeSocket(sockfd, "0");    // the hotel picked with `hotel`
                 state = READ_VIEW_RESP;
                 break;
 
             case READ_VIEW_RESP:
                 memset(response, '\0', BUFSIZE);
                 readSocket(sockfd, response);
-                printf("%s\n", response);
+                if (!serverBusy(response)){
+                    printf("%s\n", response);
+                }
                 state = CL_LOGIN;
                 break;
 
@@ -538,6 +814,7 @@ main(int argc, char** argv)
                 writeSocket(sockfd, booking->date);
                 writeSocket(sockfd, booking->room);
                 writeSocket(sockfd, booking->code);
+                writeSocket(sockfd, "0");    // the hotel picked with `hotel`
 
                 state = READ_RELEASE_RESP;
                 break;
@@ -546,7 +823,9 @@ main(int argc, char** argv)
                 memset(response, '\0', BUFSIZE);
                 readSocket(sockfd, response);
 
-                printf("%s\n", response);
+                if (!serverBusy(response)){
+                    printf("%s\n", response);
+                }
                 state = CL_LOGIN;
 
                 break;
@@ -575,3 +854,475 @@ main(int argc, char** argv)
 }
 
 
+
+const ClientCommand*
+findCommand(const char* input)
+{
+    size_t n = strcspn(input, " \t");
+
+    for (size_t i = 0; i < sizeof(client_commands) / sizeof(client_commands[0]); i++){
+        if (strncmp(input, client_commands[i].name, n) == 0 && client_commands[i].name[n] == '\0'){
+            return &client_commands[i];
+        }
+    }
+    return NULL;
+}
+
+
+
+static int
+digits(const char* s, int n)
+{
+    for (int i = 0; i < n; i++){
+        if (!isdigit((unsigned char) s[i])){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+int
+isDateFormat(const char* date)
+{
+    size_t n = strlen(date);
+
+    if (n != 5 && n != 10){
+        return 0;
+    }
+    return digits(date, 2) && date[2] == '/' && digits(date + 3, 2) &&
+           (n == 5 || (date[5] == '/' && digits(date + 6, 4)));
+}
+
+
+
+int
+isDayOfMonth(const char* date)
+{
+    int d = (date[0] - '0') * 10 + (date[1] - '0');
+    int m = (date[3] - '0') * 10 + (date[4] - '0');
+
+    return m <= 12 && d <= 31 && (month_days[m] >> d & 1);
+}
+
+
+
+int
+isRoomNumber(const char* room)
+{
+    size_t n = strlen(room);
+
+    return n >= 1 && n <= 3 && room[0] != '0' && digits(room, (int) n);
+}
+
+
+
+int
+isRoomType(const char* type)
+{
+    return type[0] == '\0' || strcmp(type, "single") == 0 || strcmp(type, "double") == 0 || strcmp(type, "suite") == 0;
+}
+
+
+
+int
+isReservationCode(const char* code)
+{
+    size_t n = strlen(code);
+
+    for (size_t i = 0; i < n; i++){
+        if (!isalnum((unsigned char) code[i])){
+            return 0;
+        }
+    }
+    return n == RESERVATION_CODE_LENGTH - 1;
+}
+
+
+
+int
+normalizeDate(char* date)
+{
+    int y, m, d;
+
+    if (parseDate(date, currentYear(), &y, &m, &d) != 0){
+        return -1;
+    }
+
+    formatDate(daysFromCivil(y, m, d), date);
+    return 0;
+}
+
+
+
+void
+saveSession(const char* username, const char* token)
+{
+    // the token is as good as the password: only the user can read it
+    int   fd = open(SESSION_FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    FILE* f  = fd >= 0 ? fdopen(fd, "w") : NULL;
+
+    if (f == NULL){
+        if (fd >= 0) close(fd);
+        return;     // `resume` just won't be available
+    }
+    fprintf(f, "%s %s\n", username, token);
+    fclose(f);
+}
+
+
+
+int
+loadSession(char* username, char* token)
+{
+    int   rv = -1;
+    FILE* f  = fopen(SESSION_FILE_NAME, "r");
+
+    if (f == NULL){
+        return -1;
+    }
+    if (fscanf(f, "%15s %63s", username, token) == 2){
+        rv = 0;
+    }
+    fclose(f);
+    return rv;
+}
+
+
+
+void
+forgetSession()
+{
+    remove(SESSION_FILE_NAME);
+}
+
+
+
+int
+serverBusy(const char* reply)
+{
+    int retry;
+
+    if (strcmp(reply, READONLY_MSG) == 0){
+        printf(READ_ONLY_REPLICA_MSG);
+        return 1;
+    }
+    if (sscanf(reply, BUSY_MSG " %d", &retry) != 1){
+        return 0;
+    }
+    printf(SERVER_BUSY_MSG, retry);
+    return 1;
+}
+
+
+
+static uint64_t
+batchNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+
+
+int
+runBatch(Address* address, const char* path)
+{
+    FILE*   script = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    Batch   b;
+    char    line[BUFSIZE];
+    int     size = 0, lineno = 0, invalid = 0;
+    int*    logins;         // open addressing: username -> index of its last login
+    int     mask;
+
+    if (script == NULL){
+        perror(path);
+        return 2;
+    }
+
+    memset(&b, 0, sizeof(b));
+
+    while (fgets(line, sizeof(line), script) != NULL){
+        BatchCommand cmd;
+        int          rv;
+
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.line = lineno;
+
+        if ((rv = parseBatchLine(line, &cmd)) <= 0){
+            invalid += rv < 0;
+            continue;
+        }
+
+        if (b.count == size){
+            size = size > 0 ? 2 * size : 1024;
+            b.commands = (BatchCommand*) realloc(b.commands, size * sizeof(BatchCommand));
+            if (b.commands == NULL){
+                perror_die("realloc()");
+            }
+        }
+        b.commands[b.count++] = cmd;
+    }
+    if (script != stdin){
+        fclose(script);
+    }
+
+    if (invalid > 0){
+        fprintf(stderr, "%d invalid line%s, nothing was sent\n", invalid, invalid > 1 ? "s" : "");
+        free(b.commands);
+        return 2;
+    }
+
+    // every command waits for the last login of its user before it in the script
+    for (mask = 1; mask < 2 * b.count; mask <<= 1);
+    mask  -= 1;
+    logins = (int*) malloc((mask + 1) * sizeof(int));
+    b.retries = (int*) malloc((b.count + 1) * sizeof(int));
+    if (logins == NULL || b.retries == NULL){
+        perror_die("malloc()");
+    }
+    memset(logins, -1, (mask + 1) * sizeof(int));
+
+    for (int i = 0; i < b.count; i++){
+        BatchCommand* cmd  = &b.commands[i];
+        uint32_t      slot = hashString(cmd->username) & mask;
+
+        while (logins[slot] >= 0 && strcmp(b.commands[logins[slot]].username, cmd->username) != 0){
+            slot = (slot + 1) & mask;
+        }
+        cmd->login = logins[slot];
+        cmd->batch = &b;
+        if (cmd->op == BATCH_LOGIN || cmd->op == BATCH_REGISTER){
+            logins[slot] = i;
+        }
+    }
+    free(logins);
+
+
+    b.client = hotelClientCreate(address->ip, address->port, BATCH_CONNECTIONS);
+    if (b.client == NULL){
+        fprintf(stderr, "Invalid server address %s:%d\n", address->ip, address->port);
+        return 2;
+    }
+
+    uint64_t started = batchNow();
+
+    while (b.next < b.count || b.in_flight > 0 || b.retrying > 0){
+        uint64_t now = batchNow();
+
+        // turned down by the server: sent again once it's time, and once their login is through
+        for (int i = 0; i < b.retrying; ){
+            BatchCommand* cmd = &b.commands[b.retries[i]];
+
+            if (cmd->retry_at <= now && b.in_flight < BATCH_WINDOW && (cmd->login < 0 || b.commands[cmd->login].done)){
+                b.retries[i] = b.retries[--b.retrying];
+                sendBatchCommand(&b, cmd);
+            }
+            else {
+                i++;
+            }
+        }
+
+        while (b.next < b.count && b.in_flight < BATCH_WINDOW){
+            sendBatchCommand(&b, &b.commands[b.next++]);
+        }
+
+        if (hotelClientPoll(b.client, b.in_flight > 0 ? 100 : BATCH_LOGIN_WAIT) < 0){
+            perror("poll()");
+            break;
+        }
+    }
+
+    uint64_t elapsed = batchNow() - started;
+
+    hotelClientDestroy(b.client);
+
+    fprintf(stderr, "%d commands in %.3f s: %d ok, %d refused, %d failed\n",
+        b.count, elapsed / 1000.0, b.ok, b.refused, b.failed
+    );
+
+    free(b.commands);
+    free(b.retries);
+
+    return b.ok == b.count ? 0 : 1;
+}
+
+
+
+int
+parseBatchLine(char* line, BatchCommand* cmd)
+{
+    char op[16], extra[2];
+    char username[64], password[64];    // longer than allowed, to tell them apart
+    char room[8];
+    int  n;
+
+    const ClientCommand* found;
+
+    memset(op, '\0', sizeof(op));
+    n = sscanf(line, "%15s", op);
+    if (n != 1 || op[0] == '#'){
+        return 0;
+    }
+    lower(op);
+
+    found   = findCommand(op);
+    cmd->op = found != NULL ? found->batch : BATCH_NONE;
+
+    if (cmd->op == BATCH_REGISTER || cmd->op == BATCH_LOGIN){
+        n = sscanf(line, "%*s %63s %63s %1s", username, password, extra);
+
+        if (n != 2 || strlen(password) < PASSWORD_MIN_LENGTH || strlen(password) > PASSWORD_MAX_LENGTH - 1){
+            fprintf(stderr, "line %d: usage: %s <username> <password> (%d-%d characters)\n", cmd->line, op, PASSWORD_MIN_LENGTH, PASSWORD_MAX_LENGTH - 1);
+            return -1;
+        }
+        strcpy(cmd->password, password);
+    }
+    else if (cmd->op == BATCH_RESERVE){
+        n = sscanf(line, "%*s %63s %10s %7s %1s", username, cmd->date, cmd->room_type, extra);
+        lower(cmd->room_type);
+
+        if (n < 2 || n > 3 || !isDateFormat(cmd->date) || !isRoomType(cmd->room_type)){
+            fprintf(stderr, "line %d: usage: reserve <username> <dd/mm[/yyyy]> [single|double|suite]\n", cmd->line);
+            return -1;
+        }
+    }
+    else if (cmd->op == BATCH_RELEASE){
+        n = sscanf(line, "%*s %63s %10s %7s %5s %1s", username, cmd->date, room, cmd->code, extra);
+
+        if (n != 4 || !isDateFormat(cmd->date) || !isRoomNumber(room) || !isReservationCode(cmd->code)){
+            fprintf(stderr, "line %d: usage: release <username> <dd/mm[/yyyy]> <room> <code>\n", cmd->line);
+            return -1;
+        }
+        cmd->room = atoi(room);
+    }
+    else if (cmd->op == BATCH_VIEW){
+        n = sscanf(line, "%*s %63s %1s", username, extra);
+
+        if (n != 1){
+            fprintf(stderr, "line %d: usage: view <username>\n", cmd->line);
+            return -1;
+        }
+    }
+    else {
+        fprintf(stderr, "line %d: unknown command `%s`\n", cmd->line, op);
+        return -1;
+    }
+
+    lower(username);
+    if (strlen(username) < USERNAME_MIN_LENGTH || strlen(username) > USERNAME_MAX_LENGTH - 1){
+        fprintf(stderr, "line %d: invalid username `%s`\n", cmd->line, username);
+        return -1;
+    }
+    strcpy(cmd->username, username);
+    if ((cmd->op == BATCH_RESERVE || cmd->op == BATCH_RELEASE) && 
+        (!isDayOfMonth(cmd->date) || normalizeDate(cmd->date) != 0))
+    {
+        fprintf(stderr, "line %d: invalid date `%s`\n", cmd->line, cmd->date);
+        return -1;
+    }
+    return 1;
+}
+
+
+
+void
+sendBatchCommand(Batch* b, BatchCommand* cmd)
+{
+    int rv = -1;
+
+    b->in_flight++;
+    switch (cmd->op){
+        case BATCH_REGISTER:
+            rv = hotelClientRegister(b->client, cmd->username, cmd->password, batchCommandDone, cmd);
+            break;
+        case BATCH_LOGIN:
+            rv = hotelClientLogin(b->client, cmd->username, cmd->password, batchCommandDone, cmd);
+            break;
+        case BATCH_RESERVE:
+            rv = hotelClientReserve(b->client, cmd->username, cmd->date, strlen(cmd->room_type) ? cmd->room_type : NULL, batchCommandDone, cmd);
+            break;
+        case BATCH_RELEASE:
+            rv = hotelClientRelease(b->client, cmd->username, cmd->date, cmd->room, cmd->code, batchCommandDone, cmd);
+            break;
+        case BATCH_VIEW:
+            rv = hotelClientView(b->client, cmd->username, batchCommandDone, cmd);
+            break;
+        default:
+            break;
+    }
+
+    if (rv != 0){
+        HotelReply reply;
+
+        memset(&reply, 0, sizeof(reply));
+        reply.status = HOTEL_ERROR;
+        batchCommandDone(cmd, &reply);
+    }
+}
+
+
+
+void
+batchCommandDone(void* arg, const HotelReply* reply)
+{
+    static const char* names[] = { "register", "login", "reserve", "release", "view" };
+
+    BatchCommand* cmd   = (BatchCommand*) arg;
+    Batch*        b     = cmd->batch;
+    int           retry = -1;
+
+    b->in_flight--;
+
+    if (reply->status == HOTEL_BUSY){
+        retry = reply->retry_ms;
+    }
+    else if (reply->status == HOTEL_EXPIRED && cmd->login >= 0 && !b->commands[cmd->login].done){
+        retry = BATCH_LOGIN_WAIT;     // the login was turned down and waits to be sent again
+    }
+    if (retry >= 0){
+        cmd->retry_at = batchNow() + retry;
+        b->retries[b->retrying++] = (int) (cmd - b->commands);
+        return;
+    }
+
+    cmd->done = 1;
+    printf("%d %s %s ", cmd->line, names[cmd->op], cmd->username);
+
+    switch (reply->status){
+        case HOTEL_OK:
+            b->ok++;
+            if (cmd->op == BATCH_RESERVE){
+                printf("OK %s room %d code %s\n", cmd->date, reply->room, reply->code);
+            }
+            else if (cmd->op == BATCH_VIEW){
+                printf("OK\n%s\n", reply->text);
+            }
+            else {
+                printf("OK\n");
+            }
+            break;
+
+        case HOTEL_REFUSED:
+            b->refused++;
+            // the reason, when it's a word (a replica's READONLY comes with any command)
+            printf("REFUSED %s\n", reply->text != NULL && (cmd->op == BATCH_RESERVE || strcmp(reply->text, READONLY_MSG) == 0) ? reply->text : "");
+            break;
+
+        case HOTEL_EXPIRED:
+            b->failed++;
+            printf("FAILED not logged in\n");
+            break;
+
+        default:
+            b->failed++;
+            printf("FAILED connection error\n");
+            break;
+    }
+}
@@ -24,8 +24,15 @@
 
 
 
-#define NUM_THREADS             2       // # threads
+#ifndef NUM_THREADS
+#define NUM_THREADS             2       // # threads, each one running an event loop over its sessions
+#endif
 #define NUM_CONNECTION          10      // # queued connections
+#ifndef STORAGE_ENGINE
+#define STORAGE_ENGINE          STORAGE_SQLITE  // STORAGE_SQLITE or STORAGE_JOURNAL (see `Storage.h`)
+#endif
+#define DATABASE_BUSY_TIMEOUT   2000    // ms a connection waits for another one holding the database lock
+#define JOURNAL_SYNC_EVERY      1       // msync the journal every N appends, 0 leaves it to the kernel
 
 #define MAX_BOOKINGS_PER_USER   5       // max number of bookings allowed for each user
 
@@ -34,6 +41,9 @@
 #define USERNAME_MAX_LENGTH     16
 #define USERNAME_MIN_LENGTH     2
 
+#define SESSION_TOKENS_MAX      4096    // live session tokens, the oldest is replaced when full
+#define SESSION_TOKEN_TTL       (24 * 60 * 60)  // seconds a session token stays valid after its last use
+
 
 
 #define DEBUG                   1       // debug mode: prints messages to the console
@@ -59,22 +69,91 @@
 #define DATA_FOLDER             ".data"
 
 // USER_FILE and DATABASE will be saved inside DATA_FOLDER/
-#define USER_FILE_NAME          "users.txt"         ///< text file containig users and relative encrypted passwords
+#define USER_FILE_NAME          "users.txt"         ///< legacy text file of users and encrypted passwords, imported once into USER_TABLE_NAME
+#define USER_TABLE_NAME         "users.bin"         ///< registered users and encrypted passwords (see `UserTable.h`)
 #define DATABASE_NAME           "bookings.db"
+#define JOURNAL_NAME            "bookings.journal"  ///< used instead of DATABASE_NAME when STORAGE_ENGINE is STORAGE_JOURNAL
+#define ARCHIVE_FOLDER_NAME     "archive"           ///< per-year occupancy of the years that left the booking horizon
+#define METRICS_FILE_NAME       "metrics.txt"       ///< rewritten every METRICS_INTERVAL seconds and on SIGUSR1
+#define SPANS_FILE_NAME         "spans.json"        ///< Chrome trace of the last spans of every thread, written on SIGUSR2 (SPAN_TRACING)
+#define SNAPSHOT_NAME           "snapshot.bin"      ///< live bookings, rewritten every SNAPSHOT_INTERVAL seconds (see `Snapshot.h`)
+#define SESSION_FILE_NAME       ".hotel_session"    ///< client side, in the working directory: username and session token of the last login
+#define REPLICA_MARK_NAME       "follower"          ///< marks the data folder of a follower, emptied at every start (see `Replication.h`)
+#define ROOM_CATALOG_NAME       "rooms.txt"         ///< room numbers and types (see `Inventory.h`). If missing, rooms 1..N are all singles.
 
 
 
 ////////////////////////// miscellaneous //////////////////////////
 
 #define BUFSIZE                 2048    // buffer size: maximum length of messages
-#define BACKLOG                 10      // listen() function parameter
+#define BACKLOG                 128     // listen() function parameter
+
+#define SESSION_INPUT_SIZE      128     // bytes of client frames a session buffers: the longest frame a client sends is a session token
+#define SESSION_OUTPUT_SIZE     (2 * BUFSIZE)   // replies a thread frames before sending them at once
+#define EVENT_LOOP_BATCH        64      // readiness events handled per wait
+#ifndef IO_URING
+#define IO_URING                1       // Linux: event loops on io_uring (see `Uring.h`), epoll if the kernel refuses it
+#endif
+#define URING_ENTRIES           256     // submission entries of each event loop ring
+
+#define ADMISSION_LOGIN_DELAY   20      // ms of expected queue delay over which new logins and registrations are turned down
+#define ADMISSION_SHED_DELAY    200     // ms of expected queue delay over which logged-in commands are turned down too
+#define ADMISSION_RETRY_MIN     10      // ms, bounds of the retry time suggested to the clients turned down
+#define ADMISSION_RETRY_MAX     2000
+
+#ifndef RATE_LIMIT
+#define RATE_LIMIT              1       // token bucket per user and per client IP for each command class (see `RateLimit.h`)
+#endif
+#define RATE_LIMIT_SLOTS        (1 << 16)   // buckets, enough for the clients active at the same time
+#define RATE_LIMIT_IP_FACTOR    8       // an IP bucket is this many times a user bucket (users behind the same address)
+#define RATE_LOGIN_PER_SECOND   1       // login, register and resume attempts
+#define RATE_LOGIN_BURST        5
+#define RATE_BOOKING_PER_SECOND 10      // reserve and release
+#define RATE_BOOKING_BURST      20
+#define RATE_VIEW_PER_SECOND    20      // view
+#define RATE_VIEW_BURST         40
+
+#define USER_TABLE_CAPACITY     (1 << 16)   // users that can register (fixed when the user table is created)
+#define USER_CACHE_MAX_USERS    1024    // users whose reservations are kept in memory to serve `view`
+#define ARENA_SIZE              (16 * 1024) // bytes of session and request scoped memory of each thread
+
+#define METRICS_INTERVAL        60      // seconds between two metrics reports
+#define METRICS_TOP_USERS       5       // heaviest users listed in the metrics report
+#define SNAPSHOT_INTERVAL       300     // seconds between two snapshots (taken only if bookings changed)
+#ifndef SPAN_TRACING
+#define SPAN_TRACING            0       // time the FSM states, storage calls and socket operations, dumped on SIGUSR2 (see `Spans.h`)
+#endif
+#define SPAN_BUFFER_EVENTS      (1 << 16)   // spans each thread keeps, the last ones (32 bytes each)
+#define SPAN_MAX_THREADS        64      // threads recording spans
+#ifndef LOCK_PROFILING
+#define LOCK_PROFILING          0       // wait and hold time of every place a lock is taken (see `LockProfile.h`)
+#endif
+#define LOCK_PROFILE_DEPTH      8       // locks a thread holds at once that get their hold time counted
+#define LOCK_PROFILE_INTERVAL   10      // seconds between two console summaries of the lock waits
+#define LOCK_PROFILE_TOP        5       // sites in a summary
+#define TRAFFIC_TRACE_FLUSH_MS  1000    // ms a traffic record (`--record`) may wait in the buffer before reaching the file
+
+#define REPLICATION_LOG_SIZE    (1 << 16)   // booking changes kept for followers to catch up, a follower further behind gets a snapshot
+#define REPLICATION_MAX_FOLLOWERS 8     // followers a primary ships its changes to (see `Replication.h`)
+#define REPLICATION_HEARTBEAT_MS 100    // ms between two heartbeats to an idle follower
+#define REPLICATION_MAX_STALENESS 1000  // ms a follower may lag behind the primary before turning `view` down
+#define REPLICATION_RETRY_MS    500     // ms between two attempts of a follower to reach its primary
+
+#define ROUTER_MAX_SHARDS       64      // server processes a router spreads the hotels over (see `HashRing.h`)
+#define ROUTER_VNODES           128     // points of each shard on the hash ring: the more, the more even the spread
+#define ROUTER_BUFFER_SIZE      (2 * BUFSIZE)   // bytes a router buffers in each direction of a session
 
 
 
 ////////////////////////// design directives //////////////////////////
 
 #define ENCRYPT_PASSWORD        1
-#define RESERVATION_CODE_LENGTH 6       // 5 + '\0'     // carefeul, if you change this the regex `REGEX_CODE` has to be manually changed.
+#define RESERVATION_CODE_LENGTH 6       // 5 + '\0'     // careful, codes are checked by `isReservationCode()` in client.c
+#define HOTEL_MAX_ROOMS         1000    // rooms are numbered 1..999 (see `isRoomNumber()` in client.c)
+#define ROOM_STRING_LENGTH      5       // digits of HOTEL_MAX_ROOMS + '\0'     // careful, grow it with HOTEL_MAX_ROOMS
+#define HOTEL_ID_DEFAULT        1       // hotel of sessions that don't pick one, and of bookings stored before hotels had an ID
+#define HOTELS_MAX              64      // hotels a server process holds the occupancy of (made on their first booking)
+#define CALENDAR_HORIZON_YEARS  3       // bookings are accepted for the current year and the following ones, up to this many years.
 
 
 
@@ -25,12 +25,14 @@
     \x1b[36m help     \x1b[0m show available commands\n\
     \x1b[36m register \x1b[0m register an account\n\
     \x1b[36m login    \x1b[0m log into the system\n\
+    \x1b[36m resume   \x1b[0m log in again with the last session\n\
+    \x1b[36m hotel    \x1b[0m pick the hotel (first command only)\n\
     \x1b[36m quit     \x1b[0m log out and quit\n"
     
     #define HELP_LOGGED_IN_MESSAGE "Commands:\n\
     \x1b[36m help                                 \x1b[0m show available commands\n\
-    \x1b[36m reserve [date (dd/mm)]               \x1b[0m book a room\n\
-    \x1b[36m release [date (dd/mm)] [room] [code] \x1b[0m cancel a booking\n\
+    \x1b[36m reserve [date (dd/mm[/yyyy])] [type] \x1b[0m book a room\n\
+    \x1b[36m release [date] [room] [code]         \x1b[0m cancel a booking\n\
     \x1b[36m view                                 \x1b[0m show current bookings\n\
     \x1b[36m logout                               \x1b[0m log out\n\
     \x1b[36m quit                                 \x1b[0m log out and quit\n"
@@ -43,16 +45,18 @@
     #define HELP_UNLOGGED_MESSAGE "Commands:\n\
     \x1b[36m register                             \x1b[0m register an account\n\
     \x1b[36m login                                \x1b[0m log into the system\n\
+    \x1b[36m resume                               \x1b[0m log in again with the last session\n\
+    \x1b[36m hotel [id]                           \x1b[0m pick the hotel (first command only)\n\
     \x1b[36m quit                                 \x1b[0m quit\n\
     \x1b[36m help                                 \x1b[0m show available commands\n\n\
     \x1b[36m logout                               \x1b[0m log out                 (log-in required)\n\
-    \x1b[36m reserve [date (dd/mm)]               \x1b[0m book a room             (log-in required)\n\
-    \x1b[36m release [date (dd/mm)] [room] [code] \x1b[0m cancel a booking        (log-in required)\n\
+    \x1b[36m reserve [date (dd/mm[/yyyy])] [type] \x1b[0m book a room             (log-in required)\n\
+    \x1b[36m release [date] [room] [code]         \x1b[0m cancel a booking        (log-in required)\n\
     \x1b[36m view                                 \x1b[0m show current bookings   (log-in required)\n"
     
     #define HELP_LOGGED_IN_MESSAGE "Commands:\n\
-    \x1b[36m reserve [date (dd/mm)]               \x1b[0m book a room\n\
-    \x1b[36m release [date (dd/mm)] [room] [code] \x1b[0m cancel a booking\n\
+    \x1b[36m reserve [date (dd/mm[/yyyy])] [type] \x1b[0m book a room\n\
+    \x1b[36m release [date] [room] [code]         \x1b[0m cancel a booking\n\
     \x1b[36m view                                 \x1b[0m show current bookings\n\
     \x1b[36m logout                               \x1b[0m log out\n\
     \x1b[36m quit                                 \x1b[0m log out and quit\n\
@@ -63,14 +67,20 @@
 
 #define INVALID_COMMAND_MESSAGE         "\x1b[31mInvalid command.\x1b[0m\n"
 #define UNREGISTERED_USERNAME_ERR_MSG   "\x1b[31mUnregistered username.\x1b[0m\nGo ahead and register first.\n"
-#define INVALID_DATE_MSG                "\x1b[31mInvalid date.\x1b[0m Make sure the day actually exists in 2020.\n"
-#define INVALID_FORMAT_RESERVE_MSG      "\x1b[31mInvalid format.\x1b[0m Make sure the foramt is:\n\t        reserve [dd/mm]\n"
-#define INVALID_FORMAT_RELEASE_MSG      "\x1b[31mInvalid format.\x1b[0m Make sure the format is:\n\t        release [dd/mm] [room] [code]\n"
+#define INVALID_DATE_MSG                "\x1b[31mInvalid date.\x1b[0m Make sure the day actually exists.\n"
+#define INVALID_FORMAT_RESERVE_MSG      "\x1b[31mInvalid format.\x1b[0m Make sure the foramt is:\n\t        reserve [dd/mm] or reserve [dd/mm/yyyy]\n\t        optionally followed by the room type: single, double or suite\n"
+#define INVALID_FORMAT_RELEASE_MSG      "\x1b[31mInvalid format.\x1b[0m Make sure the format is:\n\t        release [dd/mm[/yyyy]] [room] [code]\n"
 #define WRONG_PASSWORD_MSG              "\x1b[31m\033[1mwrong password.\x1b[0m Try to login again...\n"
 #define ACCESS_GRANTED_MSG              "OK, access granted.\n"
 #define USERNAME_TAKEN_MSG              "\x1b[31m\033[1musername already taken.\x1b[0m\n"
 #define USERNAME_PROMPT_MSG             "Insert username: "
 #define PASSWORD_PROMPT_MSG             "Insert password: "
+#define QUOTA_REACHED_MSG               "\x1b[31mBooking limit reached.\x1b[0m You can hold at most %d active reservations.\n"
+#define SESSION_EXPIRED_MSG             "\x1b[31mSession expired.\x1b[0m Please login again.\n"
+#define SERVER_BUSY_MSG                 "\x1b[33mServer busy.\x1b[0m Try again in %d ms.\n"
+#define READ_ONLY_REPLICA_MSG           "\x1b[33mRead-only server.\x1b[0m This one is a replica: register, reserve and release on the primary.\n"
+#define UNKNOWN_HOTEL_MSG               "\x1b[31mNo such hotel.\x1b[0m A connection picks its hotel with its first command, and keeps it.\n"
+#define OUT_OF_HORIZON_MSG              "\x1b[31mDate out of the booking horizon.\x1b[0m Bookings are open for %d years starting from the current one.\n"
 
 
 
@@ -82,9 +92,16 @@
 #define LOGIN_MSG                       "l"
 #define QUIT_MSG                        "q"
 #define LOGOUT_MSG                      "lgt"
+#define RESUME_MSG                      "rsm"
 #define VIEW_MSG                        "v"
 #define RESERVE_MSG                     "res"
 #define RELEASE_MSG                     "rel"
+#define HOTEL_MSG                       "htl"       // followed by the hotel ID
+
+#define BUSY_MSG                        "BUSY"      // server reply: "BUSY <ms>", turned down, retry after <ms>
+#define READONLY_MSG                    "READONLY"  // server reply of a follower to register, reserve and release
+#define NO_HOTEL_MSG                    "NOHOTEL"   // server reply to `htl` for a hotel it can't hold (HOTELS_MAX) or other than the connection's, and to `reserve` for another hotel than the session's
+#define OTHER_HOTEL_MSG                 "\x1b[31mFailed. \x1b[0mThe session is in another hotel: connect again and pick it with `hotel <id>` first."   // server reply to `release` and `view` for another hotel than the session's
 
 
 
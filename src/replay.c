@@ -0,0 +1,759 @@
+/**
+ * @name            hotel-booking
+ * @file            replay.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Sat Oct 31 15:04:51 CET 2026
+ * @brief           replay: drives a server with the client traffic another one recorded
+ *
+ * *compilation     `make replay` or `gcc replay.c -o replay`
+ *
+ *
+ * usage            ./replay <ip> <port> <trace> [--speed <x>] [--save <results>] [--baseline <results>]
+ *
+ * The trace is written by a server started with `--record <trace>` (see
+ * `TrafficTrace.h`). Every recorded session gets a connection of its own and
+ * each frame is sent to it when it arrived at the recording server, divided
+ * by the speed (`--speed 4`: four times as fast), in the order recorded:
+ * the interleaving of the sessions is the recorded one. Reservation codes and
+ * session tokens sent back by the clients are swapped for the ones the
+ * server being driven handed out; a frame carrying one not handed out yet
+ * holds the whole replay until it is (at most REPLAY_HOLD_MS).
+ *
+ * Reported: for each command, the latency from its last frame to the first
+ * reply, percentiles over the replay. The replay doesn't wait for replies
+ * (the recorded times say when to send): a command sent before the reply to
+ * the previous one came in shares its sample. `--save` writes them to a file;
+ * `--baseline` prints the difference with a file saved by a previous replay,
+ * e.g. of the same trace against another server build.
+ *
+ * Replay against a copy of the data folder taken when the recording started:
+ * the recorded sessions expect the users and the bookings of that moment.
+ * Speeding up makes the commands of a user closer to each other than the
+ * rate limits allow: build the server with -DRATE_LIMIT=0 (or raise them) to
+ * measure anything else than BUSY replies.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// networking
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <arpa/inet.h>
+
+
+/* user-defined headers */
+
+#include "config.h"
+#include "messages.h"
+#include "utils.h"
+#include "Address.h"
+#include "EventLoop.h"
+#include "TrafficTrace.h"
+
+
+#define REPLAY_BUFFER_SIZE      (SESSION_OUTPUT_SIZE + 4)   // the longest reply frame
+#define REPLAY_HOLD_MS          5000    // ms a frame may wait for the code or token it carries to be handed out
+#define REPLAY_DRAIN_MS         5000    // ms the replies still due are waited for at the end
+
+
+typedef struct replay_record {
+    uint64_t        time;
+    uint32_t        session;
+    uint16_t        kind;               // trace_kind_t
+    uint16_t        length;
+    char*           data;               // NUL-terminated
+} ReplayRecord;
+
+
+typedef struct replay_issued {
+    uint64_t        time;               // recorded
+    uint32_t        session;
+    uint32_t        frame;              // reply frame of the session carrying it
+    char            recorded[SESSION_INPUT_SIZE];
+    char            replayed[SESSION_INPUT_SIZE];  // "" until handed out by the server being driven
+} ReplayIssued;
+
+
+typedef struct replay_conn {
+    int             fd;                 // -1 once closed
+    int             closing;            // the recorded session closed: close once the last reply is in
+    uint32_t        frames_in;          // reply frames received
+    int             waiting;            // a command was sent, its first reply hasn't come yet
+    uint64_t        sent_at;            // us, last frame sent
+    int             command;            // index in `commands_g` of the last command word sent
+
+    char            in[REPLAY_BUFFER_SIZE];
+    uint32_t        in_used;
+} ReplayConn;
+
+
+typedef struct replay_command {
+    const char*     word;               // first frame of the command
+    const char*     name;
+    uint32_t*       samples;            // latencies, us
+    uint32_t        count;
+    uint32_t        size;
+} ReplayCommand;
+
+
+static ReplayCommand    commands_g[] = {
+    { "",               "other" },      // frames sent before any command word
+    { REGISTER_MSG,     "register" },
+    { LOGIN_MSG,        "login" },
+    { RESUME_MSG,       "resume" },
+    { HOTEL_MSG,        "hotel" },
+    { RESERVE_MSG,      "reserve" },
+    { RELEASE_MSG,      "release" },
+    { VIEW_MSG,         "view" },
+    { LOGOUT_MSG,       "logout" },
+    { QUIT_MSG,         "quit" },
+    { HELP_MSG,         "help" },
+};
+static const int        commands_count_g = sizeof(commands_g) / sizeof(commands_g[0]);
+
+static struct sockaddr_in   server_g;
+static int                  poller_g;
+
+static ReplayIssued*    issued_g;               // sorted by session and frame
+static uint32_t         issued_count_g;
+static ReplayIssued**   issued_by_value_g;      // sorted by recorded value and time
+
+static ReplayConn**     conns_g;                // by recorded session ID
+static uint32_t         conns_size_g;
+
+// totals
+static uint64_t         frames_sent_g;
+static uint64_t         swapped_g;              // codes and tokens swapped
+static uint64_t         unswapped_g;            // sent as recorded: never handed out
+static uint64_t         failures_g;             // sessions the server refused, or dropped before replying
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+/** @brief  Reads the whole trace, indexing the codes and tokens handed out.
+ *  @return number of records, -1 if the trace can't be read
+ */
+int         replayLoad(const char* path, ReplayRecord** records);
+
+/** @brief  Replays one record.
+ *  @return 0 if done, 1 if it has to wait for the code or token it carries
+ */
+int         replayStep(const ReplayRecord* r, uint64_t now);
+
+/** @brief  Reads the replies of a session, timing the commands and picking
+ *          up the codes and tokens handed out.
+ *  @return 0 if OK, -1 if the server closed the session
+ */
+int         replayReceive(uint32_t session, ReplayConn* c, uint64_t now);
+
+/** @brief  Prints the latency of each command, saves it and compares it with a baseline.
+ *  @return Void
+ */
+void        replayReport(double elapsed, const char* save, const char* baseline);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+main(int argc, char** argv)
+{
+    Address       address = readArguments(argc, argv);
+    ReplayRecord* records;
+    PollerEvent   events[EVENT_LOOP_BATCH];
+    double        speed    = 1.0;
+    const char*   save     = NULL;
+    const char*   baseline = NULL;
+    int           count;
+
+    if (argc < 4){
+        printf("Usage: %s <ip> <port> <trace> [--speed <x>] [--save <results>] [--baseline <results>]\n", argv[0]);
+        exit(-1);
+    }
+    for (int i = 4; i < argc; i++){
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0){
+            speed = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc){
+            save = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc){
+            baseline = argv[++i];
+        }
+        else {
+            printf("\x1b[31mbad option %s\x1b[0m\n", argv[i]);
+            exit(-1);
+        }
+    }
+
+    count = replayLoad(argv[3], &records);
+    if (count < 0){
+        printf("\x1b[31mCould not read the trace %s.\x1b[0m\n", argv[3]);
+        exit(-1);
+    }
+
+    memset(&server_g, '\0', sizeof(server_g));
+    server_g.sin_family      = AF_INET;
+    server_g.sin_port        = htons(address.port);
+    server_g.sin_addr.s_addr = inet_addr(address.ip);
+
+    poller_g = pollerCreate();
+    if (poller_g < 0){
+        perror_die("pollerCreate()");
+    }
+
+    printf("%d records, %u codes and tokens, %.1f s recorded, replaying at %gx...\n",
+            count, issued_count_g, count > 0 ? records[count - 1].time / 1e6 : 0.0, speed);
+
+
+    uint64_t start  = trafficTraceNow();
+    uint64_t held   = 0;        // us the replay spent waiting for codes and tokens, the schedule is shifted by it
+    uint64_t hold   = 0;        // since when the next record is held, 0 if it isn't
+    uint64_t drain  = 0;        // since when the trace is over
+    int      next   = 0;
+
+    while (1)
+    {
+        uint64_t now = trafficTraceNow();
+        int      timeout;
+        int      n;
+
+        // records due
+        while (next < count && start + held + (uint64_t) (records[next].time / speed) <= now){
+            if (replayStep(&records[next], now) != 0){
+                if (hold == 0){
+                    hold = now;
+                }
+                if (now - hold < REPLAY_HOLD_MS * 1000){
+                    break;
+                }
+                // never handed out: goes as recorded
+                unswapped_g++;
+                replayStep(&records[next], 0);
+            }
+            if (hold != 0){
+                held += now - hold;
+                hold  = 0;
+            }
+            next++;
+        }
+
+        if (next == count){
+            int waiting = 0;
+
+            if (drain == 0){
+                drain = now;
+            }
+            for (uint32_t i = 0; i < conns_size_g; i++){
+                waiting += conns_g[i] != NULL && conns_g[i]->fd >= 0 && conns_g[i]->waiting;
+            }
+            if (!waiting || now - drain >= REPLAY_DRAIN_MS * 1000){
+                break;
+            }
+        }
+
+        // until the next record is due, the replies permitting
+        if (hold != 0 || next == count){
+            timeout = 1;
+        }
+        else {
+            uint64_t due = start + held + (uint64_t) (records[next].time / speed);
+
+            timeout = due > now ? (int) ((due - now + 999) / 1000) : 0;
+        }
+
+        n = pollerWait(poller_g, events, EVENT_LOOP_BATCH, timeout);
+        now = trafficTraceNow();
+
+        for (int i = 0; i < n; i++){
+            uint32_t    session = (uint32_t) (uintptr_t) events[i].data;
+            ReplayConn* c       = conns_g[session];
+
+            if (c->fd < 0){
+                continue;
+            }
+            if (replayReceive(session, c, now) != 0 || (c->closing && !c->waiting)){
+                // gone while the recorded client was still there
+                if (c->waiting && !c->closing){
+                    failures_g++;
+                }
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+    }
+
+    double elapsed = (double) (trafficTraceNow() - start) / 1e6;
+
+    for (uint32_t i = 0; i < conns_size_g; i++){
+        if (conns_g[i] != NULL && conns_g[i]->fd >= 0){
+            close(conns_g[i]->fd);
+        }
+    }
+
+    replayReport(elapsed, save, baseline);
+
+    return failures_g == 0 ? 0 : 1;
+}
+
+
+
+static int
+compareIssued(const void* a, const void* b)
+{
+    const ReplayIssued* x = (const ReplayIssued*) a;
+    const ReplayIssued* y = (const ReplayIssued*) b;
+
+    if (x->session != y->session){
+        return x->session < y->session ? -1 : 1;
+    }
+    return x->frame < y->frame ? -1 : x->frame > y->frame;
+}
+
+
+static int
+compareIssuedValue(const void* a, const void* b)
+{
+    const ReplayIssued* x = *(ReplayIssued* const*) a;
+    const ReplayIssued* y = *(ReplayIssued* const*) b;
+    int                 c = strcmp(x->recorded, y->recorded);
+
+    if (c != 0){
+        return c;
+    }
+    return x->time < y->time ? -1 : x->time > y->time;
+}
+
+
+int
+replayLoad(const char* path, ReplayRecord** records)
+{
+    FILE*         in = fopen(path, "rb");
+    char          magic[8];
+    uint64_t      wall;
+    char          data[REPLAY_BUFFER_SIZE];
+    TrafficRecord r;
+    int           count = 0, size = 1024, rv;
+    uint32_t      issued_size = 64;
+
+    if (in == NULL){
+        return -1;
+    }
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, TRAFFIC_TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&wall, sizeof(wall), 1, in) != 1){
+        fclose(in);
+        return -1;
+    }
+
+    *records  = (ReplayRecord*) malloc(size * sizeof(ReplayRecord));
+    issued_g  = (ReplayIssued*) malloc(issued_size * sizeof(ReplayIssued));
+    if (*records == NULL || issued_g == NULL){
+        fclose(in);
+        return -1;
+    }
+
+    while ((rv = trafficTraceRead(in, &r, data, sizeof(data))) == 0){
+        if (r.kind == TRACE_ISSUED){
+            uint32_t frame;
+
+            if (r.length < sizeof(frame)){
+                continue;
+            }
+            if (issued_count_g == issued_size){
+                ReplayIssued* grown = (ReplayIssued*) realloc(issued_g, 2 * issued_size * sizeof(ReplayIssued));
+
+                if (grown == NULL){
+                    rv = -2;
+                    break;
+                }
+                issued_g     = grown;
+                issued_size *= 2;
+            }
+            memcpy(&frame, data, sizeof(frame));
+
+            ReplayIssued* issued = &issued_g[issued_count_g++];
+
+            memset(issued, '\0', sizeof(ReplayIssued));
+            issued->time    = r.time;
+            issued->session = r.session;
+            issued->frame   = frame;
+            strncpy(issued->recorded, data + sizeof(frame), sizeof(issued->recorded) - 1);
+            continue;   // nothing to send
+        }
+
+        if (count == size){
+            ReplayRecord* grown = (ReplayRecord*) realloc(*records, 2 * size * sizeof(ReplayRecord));
+
+            if (grown == NULL){
+                rv = -2;
+                break;
+            }
+            *records = grown;
+            size    *= 2;
+        }
+        if (r.session >= conns_size_g){
+            uint32_t     wanted = r.session + 1 > 2 * conns_size_g ? r.session + 1 : 2 * conns_size_g;
+            ReplayConn** grown  = (ReplayConn**) realloc(conns_g, wanted * sizeof(ReplayConn*));
+
+            if (grown == NULL){
+                rv = -2;
+                break;
+            }
+            conns_g = grown;
+            memset(conns_g + conns_size_g, 0, (wanted - conns_size_g) * sizeof(ReplayConn*));
+            conns_size_g = wanted;
+        }
+
+        (*records)[count].time    = r.time;
+        (*records)[count].session = r.session;
+        (*records)[count].kind    = r.kind;
+        (*records)[count].length  = r.length < sizeof(data) ? r.length : sizeof(data) - 1;
+        (*records)[count].data    = (char*) malloc((*records)[count].length + 1);
+        if ((*records)[count].data == NULL){
+            rv = -2;
+            break;
+        }
+        memcpy((*records)[count].data, data, (*records)[count].length + 1);
+        count++;
+    }
+    fclose(in);
+
+    if (rv == -2){
+        printf("\x1b[31mout of memory after %d records\x1b[0m\n", count);
+        return -1;
+    }
+    if (rv < 0){
+        printf("\x1b[33mtrace cut after %d records\x1b[0m\n", count);
+    }
+
+    qsort(issued_g, issued_count_g, sizeof(ReplayIssued), compareIssued);
+
+    issued_by_value_g = (ReplayIssued**) malloc((issued_count_g + 1) * sizeof(ReplayIssued*));
+    if (issued_by_value_g == NULL){
+        printf("\x1b[31mout of memory after %d records\x1b[0m\n", count);
+        return -1;
+    }
+    for (uint32_t i = 0; i < issued_count_g; i++){
+        issued_by_value_g[i] = &issued_g[i];
+    }
+    qsort(issued_by_value_g, issued_count_g, sizeof(ReplayIssued*), compareIssuedValue);
+
+    return count;
+}
+
+
+/**
+ * return the latest code or token handed out as `value` before `time`, NULL if none
+ */
+static ReplayIssued*
+findIssued(const char* value, uint64_t time)
+{
+    uint32_t      lo = 0, hi = issued_count_g;
+    ReplayIssued* found = NULL;
+
+    // first one with this value
+    while (lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(issued_by_value_g[mid]->recorded, value) < 0){
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    for (; lo < issued_count_g && strcmp(issued_by_value_g[lo]->recorded, value) == 0; lo++){
+        if (issued_by_value_g[lo]->time <= time){
+            found = issued_by_value_g[lo];
+        }
+    }
+    return found;
+}
+
+
+static int
+commandOf(const char* frame)
+{
+    for (int i = 1; i < commands_count_g; i++){
+        if (strcmp(frame, commands_g[i].word) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Send one frame, blocking: frames are short and the server reads them all.
+ * return 0 if OK, -1 otherwise
+ */
+static int
+replaySend(int fd, const char* msg, uint32_t len)
+{
+    char     frame[sizeof(uint32_t) + REPLAY_BUFFER_SIZE];
+    uint32_t dim  = htonl(len);
+    uint32_t sent = 0;
+
+    memcpy(frame, &dim, sizeof(dim));
+    memcpy(frame + sizeof(dim), msg, len);
+
+    while (sent < sizeof(dim) + len){
+        ssize_t n = send(fd, frame + sent, sizeof(dim) + len - sent, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR){
+            continue;
+        }
+        if (n <= 0){
+            return -1;
+        }
+        sent += (uint32_t) n;
+    }
+    return 0;
+}
+
+
+/**
+ * `now` 0: send the frame as recorded, whatever it carries.
+ */
+int
+replayStep(const ReplayRecord* r, uint64_t now)
+{
+    ReplayConn* c = conns_g[r->session];
+
+    switch (r->kind){
+        case TRACE_OPEN: {
+            int one = 1;
+
+            c = (ReplayConn*) calloc(1, sizeof(ReplayConn));
+            if (c == NULL){
+                failures_g++;   // the session isn't replayed: its frames are skipped
+                break;
+            }
+            conns_g[r->session] = c;
+
+            // the server is close by: a blocking connect() is short
+            c->fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (c->fd < 0 || connect(c->fd, (struct sockaddr*) &server_g, sizeof(server_g)) != 0){
+                perror("connect()");
+                failures_g++;
+                if (c->fd >= 0){
+                    close(c->fd);
+                }
+                c->fd = -1;
+                break;
+            }
+            setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            pollerAdd(poller_g, c->fd, POLLER_IN, (void*) (uintptr_t) r->session);
+            break;
+        }
+
+        case TRACE_FRAME: {
+            const char*   msg = r->data;
+            uint32_t      len = r->length;
+            ReplayIssued* issued;
+            int           command;
+
+            if (c == NULL || c->fd < 0){
+                break;
+            }
+
+            // a code or token sent back: the one this server handed out
+            issued = now != 0 ? findIssued(r->data, r->time) : NULL;
+            if (issued != NULL){
+                if (issued->replayed[0] == '\0'){
+                    return 1;
+                }
+                msg = issued->replayed;
+                len = (uint32_t) strlen(msg);
+                swapped_g++;
+            }
+
+            command = commandOf(r->data);
+            if (command >= 0){
+                c->command = command;
+            }
+            // timed from the last frame: the command is complete, the server can reply
+            c->waiting = 1;
+            c->sent_at = now != 0 ? now : trafficTraceNow();
+
+            if (replaySend(c->fd, msg, len) != 0){
+                failures_g++;
+                close(c->fd);
+                c->fd = -1;
+                break;
+            }
+            frames_sent_g++;
+            break;
+        }
+
+        case TRACE_CLOSE:
+            if (c != NULL && c->fd >= 0){
+                c->closing = 1;
+                if (!c->waiting){
+                    close(c->fd);
+                    c->fd = -1;
+                }
+            }
+            break;
+    }
+    return 0;
+}
+
+
+static void
+addSample(ReplayCommand* command, uint32_t us)
+{
+    if (command->count == command->size){
+        uint32_t  size  = command->size ? 2 * command->size : 1024;
+        uint32_t* grown = (uint32_t*) realloc(command->samples, size * sizeof(uint32_t));
+
+        if (grown == NULL){
+            return;     // the sample is left out, the percentiles go on with the others
+        }
+        command->samples = grown;
+        command->size    = size;
+    }
+    command->samples[command->count++] = us;
+}
+
+
+int
+replayReceive(uint32_t session, ReplayConn* c, uint64_t now)
+{
+    uint32_t at = 0;
+    ssize_t  n  = recv(c->fd, c->in + c->in_used, REPLAY_BUFFER_SIZE - c->in_used, MSG_DONTWAIT);
+
+    if (n == 0){
+        return -1;
+    }
+    if (n < 0){
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    }
+    c->in_used += (uint32_t) n;
+
+    while (c->in_used - at >= sizeof(uint32_t)){
+        uint32_t dim;
+
+        memcpy(&dim, c->in + at, sizeof(dim));
+        dim = ntohl(dim);
+        if (dim > REPLAY_BUFFER_SIZE - sizeof(dim)){
+            return -1;
+        }
+        if (c->in_used - at - sizeof(dim) < dim){
+            break;
+        }
+
+        if (c->waiting){
+            addSample(&commands_g[c->command], (uint32_t) (now - c->sent_at));
+            c->waiting = 0;
+        }
+
+        // a code or token handed out in this frame?
+        ReplayIssued  key = { .session = session, .frame = c->frames_in };
+        ReplayIssued* issued = (ReplayIssued*) bsearch(&key, issued_g, issued_count_g, sizeof(ReplayIssued), compareIssued);
+
+        if (issued != NULL){
+            uint32_t len = dim < sizeof(issued->replayed) - 1 ? dim : sizeof(issued->replayed) - 1;
+
+            memcpy(issued->replayed, c->in + at + sizeof(dim), len);
+            issued->replayed[len] = '\0';
+        }
+
+        c->frames_in++;
+        at += sizeof(dim) + dim;
+    }
+
+    c->in_used -= at;
+    memmove(c->in, c->in + at, c->in_used);
+    return 0;
+}
+
+
+static int
+compareSamples(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+void
+replayReport(double elapsed, const char* save, const char* baseline)
+{
+    FILE* out  = save != NULL ? fopen(save, "w") : NULL;
+    FILE* base = baseline != NULL ? fopen(baseline, "r") : NULL;
+    char  line[128];
+
+    if (save != NULL && out == NULL){
+        perror(save);
+    }
+    if (baseline != NULL && base == NULL){
+        perror(baseline);
+    }
+
+    printf("elapsed        %.2f s\n", elapsed);
+    printf("frames sent    %llu\n", (unsigned long long) frames_sent_g);
+    printf("swapped        %llu (codes and tokens)\n", (unsigned long long) swapped_g);
+    printf("unswapped      %llu\n", (unsigned long long) unswapped_g);
+    printf("failures       %llu\n", (unsigned long long) failures_g);
+    printf("\n%-10s %8s %8s %8s %8s %8s%s\n", "command", "count", "p50", "p95", "p99", "max", base != NULL ? "   (us, vs baseline)" : "   (us)");
+
+    for (int i = 0; i < commands_count_g; i++){
+        ReplayCommand* command = &commands_g[i];
+        uint32_t       p[4];
+
+        if (command->count == 0){
+            continue;
+        }
+        qsort(command->samples, command->count, sizeof(uint32_t), compareSamples);
+        p[0] = command->samples[command->count / 2];
+        p[1] = command->samples[(uint64_t) command->count * 95 / 100];
+        p[2] = command->samples[(uint64_t) command->count * 99 / 100];
+        p[3] = command->samples[command->count - 1];
+
+        printf("%-10s %8u %8u %8u %8u %8u\n", command->name, command->count, p[0], p[1], p[2], p[3]);
+
+        if (out != NULL){
+            fprintf(out, "%s %u %u %u %u %u\n", command->name, command->count, p[0], p[1], p[2], p[3]);
+        }
+
+        // same command in the baseline
+        if (base != NULL){
+            char     name[32];
+            uint32_t count, b[4];
+
+            rewind(base);
+            while (fgets(line, sizeof(line), base) != NULL){
+                if (sscanf(line, "%31s %u %u %u %u %u", name, &count, &b[0], &b[1], &b[2], &b[3]) != 6 ||
+                    strcmp(name, command->name) != 0){
+                    continue;
+                }
+                printf("%-10s %8s", "", "");
+                for (int k = 0; k < 4; k++){
+                    long delta = (long) p[k] - (long) b[k];
+
+                    printf(" %+7.0f%%", b[k] > 0 ? 100.0 * delta / b[k] : 0.0);
+                }
+                printf("\n");
+                break;
+            }
+        }
+    }
+
+    if (out != NULL){
+        fclose(out);
+    }
+    if (base != NULL){
+        fclose(base);
+    }
+}
@@ -0,0 +1,448 @@
+/**
+ * @name            hotel-booking
+ * @file            router.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Thu Oct 29 11:30:06 CET 2026
+ * @brief           router: sends each session to the server process serving its hotel
+ *
+ * *compilation     `make router` or `gcc router.c -o router`
+ *
+ *
+ * usage            ./router <ip> <port> <shard ip:port> [<shard ip:port> ...]
+ *
+ * Every shard is a server process holding the hotels that hash to it: hotels
+ * are spread over the shards by consistent hashing (see `HashRing.h`), so
+ * adding a shard moves about 1/N of them. Clients connect to the router as
+ * they would to a server. The first command of a session picks its hotel
+ * (`hotel <id>` on the client); a session starting with anything else goes
+ * to HOTEL_ID_DEFAULT. From then on the router connects the session to its
+ * shard and only copies bytes both ways: the shard answers the hotel pick
+ * too, "NOHOTEL" if it can't hold one more hotel (HOTELS_MAX).
+ *
+ * One thread, one event loop over the client and shard sockets of all the
+ * sessions.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// networking
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <arpa/inet.h>
+
+
+/* user-defined headers */
+
+#include "config.h"
+#include "messages.h"
+#include "utils.h"          // setupServer()
+#include "Address.h"
+#include "EventLoop.h"
+#include "HashRing.h"
+
+
+typedef struct route_end {
+    struct route*   route;
+    int             fd;                 // -1 until a shard is picked (shard end)
+    int             interest;           // POLLER_IN / POLLER_OUT it's registered for
+} RouteEnd;
+
+
+typedef struct route {
+    RouteEnd        client;
+    RouteEnd        shard;
+    uint32_t        hotel;
+    int             connecting;         // the shard end waits for its connect() to complete
+    int             closed;             // freed once the events of the batch are handled
+
+    char            up[ROUTER_BUFFER_SIZE];     // client -> shard
+    uint32_t        up_used;
+    char            down[ROUTER_BUFFER_SIZE];   // shard -> client
+    uint32_t        down_used;
+
+    struct route*   next;               // routes to free
+} Route;
+
+
+static HashRing     ring_g;
+static int          poller_g;
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+/** @brief  Picks the hotel of a session from its first frames, once they're in.
+ *  @return 1 if picked, 0 if more bytes are needed, -1 if they can't pick
+ *          one (longer than the buffer, or not a hotel ID)
+ */
+int         routeHotel(Route* r);
+
+/** @brief  Starts connecting the session to the shard serving its hotel,
+ *          without waiting: routePump() finishes it when the shard end
+ *          turns writable.
+ *  @return 0 if OK (maybe still connecting), -1 if the shard can't be reached
+ */
+int         routeConnect(Route* r);
+
+/** @brief  Moves bytes between the two ends of `r`, as far as the sockets allow.
+ *  @param  e   end the event is about
+ *  @return 0 if the session goes on, -1 if it's over
+ */
+int         routePump(Route* r, RouteEnd* e, const PollerEvent* event);
+
+/** @brief  Closes both ends of `r`, freed after the batch.
+ *  @return Void
+ */
+void        routeClose(Route* r, Route** closed);
+
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+int
+main(int argc, char** argv)
+{
+    Address     address = readArguments(argc, argv);
+    PollerEvent events[EVENT_LOOP_BATCH];
+    int         listener;
+
+    if (argc < 4){
+        printf("Usage: %s <ip> <port> <shard ip:port> [<shard ip:port> ...]\n", argv[0]);
+        exit(-1);
+    }
+
+    for (int i = 3; i < argc; i++){
+        Address shard;
+
+        memset(&shard, '\0', sizeof(shard));
+        if (sscanf(argv[i], "%15[^:]:%d", shard.ip, &shard.port) != 2 || shard.port <= 0 || hashRingAdd(&ring_g, &shard) < 0){
+            printf("\x1b[31mbad shard %s\x1b[0m (ip:port, at most %d)\n", argv[i], ROUTER_MAX_SHARDS);
+            exit(-1);
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    listener = setupServer(&address);
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+    poller_g = pollerCreate();
+    if (poller_g < 0 || pollerAdd(poller_g, listener, POLLER_IN, NULL) != 0){
+        perror_die("pollerCreate()");
+    }
+
+    #if DEBUG
+        // share of the ring each shard owns: the hotels it gets, on average
+        uint64_t share[ROUTER_MAX_SHARDS] = { 0 };
+
+        for (int i = 0; i < ring_g.size; i++){
+            uint32_t from = i > 0 ? ring_g.points[i - 1].hash : ring_g.points[ring_g.size - 1].hash;
+
+            share[ring_g.points[i].shard] += (uint32_t) (ring_g.points[i].hash - from);
+        }
+        for (int i = 0; i < ring_g.count; i++){
+            printf(ANSI_COLOR_GREEN "[+] Shard %s:%d, %.1f%% of the hotels.\n" ANSI_COLOR_RESET,
+                    ring_g.shards[i].ip, ring_g.shards[i].port, ring_g.count > 1 ? 100.0 * share[i] / 4294967296.0 : 100.0);
+        }
+    #endif
+
+    while (1)
+    {
+        Route* closed = NULL;
+        int    n      = pollerWait(poller_g, events, EVENT_LOOP_BATCH, -1);
+
+        for (int i = 0; i < n; i++){
+            RouteEnd* e = (RouteEnd*) events[i].data;
+
+            if (e == NULL){
+                // new sessions
+                int fd;
+
+                while ((fd = accept(listener, NULL, NULL)) >= 0){
+                    Route* r = (Route*) calloc(1, sizeof(Route));
+                    int    one = 1;
+
+                    if (r == NULL){
+                        close(fd);
+                        continue;
+                    }
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                    r->client   = (RouteEnd){ .route = r, .fd = fd, .interest = POLLER_IN };
+                    r->shard    = (RouteEnd){ .route = r, .fd = -1 };
+
+                    if (pollerAdd(poller_g, fd, POLLER_IN, &r->client) != 0){
+                        close(fd);
+                        free(r);
+                    }
+                }
+                continue;
+            }
+
+            if (e->route->closed){
+                continue;   // the other end closed it earlier in this batch
+            }
+            if (routePump(e->route, e, &events[i]) != 0){
+                routeClose(e->route, &closed);
+            }
+        }
+
+        while (closed != NULL){
+            Route* next = closed->next;
+
+            free(closed);
+            closed = next;
+        }
+    }
+
+    return 0;
+}
+
+
+
+int
+routeHotel(Route* r)
+{
+    uint32_t dim, next;
+    char     msg[16];
+
+    if (r->up_used < sizeof(dim)){
+        return 0;
+    }
+    memcpy(&dim, r->up, sizeof(dim));
+    dim = ntohl(dim);
+
+    // the frames picking the hotel have to fit in the buffer: they're all read before going on
+    if (dim > ROUTER_BUFFER_SIZE - sizeof(dim)){
+        return -1;
+    }
+    if (r->up_used - sizeof(dim) < dim){
+        return 0;
+    }
+
+    if (dim != strlen(HOTEL_MSG) || memcmp(r->up + sizeof(dim), HOTEL_MSG, dim) != 0){
+        r->hotel = HOTEL_ID_DEFAULT;    // didn't pick one
+        return 1;
+    }
+
+    // the hotel ID is the next frame
+    next = sizeof(dim) + dim;
+    if (r->up_used - next < sizeof(dim)){
+        return 0;
+    }
+    memcpy(&dim, r->up + next, sizeof(dim));
+    dim = ntohl(dim);
+    if (dim >= sizeof(msg)){
+        return -1;  // no hotel ID is that long
+    }
+    if (r->up_used - next - sizeof(dim) < dim){
+        return 0;
+    }
+
+    memset(msg, '\0', sizeof(msg));
+    memcpy(msg, r->up + next + sizeof(dim), dim);
+    r->hotel = (uint32_t) strtoul(msg, NULL, 10);
+    return 1;
+}
+
+
+
+int
+routeConnect(Route* r)
+{
+    int                shard = hashRingLookup(&ring_g, r->hotel);
+    struct sockaddr_in addr;
+    int                one = 1;
+    int                fd  = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0){
+        return -1;
+    }
+
+    memset(&addr, '\0', sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(ring_g.shards[shard].port);
+    addr.sin_addr.s_addr = inet_addr(ring_g.shards[shard].ip);
+
+    // a shard slow to answer mustn't hold the sessions of the others: the loop goes on meanwhile
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 && errno != EINPROGRESS){
+        printf("ROUTER: shard %s:%d unreachable (hotel %u)\n", ring_g.shards[shard].ip, ring_g.shards[shard].port, r->hotel);
+        close(fd);
+        return -1;
+    }
+
+    // writable once connected (or failed, see routeConnected())
+    r->shard.fd       = fd;
+    r->shard.interest = POLLER_OUT;
+    r->connecting     = 1;
+    if (pollerAdd(poller_g, fd, POLLER_OUT, &r->shard) != 0){
+        return -1;
+    }
+
+    #if VERBOSE_DEBUG
+        printf("ROUTER: hotel %u -> shard %s:%d\n", r->hotel, ring_g.shards[shard].ip, ring_g.shards[shard].port);
+    #endif
+    return 0;
+}
+
+
+/**
+ * Send what `buf` holds to `fd`.
+ * return 0 if OK (maybe not all of it), -1 if the peer is gone
+ */
+static int
+routeSend(int fd, char* buf, uint32_t* used)
+{
+    while (*used > 0){
+        ssize_t n = send(fd, buf, *used, MSG_NOSIGNAL);
+
+        if (n < 0){
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        *used -= (uint32_t) n;
+        memmove(buf, buf + n, *used);
+    }
+    return 0;
+}
+
+
+/**
+ * Read what `fd` has into `buf`.
+ * return 0 if OK (maybe nothing), -1 if the peer is gone
+ */
+static int
+routeReceive(int fd, char* buf, uint32_t* used)
+{
+    ssize_t n;
+
+    if (*used == ROUTER_BUFFER_SIZE){
+        return 0;   // the other end has to take some first
+    }
+    n = recv(fd, buf + *used, ROUTER_BUFFER_SIZE - *used, 0);
+    if (n == 0){
+        return -1;
+    }
+    if (n < 0){
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    }
+    *used += (uint32_t) n;
+    return 0;
+}
+
+
+/**
+ * The connect() of the shard end completed.
+ * return 0 if it's connected, -1 if it failed
+ */
+static int
+routeConnected(Route* r)
+{
+    int       error = 0;
+    socklen_t len   = sizeof(error);
+
+    if (getsockopt(r->shard.fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0){
+        int shard = hashRingLookup(&ring_g, r->hotel);
+
+        printf("ROUTER: shard %s:%d unreachable (hotel %u): %s\n", ring_g.shards[shard].ip, ring_g.shards[shard].port, r->hotel, strerror(error != 0 ? error : errno));
+        return -1;
+    }
+    r->connecting = 0;
+    return 0;
+}
+
+
+static void
+routeInterest(RouteEnd* e, int interest)
+{
+    if (e->fd >= 0 && e->interest != interest){
+        pollerModify(poller_g, e->fd, interest, e);
+        e->interest = interest;
+    }
+}
+
+
+int
+routePump(Route* r, RouteEnd* e, const PollerEvent* event)
+{
+    int gone = 0;
+    int picked;
+
+    if (e == &r->shard && r->connecting){
+        if (routeConnected(r) != 0){
+            return -1;
+        }
+    }
+    else if (event->readable || event->hangup){
+        if (e == &r->client){
+            gone = routeReceive(r->client.fd, r->up, &r->up_used);
+        }
+        else {
+            gone = routeReceive(r->shard.fd, r->down, &r->down_used);
+        }
+    }
+
+    // the first frames tell where the session goes
+    if (r->shard.fd < 0){
+        if (gone){
+            return -1;
+        }
+        picked = routeHotel(r);
+        if (picked < 0 || (picked == 0 && r->up_used == ROUTER_BUFFER_SIZE)){
+            return -1;  // can't be routed: nothing more can be read to pick the hotel
+        }
+        if (picked == 0){
+            return 0;
+        }
+        if (routeConnect(r) != 0){
+            return -1;
+        }
+    }
+
+    // the client goes on sending meanwhile, as far as the buffer takes it
+    if (r->connecting){
+        if (gone){
+            return -1;
+        }
+        routeInterest(&r->client, r->up_used < ROUTER_BUFFER_SIZE ? POLLER_IN : 0);
+        return 0;
+    }
+
+    // whatever came in goes out, even if its sender is gone (e.g. the reply to `quit`)
+    if (routeSend(r->shard.fd, r->up, &r->up_used) != 0 ||
+        routeSend(r->client.fd, r->down, &r->down_used) != 0 ||
+        gone){
+        return -1;
+    }
+
+    // read only what there's room for, wait for writability only when something is left
+    routeInterest(&r->client, (r->up_used   < ROUTER_BUFFER_SIZE ? POLLER_IN : 0) | (r->down_used ? POLLER_OUT : 0));
+    routeInterest(&r->shard,  (r->down_used < ROUTER_BUFFER_SIZE ? POLLER_IN : 0) | (r->up_used   ? POLLER_OUT : 0));
+    return 0;
+}
+
+
+
+void
+routeClose(Route* r, Route** closed)
+{
+    // closing the sockets also takes them out of the poller
+    close(r->client.fd);
+    if (r->shard.fd >= 0){
+        close(r->shard.fd);
+    }
+    r->closed = 1;
+    r->next   = *closed;
+    *closed   = r;
+}
@@ -0,0 +1,106 @@
+#!/bin/sh
+#
+# @name            hotel-booking
+# @file            scale.sh
+# @author          Francesco Urbani <https://urbanij.github.io/>
+#
+# @date            Mon Nov  2 09:37:15 CET 2026
+# @brief           scalability sweep: server worker threads x client sessions x date spread
+#
+#
+# usage            src/scale.sh [seconds per run] > scale.csv      (from the repository root)
+#
+# NUM_THREADS is fixed at compile time: the server is built once for each
+# worker count in WORKERS (under SCALE_BUILD, without rate limits), then
+# started on localhost with a fresh data folder for every run. `bench`
+# drives it with each number of sessions in SESSIONS, their reservations
+# spread over the year and then all on one day (`--hot`), which is the
+# contention on assignRoom() and on the hotel lock.
+#
+# One CSV line per run on stdout (workers first, then the columns of
+# `bench --csv`), progress on stderr. Every session keeps a command in
+# flight, so SESSIONS is the number of concurrent requests.
+#
+# Exit status 1 if a run had errors or, given the CSV of a previous sweep
+# as BASELINE, if a run made more than TOLERANCE percent fewer pairs per
+# second than the same run of the baseline: a release can be gated on it.
+#
+#       WORKERS="1 2 4" SESSIONS="16 64" src/scale.sh 5 > scale.csv
+#       BASELINE=scale.csv src/scale.sh 5 > scale-new.csv
+
+
+SECONDS_PER_RUN=${1:-10}
+WORKERS=${WORKERS:-"1 2 4 8"}
+SESSIONS=${SESSIONS:-"8 32 128 512"}
+BENCH_THREADS=${BENCH_THREADS:-4}
+ROOMS=${ROOMS:-999}                         # more than the sessions: a hot day never sells out
+PORT=${PORT:-18800}
+SCALE_BUILD=${SCALE_BUILD:-_scale_build}
+TOLERANCE=${TOLERANCE:-10}                  # percent of throughput a run may lose against BASELINE
+
+ROOT=$(pwd)
+failed=0
+
+if [ ! -f "$ROOT/CMakeLists.txt" ]; then
+    echo "run it from the repository root" >&2
+    exit 2
+fi
+if [ -n "$BASELINE" ] && [ ! -r "$BASELINE" ]; then
+    echo "can't read the baseline $BASELINE" >&2
+    exit 2
+fi
+
+echo "workers,sessions,dates,pairs_per_s,p50_us,p99_us,max_us,refused,busy,errors"
+
+for workers in $WORKERS; do
+    build="$ROOT/$SCALE_BUILD/workers$workers"
+
+    echo "building the server with $workers worker threads..." >&2
+    cmake -S "$ROOT" -B "$build" -DCMAKE_BUILD_TYPE=Release -DCMAKE_C_FLAGS="-DNUM_THREADS=$workers -DRATE_LIMIT=0" > /dev/null &&
+    cmake --build "$build" --target server bench > /dev/null || exit 2
+
+    for sessions in $SESSIONS; do
+        for dates in uniform hot; do
+            data=$(mktemp -d)
+            threads=$(( sessions < BENCH_THREADS ? sessions : BENCH_THREADS ))
+            PORT=$(( PORT + 1 ))
+
+            # a fresh data folder: every run starts from no users and no bookings
+            (cd "$data" && exec "$build/bin/server" 127.0.0.1 $PORT $ROOMS > server.log 2>&1) &
+            server=$!
+            sleep 1
+
+            echo "$workers workers, $sessions sessions, $dates dates..." >&2
+            row=$("$build/bin/bench" 127.0.0.1 $PORT $threads $(( sessions / threads )) $SECONDS_PER_RUN --csv $( [ $dates = hot ] && echo --hot ))
+            rv=$?
+
+            kill $server 2> /dev/null
+            wait $server 2> /dev/null
+            rm -rf "$data"
+
+            if [ $rv -ne 0 ]; then
+                echo "  run failed (bench exit status $rv)" >&2
+                failed=1
+            fi
+            case "$row" in
+                [0-9]*,*)   echo "$workers,$row" ;;
+                *)          continue ;;
+            esac
+
+            # pairs per second against the same run of the baseline
+            if [ -n "$BASELINE" ]; then
+                echo "$workers,$row" | awk -F, -v tolerance=$TOLERANCE '
+                    NR == FNR { base[$1 "," $2 "," $3] = $4; next }
+                    ($1 "," $2 "," $3) in base {
+                        was = base[$1 "," $2 "," $3]
+                        if ($4 < was * (100 - tolerance) / 100){
+                            printf "  regression: %d pairs/s, %d in the baseline\n", $4, was > "/dev/stderr"
+                            exit 1
+                        }
+                    }' "$BASELINE" - || failed=1
+            fi
+        done
+    done
+done
+
+exit $failed
@@ -29,10 +29,14 @@
 
 // POSIX threading
 #include <pthread.h>    // gcc requires -lpthread flag 
-#include "xp_sem.h"
 
 // networking
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/stat.h>     // mkdir()
 #include <sys/types.h>
 #include <netdb.h>
 #include <netinet/in.h>
@@ -57,9 +61,29 @@
 
 // data structures and relative functions
 #include "Address.h"
+#include "Calendar.h"
 #include "Booking.h"
 #include "Hotel.h"
 #include "User.h"
+#include "UserQuota.h"
+#include "UserCache.h"
+#include "Random.h"
+#include "CodeIndex.h"
+#include "HotelRegistry.h"
+#include "Metrics.h"
+#include "Arena.h"
+#include "Storage.h"
+#include "Journal.h"
+#include "Snapshot.h"
+#include "UserTable.h"
+#include "SessionTokens.h"
+#include "Session.h"
+#include "EventLoop.h"
+#include "RateLimit.h"
+#include "Replication.h"
+#include "TrafficTrace.h"
+#include "Spans.h"
+#include "LockProfile.h"
 
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
@@ -90,42 +114,91 @@
          * that no single database connection is used simultaneously in two or more threads.
          */
 
+#define VIEW_MAX_BOOKINGS   (BUFSIZE / 24)  // reservations fitting in a `view` response
+
+#define SNAPSHOT_THREAD_INDEX   -2          // thread_index of the snapshot thread (-1 is main)
+#define REPLICATION_THREAD_INDEX -3         // thread_index of the replication threads (shipping snapshots, or applying changes)
+
+#define URING_ACCEPT        0               // user_data of the accept completions
+#define URING_RECV          1               // user_data of a session's completions: session address | operation
+#define URING_SEND          2
+#define URING_OP_MASK       3
+
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
 /********************************/
 /*                              */
-/*       global variables       */
+/*          local types         */
 /*                              */
 /********************************/
 
-static pthread_mutex_t  lock_g;                     // global lock
-static pthread_mutex_t  users_lock_g;               // global lock for accessing the file `users.txt`
+typedef struct user_bookings {
+    int             count;
+    CachedBooking   bookings[VIEW_MAX_BOOKINGS];
+} UserBookings;     // bookings of one user, collected by `viewVisit()`
+
+
+typedef struct scan_request {
+    storage_visit_t visit;
+    storage_visit_t removed;
+    void*           payload;
+} ScanRequest;      // Storage.scan/tail arguments handed to `scanCallback()` and `changeCallback()`
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
+/********************************/
+/*                              */
+/*       global variables       */
+/*                              */
+/********************************/
 
-static xp_sem_t         free_threads;               // semaphore for waiting for free threads
-static xp_sem_t         evsem[NUM_THREADS];         // per-thread event semaphores
+static pthread_mutex_t  users_lock_g;               // global lock for calling crypt() (not reentrant)
 
-static int              fds[NUM_THREADS];           // array of file descriptors
 
+static EventLoop        loops_g[NUM_THREADS];       // sessions served by each thread
+static int              listeners_g[NUM_THREADS];   // listening socket of each loop on io_uring
 
-static int              busy[NUM_THREADS];          // map of busy threads
 static int              tid[NUM_THREADS];           // array of pre-allocated thread IDs
 static pthread_t        threads[NUM_THREADS];       // array of pre-allocated threads
+static sqlite3*         db_g[NUM_THREADS + 3];      // persistent database connection of each thread, then main's, the snapshot thread's and replication's
+static Arena            arenas_g[NUM_THREADS];      // request scoped memory of each thread
+static Storage          storage_g;                  // where bookings are stored (STORAGE_ENGINE)
+static uint64_t         bookings_changed_g;         // reservations and releases so far, tells the snapshot thread there's something new
+static uint64_t         snapshots_g;                // snapshots taken
+static uint64_t         warmup_snapshot_g;          // bookings loaded from the snapshot at startup
+static uint64_t         warmup_tail_g;              // changes replayed on top of it
+
+static ReplicationLog   replication_g;              // changes shipped to the followers (`--replicate`), unused otherwise
+static Replica          replica_g;                  // primary followed (`--follow`)
+static int              follower_g;                 // 1 if read-only follower of `replica_g.primary`
 
 
 
-static char             query_result_g[BUFSIZE];    // response of `view` query.            Used in `viewCallback()`
-static char             rooms_busy_g[4];            // response of `SELECT COUNT...` query. Used in `busy_roomsCallback()`
-static int              entry_id_g;                 // Used in `validEntryCallback()`. Stores whether entry is in Bookings table or not.
 
 
 static int              hotel_max_available_rooms;  // hotel max available rooms. Read from stdin as soon as the program starts.
 
+static UserTable        users_g;                    // registered users, looked up lock-free by every thread.
+static SessionTokens    tokens_g;                   // session resumption tokens of logged-in users.
+static RateLimiter      limits_g;                   // token buckets of the users and of the client addresses.
+static UserCache        user_cache_g;               // bookings of the most recently active users, serves `view`.
+static UserQuota        quota_g;                    // active bookings of each user, enforces MAX_BOOKINGS_PER_USER.
+
+static HotelRegistry    hotels_g;                   // hotels hosted: occupancy over the booking horizon, live codes and lock of each, warmed up from the database at startup.
+static TrafficTrace     trace_g;                    // client traffic recorded with `--record`, replayed by `replay`
+
 
 
                                                     // folder path + file name saved in `config.h` merge
-static char             USER_FILE[30];              // user file path
+static char             USER_FILE[30];              // legacy user file path (imported once into USER_TABLE)
+static char             USER_TABLE[30];             // user table path
 static char             DATABASE[30];               // database  path 
+static char             JOURNAL[30];                // journal   path (STORAGE_JOURNAL)
+static char             ARCHIVE[30];                // archive folder path
+static char             ROOM_CATALOG[30];           // room catalog path
+static char             METRICS[30];                // metrics report path
+static char             SPANS[30];                  // spans dump path (SPAN_TRACING)
+static char             SNAPSHOT[30];               // snapshot path
 
 
 
@@ -138,39 +211,84 @@ static char             DATABASE[30];               // database  path
 /********************************/
 
 
-/** @brief Thread body for the request handlers. 
- *         Wait for a signal from the main thread, collect the
- *         client file descriptor and serve the request.
- *         Signal the main thread when the request has finished.
+/** @brief Thread body for the request handlers: event loop over the
+ *         sessions the main thread assigned to this thread.
+ *         Resumes a session whenever its socket is ready.
  *   @param opaque 
  *   @return Void*
  */
 void*       threadHandler(void* opaque);
 
+/** @brief Handles one readiness event of session `s`: flushes its pending
+ *         replies, reads what arrived and resumes its FSM.
+ *  @param loop event loop of the thread
+ *  @param s session
+ *  @param event what the socket is ready for
+ *  @param thread_index Thread index
+ *  @return 0 if the session goes on, 1 if it's over (client gone or quit).
+ */
+int         serveSession(EventLoop* loop, Session* s, const PollerEvent* event, int thread_index);
+
+#ifdef __linux__
+
+/** @brief Event loop on io_uring: accepts connections (multishot) and keeps
+ *         a receive or a send posted for each of its sessions, submitting
+ *         and reaping them with one io_uring_enter() per batch. Never returns.
+ *  @param loop event loop of the thread
+ *  @param thread_index Thread index
+ *  @return Void
+ */
+void        uringHandler(EventLoop* loop, int thread_index);
+
+/** @brief io_uring completions: a connection accepted, a receive into the
+ *         input buffer of `s`, a send of its pending replies.
+ *  @param res result of the operation (descriptor, bytes or -errno)
+ *  @return Void
+ */
+void        uringAccepted(EventLoop* loop, int fd, int thread_index);
+void        uringReceived(EventLoop* loop, Session* s, int res, int thread_index);
+void        uringSent(EventLoop* loop, Session* s, int res, int thread_index);
+
+/** @brief Resumes the FSM of `s` on the frames received, queueing its replies.
+ *         Deferred while a send of `s` is in flight.
+ *  @return Void
+ */
+void        uringStep(EventLoop* loop, Session* s, int thread_index);
+
+/** @brief Posts what `s` waits for next: the send of its pending replies
+ *         linked to the next receive, or just the receive.
+ *  @return Void
+ */
+void        uringPost(EventLoop* loop, Session* s);
+
+/** @brief Closes `s`, freeing it once no operation of it is in flight.
+ *  @return Void
+ */
+void        uringClose(EventLoop* loop, Session* s);
+
+#endif
+
 /** @brief Command dispatcher: actually serving the requests of the client.
- *         Runs inside the threadHandler functions and dispatches
- *         the inbound commands to the executive functions.
+ *         Runs the session FSM until it needs frames that haven't arrived yet,
+ *         dispatching the inbound commands to the executive functions.
  *
- *  @param sockfd Socket file descriptor
- *  @param thread_index Thread index
- *  @return Void.
+ *  @param s session
+ *  @param thread_index Thread index
+ *  @return 0 if suspended waiting for input, 1 if the session is over.
  */
-void        dispatcher(int sockfd, int thread_index);
+int         dispatcher(Session* s, int thread_index);
 
-/** @brief Takes a username `u` and opens the file 
- *         `users.txt` to see if such username is
- *         therein contained.
+/** @brief Looks username `u` up in the user table.
  *  @param u Username
- *  @return 0 if username is in file, -1 otherwise
+ *  @return 1 if username is registered, 0 otherwise
  */
 int         usernameIsRegistered(char* u);
 
 
-/** @brief  Opens the file where the users are stored
- *          and update it with the new data (parameter of fucntion)
+/** @brief  Appends the new user to the user table
  *  @param  username new username to be added
  *  @param  password new password to be added
- *  @return 0 if ok; dies otherwise.
+ *  @return 0 if ok, 1 if username got registered meanwhile, -1 if the table is full.
  */
 int         updateUsersRecordFile(char* username, char* password);
 
@@ -182,7 +300,7 @@ int         updateUsersRecordFile(char* username, char* password);
 char*       encryptPassword(int thread_index, char* password);
 
 
-/** @brief   `Opens users.txt` and checks whether password of user `user` matches.
+/** @brief   Checks whether password of user `user` matches the one in the user table.
  *  @param    user
  *  @return   0 : ok. 
  *            -1: failure. 
@@ -195,10 +313,17 @@ int         checkIfPasswordMatches(User* user);
  *  @param thread index used from printing purposes
  *  @param user
  *  @param booking booking data
- *  @return 
+ *  @param id row id of the new reservation (output)
+ *  @return 0 if OK, !0 otherwise
  */
-int         saveReservation(int thread_index, User* user, Booking* booking);
+int         saveReservation(int thread_index, User* user, Booking* booking, int64_t* id);
+
 
+/** @brief Database connection of the calling thread, opened on first use and kept open
+ *  @param thread index (-1 for the main thread)
+ *  @return connection, NULL if the database can't be opened
+ */
+sqlite3*    databaseConnection(int thread_index);
 
 /** @brief Commit command to database
  *  @param sql_command Sql command to be committed
@@ -211,59 +336,259 @@ int         commitToDatabase(int thread_index, const char* sql_command);
  *  @param thread index used from printing purposes
  *  @param query_id
  *  @param sql_command 
- *  @return struct query (i.e.: return value (int), and query response (char*) )
+ *  @param payload passed to the callback as its first argument (may be NULL)
+ *  @return struct query (i.e.: return value (int), and query response (void*) )
  */
-query_t*    queryDatabase(int thread_index, const int query_id, const char* sql_command);
+query_t     queryDatabase(int thread_index, const int query_id, const char* sql_command, void* payload);
 
-/** @brief Used by queryDatabase()
- *  @param
+/** @brief Used by queryDatabase(): turns a row into a StoredBooking for Storage.scan
+ *  @param  payload the ScanRequest
  *  @param
  *  @return
  */
-int         viewCallback(void* NotUsed, int argc, char** argv, char** azColName);
+int         scanCallback(void* payload, int argc, char** argv, char** azColName);
 
+/** @brief Used by queryDatabase(): replays a row of the Changes table for Storage.tail
+ *  @param  payload the ScanRequest (`visit` for stored bookings, `removed` for released ones)
+ *  @param
+ *  @return
+ */
+int         changeCallback(void* payload, int argc, char** argv, char** azColName);
 
 /** @brief Used by queryDatabase()
- *  @param
+ *  @param  payload int64_t receiving the first column (e.g. the id of the row just inserted)
  *  @param
  *  @return
  */
-int         busy_roomsCallback(void* NotUsed, int argc, char** argv, char** azColName);
-
+int         int64Callback(void* payload, int argc, char** argv, char** azColName);
 
 /** @brief Used by queryDatabase()
- *  @param
+ *  @param  payload int counting the rows deleted
  *  @param
  *  @return
  */
-int         validEntryCallback(void* NotUsed, int argc, char** argv, char** azColName);
+int         deleteCallback(void* payload, int argc, char** argv, char** azColName);
 
 /** @brief Initial database setup. Creates the table Booking.
  *  @return return value (0 OK; !0 not OK)
  */
 int         setupDatabase();
 
-/** @brief Assign room to user upon `reserve` request.
+/** @brief  Brings a database of an older version up to date: gives the bookings
+ *          stored before hotels had an ID to HOTEL_ID_DEFAULT.
+ *  @return return value (0 OK; !0 not OK)
+ */
+int         migrateDatabase();
+
+/** @brief  SQLite storage engine (see `Storage.h`)
+ */
+int         sqliteOpen(const char* path);
+int         sqliteScan(int thread_index, const char* username, storage_visit_t visit, void* payload);
+int         sqliteInsert(int thread_index, StoredBooking* booking);
+int         sqliteRemove(int thread_index, int64_t id);
+void        sqliteStats(FILE* out);
+
+int         sqliteSnapshot(int thread_index, storage_visit_t visit, void* payload, StorageCursor* cursor);
+int         sqliteTail(int thread_index, const StorageCursor* since,
+                       storage_visit_t inserted, storage_visit_t removed, void* payload);
+void        sqliteCheckpoint(int thread_index, const StorageCursor* cursor);
+
+/** @brief  Storage visitor indexing a stored booking in the occupancy and codes of its hotel, and in `quota_g`.
+ *  @return 0 to go on with the scan
+ */
+int         warmupVisit(const StoredBooking* booking, void* NotUsed);
+
+/** @brief  Storage visitor undoing warmupVisit() for a booking released after the snapshot.
+ *  @return 0 to go on with the scan
+ */
+int         warmdownVisit(const StoredBooking* booking, void* NotUsed);
+
+/** @brief  Warm up occupancy, reservation codes and booking quota from the
+ *          latest snapshot plus the storage tail, or with a full scan of the storage.
+ *  @return 0 OK; -1 not OK
+ */
+int         loadBookings();
+
+/** @brief  Snapshot thread body: every SNAPSHOT_INTERVAL seconds, if bookings
+ *          changed, write a new snapshot and let the storage drop older history.
+ *  @return NULL
+ */
+void*       snapshotThread(void* NotUsed);
+
+/** @brief  `snapshot` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
+ */
+void        snapshotMetrics(FILE* out);
+
+/** @brief  Storage.scan visitor collecting the bookings of a user
+ *  @param  payload a UserBookings
+ *  @return 0 to go on with the scan, 1 when the response is full
+ */
+int         viewVisit(const StoredBooking* booking, void* payload);
+
+/** @brief  Makes the data folder a follower's: refuses one holding a primary's
+ *          data, otherwise wipes what a previous run left (it's shipped again).
+ *  @return 0 if ok, -1 otherwise.
+ */
+int         setupReplicaData();
+
+/** @brief  Follower side: apply a user, a booking stored or removed, or a
+ *          reset shipped by the primary to the storage and the in-memory indexes (see `Replication.h`).
+ *  @return 0 if OK, -1 otherwise
+ */
+int         replicaUser(const char* username, const char* password);
+int         replicaInsert(const StoredBooking* booking, void* NotUsed);
+int         replicaRemove(const StoredBooking* booking, void* NotUsed);
+int         replicaReset();
+uint32_t    replicaUsers();
+
+/** @brief  `replication` section of the metrics report: followers and log position,
+ *          or position and staleness of a follower.
+ *  @param  out report file
+ *  @return Void
+ */
+void        replicationMetrics(FILE* out);
+
+/** @brief  Opens the user table, importing the legacy `users.txt` the first time.
+ *  @return 0 if ok, -1 otherwise.
+ */
+int         setupUsers();
+
+/** @brief  `users` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
+ */
+void        usersMetrics(FILE* out);
+
+/** @brief  `sessions` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
+ */
+void        sessionsMetrics(FILE* out);
+
+/** @brief  `loops` section of the metrics report: sessions served by each thread.
+ *  @param  out report file
+ *  @return Void
+ */
+void        loopsMetrics(FILE* out);
+
+/** @brief  `admission` section of the metrics report: queue delay and load shed by each loop.
+ *  @param  out report file
+ *  @return Void
+ */
+void        admissionMetrics(FILE* out);
+
+/** @brief  `rate_limit` section of the metrics report: commands allowed and limited per class.
+ *  @param  out report file
+ *  @return Void
+ */
+void        rateLimitMetrics(FILE* out);
+
+/** @brief  `storage` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
+ */
+void        storageMetrics(FILE* out);
+
+/** @brief  `quota` section of the metrics report: heaviest users.
+ *  @param  out report file
+ *  @return Void
+ */
+void        quotaMetrics(FILE* out);
+
+/** @brief  Parse the `dd/mm/yyyy` (or `dd/mm`, current year) date sent by the client.
+ *  @param  booking booking whose `date` is parsed; `day` and `date` are normalized.
+ *  @return 0 if the date exists, -1 otherwise
+ */
+int         parseBookingDate(Booking* booking);
+
+/** @brief  Parse the date sent by the client and make sure it lies inside
+ *          the booking horizon, sliding the horizon forward (and archiving
+ *          the past years) when a new year has begun.
+ *  @param  booking booking whose `date` is parsed; `day` and `date` are normalized.
+ *  @return 0 if the date is bookable, -1 otherwise
+ */
+int         checkDateValidity(Booking* booking);
+
+/** @brief Assign room to user upon `reserve` request, picking the
+ *         lowest free room of the requested type from the occupancy index.
  *  @param thread index used from printing purposes
- *  @param date
- *  @return room number (string) or "ERR" to notify error (no room available)
+ *  @param booking booking whose `day` is set; `room` is filled in.
+ *  @param type room type requested, ROOM_ANY for best fit.
+ *  @return 0 if a room has been booked, -1 if no room is available
+ */
+int         assignRoom(int thread_index, Booking* booking, room_type_t type);
+
+/** @brief  Load the room catalog, falling back to `rooms` single rooms
+ *          numbered 1..rooms when the catalog file is missing.
+ *  @param  rooms number of rooms read from stdin
+ *  @return number of rooms in the hotel
+ */
+int         setupInventory(int rooms);
+
+/** @brief  Reads the hotel frame of `reserve`, `release` and `view`. A session
+ *          stays in the hotel it picked (see `hotel`): a router routes it by that.
+ *  @return the session's hotel, 0 if the frame names another one
+ */
+uint32_t    commandHotel(Session* s);
+
+/** @brief  Parses a hotel ID frame, strictly: the server reads raw frames.
+ *  @param  id the frame
+ *  @return the hotel ID, 0 unless the frame is all digits and an ID (1..UINT32_MAX)
+ */
+uint32_t    parseHotelId(const char* id);
+
+/** @brief  `hotels` section of the metrics report: bookings and traffic of each hotel.
+ *  @param  out report file
+ *  @return Void
+ */
+void        hotelsMetrics(FILE* out);
+
+/** @brief  Traffic trace (`--record`, see `TrafficTrace.h`): a session opening,
+ *          the frames it received since the last call, its closing.
+ *  @return Void
+ */
+void        traceOpen(Session* s);
+void        traceInbound(Session* s);
+void        traceClose(Session* s);
+
+/** @brief  `trace` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
  */
-char*       assignRoom(int thread_index, char* date);
+void        traceMetrics(FILE* out);
 
-/** @brief Generate random string. Used both for CODE generatio and for salt generation
+/** @brief Generate random string (per-thread PRNG, see `Random.h`). Used for salt generation,
+ *         reservation codes come from the code index instead.
  *  @param str the random string generated
  *  @param size the length of the random string to be generated
  *  @return Void
  */
 void        generateRandomString(char* str, size_t size);
 
-/** @brief Open database and returns the reservation for the user
- *         the called the function.
+/** @brief Render the reservations of `user` in `hotel` into `out`, one per line.
+ *         Served by the user cache; the database is opened only on a miss.
  *  @param thread index used from printing purposes
- *  @param username
- *  @return 
+ *  @param user
+ *  @param hotel hotel picked by the session
+ *  @param out output buffer
+ *  @param size size of `out`
+ *  @return number of reservations, -1 on database error
+ */
+int         fetchUserReservations(int thread_index, User* user, uint32_t hotel, char* out, size_t size);
+
+/** @brief  `user_cache` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
  */
-char*       fetchUserReservations(int thread_index, User* user);
+void        userCacheMetrics(FILE* out);
+
+/** @brief  `arena` section of the metrics report.
+ *  @param  out report file
+ *  @return Void
+ */
+void        arenaMetrics(FILE* out);
 
 /** @brief   release reservation and wipe related entry from databse.
  *  @param user
@@ -288,14 +613,44 @@ main(int argc, char** argv)
     strcat(USER_FILE, "/");
     strcat(USER_FILE, USER_FILE_NAME);
 
+    strcat(USER_TABLE, DATA_FOLDER);
+    strcat(USER_TABLE, "/");
+    strcat(USER_TABLE, USER_TABLE_NAME);
+
     strcat(DATABASE, DATA_FOLDER);
     strcat(DATABASE, "/");
     strcat(DATABASE, DATABASE_NAME);
 
+    strcat(JOURNAL, DATA_FOLDER);
+    strcat(JOURNAL, "/");
+    strcat(JOURNAL, JOURNAL_NAME);
+
+    strcat(ARCHIVE, DATA_FOLDER);
+    strcat(ARCHIVE, "/");
+    strcat(ARCHIVE, ARCHIVE_FOLDER_NAME);
+
+    strcat(ROOM_CATALOG, DATA_FOLDER);
+    strcat(ROOM_CATALOG, "/");
+    strcat(ROOM_CATALOG, ROOM_CATALOG_NAME);
+
+    strcat(METRICS, DATA_FOLDER);
+    strcat(METRICS, "/");
+    strcat(METRICS, METRICS_FILE_NAME);
+
+    strcat(SNAPSHOT, DATA_FOLDER);
+    strcat(SNAPSHOT, "/");
+    strcat(SNAPSHOT, SNAPSHOT_NAME);
+
+    strcat(SPANS, DATA_FOLDER);
+    strcat(SPANS, "/");
+    strcat(SPANS, SPANS_FILE_NAME);
+
 
 
     int conn_sockfd;    // connected socket file descriptor
 
+    Address replication_address = { .port = 0 };    // --replicate
+
 
     #if GDB_MODE
         char port[5];
@@ -319,7 +674,7 @@ main(int argc, char** argv)
         // reading argument (room number) from stdin
         if (argc < 4){
             printf("\x1b[31mWrong number of parameters!\x1b[0m\n");
-            printf("Usage: %s <ip> <port> <hotel rooms>\n", argv[0]);
+            printf("Usage: %s <ip> <port> <hotel rooms> [--replicate <port> | --follow <ip>:<port>] [--record <trace>]\n", argv[0]);
             exit(-1);
         }
         else {
@@ -331,6 +686,33 @@ main(int argc, char** argv)
             }
         }
 
+        // replication role: primary shipping its changes on a port of its own, or follower of one
+        for (int i = 4; i < argc; i++){
+            if (strcmp(argv[i], "--replicate") == 0 && i + 1 < argc && !follower_g){
+                replication_address.port = atoi(argv[++i]);
+            }
+            else if (strcmp(argv[i], "--follow") == 0 && i + 1 < argc && replication_address.port == 0 &&
+                     sscanf(argv[i + 1], "%15[^:]:%d", replica_g.primary.ip, &replica_g.primary.port) == 2){
+                follower_g = 1;
+                i++;
+            }
+            else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc && trace_g.file == NULL){
+                if (trafficTraceOpen(&trace_g, argv[++i]) != 0){
+                    perror("--record");
+                    exit(-1);
+                }
+            }
+            else {
+                printf("Usage: %s <ip> <port> <hotel rooms> [--replicate <port> | --follow <ip>:<port>] [--record <trace>]\n", argv[0]);
+                printf("\x1b[31mbad option %s\x1b[0m\n", argv[i]);
+                exit(-1);
+            }
+        }
+        if (replication_address.port < 0 || (follower_g && replica_g.primary.port <= 0)){
+            printf("\x1b[31mreplication ports have to be >= 1\x1b[0m\n");
+            exit(-1);
+        }
+
     #endif
     
 
@@ -340,42 +722,243 @@ main(int argc, char** argv)
 
 
     // setup semaphores
-    pthread_mutex_init(&lock_g, 0);
     pthread_mutex_init(&users_lock_g, 0);
-    xp_sem_init(&free_threads, 0, NUM_THREADS);
+
+    // a client that goes away mid-reply must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    // thousands of sessions need as many descriptors as we're allowed
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max){
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
 
 
     char ip_client[INET_ADDRSTRLEN];
     
 
     // setup database
-    char mkdir_command[7 + sizeof(DATA_FOLDER)] = "mkdir ";
-    strcat(mkdir_command, DATA_FOLDER); // DATA_FOLDER set inside `config.h`
+    char mkdir_command[10 + sizeof(ARCHIVE)] = "mkdir -p ";
+    strcat(mkdir_command, ARCHIVE);     // DATA_FOLDER and ARCHIVE_FOLDER_NAME set inside `config.h`
     system(mkdir_command);
 
-    if (setupDatabase() != 0){
+    int rv;
+
+    // a follower starts from scratch: everything is shipped by the primary
+    if (follower_g && setupReplicaData() != 0){
+        exit(-1);
+    }
+
+    #if STORAGE_ENGINE == STORAGE_JOURNAL
+        storage_g = journal_storage;
+        rv = storage_g.open(JOURNAL);
+    #else
+        storage_g = (Storage){
+            .name       = "sqlite",
+            .open       = sqliteOpen,
+            .scan       = sqliteScan,
+            .insert     = sqliteInsert,
+            .remove     = sqliteRemove,
+            .snapshot   = sqliteSnapshot,
+            .tail       = sqliteTail,
+            .checkpoint = sqliteCheckpoint,
+            .stats      = sqliteStats,
+        };
+        rv = storage_g.open(DATABASE);
+    #endif
+
+    if (rv != 0){
+        perror_die("Database error.");
+    }
+    #if DEBUG
+        printf(ANSI_COLOR_GREEN "[+] Database setup OK (%s).\n" ANSI_COLOR_RESET, storage_g.name);
+    #endif
+
+    if (setupUsers() != 0){
+        perror_die("User table error.");
+    }
+    #if DEBUG
+        printf(ANSI_COLOR_GREEN "[+] %u registered users.\n" ANSI_COLOR_RESET, users_g.header->count);
+    #endif
+
+    initializeHotelRegistry(&hotels_g);
+
+    hotel_max_available_rooms = setupInventory(hotel_max_available_rooms);
+    #if DEBUG
+        printf(ANSI_COLOR_GREEN "[+] Inventory: %d rooms (%d single, %d double, %d suite).\n" ANSI_COLOR_RESET,
+                hotel_max_available_rooms, 
+                hotels_g.inventory.rooms_per_type[ROOM_SINGLE],
+                hotels_g.inventory.rooms_per_type[ROOM_DOUBLE],
+                hotels_g.inventory.rooms_per_type[ROOM_SUITE]);
+    #endif
+
+    // sessions that don't pick a hotel book in the default one, always there
+    if (hotelRegistryAdd(&hotels_g, HOTEL_ID_DEFAULT) == NULL){
+        perror_die("Hotel error.");
+    }
+
+    initializeUserQuota(&quota_g, MAX_BOOKINGS_PER_USER);
+    initializeUserCache(&user_cache_g, USER_CACHE_MAX_USERS);
+
+    for (int i = 0; i < NUM_THREADS; i++){
+        if (initializeArena(&arenas_g[i], ARENA_SIZE) != 0){
+            perror_die("Arena error.");
+        }
+    }
+
+    if (initializeSessionTokens(&tokens_g, SESSION_TOKENS_MAX) != 0){
+        perror_die("Session tokens error.");
+    }
+
+    if (initializeRateLimiter(&limits_g, RATE_LIMIT_SLOTS) != 0){
+        perror_die("Rate limiter error.");
+    }
+
+    if (loadBookings() != 0){
         perror_die("Database error.");
     }
     #if DEBUG
-        printf(ANSI_COLOR_GREEN "[+] Database setup OK.\n" ANSI_COLOR_RESET );
+        printf(ANSI_COLOR_GREEN "[+] %u live reservation codes indexed.\n" ANSI_COLOR_RESET, hotelRegistryCodes(&hotels_g));
+        printf(ANSI_COLOR_GREEN "[+] Booking quota loaded for %d users.\n" ANSI_COLOR_RESET, quota_g.users);
+        printf(ANSI_COLOR_GREEN "[+] Occupancy of %u hotel(s) loaded, horizon %d-%d.\n" ANSI_COLOR_RESET, hotels_g.count,
+                hotels_g.tenants[0]->hotel.calendar.first_year,
+                hotels_g.tenants[0]->hotel.calendar.first_year + hotels_g.tenants[0]->hotel.calendar.years - 1);
+    #endif
+
+
+    // replication: ship the changes to the followers, or follow a primary
+    pthread_t replication_thread;
+
+    if (replication_address.port > 0){
+        if (initializeReplicationLog(&replication_g, &storage_g, &users_g, REPLICATION_THREAD_INDEX) != 0){
+            perror_die("Replication log error.");
+        }
+        replication_g.listener = setupServer(&replication_address);
+
+        if (pthread_create(&replication_thread, NULL, replicationListenThread, &replication_g) != 0){
+            perror_die("pthread_create(replication)");
+        }
+        #if DEBUG
+            printf(ANSI_COLOR_GREEN "[+] Shipping changes to followers on port %d.\n" ANSI_COLOR_RESET, replication_address.port);
+        #endif
+    }
+
+    if (follower_g){
+        replica_g.user   = replicaUser;
+        replica_g.insert = replicaInsert;
+        replica_g.remove = replicaRemove;
+        replica_g.reset  = replicaReset;
+        replica_g.users  = replicaUsers;
+
+        if (pthread_create(&replication_thread, NULL, replicaThread, &replica_g) != 0){
+            perror_die("pthread_create(replica)");
+        }
+        #if DEBUG
+            printf(ANSI_COLOR_GREEN "[+] Read-only follower of %s:%d.\n" ANSI_COLOR_RESET, replica_g.primary.ip, replica_g.primary.port);
+        #endif
+    }
+
+
+    // metrics report
+    pthread_t metrics_thread;
+
+    metricsRegister("users", usersMetrics);
+    metricsRegister("sessions", sessionsMetrics);
+    metricsRegister("quota", quotaMetrics);
+    metricsRegister("user_cache", userCacheMetrics);
+    metricsRegister("arena", arenaMetrics);
+    metricsRegister("loops", loopsMetrics);
+    metricsRegister("admission", admissionMetrics);
+    metricsRegister("rate_limit", rateLimitMetrics);
+    metricsRegister("storage", storageMetrics);
+    metricsRegister("snapshot", snapshotMetrics);
+    metricsRegister("hotels", hotelsMetrics);
+    if (trace_g.file != NULL){
+        metricsRegister("trace", traceMetrics);
+    }
+    if (replication_address.port > 0 || follower_g){
+        metricsRegister("replication", replicationMetrics);
+    }
+    #if LOCK_PROFILING
+        metricsRegister("locks", lockProfileStats);
     #endif
 
+    if (pthread_create(&metrics_thread, NULL, metricsThread, (void*) METRICS) != 0){
+        perror_die("pthread_create(metrics)");
+    }
+
+    #if LOCK_PROFILING
+        // the locks that waited the most, on the console
+        pthread_t locks_thread;
+
+        if (pthread_create(&locks_thread, NULL, lockProfileThread, NULL) != 0){
+            perror_die("pthread_create(locks)");
+        }
+    #endif
+
+    #if SPAN_TRACING
+        // spans of every thread, dumped on SIGUSR2
+        pthread_t spans_thread;
+
+        SPAN_THREAD("main", -1);
+        if (pthread_create(&spans_thread, NULL, spansThread, (void*) SPANS) != 0){
+            perror_die("pthread_create(spans)");
+        }
+    #endif
+
+    // background snapshots of the live bookings
+    pthread_t snapshot_thread;
+
+    if (pthread_create(&snapshot_thread, NULL, snapshotThread, NULL) != 0){
+        perror_die("pthread_create(snapshot)");
+    }
+
+
+
+
 
+    // io_uring for all the loops or for none
+    int uring = 0;
 
+    #if IO_URING
+        uring = 1;
+        for (int i = 0; i < NUM_THREADS && uring; i++){
+            if (uringInit(&loops_g[i].ring, URING_ENTRIES) != 0){
+                for (int j = 0; j < i; j++){
+                    uringExit(&loops_g[j].ring);
+                }
+                uring = 0;
+            }
+        }
+    #endif
+    #if DEBUG
+        printf(ANSI_COLOR_GREEN "[+] Event loops on %s.\n" ANSI_COLOR_RESET, uring ? "io_uring" : "epoll/kqueue");
+    #endif
+
+    // each loop on io_uring accepts from its own socket
+    for (int i = 0; i < NUM_THREADS && uring; i++){
+        listeners_g[i] = i == 0 ? sockfd : setupServer(&address);
+    }
 
-    // building pool
+    // building pool: one event loop per thread
     for (int i = 0; i < NUM_THREADS; i++) {
         int rv;
 
         tid[i] = i;
+        loops_g[i].uring = uring;
+        if (!uring){
+            loops_g[i].poller = pollerCreate();
+            if (loops_g[i].poller < 0){
+                perror_die("pollerCreate()");
+            }
+        }
         
         rv = pthread_create(&threads[i], NULL, threadHandler, (void*) &tid[i]);
         if (rv) {
             printf("ERROR: #%d\n", rv);
             exit(-1);
         }
-        busy[i] = 0;                    // busy threads        initialized at 0
-        xp_sem_init(&evsem[i], 0, 0);   // semaphore of events initialized at 0
     }
 
 
@@ -383,58 +966,78 @@ main(int argc, char** argv)
 
 
 
-    while(1) 
-    {
-        int thread_index;
-
+    // with io_uring the loops accept their own connections
+    if (uring){
+        for (int i = 0; i < NUM_THREADS; i++){
+            pthread_join(threads[i], NULL);
+        }
+    }
 
-        xp_sem_wait(&free_threads);             // wait until a thread is free
+    while(!uring) 
+    {
+        int      thread_index;
+        Session* session;
 
-            struct sockaddr_in client_addr;         // client address
-            socklen_t addrlen = sizeof(client_addr);
+        struct sockaddr_in client_addr;         // client address
+        socklen_t addrlen = sizeof(client_addr);
 
-            conn_sockfd = accept(sockfd, (struct sockaddr*) &client_addr, &addrlen);
-            if (conn_sockfd < 0) {
-                perror_die("accept()");
+        conn_sockfd = accept(sockfd, (struct sockaddr*) &client_addr, &addrlen);
+        if (conn_sockfd < 0) {
+            perror("accept()");
+            if (errno == EMFILE || errno == ENFILE){
+                usleep(10 * 1000);  // out of descriptors: give sessions the time to close
             }
+            continue;
+        }
 
-            // conversion: network to presentation
-            inet_ntop(AF_INET, &client_addr.sin_addr, ip_client, INET_ADDRSTRLEN);
-
-            printf("%s: \x1b[32mconnection established\x1b[0m  with client @ %s:%d\n",
-                                                            "MAIN", // __func__, 
-                                                            ip_client, 
-                                                            address.port // client_addr.sin_port 
-                                                        );
-
-
-            // looking for free thread
-
-            /* critical section */
-            pthread_mutex_lock(&lock_g);
-
-                for (thread_index = 0; thread_index < NUM_THREADS; thread_index++){  
-                    // thread assignment
-                    if (busy[thread_index] == 0) {
-                        break;
-                    }
-                }
-                printf("MAIN: Thread #%d has been selected.\n", thread_index);
+        // conversion: network to presentation
+        inet_ntop(AF_INET, &client_addr.sin_addr, ip_client, INET_ADDRSTRLEN);
 
-                fds[thread_index] = conn_sockfd;    // assigning socket file descriptor to the file descriptors array
-                busy[thread_index] = 1;             // notification busy thread, so that it can't be assigned to another, till it's released.
+        printf("%s: \x1b[32mconnection established\x1b[0m  with client @ %s:%d\n",
+                                                        "MAIN", // __func__, 
+                                                        ip_client, 
+                                                        address.port // client_addr.sin_port 
+                                                    );
 
-            /* end critical section */
-            pthread_mutex_unlock(&lock_g);
 
-        
-        xp_sem_post(&evsem[thread_index]);        
+        // the thread serving the fewest sessions takes the new one
+        thread_index = 0;
+        for (int i = 1; i < NUM_THREADS; i++){
+            if (__atomic_load_n(&loops_g[i].sessions, __ATOMIC_RELAXED) < __atomic_load_n(&loops_g[thread_index].sessions, __ATOMIC_RELAXED)){
+                thread_index = i;
+            }
+        }
 
+        session = NULL;
+        if (fcntl(conn_sockfd, F_SETFL, fcntl(conn_sockfd, F_GETFL) | O_NONBLOCK) == 0){
+            session = sessionCreate(conn_sockfd);
+        }
+        if (session == NULL){
+            perror("sessionCreate()");
+            close(conn_sockfd);
+            continue;
+        }
+        session->interest = POLLER_IN;
+        session->ip       = client_addr.sin_addr.s_addr;
+        traceOpen(session);
+
+        __atomic_add_fetch(&loops_g[thread_index].sessions, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&loops_g[thread_index].accepted, 1, __ATOMIC_RELAXED);
+
+        // from here on the session belongs to the thread
+        if (pollerAdd(loops_g[thread_index].poller, conn_sockfd, POLLER_IN, session) != 0){
+            perror("pollerAdd()");
+            __atomic_sub_fetch(&loops_g[thread_index].sessions, 1, __ATOMIC_RELAXED);
+            traceClose(session);
+            sessionDestroy(session);
+            continue;
+        }
+        printf("MAIN: Thread #%d has been selected.\n", thread_index);
     }
 
     
 
-    close(conn_sockfd);
+    close(sockfd);
 
 
     return 0;
@@ -455,143 +1058,554 @@ void*
 threadHandler(void* indx)
 {
     int thread_index = *(int*) indx;       // unpacking argument
-    int conn_sockfd;                       // file desc. local variable
+    EventLoop* loop  = &loops_g[thread_index];
+    PollerEvent events[EVENT_LOOP_BATCH];
 
     
     printf("THREAD #%d ready.\n", thread_index);
+    SPAN_THREAD("worker", thread_index);
 
+    #ifdef __linux__
+        if (loop->uring){
+            uringHandler(loop, thread_index);
+        }
+    #endif
 
+    uint64_t waits = 0;
 
     while(1)
     {
         
-        // waiting for a request assigned by the main thread
-        xp_sem_wait(&evsem[thread_index]);
-        
-        
-            /* critical section */
-            pthread_mutex_lock(&lock_g);
-                conn_sockfd = fds[thread_index];
-            pthread_mutex_unlock(&lock_g);
-            /* end critical section */
+        // waiting for sessions to be ready
+        int n = pollerWait(loop->poller, events, EVENT_LOOP_BATCH, -1);
+        waits++;
 
+        admissionBatch(&loop->admission, n > 0 ? n : 0);
 
-            // serving the request (dispatched)
-            dispatcher(conn_sockfd, thread_index);
-            
-            // you here when the client has disconnected, assiciated to `thread_index` has left.
-            printf ("Thread #%d closed session, client disconnected.\n", thread_index);
-        
+        for (int i = 0; i < n; i++){
+            Session* session = (Session*) events[i].data;
+            int      over;
 
+            admissionServe(&loop->admission);
+            over = serveSession(loop, session, &events[i], thread_index);
+            admissionDone(&loop->admission);
 
-        
-            // notifying the main thread that THIS thread is now free and can be assigned to new requests.
-        
-            /* critical section */
-            pthread_mutex_lock(&lock_g);
-                busy[thread_index] = 0;
-                printf("MAIN: Thread #%d has been freed.\n", thread_index);
-            pthread_mutex_unlock(&lock_g);
-            /* end critical section */
-    
-    
-        xp_sem_post(&free_threads);
+            if (over != 0){
+                // closing the socket also takes it out of the poller
+                traceClose(session);
+                sessionDestroy(session);
+
+                __atomic_sub_fetch(&loop->sessions, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&loop->closed, 1, __ATOMIC_RELAXED);
+
+                printf ("Thread #%d closed session, client disconnected.\n", thread_index);
+            }
+        }
 
+        __atomic_store_n(&loop->syscalls, waits + session_syscalls_tls, __ATOMIC_RELAXED);
     }
 
     pthread_exit(NULL);
     
 }
 
-/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
 
-void 
-dispatcher (int conn_sockfd, int thread_index)
+int 
+serveSession(EventLoop* loop, Session* s, const PollerEvent* event, int thread_index)
 {
+    int gone = 0;   // client closed its side
+    int over;       // FSM reached QUIT
+    int rv;
 
-    char command[BUFSIZE];
-    Booking booking;        // variable to handle the functions 
-                            // `release` and `reserve` from the client.
-
+    if (event->hangup){
+        return 1;
+    }
 
+    // replies left over from the previous step go first
+    if (s->pending != NULL){
+        SPAN_BEGIN(send_span);
+        rv = sessionFlush(s);
+        SPAN_END(send_span, "socket", "send", s->id);
+        if (rv != 0){
+            return rv < 0;
+        }
+    }
 
-    // creating variable for holding FSM current state on server side.
-    server_fsm_state_t state = INIT;
+    if (event->readable){
+        SPAN_BEGIN(recv_span);
+        gone = sessionReceive(s) != 0;
+        SPAN_END(recv_span, "socket", "recv", s->id);
+        traceInbound(s);
+    }
 
-    
+    if (sessionFrames(s) < 0){
+        __atomic_add_fetch(&loop->protocol_errors, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    __atomic_add_fetch(&loop->steps, 1, __ATOMIC_RELAXED);
+    SPAN_BEGIN(step_span);
+    over = dispatcher(s, thread_index);
+    SPAN_END(step_span, "fsm", "step", s->id);
+
+    SPAN_BEGIN(flush_span);
+    rv = sessionFlush(s);
+    SPAN_END(flush_span, "socket", "send", s->id);
+    if (rv < 0 || over || gone){
+        return 1;
+    }
+
+    // suspended with a full buffer: the frames it waits for can never fit
+    if (s->in_used == SESSION_INPUT_SIZE){
+        __atomic_add_fetch(&loop->protocol_errors, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    // a backlogged session reads no more commands until its replies are gone
+    int interest = rv > 0 ? POLLER_OUT : POLLER_IN;
+
+    if (interest != s->interest){
+        if (pollerModify(loop->poller, s->fd, interest, s) != 0){
+            return 1;
+        }
+        s->interest = interest;
+        if (rv > 0){
+            __atomic_add_fetch(&loop->backlogged, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return 0;
+}
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+#ifdef __linux__
+
+
+void
+uringHandler(EventLoop* loop, int thread_index)
+{
+    Uring*               ring      = &loop->ring;
+    int                  multishot = 1;
+    int                  accepting = 0;     // an accept is queued or in flight
+    struct io_uring_cqe* cqe;
+
+    while (1)
+    {
+        // connections are accepted by every loop, the kernel spreads them over the listening sockets.
+        // A full submission queue makes it wait for the next batch.
+        if (!accepting){
+            accepting = uringAccept(ring, listeners_g[thread_index], URING_ACCEPT, multishot) == 0;
+        }
+
+        // submitting this batch's receives and sends, waiting for the next completions
+        if (uringEnter(ring, 1) != 0 && errno != EBUSY){
+            perror("io_uring_enter()");
+        }
+        __atomic_store_n(&loop->syscalls, ring->enters, __ATOMIC_RELAXED);
+        admissionBatch(&loop->admission, uringReady(ring));
+
+        while ((cqe = uringPeek(ring)) != NULL){
+            uint64_t data  = cqe->user_data;
+            int      res   = cqe->res;
+            unsigned flags = cqe->flags;
+
+            uringSeen(ring);
+            admissionServe(&loop->admission);
+
+            if (data == URING_ACCEPT){
+                if (res >= 0){
+                    uringAccepted(loop, res, thread_index);
+                }
+                else if (res == -EINVAL && multishot){
+                    multishot = 0;      // kernel older than 5.19: one accept at a time
+                }
+                else if (res == -EMFILE || res == -ENFILE){
+                    usleep(10 * 1000);  // out of descriptors: give sessions the time to close
+                }
+                if (!(flags & IORING_CQE_F_MORE)){
+                    accepting = uringAccept(ring, listeners_g[thread_index], URING_ACCEPT, multishot) == 0;
+                }
+                continue;
+            }
+
+            Session* session = (Session*) (uintptr_t) (data & ~(uint64_t) URING_OP_MASK);
+
+            if ((data & URING_OP_MASK) == URING_RECV){
+                uringReceived(loop, session, res, thread_index);
+            }
+            else {
+                uringSent(loop, session, res, thread_index);
+            }
+            admissionDone(&loop->admission);
+        }
+    }
+}
+
+
+
+void
+uringAccepted(EventLoop* loop, int fd, int thread_index)
+{
+    char               ip_client[INET_ADDRSTRLEN] = "?";
+    struct sockaddr_in client_addr;
+    socklen_t          addrlen = sizeof(client_addr);
+
+    Session* s = sessionCreate(fd);
+    if (s == NULL){
+        perror("sessionCreate()");
+        close(fd);
+        return;
+    }
+
+    if (getpeername(fd, (struct sockaddr*) &client_addr, &addrlen) == 0){
+        inet_ntop(AF_INET, &client_addr.sin_addr, ip_client, INET_ADDRSTRLEN);
+        s->ip = client_addr.sin_addr.s_addr;
+    }
+    traceOpen(s);
+    printf("THREAD #%d: \x1b[32mconnection established\x1b[0m  with client @ %s\n", thread_index, ip_client);
+
+    __atomic_add_fetch(&loop->sessions, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&loop->accepted, 1, __ATOMIC_RELAXED);
+
+    uringPost(loop, s);
+}
+
+
+
+void
+uringReceived(EventLoop* loop, Session* s, int res, int thread_index)
+{
+    s->recv_posted = 0;
+
+    // the send it was linked to failed: uringSent() sees to it
+    if (res == -ECANCELED && !s->closing){
+        uringPost(loop, s);
+        return;
+    }
+    if (res <= 0 || s->closing){
+        uringClose(loop, s);
+        return;
+    }
+
+    s->in_used += (uint32_t) res;
+    traceInbound(s);
+    uringStep(loop, s, thread_index);
+}
+
+
+
+void
+uringSent(EventLoop* loop, Session* s, int res, int thread_index)
+{
+    s->send_posted = 0;
+
+    if (res < 0 || s->closing){
+        uringClose(loop, s);
+        return;
+    }
+
+    s->pending_sent += (uint32_t) res;
+    if (s->pending_sent < s->pending_size){
+        __atomic_add_fetch(&loop->backlogged, 1, __ATOMIC_RELAXED);
+    }
+    else {
+        free(s->pending);
+        s->pending      = NULL;
+        s->pending_size = 0;
+        s->pending_sent = 0;
+    }
+
+    // commands that arrived meanwhile waited for the replies to be gone
+    if (s->pending == NULL && !s->quit && sessionFrames(s) != 0){
+        uringStep(loop, s, thread_index);
+    }
+    else {
+        uringPost(loop, s);
+    }
+}
+
+
+
+void
+uringStep(EventLoop* loop, Session* s, int thread_index)
+{
+    int over;
+
+    // `pending` must stay put until its send completes
+    if (s->send_posted){
+        return;
+    }
+
+    if (sessionFrames(s) < 0){
+        __atomic_add_fetch(&loop->protocol_errors, 1, __ATOMIC_RELAXED);
+        uringClose(loop, s);
+        return;
+    }
+
+    __atomic_add_fetch(&loop->steps, 1, __ATOMIC_RELAXED);
+    SPAN_BEGIN(step_span);
+    over = dispatcher(s, thread_index);
+    SPAN_END(step_span, "fsm", "step", s->id);
+
+    if (sessionQueue(s) != 0){
+        uringClose(loop, s);
+        return;
+    }
+
+    if (over){
+        s->quit = 1;    // closed as soon as the last replies are out
+    }
+    else if (s->in_used == SESSION_INPUT_SIZE){
+        // suspended with a full buffer: the frames it waits for can never fit
+        __atomic_add_fetch(&loop->protocol_errors, 1, __ATOMIC_RELAXED);
+        uringClose(loop, s);
+        return;
+    }
+
+    uringPost(loop, s);
+}
+
+
+
+void
+uringPost(EventLoop* loop, Session* s)
+{
+    Uring*   ring = &loop->ring;
+    uint64_t data = (uint64_t) (uintptr_t) s;
+
+    if (s->closing){
+        return;
+    }
+
+    if (s->pending != NULL){
+        if (s->send_posted){
+            return;
+        }
+
+        // the next receive starts once the replies are out: a backlogged session reads no more commands
+        int receive = !s->quit && !s->recv_posted;
+
+        // both or none: the send is linked to the receive
+        if (uringReserve(ring, receive ? 2 : 1) != 0){
+            perror("io_uring submission queue");
+            uringClose(loop, s);
+            return;
+        }
+
+        uringSend(ring, s->fd, s->pending + s->pending_sent, s->pending_size - s->pending_sent, data | URING_SEND, receive);
+        s->send_posted = 1;
+
+        if (receive){
+            uringRecv(ring, s->fd, s->in + s->in_used, SESSION_INPUT_SIZE - s->in_used, data | URING_RECV);
+            s->recv_posted = 1;
+        }
+    }
+    else if (s->quit){
+        uringClose(loop, s);
+    }
+    else if (!s->recv_posted){
+        if (uringRecv(ring, s->fd, s->in + s->in_used, SESSION_INPUT_SIZE - s->in_used, data | URING_RECV) != 0){
+            perror("io_uring submission queue");
+            uringClose(loop, s);
+            return;
+        }
+        s->recv_posted = 1;
+    }
+}
+
+
+
+void
+uringClose(EventLoop* loop, Session* s)
+{
+    if (!s->closing){
+        s->closing = 1;
+        shutdown(s->fd, SHUT_RDWR);     // completes what's in flight
+    }
+
+    // freed with the last completion
+    if (s->recv_posted || s->send_posted){
+        return;
+    }
+
+    traceClose(s);
+    sessionDestroy(s);
+
+    __atomic_sub_fetch(&loop->sessions, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&loop->closed, 1, __ATOMIC_RELAXED);
+
+    printf ("Thread #%d closed session, client disconnected.\n", (int) (loop - loops_g));
+}
+
+
+#endif
+
+/* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
+
+
+
+int 
+dispatcher(Session* s, int thread_index)
+{
 
-    // creating user "object"
-    User* user = (User*) malloc(sizeof(User));
+    char command[BUFSIZE];
+    CodeEntry code_entry;   // reservation code being generated
+    HotelTenant* tenant;    // hotel of the command
+    uint32_t hotel;         // hotel picked with `htl`
+
+    memset(&code_entry, '\0', sizeof(code_entry));
+
+
+    // the session keeps what has to survive a suspension
+    User*    user    = &s->user;
+    char*    token   = s->token;            // resumption token, "" until logged in
+    Booking* booking = &s->booking;         // arguments of `release` and `reserve` from the client.
 
-    memset(user->username, '\0', sizeof(user->username));
-    memset(user->actual_password, '\0', sizeof(user->actual_password));
 
+    // everything allocated from the arena is given back before suspending
+    Arena* arena = &arenas_g[thread_index];
+    arenaReset(arena);
 
-    memset(booking.date, '\0', sizeof(booking.date));
-    memset(booking.code, '\0', sizeof(booking.code));
+    // what the loop is turning down when it's saturated
+    Admission* admission = &loops_g[thread_index].admission;
+    char       busy[32];
 
 
     // used when processing `view` request and send message back to client.
-    // ! good idea would be to use heap and realloc memory as it grows.
-    char reservation_response[BUFSIZE];
-    char view_response[BUFSIZE];
+    char* view_response;
 
+    #if SPAN_TRACING
+        // span of the state being run, recorded when the next one starts
+        uint64_t           state_span    = 0;
+        server_fsm_state_t state_spanned = s->state;
+    #endif
     
 
     while (1) 
     {
     
+        #if SPAN_TRACING
+            if (state_span != 0){
+                spanRecord("fsm", serverFSMStateName(state_spanned), state_span, s->id);
+            }
+            state_span    = spanNow();
+            state_spanned = s->state;
+        #endif
     
         // stores return value, used throughout the loop.
         int rv;
 
 
-        switch (state)
+        switch (s->state)
         {
             case INIT:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the next command arrives
+                }
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command);  // fix space separated strings
+                sessionRead(s, command, BUFSIZE);  // fix space separated strings
 
                 if      (strcmp(command, HELP_MSG) == 0){
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "help");
-                    state = HELP_UNLOGGED;
+                    s->state = HELP_UNLOGGED;
                 }
                 else if (strcmp(command, REGISTER_MSG) == 0){
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "register");
-                    state = REGISTER;
+                    s->state = REGISTER;
                 }
                 else if (strcmp(command, LOGIN_MSG) == 0){
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "login");
-                    state = LOGIN_REQUEST;
+                    s->state = LOGIN_REQUEST;
+                }
+                else if (strcmp(command, RESUME_MSG) == 0){
+                    printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "resume");
+                    s->state = RESUME;
                 }
                 else if (strcmp(command, QUIT_MSG) == 0){
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "quit");
-                    state = QUIT;
+                    s->state = QUIT;
+                }
+                else if (strcmp(command, HOTEL_MSG) == 0){
+                    printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "hotel");
+                    s->state = PICK_HOTEL;
+                    break;  // routed once the pick is answered
+                }
+                else {
+                    s->state = INIT;
+                }
+                s->routed = 1;
+                break;
+
+
+            case PICK_HOTEL:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the hotel ID arrives
+                }
+                memset(command, '\0', BUFSIZE);
+                sessionRead(s, command, BUFSIZE);
+
+                // a router sent the connection to a shard by its first command: the hotel is fixed from then on.
+                // Picking it again is fine (e.g. after BUSY), another one isn't. Not an ID: the connection books nowhere.
+                hotel = parseHotelId(command);
+                if (!s->routed){
+                    s->hotel  = hotel;
+                    s->routed = 1;
+                }
+
+                // anyone can send it before logging in: charged like a login
+                if (rateLimitAddress(&limits_g, RATE_LOGIN, s->ip, busy, sizeof(busy)) ||
+                    admissionShed(admission, ADMISSION_LOGIN, busy, sizeof(busy))){
+                    sessionWrite(s, busy);
+                    s->state = INIT;
+                    break;
+                }
+
+                // the hotel is made on its first booking, here it only has to fit
+                if (hotel != 0 && hotel == s->hotel && hotelRegistryAdmits(&hotels_g, hotel) == 0){
+                    sessionWrite(s, "OK");
                 }
                 else {
-                    state = INIT;
+                    sessionWrite(s, NO_HOTEL_MSG);
                 }
+                s->state = INIT;
                 break;
     
 
             case HELP_UNLOGGED:
-                writeSocket(conn_sockfd, "H");
-                state = INIT;
+                sessionWrite(s, "H");
+                s->state = INIT;
                 break;
 
 
 
             case REGISTER:
-                writeSocket(conn_sockfd, "Choose username: ");
+                if (follower_g){
+                    sessionWrite(s, READONLY_MSG);  // users are registered on the primary
+                    s->state = INIT;
+                    break;
+                }
+                // new users wait first when the loop is saturated: they'd cost a crypt()
+                if (rateLimitAddress(&limits_g, RATE_LOGIN, s->ip, busy, sizeof(busy)) ||
+                    admissionShed(admission, ADMISSION_LOGIN, busy, sizeof(busy))){
+                    sessionWrite(s, busy);
+                    s->state = INIT;
+                    break;
+                }
+                sessionWrite(s, "Choose username: ");
 
-                state = PICK_USERNAME;
+                s->state = PICK_USERNAME;
                 break;
 
             case PICK_USERNAME:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the username arrives
+                }
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command);
-                strcpy(user->username, command);
+                sessionRead(s, command, BUFSIZE);
+                strncpy(user->username, command, sizeof(user->username) - 1);
 
                 #if VERBOSE_DEBUG
                     printf("Username inserted: \033[1m%s\x1b[0m\n", user->username);
@@ -600,76 +1614,110 @@ dispatcher (int conn_sockfd, int thread_index)
                 rv = usernameIsRegistered(user->username);
 
                 if (rv == 0){
-                    state = PICK_PASSWORD;
-                    writeSocket(conn_sockfd, "Y");  // Y stands for: "username OK.\nChoose password: "
+                    s->state = PICK_PASSWORD;
+                    sessionWrite(s, "Y");  // Y stands for: "username OK.\nChoose password: "
                 }
                 else {
-                    state = PICK_USERNAME;
-                    writeSocket(conn_sockfd, "N");  // N stands for: "username already taken, pick another one: "
+                    s->state = PICK_USERNAME;
+                    sessionWrite(s, "N");  // N stands for: "username already taken, pick another one: "
                 }
 
                 break;
 
             case PICK_PASSWORD:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the password arrives
+                }
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command);
-                strcpy(user->actual_password, command);
+                sessionRead(s, command, BUFSIZE);
+                strncpy(user->actual_password, command, sizeof(user->actual_password) - 1);
 
                 #if VERBOSE_DEBUG
                     printf("Thread #%d: Plain text password inserted: \033[1m%s\x1b[0m\n", thread_index, user->actual_password);
                 #endif
 
-                state = SAVE_CREDENTIAL;
+                s->state = SAVE_CREDENTIAL;
                 break;
 
             case SAVE_CREDENTIAL:
                 
                 #if ENCRYPT_PASSWORD 
-                    updateUsersRecordFile(user->username, encryptPassword(thread_index, user->actual_password));
+                    rv = updateUsersRecordFile(user->username, encryptPassword(thread_index, user->actual_password));
                 #else
-                    updateUsersRecordFile(user->username, user->actual_password);
+                    rv = updateUsersRecordFile(user->username, user->actual_password);
                 #endif
 
-                writeSocket(conn_sockfd, "password OK.");
-                writeSocket(conn_sockfd, "Successfully registerd, you are now logged-in.");
+                if (rv != 0){
+                    // someone else took the username after PICK_USERNAME, or the user table is full
+                    sessionWrite(s, "password NOT OK.");
+                    sessionWrite(s, "Registration failed, please try again later.");
+                    s->state = QUIT;
+                    break;
+                }
+
+                sessionWrite(s, "password OK.");
+                sessionWrite(s, "Successfully registerd, you are now logged-in.");
 
-                state = LOGIN;
+                sessionTokenIssue(&tokens_g, user->username, token);
+                trafficTraceIssued(&trace_g, s->id, s->frames_out, token);
+                sessionWrite(s, token);
+
+                s->state = LOGIN;
                 break;
 
             case LOGIN_REQUEST:
-                writeSocket(conn_sockfd, "OK"); // not actually necessary 
-                state = CHECK_USERNAME;
+                if (rateLimitAddress(&limits_g, RATE_LOGIN, s->ip, busy, sizeof(busy)) ||
+                    admissionShed(admission, ADMISSION_LOGIN, busy, sizeof(busy))){
+                    sessionWrite(s, busy);
+                    s->state = INIT;
+                    break;
+                }
+                sessionWrite(s, "OK"); // not actually necessary 
+                s->state = CHECK_USERNAME;
                 break;
 
             case CHECK_USERNAME:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the username arrives
+                }
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command);
+                sessionRead(s, command, BUFSIZE);
+
+                // password guessing on one account, from whatever address
+                if (rateLimitUser(&limits_g, RATE_LOGIN, command, busy, sizeof(busy))){
+                    s->state = INIT;
+                    sessionWrite(s, busy);
+                    break;
+                }
 
                 rv = usernameIsRegistered(command);
 
                 if (rv == 1){
-                    state = CHECK_PASSWORD;
+                    s->state = CHECK_PASSWORD;
 
                     // storing command (i.e. the username just received)
                     // into the user structure so I can use this in
                     // the next stage to check wheter the password for THIS user 
                     // matches the password previously stored.
-                    strcpy(user->username, command);
+                    strncpy(user->username, command, sizeof(user->username) - 1);
 
-                    writeSocket(conn_sockfd, "Y");  // Y stands for OK
+                    sessionWrite(s, "Y");  // Y stands for OK
                 }
                 else {
-                    state = INIT;
-                    writeSocket(conn_sockfd, "N");  // N stands for NOT OK
+                    s->state = INIT;
+                    sessionWrite(s, "N");  // N stands for NOT OK
                 }
                 
                 break;
 
             case CHECK_PASSWORD:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the password arrives
+                }
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command);
+                sessionRead(s, command, BUFSIZE);
 
-                strcpy(user->actual_password, command);
+                strncpy(user->actual_password, command, sizeof(user->actual_password) - 1);
 
                 #if VERBOSE_DEBUG
                     printf("Thread #%d: Plain text password received \033[1m%s\x1b[0m\n", thread_index, user->actual_password);
@@ -684,185 +1732,357 @@ dispatcher (int conn_sockfd, int thread_index)
 
 
                 if (rv == 0){
-                    state = GRANT_ACCESS;
+                    s->state = GRANT_ACCESS;
                 }
                 else {
-                    state = INIT;
-                    writeSocket(conn_sockfd, "N");  // N stands for NOT OK
+                    s->state = INIT;
+                    sessionWrite(s, "N");  // N stands for NOT OK
                 }
                 
                 break;
 
             case GRANT_ACCESS:
-                writeSocket(conn_sockfd, "Y");  // Y stands for OK
-                state = LOGIN;
+                sessionWrite(s, "Y");  // Y stands for OK
+
+                sessionTokenIssue(&tokens_g, user->username, token);
+                trafficTraceIssued(&trace_g, s->id, s->frames_out, token);
+                sessionWrite(s, token);
+
+                s->state = LOGIN;
+                break;
+
+            case RESUME:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the token arrives
+                }
+                memset(command, '\0', BUFSIZE);
+                sessionRead(s, command, BUFSIZE);
+
+                // token guessing: only failed resumes are charged, but none is tried once they ran out
+                if (rateLimitAddressCheck(&limits_g, RATE_LOGIN, s->ip, busy, sizeof(busy))){
+                    s->state = INIT;
+                    sessionWrite(s, busy);
+                    break;
+                }
+
+                // no password, no crypt(): the token proves the user logged in before
+                if (sessionTokenResume(&tokens_g, command, user->username) == 0){
+                    strcpy(token, command);
+                    s->state = LOGIN;
+                    sessionWrite(s, "Y");
+                }
+                else {
+                    rateLimitAddress(&limits_g, RATE_LOGIN, s->ip, busy, sizeof(busy));
+                    s->state = INIT;
+                    sessionWrite(s, "N");
+                }
                 break;
 
             case LOGIN:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the next command arrives
+                }
                 
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command);  // fix space separated strings
+                sessionRead(s, command, BUFSIZE);  // fix space separated strings
 
                 if      (strcmp(command, HELP_MSG) == 0){ 
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "help");
-                    state = HELP_LOGGED_IN;
+                    s->state = HELP_LOGGED_IN;
                 }
                 else if (strcmp(command, QUIT_MSG) == 0){  
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "quit");
-                    state = QUIT;
+                    s->state = QUIT;
                 }
                 else if (strcmp(command, LOGOUT_MSG) == 0) {
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "logout");
-                    state = INIT;
+                    sessionTokenRevoke(&tokens_g, token);
+                    memset(token, '\0', SESSION_TOKEN_LENGTH);
+                    s->state = INIT;
+                }
+                else if (strcmp(command, REGISTER_MSG) == 0 || strcmp(command, LOGIN_MSG) == 0 || strcmp(command, RESUME_MSG) == 0){
+                    // switching user (client library pools): the current one is left logged in elsewhere, its token stays valid
+                    printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "switch");
+                    memset(token, '\0', SESSION_TOKEN_LENGTH);
+                    s->state = strcmp(command, REGISTER_MSG) == 0 ? REGISTER : strcmp(command, LOGIN_MSG) == 0 ? LOGIN_REQUEST : RESUME;
                 }
                 else if (strcmp(command, VIEW_MSG) == 0){  
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "view");
-                    state = VIEW;
+                    s->state = VIEW;
                 }
                 else if (strcmp(command, RESERVE_MSG) == 0){
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "reserve");
-                    state = CHECK_DATE_VALIDITY;
+                    s->state = CHECK_DATE_VALIDITY;
                 }
                 else if (strcmp(command, RELEASE_MSG) == 0){
                     printf("THREAD #%d: command received: \033[1m%s\x1b[0m\n", thread_index, "release");
-                    state = RELEASE;
+                    s->state = RELEASE;
                 }
                 else {
-                    state = LOGIN;        
+                    s->state = LOGIN;        
                 }
 
                 break;
 
             case HELP_LOGGED_IN:
-                writeSocket(conn_sockfd, "H");
-                state = LOGIN;
+                sessionWrite(s, "H");
+                s->state = LOGIN;
                 break;
 
             
             case CHECK_DATE_VALIDITY:
+                if (sessionFrames(s) < 3){
+                    return 0;   // suspended until date, room type and hotel arrive
+                }
                 memset(command, '\0', BUFSIZE);
-                readSocket(conn_sockfd, command); // read date or reserve request
+                sessionRead(s, command, BUFSIZE); // read date or reserve request
 
 
-                // ! useless state: check date validity is performed on client side. 
-                strcpy(booking.date, command);
-                rv = 0; // formerly   rv = checkDateValidity();
-                if (rv == 0){
-                    state = CHECK_AVAILABILITY;
+                // the client already checked the date exists, here it's checked against the booking horizon.
+                memset(booking->date, '\0', sizeof(booking->date));
+                strncpy(booking->date, command, sizeof(booking->date) - 1);
+
+                memset(command, '\0', BUFSIZE);
+                sessionRead(s, command, BUFSIZE); // read room type ("any" if the user didn't ask for one)
+                s->room_type = parseRoomType(command);
+
+                booking->hotel = commandHotel(s);
+
+                if (booking->hotel == 0){
+                    sessionWrite(s, NO_HOTEL_MSG);
+                    s->state = LOGIN;
+                    break;
+                }
+
+                if (follower_g){
+                    sessionWrite(s, READONLY_MSG);
+                    s->state = LOGIN;
+                    break;
+                }
+
+                if (rateLimitUser(&limits_g, RATE_BOOKING, user->username, busy, sizeof(busy)) ||
+                    rateLimitAddress(&limits_g, RATE_BOOKING, s->ip, busy, sizeof(busy)) ||
+                    admissionShed(admission, ADMISSION_SESSION, busy, sizeof(busy))){
+                    sessionWrite(s, busy);
+                    s->state = LOGIN;
+                    break;
+                }
+
+                // booking in a hotel makes it
+                if (hotelRegistryAdd(&hotels_g, booking->hotel) == NULL){
+                    sessionWrite(s, NO_HOTEL_MSG);
+                    s->state = LOGIN;
+                    break;
+                }
+
+                rv = checkDateValidity(booking);
+                if (rv == 0 && s->room_type < 0){
+                    s->state = LOGIN;
+                    sessionWrite(s, "BADTYPE");
+                }
+                else if (rv == 0){
+                    s->state = CHECK_AVAILABILITY;
                 }
                 else {
-                    state = LOGIN;
-                    writeSocket(conn_sockfd, "BADDATE");
+                    s->state = LOGIN;
+                    sessionWrite(s, "BADDATE");
                 }
                 break;
 
             // check data validity and availability
             case CHECK_AVAILABILITY:
 
-                if (strcmp(assignRoom(thread_index, booking.date), "FULL") != 0){
-                    state = RESERVE_CONFIRMATION;
+                // quota and room are both checked in memory, no database round trip.
+                if (userQuotaAcquire(&quota_g, user->username) != 0){
+                    sessionWrite(s, "QUOTA");
+                    s->state = LOGIN;
+                    break;
+                }
+
+                // room is picked and booked atomically from the occupancy index.
+                rv = assignRoom(thread_index, booking, s->room_type);
+
+                if (rv == 0){
+                    s->state = RESERVE_CONFIRMATION;
                 }
                 else {
-                    writeSocket(conn_sockfd, "NOAVAL");
-                    state = LOGIN;
+                    userQuotaRelease(&quota_g, user->username);
+                    sessionWrite(s, "NOAVAL");
+                    s->state = LOGIN;
                 }
                 break;
 
             case RESERVE_CONFIRMATION:
-                strcpy(booking.room, assignRoom(thread_index, booking.date));
                 
-                // strcpy(booking.code, generateRandomString());
-                generateRandomString(booking.code, RESERVATION_CODE_LENGTH);
-                // make sure the code is all uppercase
-                upper(booking.code);
+                // unique code in the hotel, uppercase alphanumeric, reserved in its code index
+                tenant = hotelRegistryFind(&hotels_g, booking->hotel);
+
+                code_entry.day   = booking->day;
+                code_entry.room  = atoi(booking->room);
+                code_entry.hotel = booking->hotel;
+                strcpy(code_entry.username, user->username);
+
+                rv = codeIndexGenerate(&tenant->codes, &code_entry);
+                strcpy(booking->code, code_entry.code);
+
+                if (rv == 0){
+                    rv = saveReservation(thread_index, user, booking, &code_entry.id);
+                }
+                if (rv == 0){
+                    codeIndexSetId(&tenant->codes, &code_entry, code_entry.id);
+                }
+
+
+                if (rv != 0){
+                    // not stored: give the room, the quota and the code back.
+                    MUTEX_LOCK(&tenant->lock);
+                        releaseRoom(&tenant->hotel, booking->day, atoi(booking->room));
+                    MUTEX_UNLOCK(&tenant->lock);
+                    userQuotaRelease(&quota_g, user->username);
+                    codeIndexRemove(&tenant->codes, code_entry.code, user->username, booking->day, code_entry.room);
 
+                    sessionWrite(s, "NOAVAL");
+                    s->state = LOGIN;
+                    break;
+                }
 
-                saveReservation(thread_index, user, &booking);
+                __atomic_add_fetch(&tenant->reservations, 1, __ATOMIC_RELAXED);
 
-                writeSocket(conn_sockfd, "RESOK");
-                writeSocket(conn_sockfd, booking.room);
-                writeSocket(conn_sockfd, booking.code);
-                state = LOGIN;
+                sessionWrite(s, "RESOK");
+                sessionWrite(s, booking->room);
+                trafficTraceIssued(&trace_g, s->id, s->frames_out, booking->code);
+                sessionWrite(s, booking->code);
+                s->state = LOGIN;
                 break;
 
             case VIEW:
+                if (sessionFrames(s) < 1){
+                    return 0;   // suspended until the hotel arrives
+                }
+                booking->hotel = commandHotel(s);
 
-                memset(reservation_response, '\0', sizeof(reservation_response));
-                memset(query_result_g, '\0', sizeof(query_result_g));
-                
-                strcpy(reservation_response, fetchUserReservations(thread_index, user));
+                if (booking->hotel == 0){
+                    sessionWrite(s, OTHER_HOTEL_MSG);
+                    s->state = LOGIN;
+                    break;
+                }
 
+                if (rateLimitUser(&limits_g, RATE_VIEW, user->username, busy, sizeof(busy)) ||
+                    rateLimitAddress(&limits_g, RATE_VIEW, s->ip, busy, sizeof(busy)) ||
+                    admissionShed(admission, ADMISSION_SESSION, busy, sizeof(busy))){
+                    sessionWrite(s, busy);
+                    s->state = LOGIN;
+                    break;
+                }
 
-                if (strcmp(reservation_response, "") == 0){
-                    writeSocket(conn_sockfd, "You have 0 active reservations.");
+                // a follower too far behind its primary (or cut off from it) doesn't answer
+                if (follower_g && replicaStaleness(&replica_g) > REPLICATION_MAX_STALENESS){
+                    snprintf(busy, sizeof(busy), BUSY_MSG " %d", REPLICATION_HEARTBEAT_MS);
+                    sessionWrite(s, busy);
+                    s->state = LOGIN;
+                    break;
                 }
-                else {
 
-                    // can be moved to server side except reservation_response...
-                    memset(view_response, '\0', sizeof(view_response));
-                    strcat(view_response, "Your active reservations in 2020");
-                    #if SORT_VIEW_BY_DATE
-                        strcat(view_response, " sorted by DATE");
-                    #else
-
-                    #endif
-                    strcat(view_response, ":\n");
-                    strcat(view_response, "-----+------+-------+\n");
-                    strcat(view_response, "date | room | code  |\n");
-                    strcat(view_response, "-----+------+-------+\n");
-                    strcat(view_response, reservation_response);
-                    writeSocket(conn_sockfd, view_response);
+                view_response = (char*) arenaAlloc(arena, BUFSIZE);
+                if (view_response == NULL){
+                    sessionWrite(s, "\x1b[31mFailed. \x1b[0mServer busy, try again.");
+                    s->state = LOGIN;
+                    break;
+                }
+
+                // header first, the reservations are rendered right after it.
+                memset(view_response, '\0', BUFSIZE);
+                strcat(view_response, "Your active reservations");
+                #if SORT_VIEW_BY_DATE
+                    strcat(view_response, " sorted by DATE");
+                #else
+
+                #endif
+                strcat(view_response, ":\n");
+                strcat(view_response, "-----------+------+-------+\n");
+                strcat(view_response, "date       | room | code  |\n");
+                strcat(view_response, "-----------+------+-------+\n");
+
+                tenant = hotelRegistryFind(&hotels_g, booking->hotel);
+                if (tenant != NULL){
+                    __atomic_add_fetch(&tenant->views, 1, __ATOMIC_RELAXED);
+                }
+
+                rv = strlen(view_response);
+                rv = fetchUserReservations(thread_index, user, booking->hotel, view_response + rv, BUFSIZE - rv);
+
+                if (rv <= 0){
+                    sessionWrite(s, "You have 0 active reservations.");
+                }
+                else {
+                    sessionWrite(s, view_response);
                 }
                 
-                state = LOGIN;
+                s->state = LOGIN;
                 break;
 
             case RELEASE:
+                if (sessionFrames(s) < 4){
+                    return 0;   // suspended until date, room, code and hotel arrive
+                }
 
                 // init before reading
-                memset(&booking, '\0', sizeof booking);
+                memset(booking, '\0', sizeof *booking);
 
-                readSocket(conn_sockfd, booking.date);
-                readSocket(conn_sockfd, booking.room);
-                readSocket(conn_sockfd, booking.code);
+                sessionRead(s, booking->date, sizeof booking->date);
+                sessionRead(s, booking->room, sizeof booking->room);
+                sessionRead(s, booking->code, sizeof booking->code);
+                booking->hotel = commandHotel(s);
 
                 // force code to be uppercase otherwise does not match in the table.
-                upper(booking.code);
+                upper(booking->code);
+
+                if (booking->hotel == 0){
+                    sessionWrite(s, OTHER_HOTEL_MSG);
+                    s->state = LOGIN;
+                    break;
+                }
+
+                if (follower_g){
+                    sessionWrite(s, READONLY_MSG);
+                    s->state = LOGIN;
+                    break;
+                }
 
+                if (rateLimitUser(&limits_g, RATE_BOOKING, user->username, busy, sizeof(busy)) ||
+                    rateLimitAddress(&limits_g, RATE_BOOKING, s->ip, busy, sizeof(busy)) ||
+                    admissionShed(admission, ADMISSION_SESSION, busy, sizeof(busy))){
+                    sessionWrite(s, busy);
+                    s->state = LOGIN;
+                    break;
+                }
 
-                rv = releaseReservation(thread_index, user, &booking);
+                rv = parseBookingDate(booking);
+                if (rv == 0){
+                    rv = releaseReservation(thread_index, user, booking);
+                }
 
                 if (rv == 0){
-                    writeSocket(conn_sockfd, "\033[92mOK.\x1b[0m Reservation deleted successfully.");
+                    sessionWrite(s, "\033[92mOK.\x1b[0m Reservation deleted successfully.");
                 }
                 else {
-                    writeSocket(conn_sockfd, "\x1b[31mFailed. \x1b[0mYou have no such reservation.");
+                    sessionWrite(s, "\x1b[31mFailed. \x1b[0mYou have no such reservation.");
                 }
 
-                state = LOGIN;
+                s->state = LOGIN;
 
                 break;
 
             case QUIT:
-                strcpy(command, "abort");
-                
-                free(user);
-    
                 printf("THREAD #%d: quitting\n", thread_index);
-                break;
+                return 1;           // the user goes with the session
 
         }
 
         #if DEBUG
-            printServerFSMState(&state, &thread_index);
+            printServerFSMState(&s->state, &thread_index);
         #endif
         
-
-        // check whether the only coomand that would the program exit the while loop has arrived.
-        if (strcmp(command, "abort") == 0){
-            return;
-        }
-
     
     }
 
@@ -871,17 +2091,35 @@ dispatcher (int conn_sockfd, int thread_index)
 
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
+sqlite3*
+databaseConnection(int thread_index)
+{
+    int slot = thread_index >= 0 ? thread_index : NUM_THREADS - 1 - thread_index;  // -1: main, -2: snapshot thread, -3: replication
+
+    if (db_g[slot] == NULL){
+        int rc = sqlite3_open(DATABASE, &db_g[slot]);
+
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db_g[slot]));
+            sqlite3_close(db_g[slot]);
+            db_g[slot] = NULL;
+            return NULL;
+        }
+        sqlite3_busy_timeout(db_g[slot], DATABASE_BUSY_TIMEOUT);
+    }
+    return db_g[slot];
+}
+
+
+
 int 
 commitToDatabase(int thread_index, const char* sql_command)
 {
-    sqlite3* db;
+    sqlite3* db = databaseConnection(thread_index);
     char* err_msg = 0;
+    int rc;
     
-    int rc = sqlite3_open(DATABASE, &db);
-    
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+    if (db == NULL) {
         return -1;
     }
     
@@ -901,52 +2139,47 @@ commitToDatabase(int thread_index, const char* sql_command)
         fprintf(stderr, "SQL error: %s\n", err_msg);
         
         sqlite3_free(err_msg);        
-        sqlite3_close(db);
         
         return 1;
     } 
     
-    sqlite3_close(db);
     return 0;
 }
 
 
 
-query_t* 
-queryDatabase(int thread_index, const int query_id, const char* sql_command) 
+query_t 
+queryDatabase(int thread_index, const int query_id, const char* sql_command, void* payload) 
 {
     
-    query_t* query = (query_t*) malloc(sizeof(query_t)); // variable to be returned + its initialization
+    query_t query = { .rv = -1, .query_result = (void*)"" };    // variable to be returned
 
 
-    sqlite3* db;
+    sqlite3* db = databaseConnection(thread_index);
     char* err_msg = 0;
+    int rc = SQLITE_OK;
     
-    int rc = sqlite3_open(DATABASE, &db);
-
-    
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database:\n%s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        
-        query->rv = -1;
-        query->query_result = (void*)"";
+    if (db == NULL) {
         return query;
     }
     
 
 
     switch (query_id){
-        case 0:
-            rc = sqlite3_exec(db, sql_command, viewCallback, 0, &err_msg);
+        case 5:
+            rc = sqlite3_exec(db, sql_command, int64Callback, payload, &err_msg);
             break;
-        
-        case 1:
-            rc = sqlite3_exec(db, sql_command, busy_roomsCallback, 0, &err_msg);
+
+        case 6:
+            rc = sqlite3_exec(db, sql_command, deleteCallback, payload, &err_msg);
+            break;
+
+        case 7:
+            rc = sqlite3_exec(db, sql_command, scanCallback, payload, &err_msg);
             break;
 
-        case 2:
-            rc = sqlite3_exec(db, sql_command, validEntryCallback, 0, &err_msg); 
+        case 8:
+            rc = sqlite3_exec(db, sql_command, changeCallback, payload, &err_msg);
             break;
     }
 
@@ -960,37 +2193,21 @@ queryDatabase(int thread_index, const int query_id, const char* sql_command)
         fprintf(stderr, "SQL error: %s\n", err_msg);
 
         sqlite3_free(err_msg);
-        sqlite3_close(db);
         
-        query->rv = -1;
-        query->query_result = (void*)"";
         return query;
     } 
 
-    sqlite3_close(db);
-
 
     // based on the query return the appropriate variable
     
 
     switch (query_id){
-        case 0:
-
-            // removing new line from last entry in list of entries (`view` response)
-            query_result_g[strlen(query_result_g)-1] = '\0';
-
-            query->rv = 0;
-            query->query_result = (void*) query_result_g;
-            break;
-        
-        case 1:
-            query->rv = 0;
-            query->query_result = (void*) rooms_busy_g;
-            break;
-        
-        case 2:
-            query->rv = 0;
-            query->query_result = (void*) &entry_id_g;
+        case 5:
+        case 6:
+        case 7:
+        case 8:
+            query.rv = 0;
+            query.query_result = payload;
             break;
     }
 
@@ -998,75 +2215,88 @@ queryDatabase(int thread_index, const int query_id, const char* sql_command)
 }
 
 
-int 
-viewCallback (void* NotUsed, int argc, char** argv, char** azColName) 
+/**
+ * Row (id, user, date_yyyymmdd, room, code, hotel) to StoredBooking.
+ * return 0 if OK, -1 if the row is malformed
+ */
+static int 
+rowToStoredBooking(char** argv, StoredBooking* b)
 {
-    /*  Format of returned string:
-     *  18/06/2020, room 21, reserve code: 8GT4A
-     */
-
+    int y, m, d;
 
-    // query_result_g is the payload "to be returned". 
-    // query_result_g is a global variable!
+    if (argv[0] == NULL || argv[1] == NULL || argv[2] == NULL || argv[3] == NULL || argv[4] == NULL || argv[5] == NULL ||
+        sscanf(argv[2], "%4d%2d%2d", &y, &m, &d) != 3 || !dateIsValid(y, m, d)){
+        return -1;
+    }
 
-    // clean payload right before filling if from scratch.
-    // memset(query_result_g, '\0', sizeof(query_result_g));
+    memset(b, '\0', sizeof(StoredBooking));
+    b->id    = atoll(argv[0]);
+    b->hotel = (uint32_t) atoll(argv[5]);
+    b->day   = daysFromCivil(y, m, d);
+    b->room  = atoi(argv[3]);
+    strncpy(b->username, argv[1], sizeof(b->username) - 1);
+    strncpy(b->code,     argv[4], sizeof(b->code) - 1);
+    return 0;
+}
 
-    
-    char tmp_str[64];
-    memset(tmp_str, '\0', sizeof(tmp_str));
 
 
-    for (int i = 0; i < argc; i++)
-    {
-        if (i==0){
-            snprintf(tmp_str, sizeof(tmp_str), "%s   ", argv[i]);
-        }
-        else if (i == 1){
-            snprintf(tmp_str, sizeof(tmp_str), "%s     ", argv[i]);   
-        }
-        else if (i == 2){
-            snprintf(tmp_str, sizeof(tmp_str), "%s", argv[i]);   
-        }
-        strcat(query_result_g, tmp_str);
+int 
+scanCallback(void* payload, int argc, char** argv, char** azColName) 
+{   
+    // one row per booking: id, user, date_yyyymmdd, room, code.
+    ScanRequest*  request = (ScanRequest*) payload;
+    StoredBooking b;
 
+    if (rowToStoredBooking(argv, &b) != 0){
+        return 0;   // malformed row, skip it
     }
-    
-    strcat(query_result_g, "\n");
-        
 
+    #if VERY_VERBOSE_DEBUG
+        printf("Scanning booking %lld\n", (long long) b.id);
+    #endif
+
+    request->visit(&b, request->payload);  // stopping early isn't worth aborting the query
     return 0;
 }
 
 
 
-
 int 
-busy_roomsCallback(void* NotUsed, int argc, char** argv, char** azColName) 
-{
-    
-    // rooms_busy_g is the payload "to be returned". 
-    // rooms_busy_g is a global variable!
+changeCallback(void* payload, int argc, char** argv, char** azColName) 
+{   
+    // one row per change: released, id, user, date_yyyymmdd, room, code.
+    ScanRequest*  request = (ScanRequest*) payload;
+    StoredBooking b;
 
-    // clean payload right before filling if from scratch.
-    memset(rooms_busy_g, '\0', sizeof(rooms_busy_g));
-    
-    strcpy(rooms_busy_g, argv[0]);  // the variable to be returned is
-                                    // only a number (str) and only a single argument, hence argv[0]
+    if (argv[0] == NULL || rowToStoredBooking(argv + 1, &b) != 0){
+        return 0;   // malformed row, skip it
+    }
 
+    if (atoi(argv[0])){
+        request->removed(&b, request->payload);
+    }
+    else {
+        request->visit(&b, request->payload);
+    }
     return 0;
 }
 
 
+
 int 
-validEntryCallback(void* NotUsed, int argc, char** argv, char** azColName) 
-{   
-    entry_id_g = atoi(argv[0]);
+int64Callback(void* payload, int argc, char** argv, char** azColName) 
+{
+    *(int64_t*) payload = argv[0] != NULL ? atoll(argv[0]) : 0;
+    return 0;
+}
 
-    #if VERY_VERBOSE_DEBUG
-        printf("Releasing entry with id %d\n", entry_id_g);
-    #endif
-    
+
+
+int 
+deleteCallback(void* payload, int argc, char** argv, char** azColName) 
+{
+    (*(int*) payload)++;
     return 0;
 }
 
@@ -1079,507 +2309,1216 @@ setupDatabase()
     char* sql_command = QUOTE(
             CREATE TABLE IF NOT EXISTS Bookings(
                 `id`            INTEGER     PRIMARY KEY,
+                `hotel`         INTEGER     NOT NULL,
                 `user`          TEXT        DEFAULT NULL,
                 `date`          TEXT        DEFAULT NULL,
                 `date_yyyymmdd` TEXT        DEFAULT NULL,
                 `room`          TEXT        DEFAULT NULL,
                 `code`          TEXT        DEFAULT NULL,
 
-                UNIQUE(user, date, room)
+                UNIQUE(hotel, user, date, room)
+            );
+            CREATE INDEX IF NOT EXISTS bookings_code ON Bookings(code);
+
+            CREATE TABLE IF NOT EXISTS Changes(
+                `seq`           INTEGER     PRIMARY KEY AUTOINCREMENT,
+                `released`      INTEGER,
+                `booking`       INTEGER,
+                `user`          TEXT,
+                `date_yyyymmdd` TEXT,
+                `room`          TEXT,
+                `code`          TEXT,
+                `hotel`         INTEGER
             );
+            CREATE TRIGGER IF NOT EXISTS bookings_inserted AFTER INSERT ON Bookings
+            BEGIN
+                INSERT INTO Changes(released, booking, user, date_yyyymmdd, room, code, hotel)
+                VALUES (0, new.id, new.user, new.date_yyyymmdd, new.room, new.code, new.hotel);
+            END;
+            CREATE TRIGGER IF NOT EXISTS bookings_released AFTER DELETE ON Bookings
+            BEGIN
+                INSERT INTO Changes(released, booking, user, date_yyyymmdd, room, code, hotel)
+                VALUES (1, old.id, old.user, old.date_yyyymmdd, old.room, old.code, old.hotel);
+            END;
+
+            CREATE TABLE IF NOT EXISTS Generation(`id` INTEGER);
+            INSERT INTO Generation(id) SELECT abs(random()) WHERE NOT EXISTS (SELECT 1 FROM Generation);
+
+            PRAGMA journal_mode = WAL;
     );
+                // Changes: bookings stored and deleted since the last snapshot, replayed at startup.
+                // Generation: random id of this database, snapshots of another one are ignored.
+                // WAL: snapshot reads don't block writers.
 
     int rv;
-    rv = commitToDatabase(-1, sql_command);
+    rv = migrateDatabase();
+    if (rv == 0){
+        rv = commitToDatabase(-1, sql_command);
+    }
     
     return rv;  // 0 meaning ok, -1 not ok
 }
 
 
+
 int 
-usernameIsRegistered(char* u)
+migrateDatabase()
 {
-    char username[30];
-    char enc_pass[30];
-    char line[50];
-
-    // locking shared resource
-    pthread_mutex_lock(&users_lock_g);
-
-    FILE* users_file;
-
-    users_file = fopen(USER_FILE, "r");
-    if(users_file == NULL) {
-        pthread_mutex_unlock(&users_lock_g);
-        return 0;       // no file exists, hence no username exists, gr8
+    char    sql_command[1024];
+    int64_t missing = 0;
+    int     rv;
+
+    // Bookings without the hotel ID: rebuilt, the key changed
+    rv = queryDatabase(-1, 5, "SELECT (SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'Bookings') - "
+                              "(SELECT COUNT(*) FROM pragma_table_info('Bookings') WHERE name = 'hotel')", &missing).rv;
+    if (rv != 0 || missing <= 0){
+        return rv;
     }
 
-    // check whether the user is already in the file (= already registered)
-    while(fgets(line, sizeof(line), users_file)) {
-        sscanf(line, "%s %s\n", username, enc_pass);
-        
-        // checking whether `u` (i.e. username coming from the client) 
-        // matches `username` (i.e. username saved on the file in the server)
-        if (strcmp(u, username) == 0){
-            fclose(users_file);
-            
-            // unlocking shared resource before going returning to caller
-            pthread_mutex_unlock(&users_lock_g);
-            return 1;   // found user in the file
-        }
-    }
+    snprintf(sql_command, sizeof(sql_command),
+             "BEGIN;"
+             "DROP TRIGGER IF EXISTS bookings_inserted;"
+             "DROP TRIGGER IF EXISTS bookings_released;"
+             "DROP INDEX IF EXISTS bookings_code;"
+             "ALTER TABLE Bookings RENAME TO Bookings_v1;"
+             "CREATE TABLE Bookings(`id` INTEGER PRIMARY KEY, `hotel` INTEGER NOT NULL, `user` TEXT DEFAULT NULL,"
+                                   "`date` TEXT DEFAULT NULL, `date_yyyymmdd` TEXT DEFAULT NULL, `room` TEXT DEFAULT NULL,"
+                                   "`code` TEXT DEFAULT NULL, UNIQUE(hotel, user, date, room));"
+             "INSERT INTO Bookings(id, hotel, user, date, date_yyyymmdd, room, code)"
+                " SELECT id, %d, user, date, date_yyyymmdd, room, code FROM Bookings_v1;"
+             "DROP TABLE Bookings_v1;"
+             "DROP TABLE IF EXISTS Changes;"    // history and generation start over: older snapshots are stale
+             "DROP TABLE IF EXISTS Generation;"
+             "COMMIT;",
+             HOTEL_ID_DEFAULT);
 
-    fclose(users_file);
+    #if DEBUG
+        printf(ANSI_COLOR_GREEN "[+] Bookings given hotel ID %d.\n" ANSI_COLOR_RESET, HOTEL_ID_DEFAULT);
+    #endif
+    return commitToDatabase(-1, sql_command);
+}
 
-    // unlocking shared resource before going returning to caller
-    pthread_mutex_unlock(&users_lock_g);
-    
-    return 0;           // username `u` is new to the system, hence the registration can proceed.
+
+int 
+sqliteOpen(const char* path)
+{
+    // `path` is DATABASE: every thread opens its own connection to it with databaseConnection().
+    return setupDatabase();
 }
 
 
 
 int 
-updateUsersRecordFile(char* username, char* encrypted_password)
+sqliteScan(int thread_index, const char* username, storage_visit_t visit, void* payload)
 {
-    // buffer (will) store the line to be appended to the file.
-    char buffer[USERNAME_MAX_LENGTH + PASSWORD_MAX_LENGTH + 2];
-    memset(buffer, '\0', sizeof(buffer));
+    ScanRequest request = { .visit = visit, .removed = NULL, .payload = payload };
+    char sql_command[128];
 
-    // creating the "payload"
-    strcat(buffer, username);
-    strcat(buffer, " ");
-    strcat(buffer, encrypted_password);
+    if (username == NULL){
+        snprintf(sql_command, sizeof(sql_command),
+                 "SELECT id, user, date_yyyymmdd, room, code, hotel FROM Bookings ORDER BY id");
+    }
+    else {
+        // no SQL injection hazard, usernames are sanitized on registration.
+        snprintf(sql_command, sizeof(sql_command),
+                 "SELECT id, user, date_yyyymmdd, room, code, hotel FROM Bookings WHERE user = '%s' ORDER BY id", username);
+    }
 
-    // protecting shared resource access with semaphore
-    pthread_mutex_lock(&users_lock_g);
+    return queryDatabase(thread_index, 7, sql_command, &request).rv;
+}
 
-    FILE* users_file;
-    users_file = fopen(USER_FILE, "a+");
-    if (users_file == NULL) {
-        perror_die("fopen()");
-    }
 
-    // add line
-    fprintf(users_file, "%s\n", buffer);
 
-    // close connection to file
-    fclose(users_file);
+int 
+sqliteInsert(int thread_index, StoredBooking* b)
+{
+    char date[DATE_STRING_LENGTH];
+    char date_yyyymmdd[9];      // <yyyymmdd> which is easier to sort.
+    char sql_command[256];
 
-    pthread_mutex_unlock(&users_lock_g);
+    formatDate(b->day, date);
+    formatDateYYYYMMDD(b->day, date_yyyymmdd);
 
-    return 0;
+    // no SQL injection hazard, values are sanitized on client side.
+    // no "or IGNORE": the room comes from the occupancy index, a conflict
+    // means index and table disagree and the reservation must fail.
+    snprintf(sql_command, sizeof(sql_command),
+             "INSERT INTO Bookings(hotel, user, date, date_yyyymmdd, room, code) VALUES(%u, '%s', '%s', '%s', '%d', '%s') RETURNING id;",
+             b->hotel, b->username, date, date_yyyymmdd, b->room, b->code);
+
+    b->id = 0;
+    return (queryDatabase(thread_index, 5, sql_command, &b->id).rv == 0 && b->id > 0) ? 0 : -1;
 }
 
-char* 
-encryptPassword(int thread_index, char* password)
-{
-    // encrypted password returned 
-    // (static because it has to outlive the time-scope of the function)
-    static char res[512];   
-    
-    char salt[2];           // salt
 
 
+int 
+sqliteRemove(int thread_index, int64_t id)
+{
+    char sql_command[64];
+    int  deleted = 0;
 
-    /* generating salt using generateRandomString function
-     * which I would have written regardless for generating the random reservation code.
-     */
-    generateRandomString(salt, 3);  // 3:   2 for salt, 1 for '\0'.
-    
+    // by primary key, RETURNING tells whether the row was still there.
+    snprintf(sql_command, sizeof(sql_command), "DELETE FROM Bookings WHERE id = %lld RETURNING id", (long long) id);
 
-    #if VERBOSE_DEBUG
-        printf("Thread #%d: Salt: %c%c\n", thread_index, salt[0], salt[1]);
-    #endif
+    if (queryDatabase(thread_index, 6, sql_command, &deleted).rv != 0){
+        return -1;
+    }
+    return deleted == 1 ? 0 : 1;
+}
 
-    
-    // copy encrypted password to res and return it.
-    strncpy(res, crypt(password, salt), sizeof(res)); 
 
-    return res;
-}
-    
 
 int 
-checkIfPasswordMatches(User* user) 
+sqliteSnapshot(int thread_index, storage_visit_t visit, void* payload, StorageCursor* cursor)
 {
-    char stored_username[USERNAME_MAX_LENGTH];
-    char stored_enc_psswd[PASSWORD_MAX_LENGTH];
-    char line[USERNAME_MAX_LENGTH + PASSWORD_MAX_LENGTH + 2];
+    ScanRequest request = { .visit = visit, .removed = NULL, .payload = payload };
+    int rv;
 
-    #if ENCRYPT_PASSWORD 
-        char salt[2];
-    #else
-    #endif
-    
+    // one read transaction: the cursor and the rows are the same point in time.
+    if (commitToDatabase(thread_index, "BEGIN") != 0){
+        return -1;
+    }
+
+    rv = queryDatabase(thread_index, 5, "SELECT id FROM Generation", &cursor->generation).rv;
+    if (rv == 0){
+        rv = queryDatabase(thread_index, 5, "SELECT seq FROM sqlite_sequence WHERE name = 'Changes'", &cursor->position).rv;
+    }
+    if (rv == 0){
+        rv = queryDatabase(thread_index, 5, "SELECT MAX(id) FROM Bookings", &cursor->max_id).rv;
+    }
+    if (rv == 0){
+        rv = queryDatabase(thread_index, 7, "SELECT id, user, date_yyyymmdd, room, code, hotel FROM Bookings ORDER BY id", &request).rv;
+    }
 
-    char res[512]; // result of decryption operation
+    commitToDatabase(thread_index, "COMMIT");
+    return rv;
+}
 
-    // protecting shared resource with mutex semaphore
-    pthread_mutex_lock(&users_lock_g);
 
-    FILE* users_file;
 
-    users_file = fopen(USER_FILE, "r");     // opening file in read mode
-    if (users_file == NULL) {
-        perror("fopen(USER_FILE)");
+int 
+sqliteTail(int thread_index, const StorageCursor* since,
+           storage_visit_t inserted, storage_visit_t removed, void* payload)
+{
+    ScanRequest request = { .visit = inserted, .removed = removed, .payload = payload };
+    char sql_command[128];
+    int64_t generation = 0, oldest = 0;
 
-        pthread_mutex_unlock(&users_lock_g);
-        return -1;       // file is missing...
+    // another database, or history dropped past the cursor?
+    if (queryDatabase(thread_index, 5, "SELECT id FROM Generation", &generation).rv != 0 ||
+        queryDatabase(thread_index, 5, "SELECT MIN(seq) FROM Changes", &oldest).rv != 0){
+        return -1;
+    }
+    if (generation != since->generation || (oldest != 0 && oldest > since->position + 1)){
+        return 1;
     }
 
+    snprintf(sql_command, sizeof(sql_command),
+             "SELECT released, booking, user, date_yyyymmdd, room, code, hotel FROM Changes WHERE seq > %lld ORDER BY seq",
+             (long long) since->position);
 
-    // Scroll through the lines of users_file
-    while(fgets(line, sizeof(line), users_file)){
+    return queryDatabase(thread_index, 8, sql_command, &request).rv;
+}
 
 
-        // get username and password from line
-        sscanf(line, "%s %s", stored_username, stored_enc_psswd);
 
-        #if ENCRYPT_PASSWORD 
-            // retrieve salt
-            salt[0] = stored_enc_psswd[0];
-            salt[1] = stored_enc_psswd[1];
+void 
+sqliteCheckpoint(int thread_index, const StorageCursor* cursor)
+{
+    char sql_command[64];
 
-            
-            // copy encrypted password to res and return it.
-            #if 1
-                strncpy(res, crypt(user->actual_password, salt), sizeof(res)); 
-            #else
-                memset(res, '\0', sizeof(res));
-                strcpy(res, crypt(user->actual_password, salt)); 
-            #endif
-            
-        #else
-            strcpy(res, user->actual_password);
-        
-        #endif
-        // if username and password match, login is successful.
-        if (strcmp(user->username, stored_username) == 0 && strcmp(res, stored_enc_psswd) == 0){
-            fclose(users_file);
-            pthread_mutex_unlock(&users_lock_g);
-            return 0;
-        }
+    snprintf(sql_command, sizeof(sql_command), "DELETE FROM Changes WHERE seq <= %lld", (long long) cursor->position);
+    commitToDatabase(thread_index, sql_command);
+}
+
+
+
+void 
+sqliteStats(FILE* out)
+{
+    struct stat st;
+
+    fprintf(out, "engine sqlite\n");
+    if (stat(DATABASE, &st) == 0){
+        fprintf(out, "file_bytes %lld\n", (long long) st.st_size);
     }
+}
+
+
+
+/**
+ * Index `b` in its hotel and in the quota of its user. Tenant lock held.
+ */
+static void
+tenantIndex(HotelTenant* t, const StoredBooking* b)
+{
+    CodeEntry entry;
 
-    fclose(users_file);
-    pthread_mutex_unlock(&users_lock_g);
-    return 1;
+    // bookings outside the horizon are simply not indexed
+    markRoomBooked(&t->hotel, b->day, b->room);
 
+    memset(&entry, '\0', sizeof(entry));
+    strncpy(entry.code,     b->code,     sizeof(entry.code) - 1);
+    strncpy(entry.username, b->username, sizeof(entry.username) - 1);
+    entry.day   = b->day;
+    entry.room  = b->room;
+    entry.hotel = b->hotel;
+    entry.id    = b->id;
+    codeIndexInsert(&t->codes, &entry);
+
+    userQuotaSet(&quota_g, b->username, userQuotaBookings(&quota_g, b->username) + 1);
 }
 
 
-int 
-saveReservation(int thread_index, User* u, Booking* b)
+/**
+ * Undo tenantIndex(). Tenant lock held.
+ */
+static void
+tenantUnindex(HotelTenant* t, const StoredBooking* b)
 {
+    releaseRoom(&t->hotel, b->day, b->room);
+    codeIndexRemove(&t->codes, b->code, b->username, b->day, b->room);
+    userQuotaRelease(&quota_g, b->username);
+}
 
-    /* You may want to add a check to see whether the same 
-     * reservation is already stored, even though it's higly unlikely
-     * given that the code is random.
-     */
 
-    int rv;
 
+int 
+warmupVisit(const StoredBooking* b, void* NotUsed)
+{
+    HotelTenant* t = hotelRegistryAdd(&hotels_g, b->hotel);
 
-    // manipulating date and putting into this form <yyyymmdd> which is easier to sort. remember d is <dd/mm>
-    char date_yyyymmdd[9] = {'2','0','2','0',b->date[3],b->date[4],b->date[0],b->date[1]};
+    if (t == NULL){
+        printf("\x1b[31mHotel %u not served: more than %d hotels.\x1b[0m\n", b->hotel, HOTELS_MAX);
+        return 0;
+    }
 
+    MUTEX_LOCK(&t->lock);
+        tenantIndex(t, b);
+    MUTEX_UNLOCK(&t->lock);
 
-    char sql_command[256];
+    return 0;
+}
 
-    memset(sql_command, '\0', sizeof(sql_command));
 
-    // no SQL injection hazard, values are sanitized on client side.
-    strcat(sql_command, "INSERT or IGNORE INTO Bookings(user, date, date_yyyymmdd, room, code) VALUES('");
-                            // "or IGNORE" is actually negligible since I'm sure the room differs from any other room
-                            // with the same user and date previously stored.
-    strcat(sql_command, u->username);
-    strcat(sql_command, "', '");
-    strcat(sql_command, b->date);
-    strcat(sql_command, "', '");
-    strcat(sql_command, date_yyyymmdd);
-    strcat(sql_command, "', '");
-    strcat(sql_command, b->room);
-    strcat(sql_command, "', '");
-    strcat(sql_command, b->code);
-    strcat(sql_command, "');");
-    
 
-    rv = commitToDatabase(thread_index, sql_command);
+int 
+warmdownVisit(const StoredBooking* b, void* NotUsed)
+{
+    HotelTenant* t = hotelRegistryFind(&hotels_g, b->hotel);
 
-    return rv;  // 0 is OK, -1 is not.
+    if (t != NULL){
+        MUTEX_LOCK(&t->lock);
+            tenantUnindex(t, b);
+        MUTEX_UNLOCK(&t->lock);
+    }
+    return 0;
 }
 
 
 
-char* 
-assignRoom(int thread_index, char* date)
+static int 
+countVisit(const StoredBooking* b, void* payload)
 {
+    (*(uint64_t*) payload)++;
+    return 0;
+}
 
-    char sql_command[512];
-    memset(sql_command, '\0', sizeof(sql_command));
 
-    strcat(sql_command, "SELECT count(id) from Bookings WHERE date = '");
-    strcat(sql_command, date);
-    strcat(sql_command, "'");
 
+static int 
+tailVisit(const StoredBooking* b, void* payload)
+{
+    return warmupVisit(b, NULL) + countVisit(b, payload);
+}
 
-    // Querying the database with the command just created
-    query_t* query = (query_t*) malloc(sizeof(query_t));
-    // memset(&query, 0, sizeof query );
 
 
-    // initialize that long variable
-    query = queryDatabase(thread_index, 1, sql_command);
+static int 
+tailRemoveVisit(const StoredBooking* b, void* payload)
+{
+    return warmdownVisit(b, NULL) + countVisit(b, payload);
+}
+
 
 
+int 
+loadBookings()
+{
+    Snapshot snapshot;
+    int rv = 1;
 
-    // Checking the results of the query
-    if (query->rv == 0){     // if return value is not 0, something went wrong.
+    // startup: no other thread yet, each booking takes the lock of its hotel
+    if (snapshotOpen(SNAPSHOT, &snapshot) == 0){
+        StoredBooking b;
 
-        if (atoi(query->query_result) == 0){
-            // hotel is actually empty on that date.
-            // assigning room 1 which is obviously free.
-            return "1";
+        for (uint64_t i = 0; i < snapshot.header->count; i++){
+            snapshotBooking(&snapshot, i, &b);
+            warmupVisit(&b, NULL);
         }
-        else {
+        warmup_snapshot_g = snapshot.header->count;
 
-            /*
-                
-                -- most convoluted way I could come up with to find a free room.
-                -- how this works:
-                --       1) first part selects a room stacked on top of the previous ones
-                --       2) second part looks for a room that has been reserved and then released
-                --          leaving a gap between two adjactent reservations
-                --       3) ifnull check is performed to make sure it doesn't return NULL 
-                --          which would make MIN fail.
-                --       4) the min of those two selects is choosen.
-                --
-
-                SELECT MIN
-                (
-                    (
-                        SELECT ifnull
-                        (
-
-                            (
-                                SELECT   (room + 1)
-                                FROM Bookings
-                                WHERE (
-                                    (date = '<DATE_OF_INTEREST>') 
-                                    AND 
-                                    room+1 <= <hotel_max_available_rooms>
-                                    AND 
-                                    (room + 1 NOT IN 
-                                        (SELECT DISTINCT room FROM Bookings WHERE date = '<DATE_OF_INTEREST>')
-                                    )
-                                )
-                            ),
-                            999
-                        )
-                    )
-                    ,
-                    (    
-                        SELECT ifnull
-                        (
-                            (
-                                SELECT   (room -1)
-                                FROM Bookings
-                                WHERE (
-                                    (date = '<DATE_OF_INTEREST>') 
-                                    AND 
-                                    room-1 > 0
-                                    AND 
-                                    (room - 1 NOT IN 
-                                        (SELECT DISTINCT room FROM Bookings WHERE date = '<DATE_OF_INTEREST>')
-                                    )
-                                )
-                            ),
-                            999  
-                        )
-                    )
-                )
-
-            */
-
-            char hotel_max_available_rooms_string[4];
-            sprintf(hotel_max_available_rooms_string, "%d", hotel_max_available_rooms);
-
-
-            // pushing THAT query into `sql_command` string.
-
-            memset(sql_command, '\0', sizeof(sql_command));
-
-            strcat(sql_command, "SELECT MIN ( ( SELECT ifnull ( ( SELECT (room + 1) FROM Bookings WHERE ( (date = '");
-            strcat(sql_command, date);
-            strcat(sql_command, "') AND room+1 <= ");
-            strcat(sql_command, hotel_max_available_rooms_string);
-            strcat(sql_command, " AND (room + 1 NOT IN (SELECT DISTINCT room FROM Bookings WHERE date = '");
-            strcat(sql_command, date);
-            strcat(sql_command, "') ) ) ), 999 ) ) , ( SELECT ifnull ( ( SELECT (room -1) FROM Bookings WHERE ( (date = '");
-            strcat(sql_command, date);
-            strcat(sql_command, "') AND room-1 > 0 AND (room - 1 NOT IN (SELECT DISTINCT room FROM Bookings WHERE date = '");
-            strcat(sql_command, date);
-            strcat(sql_command, "') ) ) ), 999 ) ) )");
-
-            query = queryDatabase(thread_index, 1, sql_command);
-
-            // Checking the results of the query
-            if (query->rv == 0){     // if return value is not 0, something went wrong.
-
-                if (atoi(query->query_result) == 999){
-                    // hotel is full
-                    free(query);
-                    return "FULL";
-                }
-                else {
-                    // free(query); ... to be done
-                    return query->query_result; // NUMBER as string
-                }
-            }
-            else {
-                printf("%s\n", "Error querying the database!");
-                free(query);
-                return "";
-            }
+        rv = storage_g.tail(-1, &snapshot.header->cursor, tailVisit, tailRemoveVisit, &warmup_tail_g);
 
+        if (rv != 0){
+            // stale snapshot (or storage error): forget it
+            for (uint64_t i = 0; i < snapshot.header->count; i++){
+                snapshotBooking(&snapshot, i, &b);
+                warmdownVisit(&b, NULL);
+            }
+            warmup_snapshot_g = warmup_tail_g = 0;
         }
+        snapshotClose(&snapshot);
     }
-    else {
-        printf("%s\n", "Error querying the database!");
-        free(query);
-        return "";
-    }
-}   
 
+    // the snapshot thread writes a new snapshot if the tail wasn't empty
+    bookings_changed_g = warmup_tail_g;
 
+    if (rv != 0){
+        rv = storage_g.scan(-1, NULL, warmupVisit, NULL);
+        bookings_changed_g = 1;     // no usable snapshot: take one soon
+    }
 
+    return rv;
+}
 
 
-void
-generateRandomString(char* str, size_t size)  // size_t: type able to represent the size of any object in bytes
+
+void* 
+snapshotThread(void* NotUsed)
 {
+    uint64_t      last_changed = 0;
+    StorageCursor cursor;
+    int           elapsed = 0;
 
-    const char charset[] =  "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                            "abcdefghijklmnopqrstuvwxyz"
-                            "0123456789";                       // side note: the characters "." and "/" are also allowed as arguments of `crypt()`,
-                                                                //            however they're not included in this list because the reservation code
-                                                                //            -- that uses this function -- has to be an alphanumeric string.
+    while (1)
+    {
+        sleep(1);
 
-    // init random number generator
-    srand(time(NULL));
-    
+        if (++elapsed < SNAPSHOT_INTERVAL){
+            continue;
+        }
+        elapsed = 0;
 
-    if (size) {
-        --size;
-        for (size_t n = 0; n < size; n++) {
-            int key = rand() % (int) (sizeof charset - 1);
-            str[n] = charset[key];
+        uint64_t changed = __atomic_load_n(&bookings_changed_g, __ATOMIC_RELAXED);
+        if (changed == last_changed){
+            continue;
+        }
+
+        if (snapshotTake(&storage_g, SNAPSHOT_THREAD_INDEX, SNAPSHOT, &cursor) != 0){
+            perror("snapshot");
+            continue;
         }
-        // str[size] = '\0';
+        storage_g.checkpoint(SNAPSHOT_THREAD_INDEX, &cursor);
+
+        last_changed = changed;
+        __atomic_add_fetch(&snapshots_g, 1, __ATOMIC_RELAXED);
+
+        #if DEBUG
+            printf("SNAPSHOT: written, cursor %lld/%lld\n", (long long) cursor.generation, (long long) cursor.position);
+        #endif
     }
-    return;
+
+    return NULL;
 }
 
 
 
-char* 
-fetchUserReservations(int thread_index, User* user)
+void 
+snapshotMetrics(FILE* out)
 {
-    query_t* query = (query_t*) malloc(sizeof(query_t));
- 
-    char sql_command[1024];
-    memset(sql_command, '\0', sizeof(sql_command));
+    fprintf(out, "snapshots %llu\n",          (unsigned long long) __atomic_load_n(&snapshots_g, __ATOMIC_RELAXED));
+    fprintf(out, "changes %llu\n",            (unsigned long long) __atomic_load_n(&bookings_changed_g, __ATOMIC_RELAXED));
+    fprintf(out, "warmup_snapshot %llu\n",    (unsigned long long) warmup_snapshot_g);
+    fprintf(out, "warmup_tail %llu\n",        (unsigned long long) warmup_tail_g);
+}
 
-    strcat(sql_command, "SELECT date, room, code FROM Bookings WHERE user = '");
-    strcat(sql_command, user->username);
-    #if SORT_VIEW_BY_DATE
-        strcat(sql_command, "' ORDER BY date_yyyymmdd, room");
-    #else
-        strcat(sql_command, "' ORDER BY id");
-    #endif
-    
 
-    query = queryDatabase(thread_index, 0, sql_command);
 
+void 
+quotaMetrics(FILE* out)
+{
+    UserQuotaEntry top[METRICS_TOP_USERS];
+    int n = userQuotaTop(&quota_g, top, METRICS_TOP_USERS);
 
-    if (query->rv == 0){
-        // free(query); // cant free here because it has to be returned... ¯\_(ツ)_/¯
-        return (char*) query->query_result;
+    fprintf(out, "users %d\n", __atomic_load_n(&quota_g.users, __ATOMIC_RELAXED));
+    fprintf(out, "max_bookings_per_user %d\n", quota_g.max_bookings);
+    for (int i = 0; i < n; i++){
+        fprintf(out, "top%d %s %d\n", i + 1, top[i].username, top[i].bookings);
     }
-    else {
-        printf("%s\n", "Error querying the database!");
+}
+
+
+
+int 
+parseBookingDate(Booking* booking)
+{
+    int y, m, d;
 
-        free(query);
-        return "";
+    if (parseDate(booking->date, currentYear(), &y, &m, &d) != 0){
+        return -1;
     }
 
+    booking->day = daysFromCivil(y, m, d);
+    formatDate(booking->day, booking->date);
+    return 0;
 }
 
 
+
 int 
-releaseReservation(int thread_index, User* user, Booking* booking)
+checkDateValidity(Booking* booking)
 {
+    int          rv;
+    int          year   = currentYear();
+    HotelTenant* tenant = hotelRegistryFind(&hotels_g, booking->hotel);
+    Hotel*       hotel;
+    char         archive[sizeof(ARCHIVE) + 12];
 
-    /* check if entry is found in database
-     * if YES: delete it
-     * if NO: return failure value to main function
-     */
+    if (tenant == NULL || parseBookingDate(booking) != 0){
+        return -1;
+    }
+    hotel = &tenant->hotel;
 
-    // preparing payload
-    char sql_command[1024];
-    memset(sql_command, '\0', sizeof(sql_command));
-    strcat(sql_command, "SELECT COUNT(id) FROM Bookings WHERE user = '");
-    strcat(sql_command, user->username);
-    strcat(sql_command, "' and date = '");
-    strcat(sql_command, booking->date);
-    strcat(sql_command, "' and room = '");
-    strcat(sql_command, booking->room);
-    strcat(sql_command, "' and code = '");
-    strcat(sql_command, booking->code);
-    strcat(sql_command, "'");
-    
+    /* critical section */
+    MUTEX_LOCK(&tenant->lock);
 
-    // allocating dynamic variable where the result of the query will be stored.
-    query_t* query = (query_t*) malloc(sizeof(query_t));
-    query = queryDatabase(thread_index, 2, sql_command);
+        if (year > hotel->calendar.first_year){
+            // the default hotel archives where the single hotel always did
+            if (hotel->id == HOTEL_ID_DEFAULT){
+                snprintf(archive, sizeof(archive), "%s", ARCHIVE);
+            }
+            else {
+                snprintf(archive, sizeof(archive), "%s/%u", ARCHIVE, hotel->id);
+                mkdir(archive, 0755);
+            }
+            rv = rollHotelHorizon(hotel, year, archive);
+            #if DEBUG
+                printf("Hotel %u: horizon moved to %d-%d, %d year(s) archived.\n", hotel->id,
+                        hotel->calendar.first_year, hotel->calendar.first_year + hotel->calendar.years - 1, rv);
+            #endif
+        }
+
+        rv = calendarContains(&hotel->calendar, booking->day) ? 0 : -1;
+
+    MUTEX_UNLOCK(&tenant->lock);
+    /* end critical section */
+
+    return rv;
+}
+
+
+
+int 
+usernameIsRegistered(char* u)
+{
+    // lock-free: the user table is read through its own mapping
+    return userTableFind(&users_g, u) != NULL;
+}
+
+
+
+int 
+updateUsersRecordFile(char* username, char* encrypted_password)
+{
+    return userTableAdd(&users_g, username, encrypted_password);
+}
+
+char* 
+encryptPassword(int thread_index, char* password)
+{
+    // encrypted password returned 
+    // (static because it has to outlive the time-scope of the function, one per thread)
+    static __thread char res[512];   
     
+    char salt[3];           // salt + '\0'
 
-    if (query->rv == 0){
-        
-        if ( *((int*) query->query_result) == 0){  // 1 if in database, 0 otherwise.
-            
-            free(query);
+
+
+    /* generating salt using generateRandomString function
+     * which I would have written regardless for generating the random reservation code.
+     */
+    generateRandomString(salt, 3);  // 3:   2 for salt, 1 for '\0'.
+    
+
+    #if VERBOSE_DEBUG
+        printf("Thread #%d: Salt: %c%c\n", thread_index, salt[0], salt[1]);
+    #endif
+
+    
+    // copy encrypted password to res and return it.
+    SPAN_BEGIN(crypt_span);
+    MUTEX_LOCK(&users_lock_g);
+        strncpy(res, crypt(password, salt), sizeof(res) - 1); 
+    MUTEX_UNLOCK(&users_lock_g);
+    SPAN_END(crypt_span, "users", "crypt", 0);
+
+    return res;
+}
+    
+
+int 
+checkIfPasswordMatches(User* user) 
+{
+    const UserRecord* stored = userTableFind(&users_g, user->username);
+
+    if (stored == NULL){
+        return 1;
+    }
+
+    #if ENCRYPT_PASSWORD 
+        char salt[3];
+        char res[512]; // result of the encryption of the password received
+
+        // retrieve salt
+        salt[0] = stored->password[0];
+        salt[1] = stored->password[1];
+        salt[2] = '\0';
+
+        SPAN_BEGIN(crypt_span);
+        MUTEX_LOCK(&users_lock_g);
+            strncpy(res, crypt(user->actual_password, salt), sizeof(res) - 1);
+        MUTEX_UNLOCK(&users_lock_g);
+        SPAN_END(crypt_span, "users", "crypt", 0);
+        res[sizeof(res) - 1] = '\0';
+
+        return strcmp(res, stored->password) == 0 ? 0 : 1;
+    #else
+        return strcmp(user->actual_password, stored->password) == 0 ? 0 : 1;
+    #endif
+}
+
+
+int 
+saveReservation(int thread_index, User* u, Booking* b, int64_t* id)
+{
+
+    /* You may want to add a check to see whether the same 
+     * reservation is already stored, even though it's higly unlikely
+     * given that the code is random.
+     */
+
+    StoredBooking stored;
+    int rv;
+
+    memset(&stored, '\0', sizeof(stored));
+    strncpy(stored.username, u->username, sizeof(stored.username) - 1);
+    strncpy(stored.code,     b->code,     sizeof(stored.code) - 1);
+    stored.hotel = b->hotel;
+    stored.day   = b->day;
+    stored.room  = atoi(b->room);
+
+    SPAN_BEGIN(storage_span);
+    rv = storage_g.insert(thread_index, &stored);
+    SPAN_END(storage_span, "storage", "insert", 0);
+    *id = stored.id;
+
+    if (rv == 0){
+        __atomic_add_fetch(&bookings_changed_g, 1, __ATOMIC_RELAXED);
+        replicationPublish(&replication_g, REPLICATION_INSERT, &stored);
+    }
+
+    if (rv == 0){
+        CachedBooking cached = { .day = b->day, .room = atoi(b->room), .hotel = b->hotel };
+        strcpy(cached.code, b->code);
+
+        userCacheAdd(&user_cache_g, u->username, &cached);
+    }
+
+    return rv;  // 0 is OK, -1 is not.
+}
+
+
+
+int 
+setupInventory(int rooms)
+{
+    int rv = loadRoomCatalog(&hotels_g.inventory, ROOM_CATALOG);
+
+    if (rv < 0){
+        // no catalog: every room is a single, as the hotel used to be.
+        for (int room = 1; room <= rooms && room < HOTEL_MAX_ROOMS; room++){
+            addRoom(&hotels_g.inventory, room, ROOM_SINGLE);
+        }
+    }
+    #if DEBUG
+    else {
+        printf("Room catalog %s loaded, rooms from stdin ignored.\n", ROOM_CATALOG);
+    }
+    #endif
+
+    return hotels_g.inventory.rooms;
+}
+
+
+
+int 
+assignRoom(int thread_index, Booking* booking, room_type_t type)
+{
+    HotelTenant* tenant = hotelRegistryFind(&hotels_g, booking->hotel);
+    int          room;
+
+    /* critical section */
+    MUTEX_LOCK(&tenant->lock);
+        room = bookRoom(&tenant->hotel, booking->day, type);
+    MUTEX_UNLOCK(&tenant->lock);
+    /* end critical section */
+
+    #if VERBOSE_DEBUG
+        printf("Thread #%d: %s room on %s: %d\n", thread_index, roomTypeName(type), booking->date, room);
+    #endif
+
+    if (room < 0){
+        __atomic_add_fetch(&tenant->sold_out, 1, __ATOMIC_RELAXED);
+        return -1;  // no room available
+    }
+    if (room >= HOTEL_MAX_ROOMS){
+        return -1;  // never from bookRoom(), but it bounds what's printed below
+    }
+
+    snprintf(booking->room, sizeof(booking->room), "%d", room);
+    return 0;
+}   
+
+
+
+
+
+void
+generateRandomString(char* str, size_t size)  // size_t: type able to represent the size of any object in bytes
+{
+
+    const char charset[] =  "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                            "abcdefghijklmnopqrstuvwxyz"
+                            "0123456789";                       // side note: the characters "." and "/" are also allowed as arguments of `crypt()`,
+                                                                //            however they're not included in this list.
+
+    if (size) {
+        --size;
+        for (size_t n = 0; n < size; n++) {
+            str[n] = charset[randomBelow(sizeof charset - 1)];   // per-thread generator, no locking
+        }
+        str[size] = '\0';
+    }
+    return;
+}
+
+
+
+int 
+viewVisit(const StoredBooking* b, void* payload)
+{
+    UserBookings*  rows = (UserBookings*) payload;
+    CachedBooking* cached;
+
+    if (rows->count == VIEW_MAX_BOOKINGS){
+        return 1;   // wouldn't fit in the response anyway
+    }
+
+    cached = &rows->bookings[rows->count++];
+    cached->day   = b->day;
+    cached->room  = b->room;
+    cached->hotel = b->hotel;
+    memcpy(cached->code, b->code, sizeof(cached->code));
+
+    return 0;
+}
+
+
+
+static int 
+compareViewBookings(const void* a, const void* b)
+{
+    return compareCachedBookings((const CachedBooking*) a, (const CachedBooking*) b);
+}
+
+
+
+int 
+fetchUserReservations(int thread_index, User* user, uint32_t hotel, char* out, size_t size)
+{
+    uint64_t generation;
+    int      rv = userCacheRender(&user_cache_g, user->username, hotel, out, size, &generation);
+
+    if (rv >= 0){
+        return rv;  // cache hit
+    }
+
+
+    // cache miss: load from the database and hand the rows over to the cache.
+    // rows live in the request arena, rewound when the next command is read.
+    UserBookings* rows = (UserBookings*) arenaAlloc(&arenas_g[thread_index], sizeof(UserBookings));
+    if (rows == NULL){
+        return -1;
+    }
+    rows->count = 0;
+
+    SPAN_BEGIN(storage_span);
+    rv = storage_g.scan(thread_index, user->username, viewVisit, rows);
+    SPAN_END(storage_span, "storage", "scan", 0);
+
+    if (rv != 0){
+        printf("%s\n", "Error querying the database!");
+        return -1;
+    }
+
+    #if SORT_VIEW_BY_DATE
+        // the storage returns them in order of reservation
+        qsort(rows->bookings, rows->count, sizeof(CachedBooking), compareViewBookings);
+    #endif
+
+    userCacheFill(&user_cache_g, user->username, generation, rows->bookings, rows->count);
+
+    return renderCachedBookings(rows->bookings, rows->count, hotel, out, size);
+}
+
+
+
+uint32_t
+commandHotel(Session* s)
+{
+    char     id[12];
+    uint32_t hotel;
+
+    memset(id, '\0', sizeof(id));
+    sessionRead(s, id, sizeof(id));
+
+    // "0": the session's. Another hotel may live on another shard: switching takes a new `htl`
+    if (strcmp(id, "0") == 0){
+        return s->hotel;
+    }
+    hotel = parseHotelId(id);
+    return hotel == s->hotel ? s->hotel : 0;
+}
+
+
+
+uint32_t
+parseHotelId(const char* id)
+{
+    size_t             digits = strspn(id, "0123456789");
+    unsigned long long hotel;
+
+    if (digits == 0 || digits > 10 || id[digits] != '\0'){
+        return 0;
+    }
+    hotel = strtoull(id, NULL, 10);
+    return hotel <= UINT32_MAX ? (uint32_t) hotel : 0;
+}
+
+
+
+void 
+hotelsMetrics(FILE* out)
+{
+    hotelRegistryStats(&hotels_g, out);
+}
+
+
+
+void
+traceOpen(Session* s)
+{
+    trafficTraceRecord(&trace_g, s->id, TRACE_OPEN, NULL, 0);
+}
+
+
+/**
+ * Frames are recorded as they arrive, not as the FSM consumes them: the
+ * trace keeps the timing of the clients, whatever the server did with it.
+ */
+void
+traceInbound(Session* s)
+{
+    if (trace_g.file == NULL){
+        return;
+    }
+
+    while (s->in_used - s->traced >= sizeof(int32_t)){
+        int32_t dim;
+
+        memcpy(&dim, s->in + s->traced, sizeof(dim));
+        dim = ntohl(dim);
+
+        if (dim < 0 || s->in_used - s->traced - sizeof(dim) < (uint32_t) dim){
+            break;  // incomplete, or too long for the buffer (sessionFrames() turns it down)
+        }
+        trafficTraceRecord(&trace_g, s->id, TRACE_FRAME, s->in + s->traced + sizeof(dim), (uint32_t) dim);
+        s->traced += sizeof(dim) + dim;
+    }
+}
+
+
+void
+traceClose(Session* s)
+{
+    trafficTraceRecord(&trace_g, s->id, TRACE_CLOSE, NULL, 0);
+}
+
+
+
+void
+traceMetrics(FILE* out)
+{
+    trafficTraceStats(&trace_g, out);
+}
+
+
+
+void 
+userCacheMetrics(FILE* out)
+{
+    userCacheStats(&user_cache_g, out);
+}
+
+
+
+int 
+setupUsers()
+{
+    struct stat st;
+    char        migrated[40];
+    int         added;
+
+    if (userTableOpen(&users_g, USER_TABLE, USER_TABLE_CAPACITY) != 0){
+        return -1;
+    }
+
+    // one-shot conversion of the legacy text file, renamed once imported
+    if (stat(USER_FILE, &st) == 0){
+        added = userTableImport(&users_g, USER_FILE);
+        if (added < 0){
             return -1;
         }
 
-        else {
+        snprintf(migrated, sizeof(migrated), "%s.migrated", USER_FILE);
+        if (rename(USER_FILE, migrated) != 0){
+            return -1;
+        }
+        #if DEBUG
+            printf(ANSI_COLOR_GREEN "[+] %d users imported from %s (now %s).\n" ANSI_COLOR_RESET, added, USER_FILE, migrated);
+        #endif
+    }
+
+    return 0;
+}
 
-            // prepare payload for wiping that entry from the table
 
-            memset(sql_command, '\0', sizeof(sql_command));
-            strcat(sql_command, "DELETE FROM Bookings WHERE user = '");
-            strcat(sql_command, user->username);
-            strcat(sql_command, "' and date = '");
-            strcat(sql_command, booking->date);
-            strcat(sql_command, "' and room = '");
-            strcat(sql_command, booking->room);
-            strcat(sql_command, "' and code = '");
-            strcat(sql_command, booking->code);
-            strcat(sql_command, "'");
 
-            // freeing memory before returning
-            free(query);
-            return commitToDatabase(thread_index, sql_command); // 0 is ok.
+void 
+usersMetrics(FILE* out)
+{
+    userTableStats(&users_g, out);
+}
 
+
+
+int 
+setupReplicaData()
+{
+    const char* files[] = { USER_TABLE, USER_FILE, DATABASE, JOURNAL, SNAPSHOT };
+    const int   count   = sizeof(files) / sizeof(files[0]);
+    struct stat st;
+    char        path[40];
+    FILE*       mark;
+
+    snprintf(path, sizeof(path), "%s/%s", DATA_FOLDER, REPLICA_MARK_NAME);
+
+    // a primary's bookings are never thrown away
+    if (stat(path, &st) != 0){
+        for (int i = 0; i < count; i++){
+            if (stat(files[i], &st) == 0){
+                printf("\x1b[31m%s belongs to a primary: a follower needs a data folder of its own.\x1b[0m\n", files[i]);
+                return -1;
+            }
         }
-    
+    }
+
+    for (int i = 0; i < count; i++){
+        remove(files[i]);
+    }
+    snprintf(path, sizeof(path), "%s-wal", DATABASE);
+    remove(path);
+    snprintf(path, sizeof(path), "%s-shm", DATABASE);
+    remove(path);
+
+    snprintf(path, sizeof(path), "%s/%s", DATA_FOLDER, REPLICA_MARK_NAME);
+    mark = fopen(path, "w");
+    if (mark == NULL){
+        perror(path);
+        return -1;
+    }
+    fprintf(mark, "%s:%d\n", replica_g.primary.ip, replica_g.primary.port);
+    fclose(mark);
+
+    return 0;
+}
+
+
+
+int 
+replicaUser(const char* username, const char* password)
+{
+    // 1: shipped again after a reconnection, already there
+    return userTableAdd(&users_g, username, password) < 0 ? -1 : 0;
+}
+
+
+
+uint32_t 
+replicaUsers()
+{
+    return __atomic_load_n(&users_g.header->count, __ATOMIC_ACQUIRE);
+}
+
+
+
+int 
+replicaInsert(const StoredBooking* b, void* NotUsed)
+{
+    StoredBooking stored = *b;
+    CodeEntry     key, found;
+    CachedBooking cached = { .day = b->day, .room = b->room, .hotel = b->hotel };
+    HotelTenant*  tenant = hotelRegistryAdd(&hotels_g, b->hotel);
+
+    if (tenant == NULL){
+        return -1;
+    }
+
+    memset(&key, '\0', sizeof(key));
+    strncpy(key.code,     b->code,     sizeof(key.code) - 1);
+    strncpy(key.username, b->username, sizeof(key.username) - 1);
+    key.day  = b->day;
+    key.room = b->room;
+
+    // shipped twice (in a snapshot and in the log after it): already there
+    if (codeIndexLookup(&tenant->codes, &key, &found) == 0){
+        return 0;
+    }
+
+    // stored with an id of this storage
+    if (storage_g.insert(REPLICATION_THREAD_INDEX, &stored) != 0){
+        return -1;
+    }
+    __atomic_add_fetch(&bookings_changed_g, 1, __ATOMIC_RELAXED);
+    strcpy(cached.code, stored.code);
+
+    /* critical section */
+    MUTEX_LOCK(&tenant->lock);
+
+        tenantIndex(tenant, &stored);
+        userCacheAdd(&user_cache_g, stored.username, &cached);
+
+    MUTEX_UNLOCK(&tenant->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+
+int 
+replicaRemove(const StoredBooking* b, void* NotUsed)
+{
+    CodeEntry    key, found;
+    HotelTenant* tenant = hotelRegistryFind(&hotels_g, b->hotel);
+
+    memset(&key, '\0', sizeof(key));
+    strncpy(key.code,     b->code,     sizeof(key.code) - 1);
+    strncpy(key.username, b->username, sizeof(key.username) - 1);
+    key.day  = b->day;
+    key.room = b->room;
+
+    // never got here (removed before a snapshot), or already removed
+    if (tenant == NULL || codeIndexLookup(&tenant->codes, &key, &found) != 0){
+        return 0;
+    }
+
+    if (storage_g.remove(REPLICATION_THREAD_INDEX, found.id) < 0){
+        return -1;
+    }
+    __atomic_add_fetch(&bookings_changed_g, 1, __ATOMIC_RELAXED);
+
+    /* critical section */
+    MUTEX_LOCK(&tenant->lock);
+
+        tenantUnindex(tenant, b);
+        userCacheRemove(&user_cache_g, b->username, b->hotel, b->day, b->room);
+
+    MUTEX_UNLOCK(&tenant->lock);
+    /* end critical section */
+
+    return 0;
+}
+
+
+
+int 
+replicaReset()
+{
+    ReplicationSnapshot all;
+    int                 rv;
+
+    // collected first: nothing is removed while the storage is being scanned
+    memset(&all, 0, sizeof(all));
+    rv = storage_g.scan(REPLICATION_THREAD_INDEX, NULL, replicationCollect, &all) != 0 || all.failed ? -1 : 0;
+
+    for (uint64_t i = 0; i < all.count && rv == 0; i++){
+        rv = replicaRemove(&all.bookings[i], NULL);
+    }
+    free(all.bookings);
+
+    return rv;
+}
+
+
+
+void 
+replicationMetrics(FILE* out)
+{
+    if (follower_g){
+        replicaStats(&replica_g, out);
     }
     else {
-        printf("%s\n", "Error querying the database!");
-        free(query);
+        replicationLogStats(&replication_g, out);
+    }
+}
+
+
+
+void 
+sessionsMetrics(FILE* out)
+{
+    sessionTokensStats(&tokens_g, out);
+}
+
+
+
+void 
+loopsMetrics(FILE* out)
+{
+    char prefix[16];
+
+    struct rusage usage;
+
+    fprintf(out, "session_bytes %zu\n", sizeof(Session));
+
+    // the whole process: what the backend saves in switches shows up here
+    if (getrusage(RUSAGE_SELF, &usage) == 0){
+        fprintf(out, "voluntary_context_switches %ld\n",   usage.ru_nvcsw);
+        fprintf(out, "involuntary_context_switches %ld\n", usage.ru_nivcsw);
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++){
+        snprintf(prefix, sizeof(prefix), "thread%d", i);
+        eventLoopStats(&loops_g[i], out, prefix);
+    }
+}
+
+
+
+void 
+admissionMetrics(FILE* out)
+{
+    char prefix[16];
+
+    for (int i = 0; i < NUM_THREADS; i++){
+        snprintf(prefix, sizeof(prefix), "thread%d", i);
+        admissionStats(&loops_g[i].admission, out, prefix);
+    }
+}
+
+
+
+void 
+rateLimitMetrics(FILE* out)
+{
+    rateLimiterStats(&limits_g, out);
+}
+
+
+
+void 
+storageMetrics(FILE* out)
+{
+    storage_g.stats(out);
+}
+
+
+
+void 
+arenaMetrics(FILE* out)
+{
+    char prefix[16];
+
+    for (int i = 0; i < NUM_THREADS; i++){
+        snprintf(prefix, sizeof(prefix), "thread%d", i);
+        arenaStats(&arenas_g[i], out, prefix);
+    }
+}
+
+
+int 
+releaseReservation(int thread_index, User* user, Booking* booking)
+{
+    int rv;
+    CodeEntry key, found;
+    HotelTenant* tenant = hotelRegistryFind(&hotels_g, booking->hotel);
+
+    /* look the code up in the code index of the hotel
+     * if FOUND: remove the booking by id, the storage tells whether it was still there
+     * if NOT: return failure value to main function, no database access
+     */
+
+    memset(&key, '\0', sizeof(key));
+    strncpy(key.code,     booking->code,  sizeof(key.code) - 1);
+    strncpy(key.username, user->username, sizeof(key.username) - 1);
+    key.day  = booking->day;
+    key.room = atoi(booking->room);
+
+    // each hotel has its codes
+    if (tenant == NULL || codeIndexLookup(&tenant->codes, &key, &found) != 0 || found.id <= 0){
         return -1;
     }
 
+
+    SPAN_BEGIN(storage_span);
+    rv = storage_g.remove(thread_index, found.id);
+    SPAN_END(storage_span, "storage", "remove", 0);
+    if (rv != 0){
+        return -1;  // database error, or released concurrently by another session of the same user
+    }
+    __atomic_add_fetch(&bookings_changed_g, 1, __ATOMIC_RELAXED);
+
+    // shipped before the room is free again: a follower never sees it booked twice
+    StoredBooking removed;
+
+    memset(&removed, '\0', sizeof(removed));
+    strncpy(removed.username, key.username, sizeof(removed.username) - 1);
+    strncpy(removed.code,     key.code,     sizeof(removed.code) - 1);
+    removed.id    = found.id;
+    removed.hotel = found.hotel;
+    removed.day   = key.day;
+    removed.room  = key.room;
+    replicationPublish(&replication_g, REPLICATION_REMOVE, &removed);
+
+
+    /* critical section */
+    // occupancy, code, quota and cached list change together: no thread sees
+    // the room free while the booking is still listed, or the other way round.
+    MUTEX_LOCK(&tenant->lock);
+
+        releaseRoom(&tenant->hotel, key.day, key.room);
+        codeIndexRemove(&tenant->codes, key.code, key.username, key.day, key.room);
+        userQuotaRelease(&quota_g, key.username);
+        userCacheRemove(&user_cache_g, key.username, found.hotel, key.day, key.room);
+
+    MUTEX_UNLOCK(&tenant->lock);
+    /* end critical section */
+
+    __atomic_add_fetch(&tenant->releases, 1, __ATOMIC_RELAXED);
+
+    return 0;
 }
 
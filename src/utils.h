@@ -18,7 +18,7 @@
 #include <stdarg.h>
 #include <ctype.h>          // for lowercase check
 #include <termios.h>
-#include <regex.h>
+#include <stdint.h>
 
 
 // config definition and declarations
@@ -28,6 +28,7 @@
 
 #include "Address.h"
 
+
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
 
 /********************************/
@@ -73,6 +74,12 @@ typedef enum {
     CHECK_USERNAME,
     CHECK_PASSWORD,
     GRANT_ACCESS,
+
+    // RESUME
+    RESUME,                 // checks a session token, skipping the login
+
+    // HOTEL
+    PICK_HOTEL,             // checks the hotel the session asks for is served here
     
     LOGIN,                  // the user is inside the system and can send commands that requires login
 
@@ -132,6 +139,14 @@ typedef enum {
     READ_LOGIN_USERNAME_RESP,  
     SEND_LOGIN_PASSWORD,       
     READ_LOGIN_PASSWORD_RESP,
+
+    // RESUME
+    SEND_RESUME,
+    READ_RESUME_RESP,
+
+    // HOTEL
+    SEND_HOTEL,
+    READ_HOTEL_RESP,
     
 
     CL_LOGIN,
@@ -213,6 +228,12 @@ int         setupClient(Address* address);
  */
 void        printServerFSMState(server_fsm_state_t* s, int* tid);
 
+/** @brief name of a server FSM state
+ *  @param s state
+ *  @return its name, as spelled in the code
+ */
+const char* serverFSMStateName(server_fsm_state_t s);
+
 /** @brief 
  *  @param
  *  @return 
@@ -239,12 +260,11 @@ void        upper(char* str);
  */
 void        readPassword(char* password);
 
-/** @brief checks whether string matches the pattern
- *  @param string 
- *  @param regex pattern
- *  @return 1 if matches; 0 if not.
+/** @brief string hash (FNV-1a), used by the in-memory indexes
+ *  @param s string to be hashed
+ *  @return 32 bit hash
  */
-int         regexMatch(const char* string, const char* pattern);
+uint32_t    hashString(const char* s);
 
 
 /* . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . */
@@ -378,6 +398,12 @@ setupServer(Address* address)
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY);    // connect to any
     server_addr.sin_port = htons(address->port);        // port number
 
+    #if IO_URING && defined(SO_REUSEPORT)
+        // the io_uring event loops listen on a socket each, bound to the same port: the kernel spreads the connections
+        int reuse = 1;
+        setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    #endif
+
     // Binding newly created socket to given IP and verification
 
     ret = (bind(sockfd, (struct sockaddr*) &server_addr, sizeof(server_addr)));
@@ -458,9 +484,17 @@ setupClient(Address* address)
 void 
 printServerFSMState(server_fsm_state_t* s, int* tid)
 {
-    char* rv;
+    printf("\x1b[90mTHREAD #%d: state: %s\x1b[0m\n", *tid, serverFSMStateName(*s));
+    return;
+}
 
-    switch (*s)
+
+const char*
+serverFSMStateName(server_fsm_state_t s)
+{
+    const char* rv = "?";
+
+    switch (s)
     {
         case INIT:                          rv = "INIT";                        break;
 
@@ -484,6 +518,10 @@ printServerFSMState(server_fsm_state_t* s, int* tid)
                 
         case GRANT_ACCESS:                  rv = "GRANT_ACCESS";                break;
 
+        case RESUME:                        rv = "RESUME";                      break;
+
+        case PICK_HOTEL:                    rv = "PICK_HOTEL";                  break;
+
         case CHECK_DATE_VALIDITY:           rv = "CHECK_DATE_VALIDITY";         break;
         case CHECK_AVAILABILITY:            rv = "CHECK_AVAILABILITY";          break;
         case RESERVE_CONFIRMATION:          rv = "RESERVE_CONFIRMATION";        break;
@@ -493,8 +531,7 @@ printServerFSMState(server_fsm_state_t* s, int* tid)
         case RELEASE:                       rv = "RELEASE";                     break;
     }
 
-    printf("\x1b[90mTHREAD #%d: state: %s\x1b[0m\n", *tid, rv);
-    return;
+    return rv;
 }
 
 
@@ -537,6 +574,12 @@ printClientFSMState(client_fsm_state_t* s)
         case SEND_LOGIN_PASSWORD:           rv = "SEND_LOGIN_PASSWORD";         break;       
         case READ_LOGIN_PASSWORD_RESP:      rv = "READ_LOGIN_PASSWORD_RESP";    break;
 
+        case SEND_RESUME:                   rv = "SEND_RESUME";                 break;
+        case READ_RESUME_RESP:              rv = "READ_RESUME_RESP";            break;
+
+        case SEND_HOTEL:                    rv = "SEND_HOTEL";                  break;
+        case READ_HOTEL_RESP:               rv = "READ_HOTEL_RESP";             break;
+
         case INVALID_DATE:                  rv = "INVALID_DATE";                break;
         case SEND_RESERVE:                  rv = "SEND_RESERVE";                break;
         case READ_RESERVE_RESP:             rv = "READ_RESERVE_RESP";           break;
@@ -586,23 +629,19 @@ readPassword(char* password)
 }
 
 
-int 
-regexMatch(const char* string, const char* pattern)
+uint32_t
+hashString(const char* s)
 {
-    regex_t re;
-    if (regcomp(&re, pattern, REG_EXTENDED|REG_NOSUB) != 0) {
-        return 0;
-    }
-    int status = regexec(&re, string, 0, NULL, 0);
-    regfree(&re);
-    if (status != 0) {
-        return 0;
+    uint32_t h = 2166136261u;
+
+    while (*s){
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
     }
-    return 1;
+    return h;
 }
 
 
 
 
 #endif
-
@@ -72,6 +72,22 @@ xp_sem_wait(xp_sem_t* s)
 
 
 
+/**
+ *    sem_trywait
+ *    return 0 if taken, -1 if it would have to wait
+ */
+static inline int
+xp_sem_trywait(xp_sem_t* s)
+{
+    #ifdef __APPLE__
+        return dispatch_semaphore_wait(s->sem, DISPATCH_TIME_NOW) == 0 ? 0 : -1;
+    #else
+        return sem_trywait(&s->sem) == 0 ? 0 : -1;
+    #endif
+}
+
+
+
 /**
  *    sem_post
  */
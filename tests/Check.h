@@ -0,0 +1,58 @@
+/**
+ * @name            hotel-booking
+ * @file            Check.h
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 15:02:11 CET 2026
+ * @brief           the few assertions the regression tests are written with
+ *
+ *
+ * Every test is a program of its own under tests/, run by ctest: it
+ * includes the modules it tests (they're header-only) and exits with
+ * checkDone(), 0 if every CHECK held. A failed CHECK prints where it is
+ * and the test goes on, so one run tells every check that failed.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+
+static int  checks_g;
+static int  failures_g;
+
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        checks_g++;                                                             \
+        if (!(condition)){                                                      \
+            failures_g++;                                                       \
+            printf("\x1b[31mFAILED\x1b[0m %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        long long check_a_ = (long long) (a), check_b_ = (long long) (b);      \
+        checks_g++;                                                             \
+        if (check_a_ != check_b_){                                              \
+            failures_g++;                                                       \
+            printf("\x1b[31mFAILED\x1b[0m %s:%d: %s == %s (%lld != %lld)\n",    \
+                   __FILE__, __LINE__, #a, #b, check_a_, check_b_);             \
+        }                                                                       \
+    } while (0)
+
+
+/**
+ * return the exit status of the test: 0 if every check held, 1 otherwise
+ */
+static int
+checkDone(const char* test)
+{
+    printf("%s: %d checks, %d failed\n", test, checks_g, failures_g);
+    return failures_g == 0 ? 0 : 1;
+}
+
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * @name            hotel-booking
+ * @file            test_calendar.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 15:10:48 CET 2026
+ * @brief           day-indexed calendar and the occupancy kept on it (Calendar.h, Hotel.h)
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Check.h"
+#include "Hotel.h"
+
+
+#define FIRST_YEAR      2027
+
+
+static void
+testDays(void)
+{
+    int y, m, d;
+
+    CHECK_EQ(daysFromCivil(1970, 1, 1), 0);
+    CHECK_EQ(daysFromCivil(2000, 3, 1), 11017);
+    CHECK_EQ(daysFromCivil(2028, 1, 1) - daysFromCivil(2027, 1, 1), 365);
+    CHECK_EQ(daysFromCivil(2029, 1, 1) - daysFromCivil(2028, 1, 1), 366);
+
+    CHECK(isLeapYear(2028) && isLeapYear(2000) && !isLeapYear(2100) && !isLeapYear(2027));
+    CHECK_EQ(daysInMonth(2028, 2), 29);
+    CHECK_EQ(daysInMonth(2027, 2), 28);
+
+    // every day back and forth
+    for (day_t day = daysFromCivil(1999, 12, 1); day < daysFromCivil(2101, 1, 1); day++){
+        civilFromDays(day, &y, &m, &d);
+        if (daysFromCivil(y, m, d) != day || !dateIsValid(y, m, d)){
+            CHECK_EQ(daysFromCivil(y, m, d), day);
+            break;
+        }
+    }
+}
+
+
+static void
+testParse(void)
+{
+    int  y, m, d;
+    char date[DATE_STRING_LENGTH];
+
+    CHECK_EQ(parseDate("10/11/2027", 2000, &y, &m, &d), 0);
+    CHECK(y == 2027 && m == 11 && d == 10);
+
+    // the year left out is the default one
+    CHECK_EQ(parseDate("10/11", 2031, &y, &m, &d), 0);
+    CHECK_EQ(y, 2031);
+
+    CHECK_EQ(parseDate("29/02/2028", 2000, &y, &m, &d), 0);
+    CHECK_EQ(parseDate("29/02/2027", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("31/04/2027", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("10/11/2027x", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("10", 2000, &y, &m, &d), -1);
+
+    // exactly dd/mm or dd/mm/yyyy, the whole string
+    CHECK_EQ(parseDate("12/05xyz", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("12/05/", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("12/05/27", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("12/05/20271", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("1/5", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("1/05/2027", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("+1/05/2027", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate(" 1/05/2027", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("12-05-2027", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("", 2000, &y, &m, &d), -1);
+    CHECK_EQ(parseDate("01/05", 2000, &y, &m, &d), 0);
+    CHECK(y == 2000 && m == 5 && d == 1);
+
+    formatDate(daysFromCivil(2027, 3, 5), date);
+    CHECK(strcmp(date, "05/03/2027") == 0);
+}
+
+
+static void
+testSlots(void)
+{
+    Calendar c;
+    char*    used = (char*) calloc(CALENDAR_SLOTS, 1);
+    day_t    first = daysFromCivil(FIRST_YEAR, 1, 1);
+    day_t    end   = daysFromCivil(FIRST_YEAR + CALENDAR_HORIZON_YEARS, 1, 1);
+
+    initializeCalendar(&c, FIRST_YEAR);
+
+    CHECK(!calendarContains(&c, first - 1));
+    CHECK(calendarContains(&c, first));
+    CHECK(calendarContains(&c, end - 1));
+    CHECK(!calendarContains(&c, end));
+    CHECK_EQ(calendarSlot(&c, first - 1), -1);
+    CHECK_EQ(calendarSlot(&c, end), -1);
+
+    // every day of the horizon has a slot of its own
+    for (day_t day = first; day < end; day++){
+        int slot = calendarSlot(&c, day);
+
+        if (slot < 0 || slot >= CALENDAR_SLOTS || used[slot]){
+            CHECK(slot >= 0 && slot < CALENDAR_SLOTS && !used[slot]);
+            break;
+        }
+        used[slot] = 1;
+    }
+    free(used);
+}
+
+
+static void
+testOccupancy(void)
+{
+    Hotel* h   = (Hotel*) malloc(sizeof(Hotel));
+    day_t  day = daysFromCivil(FIRST_YEAR, 6, 15);
+
+    initializeHotel(h, FIRST_YEAR);
+    addRoom(&h->inventory, 1, ROOM_SINGLE);
+    addRoom(&h->inventory, 2, ROOM_DOUBLE);
+    addRoom(&h->inventory, 3, ROOM_SINGLE);
+
+    // lowest single first, then the other single, then the double: bigger rooms are kept for who asks
+    CHECK_EQ(bookRoom(h, day, ROOM_ANY), 1);
+    CHECK_EQ(bookRoom(h, day, ROOM_ANY), 3);
+    CHECK_EQ(bookRoom(h, day, ROOM_SINGLE), -1);
+    CHECK_EQ(bookRoom(h, day, ROOM_ANY), 2);
+    CHECK_EQ(bookRoom(h, day, ROOM_ANY), -1);
+    CHECK_EQ(roomsBooked(h, day), 3);
+
+    // the next day is another slot
+    CHECK_EQ(bookRoom(h, day + 1, ROOM_DOUBLE), 2);
+    CHECK_EQ(roomsBooked(h, day + 1), 1);
+
+    CHECK_EQ(releaseRoom(h, day, 3), 0);
+    CHECK_EQ(releaseRoom(h, day, 3), -1);
+    CHECK_EQ(roomsBooked(h, day), 2);
+    CHECK_EQ(bookRoom(h, day, ROOM_SINGLE), 3);
+
+    CHECK_EQ(markRoomBooked(h, day + 1, 2), -1);
+    CHECK_EQ(bookRoom(h, daysFromCivil(FIRST_YEAR - 1, 12, 31), ROOM_ANY), -1);
+
+    free(h);
+}
+
+
+static void
+testRoll(void)
+{
+    Hotel* h   = (Hotel*) malloc(sizeof(Hotel));
+    char   folder[] = "/tmp/test_calendar_XXXXXX";
+    char   path[64];
+    day_t  old = daysFromCivil(FIRST_YEAR, 3, 1);
+    day_t  kept = daysFromCivil(FIRST_YEAR + 1, 3, 1);
+    day_t  next = daysFromCivil(FIRST_YEAR + CALENDAR_HORIZON_YEARS, 3, 1);
+
+    CHECK(mkdtemp(folder) != NULL);
+
+    initializeHotel(h, FIRST_YEAR);
+    addRoom(&h->inventory, 1, ROOM_SINGLE);
+
+    CHECK_EQ(bookRoom(h, old, ROOM_ANY), 1);
+    CHECK_EQ(bookRoom(h, kept, ROOM_ANY), 1);
+    CHECK_EQ(bookRoom(h, next, ROOM_ANY), -1);     // past the horizon
+
+    // the second year can't be archived: the horizon is left as it was, the first year too
+    snprintf(path, sizeof(path), "%s/%d.bin", folder, FIRST_YEAR + 1);
+    CHECK_EQ(mkdir(path, 0755), 0);
+    CHECK_EQ(rollHotelHorizon(h, FIRST_YEAR + 2, folder), -1);
+    CHECK_EQ(h->calendar.first_year, FIRST_YEAR);
+    CHECK_EQ(roomsBooked(h, old), 1);
+    CHECK_EQ(roomsBooked(h, kept), 1);
+    rmdir(path);
+
+    // the first year leaves: archived, its slot recycled for the year coming in
+    CHECK_EQ(rollHotelHorizon(h, FIRST_YEAR + 1, folder), 1);
+    CHECK_EQ(roomsBooked(h, old), -1);
+    CHECK_EQ(roomsBooked(h, kept), 1);
+    CHECK_EQ(roomsBooked(h, next), 0);
+    CHECK_EQ(bookRoom(h, next, ROOM_ANY), 1);
+
+    snprintf(path, sizeof(path), "%s/%d.bin", folder, FIRST_YEAR);
+    CHECK(access(path, R_OK) == 0);
+    unlink(path);
+    rmdir(folder);
+
+    // rolling backwards changes nothing
+    CHECK_EQ(rollHotelHorizon(h, FIRST_YEAR, folder), 0);
+    CHECK_EQ(roomsBooked(h, kept), 1);
+
+    free(h);
+}
+
+
+int
+main(void)
+{
+    testDays();
+    testParse();
+    testSlots();
+    testOccupancy();
+    testRoll();
+
+    return checkDone("calendar");
+}
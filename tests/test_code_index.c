@@ -0,0 +1,227 @@
+/**
+ * @name            hotel-booking
+ * @file            test_code_index.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 16:03:55 CET 2026
+ * @brief           index of the live reservation codes: probing, backward shift deletion, growth (CodeIndex.h)
+ */
+
+#include "Check.h"
+#include "CodeIndex.h"
+
+
+static uint32_t next_code = 0;      // codes are searched in order, so no two tests pick the same
+
+
+/**
+ * Next code whose home slot in a table of `capacity` slots is `home`.
+ */
+static void
+codeWithHome(char* code, uint32_t home, uint32_t capacity)
+{
+    const uint32_t base = sizeof(CODE_CHARSET) - 1;
+
+    do {
+        uint32_t n = next_code++;
+
+        for (int i = 0; i < RESERVATION_CODE_LENGTH - 1; i++){
+            code[i] = CODE_CHARSET[n % base];
+            n /= base;
+        }
+        code[RESERVATION_CODE_LENGTH - 1] = '\0';
+    } while ((hashString(code) & (capacity - 1)) != home);
+}
+
+
+static CodeEntry
+entry(const char* code, const char* username, int room)
+{
+    CodeEntry e;
+
+    memset(&e, 0, sizeof(e));
+    strncpy(e.code, code, sizeof(e.code) - 1);
+    strncpy(e.username, username, sizeof(e.username) - 1);
+    e.day   = daysFromCivil(2027, 6, 1);
+    e.room  = room;
+    e.hotel = 1;
+    return e;
+}
+
+
+static int
+live(CodeIndex* idx, const CodeEntry* e)
+{
+    CodeEntry found;
+
+    return codeIndexLookup(idx, e, &found) == 0 && found.room == e->room;
+}
+
+
+/**
+ * Slot an entry sits in, or -1.
+ */
+static int64_t
+slotOf(const CodeIndex* idx, const CodeEntry* e)
+{
+    return codeIndexSlot(idx, e->code, e->username, e->day, e->room);
+}
+
+
+static void
+testBackwardShift(void)
+{
+    CodeIndex idx;
+    char      code[RESERVATION_CODE_LENGTH];
+    CodeEntry e[5];
+    uint32_t  h = 100;
+
+    initializeCodeIndex(&idx);
+
+    // a cluster h..h+4: three codes at home h, one at home h+1, one at its own home h+4
+    codeWithHome(code, h, idx.capacity);     e[0] = entry(code, "alice", 1);
+    codeWithHome(code, h, idx.capacity);     e[1] = entry(code, "alice", 2);
+    codeWithHome(code, h, idx.capacity);     e[2] = entry(code, "alice", 3);
+    codeWithHome(code, h + 1, idx.capacity); e[3] = entry(code, "alice", 4);
+    codeWithHome(code, h + 4, idx.capacity); e[4] = entry(code, "alice", 5);
+
+    for (int i = 0; i < 5; i++){
+        CHECK_EQ(codeIndexInsert(&idx, &e[i]), 0);
+        CHECK_EQ(slotOf(&idx, &e[i]), h + i);
+    }
+
+    // removing the head of the cluster shifts back everything that isn't at its home
+    CHECK_EQ(codeIndexRemove(&idx, e[0].code, "alice", e[0].day, 1), 0);
+    CHECK(!live(&idx, &e[0]));
+    CHECK_EQ(slotOf(&idx, &e[1]), h);
+    CHECK_EQ(slotOf(&idx, &e[2]), h + 1);
+    CHECK_EQ(slotOf(&idx, &e[3]), h + 2);
+    CHECK_EQ(slotOf(&idx, &e[4]), h + 4);
+    CHECK(idx.slots[h + 3].code[0] == '\0');
+    CHECK_EQ(idx.count, 4);
+
+    // the hole left behind doesn't cut anything off
+    for (int i = 1; i < 5; i++){
+        CHECK(live(&idx, &e[i]));
+    }
+
+    // an entry can't move before its home: removing h leaves e[3] at h+2
+    CHECK_EQ(codeIndexRemove(&idx, e[1].code, "alice", e[1].day, 2), 0);
+    CHECK_EQ(slotOf(&idx, &e[2]), h);
+    CHECK_EQ(slotOf(&idx, &e[3]), h + 1);
+    CHECK(live(&idx, &e[2]) && live(&idx, &e[3]) && live(&idx, &e[4]));
+
+    // a second removal of the same booking finds nothing
+    CHECK_EQ(codeIndexRemove(&idx, e[1].code, "alice", e[1].day, 2), -1);
+    CHECK_EQ(idx.count, 3);
+}
+
+
+static void
+testWrapAround(void)
+{
+    CodeIndex idx;
+    char      code[RESERVATION_CODE_LENGTH];
+    CodeEntry e[3];
+    uint32_t  last;
+
+    initializeCodeIndex(&idx);
+    last = idx.capacity - 1;
+
+    // a cluster running off the end of the table into slot 0
+    codeWithHome(code, last, idx.capacity); e[0] = entry(code, "bob", 1);
+    codeWithHome(code, last, idx.capacity); e[1] = entry(code, "bob", 2);
+    codeWithHome(code, 0, idx.capacity);    e[2] = entry(code, "bob", 3);
+
+    for (int i = 0; i < 3; i++){
+        CHECK_EQ(codeIndexInsert(&idx, &e[i]), 0);
+    }
+    CHECK_EQ(slotOf(&idx, &e[1]), 0);
+    CHECK_EQ(slotOf(&idx, &e[2]), 1);
+
+    CHECK_EQ(codeIndexRemove(&idx, e[0].code, "bob", e[0].day, 1), 0);
+    CHECK_EQ(slotOf(&idx, &e[1]), last);
+    CHECK_EQ(slotOf(&idx, &e[2]), 0);
+    CHECK(idx.slots[1].code[0] == '\0');
+    CHECK(live(&idx, &e[1]) && live(&idx, &e[2]));
+}
+
+
+static void
+testSameCode(void)
+{
+    CodeIndex idx;
+    CodeEntry found;
+    CodeEntry mine, theirs;
+
+    initializeCodeIndex(&idx);
+
+    // codes from before the index may be shared: the owner tells them apart
+    mine   = entry("ABCDE", "carol", 7);
+    theirs = entry("ABCDE", "dave", 7);
+    CHECK_EQ(codeIndexInsert(&idx, &mine), 0);
+    CHECK_EQ(codeIndexInsert(&idx, &theirs), 0);
+
+    CHECK_EQ(codeIndexSetId(&idx, &theirs, 42), 0);
+    CHECK_EQ(codeIndexLookup(&idx, &theirs, &found), 0);
+    CHECK_EQ(found.id, 42);
+    CHECK_EQ(codeIndexLookup(&idx, &mine, &found), 0);
+    CHECK_EQ(found.id, 0);
+
+    CHECK_EQ(codeIndexRemove(&idx, "ABCDE", "carol", mine.day, 7), 0);
+    CHECK(!live(&idx, &mine));
+    CHECK(live(&idx, &theirs));
+    CHECK_EQ(codeIndexRemove(&idx, "ABCDE", "carol", mine.day, 7), -1);
+    CHECK_EQ(codeIndexRemove(&idx, "ABCDE", "dave", theirs.day, 7), 0);
+    CHECK_EQ(idx.count, 0);
+}
+
+
+static void
+testGrowth(void)
+{
+    enum { N = 3 * CODE_INDEX_INITIAL_CAPACITY };
+    static CodeEntry e[N];
+    CodeIndex        idx;
+    int              lost = 0;
+
+    initializeCodeIndex(&idx);
+
+    // generated codes are unique, and stay reachable as the table doubles
+    for (int i = 0; i < N; i++){
+        e[i] = entry("", "erin", i);
+        CHECK_EQ(codeIndexGenerate(&idx, &e[i]), 0);
+    }
+    CHECK(idx.capacity >= 2 * N);
+    CHECK_EQ(idx.count, N);
+
+    // drop every other one, then the rest: each removal keeps the others reachable
+    for (int i = 0; i < N; i += 2){
+        CHECK_EQ(codeIndexRemove(&idx, e[i].code, "erin", e[i].day, i), 0);
+    }
+    for (int i = 0; i < N; i++){
+        lost += live(&idx, &e[i]) != (i % 2 == 1);
+    }
+    CHECK_EQ(lost, 0);
+
+    for (int i = 1; i < N; i += 2){
+        CHECK_EQ(codeIndexRemove(&idx, e[i].code, "erin", e[i].day, i), 0);
+    }
+    CHECK_EQ(idx.count, 0);
+    for (uint32_t i = 0; i < idx.capacity; i++){
+        lost += idx.slots[i].code[0] != '\0';
+    }
+    CHECK_EQ(lost, 0);
+}
+
+
+int
+main(void)
+{
+    testBackwardShift();
+    testWrapAround();
+    testSameCode();
+    testGrowth();
+
+    return checkDone("code_index");
+}
@@ -0,0 +1,298 @@
+/**
+ * @name            hotel-booking
+ * @file            test_journal.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 16:03:55 CET 2026
+ * @brief           booking journal: replay, torn records, tail, compaction (Journal.h)
+ */
+
+#include <stddef.h>
+
+#include "Check.h"
+#include "Journal.h"
+
+
+#define MAX_SEEN    (2 * JOURNAL_COMPACT_MIN)
+
+
+typedef struct seen {
+    int             count;
+    StoredBooking   bookings[MAX_SEEN];
+} Seen;
+
+
+typedef struct changes {
+    Seen            inserted;
+    Seen            removed;
+} Changes;
+
+
+static char dir_g[] = "/tmp/hotel-journal-XXXXXX";
+static char path_g[64];
+
+
+static int
+collect(const StoredBooking* b, void* payload)
+{
+    Seen* seen = (Seen*) payload;
+
+    if (seen->count < MAX_SEEN){
+        seen->bookings[seen->count] = *b;
+    }
+    seen->count++;
+    return 0;
+}
+
+
+static int
+collectInserted(const StoredBooking* b, void* payload)
+{
+    return collect(b, &((Changes*) payload)->inserted);
+}
+
+
+static int
+collectRemoved(const StoredBooking* b, void* payload)
+{
+    return collect(b, &((Changes*) payload)->removed);
+}
+
+
+static StoredBooking
+booking(const char* username, int room, uint32_t hotel, const char* code)
+{
+    StoredBooking b;
+
+    memset(&b, '\0', sizeof(b));
+    strncpy(b.username, username, sizeof(b.username) - 1);
+    strncpy(b.code, code, sizeof(b.code) - 1);
+    b.day   = daysFromCivil(2027, 4, 12);
+    b.room  = room;
+    b.hotel = hotel;
+    return b;
+}
+
+
+/**
+ * Drop the open journal, as a restart would, and open `path_g` again.
+ */
+static int
+reopen(void)
+{
+    munmap(journal_g.map, journal_g.mapped);
+    close(journal_g.fd);
+    free(journal_g.live);
+    return journalOpen(path_g);
+}
+
+
+static int
+scan(const char* username, Seen* seen)
+{
+    seen->count = 0;
+    return journalScan(0, username, collect, seen);
+}
+
+
+static void
+testReplay(void)
+{
+    Seen*         seen = calloc(1, sizeof(Seen));
+    StoredBooking a = booking("alice", 3, 2, "AAAAA");
+    StoredBooking b = booking("alice", 4, 0, "BBBBB");
+    StoredBooking c = booking("bob",   5, 1, "CCCCC");
+
+    CHECK_EQ(journalOpen(path_g), 0);
+    CHECK_EQ(journalInsert(0, &a), 0);
+    CHECK_EQ(journalInsert(0, &b), 0);
+    CHECK_EQ(journalInsert(0, &c), 0);
+    CHECK_EQ(a.id, 1);
+    CHECK_EQ(c.id, 3);
+    CHECK_EQ(journalRemove(0, a.id), 0);
+    CHECK_EQ(journalRemove(0, a.id), 1);
+
+    // the live bookings come back from the file alone
+    CHECK_EQ(reopen(), 0);
+    CHECK_EQ(journal_g.records, 4);
+    CHECK_EQ(journal_g.live_count, 2);
+    CHECK_EQ(scan("alice", seen), 0);
+    CHECK_EQ(seen->count, 1);
+    CHECK_EQ(seen->bookings[0].id, b.id);
+    CHECK_EQ(seen->bookings[0].room, 4);
+    CHECK_EQ(seen->bookings[0].day, b.day);
+    CHECK_EQ(seen->bookings[0].hotel, HOTEL_ID_DEFAULT);    // written without a hotel
+    CHECK(strcmp(seen->bookings[0].code, "BBBBB") == 0);
+    CHECK_EQ(scan(NULL, seen), 0);
+    CHECK_EQ(seen->count, 2);
+    CHECK_EQ(seen->bookings[1].hotel, 1);
+
+    // ids go on from the highest one stored, released ones aren't handed out again
+    StoredBooking d = booking("carol", 6, 1, "DDDDD");
+
+    CHECK_EQ(journalInsert(0, &d), 0);
+    CHECK_EQ(d.id, 4);
+    CHECK_EQ(journalRemove(0, a.id), 1);
+
+    free(seen);
+}
+
+
+static void
+testTorn(void)
+{
+    Seen*         seen = calloc(1, sizeof(Seen));
+    StoredBooking e = booking("dave", 7, 1, "EEEEE");
+    StoredBooking f = booking("dave", 8, 1, "FFFFF");
+    uint64_t      records;
+    char          byte;
+    off_t         offset;
+
+    CHECK_EQ(journalInsert(0, &e), 0);
+    CHECK_EQ(journalInsert(0, &f), 0);
+    records = journal_g.records;
+
+    // a crash halfway through the second to last record: it and the one after it are lost
+    offset = sizeof(JournalHeader) + (records - 2) * sizeof(JournalRecord) + offsetof(JournalRecord, room);
+    CHECK_EQ(pread(journal_g.fd, &byte, 1, offset), 1);
+    byte ^= 0x5a;
+    CHECK_EQ(pwrite(journal_g.fd, &byte, 1, offset), 1);
+
+    CHECK_EQ(reopen(), 0);
+    CHECK_EQ(journal_g.torn, 1);
+    CHECK_EQ(journal_g.records, records - 2);
+    CHECK_EQ(scan("dave", seen), 0);
+    CHECK_EQ(seen->count, 0);
+    CHECK_EQ(scan(NULL, seen), 0);
+    CHECK_EQ(seen->count, 3);
+
+    // the dropped tail is zeroed: new records land where it was and replay cleanly
+    CHECK_EQ(journalInsert(0, &f), 0);
+    CHECK_EQ(f.id, e.id);
+    CHECK_EQ(reopen(), 0);
+    CHECK_EQ(journal_g.torn, 0);
+    CHECK_EQ(journal_g.records, records - 1);
+    CHECK_EQ(scan("dave", seen), 0);
+    CHECK_EQ(seen->count, 1);
+    CHECK_EQ(seen->bookings[0].room, 8);
+
+    free(seen);
+}
+
+
+static void
+testTail(void)
+{
+    Changes*      changes = calloc(1, sizeof(Changes));
+    Seen*         live    = calloc(1, sizeof(Seen));
+    StorageCursor cursor, now;
+    StoredBooking g = booking("erin", 9, 3, "GGGGG");
+
+    CHECK_EQ(journalSnapshot(0, collect, live, &cursor), 0);
+    CHECK_EQ(live->count, (int) journal_g.live_count);
+    CHECK_EQ(cursor.max_id, journal_g.next_id - 1);
+
+    CHECK_EQ(journalInsert(0, &g), 0);
+    CHECK_EQ(journalRemove(0, live->bookings[0].id), 0);
+
+    // the changes after the cursor, and nothing before it
+    CHECK_EQ(journalTail(0, &cursor, collectInserted, collectRemoved, changes), 0);
+    CHECK_EQ(changes->inserted.count, 1);
+    CHECK_EQ(changes->inserted.bookings[0].id, g.id);
+    CHECK_EQ(changes->inserted.bookings[0].hotel, 3);
+    CHECK_EQ(changes->removed.count, 1);
+    CHECK_EQ(changes->removed.bookings[0].id, live->bookings[0].id);
+    CHECK_EQ(changes->removed.bookings[0].room, live->bookings[0].room);    // the tombstone tells what to un-index
+
+    // a cursor past the end is from another file
+    now = cursor;
+    now.position = (int64_t) journal_g.records + 1;
+    CHECK_EQ(journalTail(0, &now, collectInserted, collectRemoved, changes), 1);
+
+    free(changes);
+    free(live);
+}
+
+
+static void
+testCompaction(void)
+{
+    Seen*         seen   = calloc(1, sizeof(Seen));
+    Seen*         before = calloc(1, sizeof(Seen));
+    StorageCursor cursor;
+    StoredBooking b;
+    char          compact_path[sizeof(path_g) + 8];
+    int64_t       first;
+    int64_t       generation = journalHeader(&journal_g)->generation;
+    uint64_t      kept;
+
+    CHECK_EQ(journalSnapshot(0, collect, seen, &cursor), 0);
+    first = journal_g.next_id;
+
+    for (int i = 0; i < JOURNAL_COMPACT_MIN; i++){
+        b = booking("frank", i % (HOTEL_MAX_ROOMS - 1) + 1, 1, "HHHHH");
+        CHECK_EQ(journalInsert(0, &b), 0);
+    }
+
+    // release until the dead records outnumber the live ones
+    for (int64_t id = first; journal_g.compactions == 0 && id < first + JOURNAL_COMPACT_MIN; id++){
+        CHECK_EQ(journalRemove(0, id), 0);
+    }
+    CHECK_EQ(journal_g.compactions, 1);
+    CHECK_EQ(journalHeader(&journal_g)->generation, generation + 1);
+    CHECK_EQ(journal_g.records, journal_g.live_count);
+
+    snprintf(compact_path, sizeof(compact_path), "%s.compact", path_g);
+    CHECK(access(compact_path, F_OK) != 0);
+
+    // only live bookings were copied, each still reachable by id
+    kept = journal_g.live_count;
+    CHECK_EQ(scan(NULL, before), 0);
+    CHECK_EQ(before->count, (int) kept);
+    CHECK_EQ(journalRemove(0, first), 1);
+    CHECK_EQ(journalRemove(0, before->bookings[0].id), 0);
+    kept--;
+
+    // a cursor into the old file is stale
+    CHECK_EQ(journalTail(0, &cursor, collect, collect, seen), 1);
+
+    // the compacted file is the journal after a restart, ids go on
+    CHECK_EQ(reopen(), 0);
+    CHECK_EQ(journal_g.live_count, kept);
+    CHECK_EQ(journalHeader(&journal_g)->generation, generation + 1);
+    CHECK_EQ(scan(NULL, seen), 0);
+    CHECK_EQ(seen->count, (int) kept);
+    CHECK_EQ(memcmp(seen->bookings, before->bookings + 1, kept * sizeof(StoredBooking)), 0);
+
+    b = booking("frank", 1, 1, "IIIII");
+    CHECK_EQ(journalInsert(0, &b), 0);
+    CHECK_EQ(b.id, first + JOURNAL_COMPACT_MIN);
+
+    free(seen);
+    free(before);
+}
+
+
+int
+main(void)
+{
+    char compact_path[sizeof(path_g) + 8];
+
+    if (mkdtemp(dir_g) == NULL){
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(path_g, sizeof(path_g), "%s/%s", dir_g, JOURNAL_NAME);
+
+    testReplay();
+    testTorn();
+    testTail();
+    testCompaction();
+
+    snprintf(compact_path, sizeof(compact_path), "%s.compact", path_g);
+    unlink(compact_path);
+    unlink(path_g);
+    rmdir(dir_g);
+
+    return checkDone("journal");
+}
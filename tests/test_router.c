@@ -0,0 +1,523 @@
+/**
+ * @name            hotel-booking
+ * @file            test_router.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 16:03:55 CET 2026
+ * @brief           router: the first frames of a session pick its shard, or close it (router.c)
+ *
+ *
+ * usage            test_router <router executable> <server executable>
+ *
+ * Runs the router in front of two fake shards, listening sockets of the
+ * test itself, and checks which one each session lands on and what it gets.
+ * Then in front of two servers, to check a connection can't change hotel
+ * (and so shard) once it's routed.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>     // PATH_MAX
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// networking
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "Check.h"
+#include "HashRing.h"
+#include "messages.h"
+
+
+#define WAIT_MS     2000    // long enough for the router to act
+#define QUIET_MS    200     // long enough to tell it didn't
+
+
+static HashRing ring_g;             // of the fake shards
+static HashRing server_ring_g;      // of the servers
+static int      shards_g[2];
+static int      router_port_g;
+
+
+static int
+listenOn(int* port)
+{
+    struct sockaddr_in addr;
+    socklen_t          len = sizeof(addr);
+    int                fd  = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, '\0', sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, BACKLOG) != 0 ||
+        getsockname(fd, (struct sockaddr*) &addr, &len) != 0){
+        perror_die("listenOn()");
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+
+/**
+ * return a socket connected to `port`, -1 if nothing listens there within WAIT_MS
+ */
+static int
+connectTo(int port)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, '\0', sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int waited = 0; waited < WAIT_MS; waited += 10){
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0){
+            return fd;
+        }
+        close(fd);
+        usleep(10 * 1000);
+    }
+    return -1;
+}
+
+
+static int
+connectRouter(void)
+{
+    return connectTo(router_port_g);
+}
+
+
+/**
+ * Run `args` in the working directory `dir` (the current one if NULL), output discarded.
+ * return its pid
+ */
+static pid_t
+spawn(const char* dir, char* const* args)
+{
+    pid_t pid = fork();
+
+    if (pid == 0){
+        int null = open("/dev/null", O_WRONLY);
+
+        if (dir != NULL && chdir(dir) != 0){
+            perror_die("chdir()");
+        }
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execv(args[0], args);
+        _exit(127);
+    }
+    return pid;
+}
+
+
+/**
+ * return a port nothing listens on
+ */
+static int
+freePort(void)
+{
+    int port;
+
+    close(listenOn(&port));
+    return port;
+}
+
+
+static void
+stop(pid_t pid)
+{
+    int status;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+}
+
+
+/**
+ * return the session the router opened to `listener` within `ms`, -1 if none
+ */
+static int
+acceptWithin(int listener, int ms)
+{
+    struct pollfd p = { .fd = listener, .events = POLLIN };
+
+    return poll(&p, 1, ms) == 1 ? accept(listener, NULL, NULL) : -1;
+}
+
+
+/**
+ * Read `len` bytes, unless `fd` is closed or quiet for `ms` first.
+ * return bytes read
+ */
+static int
+readWithin(int fd, char* buf, int len, int ms)
+{
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    int           got = 0;
+
+    while (got < len && poll(&p, 1, ms) == 1){
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+
+        if (n <= 0){
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+
+/**
+ * return 1 if the peer of `fd` closes it within `ms` (nothing left to read), 0 otherwise
+ */
+static int
+closedWithin(int fd, int ms)
+{
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    char          byte;
+
+    if (poll(&p, 1, ms) != 1){
+        return 0;
+    }
+    ssize_t n = recv(fd, &byte, 1, 0);
+    return n == 0 || (n < 0 && errno == ECONNRESET);
+}
+
+
+/**
+ * Frame `msg` as the client and the server do: 4-byte big-endian length, then the bytes.
+ * return length of the frame
+ */
+static int
+frame(char* out, const char* msg)
+{
+    uint32_t dim = htonl(strlen(msg));
+
+    memcpy(out, &dim, sizeof(dim));
+    memcpy(out + sizeof(dim), msg, strlen(msg));
+    return sizeof(dim) + strlen(msg);
+}
+
+
+static void
+sendAll(int fd, const char* buf, int len)
+{
+    CHECK_EQ(send(fd, buf, len, 0), len);
+}
+
+
+/**
+ * Read one frame into `msg` (NUL terminated), within WAIT_MS.
+ * return its length, -1 if none came
+ */
+static int
+readFrame(int fd, char* msg, uint32_t size)
+{
+    uint32_t dim;
+
+    if (readWithin(fd, (char*) &dim, sizeof(dim), WAIT_MS) != sizeof(dim) || (dim = ntohl(dim)) >= size ||
+        readWithin(fd, msg, dim, WAIT_MS) != (int) dim){
+        return -1;
+    }
+    msg[dim] = '\0';
+    return dim;
+}
+
+
+/**
+ * Send `msg` as one frame and read the reply into `reply`.
+ * return length of the reply, -1 if none came
+ */
+static int
+ask(int fd, const char* msg, char* reply, uint32_t size)
+{
+    char sent[64];
+
+    sendAll(fd, sent, frame(sent, msg));
+    return readFrame(fd, reply, size);
+}
+
+
+/**
+ * Shard the router sends `hotel` to.
+ */
+static int
+shardOf(uint32_t hotel)
+{
+    return shards_g[hashRingLookup(&ring_g, hotel)];
+}
+
+
+static int
+otherShard(int shard)
+{
+    return shard == shards_g[0] ? shards_g[1] : shards_g[0];
+}
+
+
+static void
+testDefaultHotel(void)
+{
+    char sent[64], got[64];
+    int  len, client, shard;
+
+    // a session starting with anything else than a hotel pick goes to the default hotel, frames untouched
+    client = connectRouter();
+    CHECK(client >= 0);
+    len  = frame(sent, LOGIN_MSG);
+    len += frame(sent + len, "alice");
+    sendAll(client, sent, len);
+
+    shard = acceptWithin(shardOf(HOTEL_ID_DEFAULT), WAIT_MS);
+    CHECK(shard >= 0);
+    CHECK_EQ(readWithin(shard, got, len, WAIT_MS), len);
+    CHECK(memcmp(got, sent, len) == 0);
+    CHECK_EQ(acceptWithin(otherShard(shardOf(HOTEL_ID_DEFAULT)), QUIET_MS), -1);
+
+    // and the replies come back
+    len = frame(sent, "OK");
+    sendAll(shard, sent, len);
+    CHECK_EQ(readWithin(client, got, len, WAIT_MS), len);
+    CHECK(memcmp(got, sent, len) == 0);
+
+    // a shard closing the session closes the client
+    close(shard);
+    CHECK(closedWithin(client, WAIT_MS));
+    close(client);
+}
+
+
+static void
+testHotelPick(void)
+{
+    char     sent[64], got[64], id[16];
+    int      len, client, shard;
+    uint32_t hotel = HOTEL_ID_DEFAULT + 1;
+
+    // a hotel the default one doesn't share a shard with
+    while (shardOf(hotel) == shardOf(HOTEL_ID_DEFAULT)){
+        hotel++;
+    }
+    snprintf(id, sizeof(id), "%u", hotel);
+
+    client = connectRouter();
+    CHECK(client >= 0);
+    len  = frame(sent, HOTEL_MSG);
+    len += frame(sent + len, id);
+    len += frame(sent + len, LOGIN_MSG);
+
+    // the pick arrives a few bytes at a time: the router waits for both frames
+    sendAll(client, sent, 2);
+    usleep(50 * 1000);
+    sendAll(client, sent + 2, 5);
+    CHECK_EQ(acceptWithin(shardOf(hotel), QUIET_MS), -1);
+    sendAll(client, sent + 7, len - 7);
+
+    shard = acceptWithin(shardOf(hotel), WAIT_MS);
+    CHECK(shard >= 0);
+    CHECK_EQ(readWithin(shard, got, len, WAIT_MS), len);
+    CHECK(memcmp(got, sent, len) == 0);
+    CHECK_EQ(acceptWithin(shardOf(HOTEL_ID_DEFAULT), QUIET_MS), -1);
+
+    close(client);
+    CHECK(closedWithin(shard, WAIT_MS));
+    close(shard);
+}
+
+
+static void
+testUnroutable(void)
+{
+    char     sent[64];
+    uint32_t dim;
+    int      len, client;
+
+    // a first frame that can't fit in the router's buffer is never waited for
+    client = connectRouter();
+    CHECK(client >= 0);
+    dim = htonl(ROUTER_BUFFER_SIZE);
+    sendAll(client, (char*) &dim, sizeof(dim));
+    CHECK(closedWithin(client, WAIT_MS));
+    close(client);
+
+    // nor is a hotel ID longer than any
+    client = connectRouter();
+    CHECK(client >= 0);
+    len = frame(sent, HOTEL_MSG);
+    dim = htonl(16);
+    memcpy(sent + len, &dim, sizeof(dim));
+    sendAll(client, sent, len + sizeof(dim));
+    CHECK(closedWithin(client, WAIT_MS));
+    close(client);
+
+    // a client gone before its first frame is whole never reaches a shard
+    client = connectRouter();
+    CHECK(client >= 0);
+    len = frame(sent, LOGIN_MSG);
+    sendAll(client, sent, len - 1);
+    close(client);
+
+    CHECK_EQ(acceptWithin(shards_g[0], QUIET_MS), -1);
+    CHECK_EQ(acceptWithin(shards_g[1], QUIET_MS), -1);
+}
+
+
+/**
+ * Pick `hotel` (a frame of its own, as the client sends it) and read the reply into `reply`.
+ */
+static void
+pick(int fd, const char* hotel, char* reply, uint32_t size)
+{
+    char sent[64];
+    int  len;
+
+    len  = frame(sent, HOTEL_MSG);
+    len += frame(sent + len, hotel);
+    sendAll(fd, sent, len);
+    if (readFrame(fd, reply, size) < 0){
+        strcpy(reply, "(none)");
+    }
+}
+
+
+static void
+testHotelFixed(char* router_path, char* server_path)
+{
+    char     dirs[2][32], ports[2][8], shard_arg[2][32], router_port[8], reply[BUFSIZE], other[16], cleanup[128];
+    int      port[2], client;
+    pid_t    servers[2], router;
+    uint32_t hotel = HOTEL_ID_DEFAULT + 1;
+
+    for (int i = 0; i < 2; i++){
+        Address shard = { .ip = "127.0.0.1" };
+
+        strcpy(dirs[i], "/tmp/hotel-router-XXXXXX");
+        CHECK(mkdtemp(dirs[i]) != NULL);
+        shard.port = port[i] = freePort();
+        snprintf(ports[i], sizeof(ports[i]), "%d", port[i]);
+        snprintf(shard_arg[i], sizeof(shard_arg[i]), "%s:%d", shard.ip, shard.port);
+        hashRingAdd(&server_ring_g, &shard);
+
+        char* args[] = { server_path, "127.0.0.1", ports[i], "5", NULL };
+        servers[i] = spawn(dirs[i], args);
+    }
+    for (int i = 0; i < 2; i++){
+        client = connectTo(port[i]);
+        CHECK(client >= 0);
+        close(client);
+    }
+
+    router_port_g = freePort();
+    snprintf(router_port, sizeof(router_port), "%d", router_port_g);
+    char* args[] = { router_path, "127.0.0.1", router_port, shard_arg[0], shard_arg[1], NULL };
+    router = spawn(NULL, args);
+
+    // a hotel on the other shard than the default one
+    while (hashRingLookup(&server_ring_g, hotel) == hashRingLookup(&server_ring_g, HOTEL_ID_DEFAULT)){
+        hotel++;
+    }
+    snprintf(other, sizeof(other), "%u", hotel);
+
+    // the first pick is the connection's: another one, on another shard, is turned down even after a logout
+    client = connectRouter();
+    CHECK(client >= 0);
+    pick(client, other, reply, sizeof(reply));
+    CHECK(strcmp(reply, "OK") == 0);
+    pick(client, "1", reply, sizeof(reply));
+    CHECK(strcmp(reply, NO_HOTEL_MSG) == 0);
+    sendAll(client, reply, frame(reply, LOGOUT_MSG));
+    pick(client, "1", reply, sizeof(reply));
+    CHECK(strcmp(reply, NO_HOTEL_MSG) == 0);
+    pick(client, other, reply, sizeof(reply));      // the same one again is fine (e.g. after BUSY)
+    CHECK(strcmp(reply, "OK") == 0);
+    close(client);
+
+    // so is the default hotel of a session starting with anything else
+    client = connectRouter();
+    CHECK(client >= 0);
+    CHECK_EQ(ask(client, HELP_MSG, reply, sizeof(reply)), 1);
+    pick(client, other, reply, sizeof(reply));
+    CHECK(strcmp(reply, NO_HOTEL_MSG) == 0);
+    pick(client, "1", reply, sizeof(reply));
+    CHECK(strcmp(reply, "OK") == 0);
+    close(client);
+
+    // a first pick that isn't a hotel ID leaves the connection in no hotel
+    client = connectRouter();
+    CHECK(client >= 0);
+    pick(client, "1abc", reply, sizeof(reply));
+    CHECK(strcmp(reply, NO_HOTEL_MSG) == 0);
+    pick(client, "1", reply, sizeof(reply));
+    CHECK(strcmp(reply, NO_HOTEL_MSG) == 0);
+    close(client);
+
+    stop(router);
+    for (int i = 0; i < 2; i++){
+        stop(servers[i]);
+        snprintf(cleanup, sizeof(cleanup), "rm -rf %s", dirs[i]);
+        CHECK_EQ(system(cleanup), 0);
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    char    router_port[8], shard_arg[2][32];
+    char    router_path[PATH_MAX], server_path[PATH_MAX];
+    pid_t   router;
+    int     client;
+
+    if (argc != 3){
+        printf("Usage: %s <router executable> <server executable>\n", argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // the same ring as the router's: shards are added in the same order
+    for (int i = 0; i < 2; i++){
+        Address shard = { .ip = "127.0.0.1" };
+
+        shards_g[i] = listenOn(&shard.port);
+        hashRingAdd(&ring_g, &shard);
+        snprintf(shard_arg[i], sizeof(shard_arg[i]), "%s:%d", shard.ip, shard.port);
+    }
+
+    router_port_g = freePort();
+    snprintf(router_port, sizeof(router_port), "%d", router_port_g);
+
+    char* args[] = { argv[1], "127.0.0.1", router_port, shard_arg[0], shard_arg[1], NULL };
+    router = spawn(NULL, args);
+
+    testDefaultHotel();
+    testHotelPick();
+    testUnroutable();
+
+    // still serving after all that
+    client = connectRouter();
+    CHECK(client >= 0);
+    close(client);
+    stop(router);
+
+    // the servers run in a directory of their own
+    if (realpath(argv[1], router_path) == NULL || realpath(argv[2], server_path) == NULL){
+        perror_die("realpath()");
+    }
+    testHotelFixed(router_path, server_path);
+
+    return checkDone("router");
+}
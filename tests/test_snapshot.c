@@ -0,0 +1,301 @@
+/**
+ * @name            hotel-booking
+ * @file            test_snapshot.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 16:03:55 CET 2026
+ * @brief           snapshot of the live bookings: write, check, warm up from it plus the tail (Snapshot.h)
+ */
+
+#include <stddef.h>
+
+#include "Check.h"
+#include "Journal.h"
+#include "Snapshot.h"
+
+
+#define MAX_ID      (4 * JOURNAL_COMPACT_MIN)
+
+
+/**
+ * The live bookings as the server's indexes would see them, by id.
+ */
+typedef struct warm {
+    StoredBooking   bookings[MAX_ID];
+    int             live[MAX_ID];
+    int             count;
+} Warm;
+
+
+static char dir_g[] = "/tmp/hotel-snapshot-XXXXXX";
+static char journal_path_g[64];
+static char snapshot_path_g[64];
+
+
+static int
+warmup(const StoredBooking* b, void* payload)
+{
+    Warm* w = (Warm*) payload;
+
+    if (b->id <= 0 || b->id >= MAX_ID){
+        return 1;
+    }
+    w->count += !w->live[b->id];
+    w->live[b->id]     = 1;
+    w->bookings[b->id] = *b;
+    return 0;
+}
+
+
+static int
+warmdown(const StoredBooking* b, void* payload)
+{
+    Warm* w = (Warm*) payload;
+
+    if (b->id <= 0 || b->id >= MAX_ID){
+        return 1;
+    }
+    w->count -= w->live[b->id];
+    w->live[b->id] = 0;
+    return 0;
+}
+
+
+/**
+ * Warm `w` up the way the server starts: the snapshot, then what the storage changed after it.
+ * return 0 if OK, -1 without a usable snapshot, 1 if the snapshot is stale
+ */
+static int
+load(Warm* w)
+{
+    Snapshot      snapshot;
+    StoredBooking b;
+    int           rv;
+
+    memset(w, 0, sizeof(Warm));
+    if (snapshotOpen(snapshot_path_g, &snapshot) != 0){
+        return -1;
+    }
+    for (uint64_t i = 0; i < snapshot.header->count; i++){
+        snapshotBooking(&snapshot, i, &b);
+        warmup(&b, w);
+    }
+    rv = journal_storage.tail(0, &snapshot.header->cursor, warmup, warmdown, w);
+
+    snapshotClose(&snapshot);
+    return rv;
+}
+
+
+/**
+ * Whether `w` holds exactly the live bookings of the journal.
+ */
+static int
+matchesJournal(const Warm* w)
+{
+    Warm* scanned = calloc(1, sizeof(Warm));
+    int   same;
+
+    journal_storage.scan(0, NULL, warmup, scanned);
+    same = memcmp(scanned->live, w->live, sizeof(w->live)) == 0 && scanned->count == w->count;
+    for (int id = 1; same && id < MAX_ID; id++){
+        same = !w->live[id] || memcmp(&w->bookings[id], &scanned->bookings[id], sizeof(StoredBooking)) == 0;
+    }
+
+    free(scanned);
+    return same;
+}
+
+
+static int64_t
+insert(const char* username, int room, uint32_t hotel, const char* code)
+{
+    StoredBooking b;
+
+    memset(&b, '\0', sizeof(b));
+    strncpy(b.username, username, sizeof(b.username) - 1);
+    strncpy(b.code, code, sizeof(b.code) - 1);
+    b.day   = daysFromCivil(2027, 8, 20);
+    b.room  = room;
+    b.hotel = hotel;
+
+    return journal_storage.insert(0, &b) == 0 ? b.id : -1;
+}
+
+
+/**
+ * Flip one byte of the file at `path`.
+ */
+static void
+damage(const char* path, off_t offset)
+{
+    char byte;
+    int  fd = open(path, O_RDWR);
+
+    if (pread(fd, &byte, 1, offset) == 1){
+        byte ^= 0x01;
+        CHECK_EQ(pwrite(fd, &byte, 1, offset), 1);
+    }
+    close(fd);
+}
+
+
+static void
+testRoundTrip(void)
+{
+    Warm*         w = calloc(1, sizeof(Warm));
+    Snapshot      snapshot;
+    StorageCursor cursor;
+    StoredBooking b;
+    char          tmp_path[sizeof(snapshot_path_g) + 4];
+
+    // no snapshot yet
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), -1);
+    CHECK(snapshot.map == NULL);
+
+    CHECK_EQ(journal_storage.open(journal_path_g), 0);
+    for (int room = 1; room <= 20; room++){
+        CHECK(insert(room % 2 ? "alice" : "bob", room, 1 + room % 3, "ABCDE") > 0);
+    }
+    CHECK_EQ(journal_storage.remove(0, 4), 0);
+
+    CHECK_EQ(snapshotTake(&journal_storage, 0, snapshot_path_g, &cursor), 0);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", snapshot_path_g);
+    CHECK(access(tmp_path, F_OK) != 0);
+
+    // what went in comes out, with the cursor it was taken at
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), 0);
+    CHECK_EQ(snapshot.header->count, 19);
+    CHECK_EQ(snapshot.header->cursor.position, cursor.position);
+    CHECK_EQ(snapshot.header->cursor.max_id, 20);
+    snapshotBooking(&snapshot, 3, &b);
+    CHECK_EQ(b.id, 5);
+    CHECK_EQ(b.room, 5);
+    CHECK_EQ(b.hotel, 3);
+    CHECK_EQ(b.day, daysFromCivil(2027, 8, 20));
+    CHECK(strcmp(b.username, "alice") == 0);
+    CHECK(strcmp(b.code, "ABCDE") == 0);
+    snapshotClose(&snapshot);
+    CHECK(snapshot.map == NULL);
+
+    CHECK_EQ(load(w), 0);
+    CHECK_EQ(w->count, 19);
+    CHECK(matchesJournal(w));
+
+    free(w);
+}
+
+
+static void
+testTail(void)
+{
+    Warm*   w = calloc(1, sizeof(Warm));
+    int64_t added;
+
+    // changes after the snapshot come from the storage
+    added = insert("carol", 30, 2, "FGHIJ");
+    CHECK(added > 0);
+    CHECK_EQ(journal_storage.remove(0, 7), 0);
+    CHECK_EQ(journal_storage.remove(0, added), 0);
+    CHECK(insert("carol", 31, 2, "KLMNO") > 0);
+
+    CHECK_EQ(load(w), 0);
+    CHECK_EQ(w->count, 19);
+    CHECK(!w->live[7]);
+    CHECK(!w->live[added]);
+    CHECK(w->live[added + 1]);
+    CHECK(matchesJournal(w));
+
+    free(w);
+}
+
+
+static void
+testDamaged(void)
+{
+    Warm*         w = calloc(1, sizeof(Warm));
+    Snapshot      snapshot;
+    StorageCursor cursor;
+    struct stat   st;
+
+    CHECK_EQ(snapshotTake(&journal_storage, 0, snapshot_path_g, &cursor), 0);
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), 0);
+    snapshotClose(&snapshot);
+    CHECK_EQ(stat(snapshot_path_g, &st), 0);
+
+    // a flipped bit in a record fails the checksum
+    damage(snapshot_path_g, sizeof(SnapshotHeader) + offsetof(SnapshotRecord, room));
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), -1);
+    CHECK(snapshot.map == NULL);
+    damage(snapshot_path_g, sizeof(SnapshotHeader) + offsetof(SnapshotRecord, room));
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), 0);
+    snapshotClose(&snapshot);
+
+    // so does one in the magic
+    damage(snapshot_path_g, 0);
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), -1);
+    damage(snapshot_path_g, 0);
+
+    // a snapshot cut short
+    CHECK_EQ(truncate(snapshot_path_g, st.st_size - 1), 0);
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), -1);
+    CHECK_EQ(truncate(snapshot_path_g, sizeof(SnapshotHeader) - 1), 0);
+    CHECK_EQ(snapshotOpen(snapshot_path_g, &snapshot), -1);
+    CHECK_EQ(load(w), -1);
+
+    free(w);
+}
+
+
+static void
+testStale(void)
+{
+    Warm*         w = calloc(1, sizeof(Warm));
+    StorageCursor cursor;
+    int64_t       first, id;
+
+    CHECK_EQ(snapshotTake(&journal_storage, 0, snapshot_path_g, &cursor), 0);
+    CHECK_EQ(load(w), 0);
+
+    // a compaction rewrites the history the cursor points into
+    first = insert("dave", 1, 1, "PQRST");
+    for (int i = 1; i < JOURNAL_COMPACT_MIN; i++){
+        insert("dave", 1 + i % (HOTEL_MAX_ROOMS - 1), 1, "PQRST");
+    }
+    for (id = first; journal_g.compactions == 0 && id < first + JOURNAL_COMPACT_MIN; id++){
+        CHECK_EQ(journal_storage.remove(0, id), 0);
+    }
+    CHECK_EQ(journal_g.compactions, 1);
+    CHECK_EQ(load(w), 1);
+
+    // the next snapshot is taken against the compacted journal
+    CHECK_EQ(snapshotTake(&journal_storage, 0, snapshot_path_g, &cursor), 0);
+    CHECK_EQ(cursor.generation, 1);
+    CHECK_EQ(load(w), 0);
+    CHECK(matchesJournal(w));
+
+    free(w);
+}
+
+
+int
+main(void)
+{
+    if (mkdtemp(dir_g) == NULL){
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(journal_path_g,  sizeof(journal_path_g),  "%s/%s", dir_g, JOURNAL_NAME);
+    snprintf(snapshot_path_g, sizeof(snapshot_path_g), "%s/%s", dir_g, SNAPSHOT_NAME);
+
+    testRoundTrip();
+    testTail();
+    testDamaged();
+    testStale();
+
+    unlink(journal_path_g);
+    unlink(snapshot_path_g);
+    rmdir(dir_g);
+
+    return checkDone("snapshot");
+}
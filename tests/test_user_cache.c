@@ -0,0 +1,179 @@
+/**
+ * @name            hotel-booking
+ * @file            test_user_cache.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 16:03:55 CET 2026
+ * @brief           reservation cache of `view`: fills, updates racing a fill, eviction (UserCache.h)
+ */
+
+#include "Check.h"
+#include "UserCache.h"
+
+
+static CachedBooking
+booking(int year, int month, int day, int room, uint32_t hotel, const char* code)
+{
+    CachedBooking b;
+
+    memset(&b, 0, sizeof(b));
+    b.day   = daysFromCivil(year, month, day);
+    b.room  = room;
+    b.hotel = hotel;
+    strncpy(b.code, code, sizeof(b.code) - 1);
+    return b;
+}
+
+
+static void
+testFill(void)
+{
+    UserCache     c;
+    char          out[BUFSIZE];
+    uint64_t      generation = 0;
+    CachedBooking loaded[] = {
+        booking(2027, 3, 1, 4, 1, "AAAAA"),
+        booking(2027, 5, 9, 2, 2, "BBBBB"),
+    };
+
+    initializeUserCache(&c, 8);
+
+    // nothing to fill without the miss that made the entry
+    CHECK_EQ(userCacheFill(&c, "alice", generation, loaded, 2), -1);
+
+    CHECK_EQ(userCacheRender(&c, "alice", 1, out, sizeof(out), &generation), -1);
+    CHECK_EQ(c.misses, 1);
+    CHECK_EQ(userCacheFill(&c, "alice", generation, loaded, 2), 0);
+
+    // a second load of the same miss is left out
+    CHECK_EQ(userCacheFill(&c, "alice", generation, loaded, 1), -1);
+
+    // only the bookings in the hotel asked for
+    CHECK_EQ(userCacheRender(&c, "alice", 1, out, sizeof(out), &generation), 1);
+    CHECK(strcmp(out, "01/03/2027 4     AAAAA") == 0);
+    CHECK_EQ(userCacheRender(&c, "alice", 2, out, sizeof(out), &generation), 1);
+    CHECK_EQ(userCacheRender(&c, "alice", 3, out, sizeof(out), &generation), 0);
+    CHECK_EQ(c.hits, 3);
+}
+
+
+static void
+testStaleLoads(void)
+{
+    UserCache     c;
+    char          out[BUFSIZE];
+    uint64_t      first, second, third;
+    CachedBooking before[] = { booking(2027, 3, 1, 4, 1, "AAAAA") };
+    CachedBooking added    = booking(2027, 2, 1, 7, 1, "CCCCC");
+    CachedBooking after[]  = { added, before[0] };
+
+    initializeUserCache(&c, 8);
+
+    // two views of the same user miss, a reservation lands, then a third view misses
+    CHECK_EQ(userCacheRender(&c, "bob", 1, out, sizeof(out), &first), -1);
+    CHECK_EQ(userCacheRender(&c, "bob", 1, out, sizeof(out), &second), -1);
+    CHECK_EQ(first, second);
+    userCacheAdd(&c, "bob", &added);
+    CHECK_EQ(userCacheRender(&c, "bob", 1, out, sizeof(out), &third), -1);
+    CHECK(third != first);
+
+    // the loads started before the reservation are stale, whatever the order they end in
+    CHECK_EQ(userCacheFill(&c, "bob", second, before, 1), -1);
+    CHECK_EQ(userCacheFill(&c, "bob", first, before, 1), -1);
+    CHECK_EQ(userCacheRender(&c, "bob", 1, out, sizeof(out), &first), -1);
+
+    // the ones started after it publish (the first of them only)
+    CHECK_EQ(userCacheFill(&c, "bob", third, after, 2), 0);
+    CHECK_EQ(userCacheFill(&c, "bob", first, after, 2), -1);
+    CHECK_EQ(userCacheRender(&c, "bob", 1, out, sizeof(out), &first), 2);
+
+    // a release in the middle of a load too
+    CHECK_EQ(userCacheRender(&c, "carol", 1, out, sizeof(out), &first), -1);
+    userCacheRemove(&c, "carol", 1, before[0].day, before[0].room);
+    CHECK_EQ(userCacheFill(&c, "carol", first, before, 1), -1);
+    CHECK_EQ(userCacheRender(&c, "carol", 1, out, sizeof(out), &first), -1);
+}
+
+
+static void
+testUpdates(void)
+{
+    UserCache     c;
+    char          out[BUFSIZE];
+    uint64_t      generation;
+    CachedBooking first   = booking(2027, 6, 10, 1, 1, "AAAAA");
+    CachedBooking earlier = booking(2027, 1, 10, 9, 1, "BBBBB");
+
+    initializeUserCache(&c, 8);
+
+    CHECK_EQ(userCacheRender(&c, "dave", 1, out, sizeof(out), &generation), -1);
+    CHECK_EQ(userCacheFill(&c, "dave", generation, &first, 1), 0);
+
+    userCacheAdd(&c, "dave", &earlier);
+    userCacheAdd(&c, "dave", &earlier);     // the load raced with it: not twice
+    CHECK_EQ(userCacheRender(&c, "dave", 1, out, sizeof(out), &generation), 2);
+    #if SORT_VIEW_BY_DATE
+        CHECK(strncmp(out, "10/01/2027", 10) == 0);
+    #endif
+
+    // past the capacity of the first fill
+    for (int i = 0; i < 2 * MAX_BOOKINGS_PER_USER; i++){
+        CachedBooking b = booking(2028, 1, 1 + i, 1, 1, "DDDDD");
+
+        userCacheAdd(&c, "dave", &b);
+    }
+    CHECK_EQ(userCacheRender(&c, "dave", 1, out, sizeof(out), &generation), 2 + 2 * MAX_BOOKINGS_PER_USER);
+
+    userCacheRemove(&c, "dave", 1, earlier.day, earlier.room);
+    userCacheRemove(&c, "dave", 2, first.day, first.room);   // another hotel: not that one
+    CHECK_EQ(userCacheRender(&c, "dave", 1, out, sizeof(out), &generation), 1 + 2 * MAX_BOOKINGS_PER_USER);
+    #if SORT_VIEW_BY_DATE
+        CHECK(strncmp(out, "10/06/2027", 10) == 0);
+    #endif
+}
+
+
+static void
+testEviction(void)
+{
+    UserCache     c;
+    char          out[BUFSIZE];
+    uint64_t      generation, evicted;
+    CachedBooking b = booking(2027, 3, 1, 4, 1, "AAAAA");
+
+    initializeUserCache(&c, 2);
+
+    userCacheRender(&c, "a", 1, out, sizeof(out), &generation);
+    userCacheFill(&c, "a", generation, &b, 1);
+    userCacheRender(&c, "b", 1, out, sizeof(out), &generation);
+    userCacheFill(&c, "b", generation, &b, 1);
+
+    // "a" used last: "b" makes room for "c"
+    CHECK_EQ(userCacheRender(&c, "a", 1, out, sizeof(out), &generation), 1);
+    CHECK_EQ(userCacheRender(&c, "c", 1, out, sizeof(out), &generation), -1);
+    CHECK_EQ(c.evictions, 1);
+    CHECK_EQ(c.users, 2);
+
+    CHECK_EQ(userCacheRender(&c, "a", 1, out, sizeof(out), &generation), 1);
+    CHECK_EQ(userCacheFill(&c, "b", generation, &b, 1), -1);
+
+    // a load outliving the eviction of its entry doesn't fill the one a later miss makes
+    CHECK_EQ(userCacheRender(&c, "c", 1, out, sizeof(out), &evicted), -1);
+    CHECK_EQ(userCacheRender(&c, "d", 1, out, sizeof(out), &generation), -1);
+    CHECK_EQ(c.evictions, 2);
+    CHECK_EQ(userCacheRender(&c, "c", 1, out, sizeof(out), &generation), -1);
+    CHECK_EQ(userCacheFill(&c, "c", evicted, &b, 1), -1);
+    CHECK_EQ(userCacheFill(&c, "c", generation, &b, 1), 0);
+}
+
+
+int
+main(void)
+{
+    testFill();
+    testStaleLoads();
+    testUpdates();
+    testEviction();
+
+    return checkDone("user_cache");
+}
@@ -0,0 +1,156 @@
+/**
+ * @name            hotel-booking
+ * @file            test_user_quota.c
+ * @author          Francesco Urbani <https://urbanij.github.io/>
+ *
+ * @date            Mon Nov  2 15:41:26 CET 2026
+ * @brief           per-user booking quota: the compare-and-swap never lets a user over it (UserQuota.h)
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "Check.h"
+#include "UserQuota.h"
+
+
+#define MAX_BOOKINGS    5
+#define THREADS         8
+#define ROUNDS          20000
+#define USERS           64
+
+
+static UserQuota    quota_g;
+static int          held_g;             // bookings taken and not given back yet, of "racer"
+static int          most_held_g;        // the most seen at once
+
+
+static void
+testSingle(void)
+{
+    UserQuotaEntry top[2];
+
+    initializeUserQuota(&quota_g, MAX_BOOKINGS);
+
+    for (int i = 0; i < MAX_BOOKINGS; i++){
+        CHECK_EQ(userQuotaAcquire(&quota_g, "alice"), 0);
+    }
+    CHECK_EQ(userQuotaAcquire(&quota_g, "alice"), -1);
+    CHECK_EQ(userQuotaBookings(&quota_g, "alice"), MAX_BOOKINGS);
+
+    userQuotaRelease(&quota_g, "alice");
+    CHECK_EQ(userQuotaBookings(&quota_g, "alice"), MAX_BOOKINGS - 1);
+    CHECK_EQ(userQuotaAcquire(&quota_g, "alice"), 0);
+
+    // never below zero
+    userQuotaRelease(&quota_g, "bob");
+    CHECK_EQ(userQuotaBookings(&quota_g, "bob"), 0);
+
+    userQuotaSet(&quota_g, "carol", 2);
+    CHECK_EQ(userQuotaBookings(&quota_g, "carol"), 2);
+    CHECK_EQ(quota_g.users, 3);
+
+    CHECK_EQ(userQuotaTop(&quota_g, top, 2), 2);
+    CHECK(strcmp(top[0].username, "alice") == 0 && top[0].bookings == MAX_BOOKINGS);
+    CHECK(strcmp(top[1].username, "carol") == 0 && top[1].bookings == 2);
+}
+
+
+/**
+ * Every thread takes what it can out of the same user's quota, giving some back.
+ */
+static void*
+racer(void* opaque)
+{
+    unsigned int seed  = (unsigned int) (uintptr_t) opaque;
+    int          mine  = 0;
+
+    for (int i = 0; i < ROUNDS; i++){
+        if (userQuotaAcquire(&quota_g, "racer") == 0){
+            int now = __atomic_add_fetch(&held_g, 1, __ATOMIC_ACQ_REL);
+            int most = __atomic_load_n(&most_held_g, __ATOMIC_RELAXED);
+
+            while (now > most && !__atomic_compare_exchange_n(&most_held_g, &most, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+            }
+            mine++;
+        }
+        if (mine > 0 && rand_r(&seed) % 2 == 0){
+            __atomic_sub_fetch(&held_g, 1, __ATOMIC_ACQ_REL);
+            userQuotaRelease(&quota_g, "racer");
+            mine--;
+        }
+    }
+
+    while (mine-- > 0){
+        __atomic_sub_fetch(&held_g, 1, __ATOMIC_ACQ_REL);
+        userQuotaRelease(&quota_g, "racer");
+    }
+    return NULL;
+}
+
+
+/**
+ * Every thread asks for the same new users at once: each gets one entry.
+ */
+static void*
+newcomer(void* opaque)
+{
+    UserQuotaEntry** seen = (UserQuotaEntry**) opaque;
+    char             username[USERNAME_MAX_LENGTH];
+
+    for (int u = 0; u < USERS; u++){
+        snprintf(username, sizeof(username), "new%02d", u);
+        seen[u] = userQuotaEntry(&quota_g, username);
+        userQuotaAcquire(&quota_g, username);
+    }
+    return NULL;
+}
+
+
+static void
+testConcurrent(void)
+{
+    pthread_t        threads[THREADS];
+    UserQuotaEntry*  seen[THREADS][USERS];
+    char             username[USERNAME_MAX_LENGTH];
+
+    initializeUserQuota(&quota_g, MAX_BOOKINGS);
+
+    for (int t = 0; t < THREADS; t++){
+        pthread_create(&threads[t], NULL, racer, (void*) (uintptr_t) (t + 1));
+    }
+    for (int t = 0; t < THREADS; t++){
+        pthread_join(threads[t], NULL);
+    }
+
+    CHECK(most_held_g <= MAX_BOOKINGS);
+    CHECK_EQ(most_held_g, MAX_BOOKINGS);        // 8 threads do fill it up
+    CHECK_EQ(userQuotaBookings(&quota_g, "racer"), 0);
+
+    for (int t = 0; t < THREADS; t++){
+        pthread_create(&threads[t], NULL, newcomer, seen[t]);
+    }
+    for (int t = 0; t < THREADS; t++){
+        pthread_join(threads[t], NULL);
+    }
+
+    CHECK_EQ(quota_g.users, 1 + USERS);
+    for (int u = 0; u < USERS; u++){
+        snprintf(username, sizeof(username), "new%02d", u);
+
+        for (int t = 1; t < THREADS; t++){
+            CHECK(seen[t][u] == seen[0][u]);
+        }
+        CHECK_EQ(userQuotaBookings(&quota_g, username), MAX_BOOKINGS);
+    }
+}
+
+
+int
+main(void)
+{
+    testSingle();
+    testConcurrent();
+
+    return checkDone("user_quota");
+}